@@ -0,0 +1,40 @@
+#!/bin/sh
+# Per connection memory and idle CPU of the server with many idle and slow (trickling) connections.
+# Run from the repository root after `make && make bench`, or through `make bench-conn`.
+#
+#   CONNECTIONS="1000 10000 50000" sh bench/conn/idle.sh > results.jsonl
+#
+# Every step opens CONNECTIONS idle and CONNECTIONS trickling connections. Above ~14000 the connections are
+# spread over several loopback source addresses; the file descriptor limits of both processes are raised
+# as far as the hard limit allows.
+
+CONNECTIONS=${CONNECTIONS:-"1000 10000"}
+CONFIG=${CONFIG:-examples/complete/complete.conf}
+PORT=${PORT:-8080}
+WINDOW=${WINDOW:-5s}
+INTERVAL=${INTERVAL:-1s}
+METRICS=${METRICS:-}	# path of a metrics location in CONFIG, counts loop wakeups exactly
+LOADGEN=./loadgen
+SERVER=./webserv
+SERVER_PID=
+
+stop_server() {
+	[ -n "$SERVER_PID" ] && kill "$SERVER_PID" 2> /dev/null && wait "$SERVER_PID" 2> /dev/null
+	SERVER_PID=
+}
+
+trap stop_server EXIT INT TERM
+
+for count in $CONNECTIONS; do
+	(ulimit -n $((count * 2 + 256)) 2> /dev/null || ulimit -n "$(ulimit -Hn)"; exec $SERVER "$CONFIG") \
+		> /dev/null 2>&1 &
+	SERVER_PID=$!
+	for _ in 1 2 3 4 5 6 7 8 9 10; do
+		$LOADGEN -c 1 -n 1 -T 1s --host localhost "http://127.0.0.1:$PORT/" > /dev/null 2>&1 && break
+		sleep 0.2
+	done
+	echo "running $count idle + $count trickle connections" >&2
+	./connbench --name "idle-$count" --pid "$SERVER_PID" --host localhost --idle "$count" --trickle "$count" \
+		--sources $((count * 2 / 14000 + 1)) --window "$WINDOW" --interval "$INTERVAL" ${METRICS:+--metrics "$METRICS"} "http://127.0.0.1:$PORT/"
+	stop_server
+done
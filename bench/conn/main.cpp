@@ -0,0 +1,517 @@
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+ * Memory and idle cost of many open connections: opens N idle connections and N connections that trickle a
+ * request header one byte at a time, and samples the server process (RSS, open file descriptors, CPU time and
+ * event loop wakeups) from /proc while they are open.
+ */
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t MAX_EVENTS = 1024;
+constexpr auto TICK = std::chrono::milliseconds(10);
+
+volatile sig_atomic_t stopRequested = 0;
+
+void stopSignalHandler(const int) { stopRequested = 1; }
+
+struct Options {
+		std::string host = "127.0.0.1";
+		int port = 8080;
+		std::string path = "/";
+		std::string hostHeader;
+		std::string metricsPath;
+		std::string name;
+		pid_t pid = 0;
+		size_t idle = 1000;
+		size_t trickle = 1000;
+		size_t sources = 1;
+		double rampRate = 2000;	 // new connections per second
+		std::chrono::milliseconds interval{1000};
+		std::chrono::milliseconds settle{1000};
+		std::chrono::milliseconds window{5000};
+};
+
+/**
+ * @brief Resource usage of the server process at one point in time
+ */
+struct ProcessSample {
+		Clock::time_point at;
+		uint64_t rssKb = 0;
+		size_t fds = 0;
+		uint64_t cpuTicks = 0;	// user + system time of all threads
+		uint64_t wakeups = 0;	// scraped from the metrics location, or context switches of the main thread
+};
+
+/**
+ * @brief Averages of one measurement window
+ */
+struct Phase {
+		const char* name = "";
+		size_t open = 0;
+		ProcessSample end;
+		double cpuPercent = 0;
+		double wakeupsPerSecond = 0;
+};
+
+struct Connection {
+		int fd = -1;
+		bool connected = false;
+		bool trickle = false;
+		size_t sent = 0;  // bytes of the header prefix already written
+};
+
+std::chrono::milliseconds parseTime(const char* value) {
+	char* end = nullptr;
+	const double number = std::strtod(value, &end);
+	if (end == value || number < 0)
+		throw std::invalid_argument(std::string("invalid time: ") + value);
+	const std::string unit(end);
+	double factor = 1000;
+	if (unit == "ms")
+		factor = 1;
+	else if (!unit.empty() && unit != "s")
+		throw std::invalid_argument(std::string("invalid time unit: ") + value);
+	return std::chrono::milliseconds(static_cast<int64_t>(number * factor));
+}
+
+uint64_t statusField(const std::string& status, const char* name) {
+	const size_t position = status.find(name);
+	if (position == std::string::npos)
+		return 0;
+	return std::strtoull(status.c_str() + position + std::strlen(name), nullptr, 10);
+}
+
+ProcessSample sample(const pid_t pid) {
+	ProcessSample result;
+	result.at = Clock::now();
+	const std::string proc = "/proc/" + std::to_string(pid);
+
+	std::ifstream statusFile(proc + "/status");
+	std::stringstream status;
+	status << statusFile.rdbuf();
+	if (!statusFile)
+		throw std::runtime_error("cannot read " + proc + "/status, is the server running?");
+	result.rssKb = statusField(status.str(), "VmRSS:");
+	result.wakeups = statusField(status.str(), "\nvoluntary_ctxt_switches:") +
+					 statusField(status.str(), "nonvoluntary_ctxt_switches:");
+
+	// utime and stime are the 12th and 13th field after the parenthesized command name
+	std::ifstream statFile(proc + "/stat");
+	std::string stat((std::istreambuf_iterator<char>(statFile)), std::istreambuf_iterator<char>());
+	std::istringstream fields(stat.substr(stat.rfind(')') + 2));
+	std::string field;
+	uint64_t utime = 0;
+	uint64_t stime = 0;
+	for (int i = 0; i < 11 && fields >> field; ++i) {
+	}
+	fields >> utime >> stime;
+	result.cpuTicks = utime + stime;
+
+	if (DIR* directory = opendir((proc + "/fd").c_str())) {
+		while (const dirent* entry = readdir(directory)) {
+			if (entry->d_name[0] != '.')
+				result.fds++;
+		}
+		closedir(directory);
+	}
+	return result;
+}
+
+/**
+ * @brief Read a counter from the server's metrics location, with a blocking request of its own
+ */
+uint64_t scrapeCounter(const Options& options, const std::string& name) {
+	const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	const timeval timeout{2, 0};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(static_cast<uint16_t>(options.port));
+	inet_pton(AF_INET, options.host.c_str(), &address.sin_addr);
+	const std::string request = "GET " + options.metricsPath + " HTTP/1.1\r\nHost: " +
+								(options.hostHeader.empty() ? options.host : options.hostHeader) +
+								"\r\nConnection: close\r\n\r\n";
+	std::string response;
+	if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 &&
+		send(fd, request.data(), request.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(request.size())) {
+		char buffer[16384];
+		ssize_t received;
+		while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) response.append(buffer, received);
+	}
+	close(fd);
+	const size_t position = response.find("\n" + name + " ");
+	if (position == std::string::npos)
+		throw std::runtime_error(name + " not found at " + options.metricsPath);
+	return std::strtoull(response.c_str() + position + name.size() + 2, nullptr, 10);
+}
+
+class ConnectionBench {
+	public:
+		explicit ConnectionBench(const Options& options) : _options(options) {
+			_epollFd = epoll_create1(EPOLL_CLOEXEC);
+			if (_epollFd == -1)
+				throw std::runtime_error(std::string("epoll_create1: ") + std::strerror(errno));
+			_prefix = "GET " + _options.path + " HTTP/1.1\r\nHost: " +
+					  (_options.hostHeader.empty() ? _options.host + ":" + std::to_string(_options.port)
+												   : _options.hostHeader) +
+					  "\r\nX-Trickle: ";
+			_connections.reserve(_options.idle + _options.trickle);
+		}
+
+		~ConnectionBench() {
+			for (const Connection& connection : _connections) {
+				if (connection.fd != -1)
+					close(connection.fd);
+			}
+			close(_epollFd);
+		}
+
+		ConnectionBench(const ConnectionBench&) = delete;
+		ConnectionBench& operator=(const ConnectionBench&) = delete;
+
+		Phase measure(const char* name) {
+			Phase phase;
+			phase.name = name;
+			_runFor(_options.settle);
+			const ProcessSample start = _sample();
+			_runFor(_options.window);
+			phase.end = _sample();
+			const double seconds = std::chrono::duration<double>(phase.end.at - start.at).count();
+			phase.open = _open;
+			phase.cpuPercent = static_cast<double>(phase.end.cpuTicks - start.cpuTicks) * 100.0 /
+							   static_cast<double>(sysconf(_SC_CLK_TCK)) / seconds;
+			phase.wakeupsPerSecond = static_cast<double>(phase.end.wakeups - start.wakeups) / seconds;
+			return phase;
+		}
+
+		/**
+		 * @brief Open `count` connections at the ramp rate and wait until they are established
+		 */
+		void openConnections(const size_t count, const bool trickle) {
+			const auto start = Clock::now();
+			for (size_t opened = 0; opened < count && !stopRequested;) {
+				const auto due = static_cast<size_t>(
+					std::chrono::duration<double>(Clock::now() - start).count() * _options.rampRate + 1);
+				for (; opened < std::min(due, count); ++opened) _connect(trickle);
+				_poll(TICK);
+			}
+			const auto deadline = Clock::now() + std::chrono::seconds(10);
+			while (_pending != 0 && Clock::now() < deadline && !stopRequested) _poll(TICK);
+		}
+
+		[[nodiscard]] size_t connectErrors() const { return _connectErrors; }
+		[[nodiscard]] size_t closedByServer() const { return _closedByServer; }
+
+	private:
+		ProcessSample _sample() const {
+			ProcessSample result = sample(_options.pid);
+			// A loop that never blocks returns from poll without a context switch, the server's counter sees it
+			if (!_options.metricsPath.empty())
+				result.wakeups = scrapeCounter(_options, "webserv_event_loop_wakeups_total");
+			return result;
+		}
+
+		void _connect(const bool trickle) {
+			const int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+			if (fd == -1) {
+				_connectErrors++;
+				return;
+			}
+			// A source address has ~28000 ephemeral ports towards one destination, spread beyond that
+			if (_options.sources > 1) {
+				sockaddr_in source{};
+				source.sin_family = AF_INET;
+				source.sin_addr.s_addr = htonl(INADDR_LOOPBACK + _connections.size() % _options.sources);
+				bind(fd, reinterpret_cast<sockaddr*>(&source), sizeof(source));
+			}
+			sockaddr_in address{};
+			address.sin_family = AF_INET;
+			address.sin_port = htons(static_cast<uint16_t>(_options.port));
+			inet_pton(AF_INET, _options.host.c_str(), &address.sin_addr);
+			if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 && errno != EINPROGRESS) {
+				close(fd);
+				_connectErrors++;
+				return;
+			}
+			_connections.push_back({fd, false, trickle, 0});
+			epoll_event event{};
+			event.events = EPOLLOUT | EPOLLIN | EPOLLRDHUP;
+			event.data.u64 = _connections.size() - 1;
+			epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &event);
+			_pending++;
+		}
+
+		void _drop(Connection& connection, const bool byServer) {
+			if (connection.fd == -1)
+				return;
+			close(connection.fd);
+			connection.fd = -1;
+			if (connection.connected) {
+				_open--;
+				_closedByServer += byServer;
+			} else {
+				_pending--;
+				_connectErrors++;
+			}
+		}
+
+		void _onEvent(Connection& connection, const uint32_t events) {
+			if (!connection.connected && (events & EPOLLOUT)) {
+				int error = 0;
+				socklen_t length = sizeof(error);
+				getsockopt(connection.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+				if (error != 0) {
+					_drop(connection, false);
+					return;
+				}
+				connection.connected = true;
+				_pending--;
+				_open++;
+				epoll_event event{};
+				event.events = EPOLLIN | EPOLLRDHUP;
+				event.data.u64 = static_cast<uint64_t>(&connection - _connections.data());
+				epoll_ctl(_epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+				if (connection.trickle)
+					_trickleConnections.push_back(event.data.u64);
+			}
+			// Neither kind of connection expects a response, anything readable means the server gave up on it
+			if (events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP))
+				_drop(connection, true);
+		}
+
+		/**
+		 * @brief Send the next byte on as many trickle connections as are due, each one byte per interval
+		 */
+		void _trickle(const Clock::time_point now) {
+			if (_trickleConnections.empty()) {
+				_lastTrickle = now;
+				return;
+			}
+			_trickleDue += std::chrono::duration<double>(now - _lastTrickle).count() /
+						   std::chrono::duration<double>(_options.interval).count() *
+						   static_cast<double>(_trickleConnections.size());
+			_lastTrickle = now;
+			for (; _trickleDue >= 1; _trickleDue -= 1) {
+				Connection& connection = _connections[_trickleConnections[_trickleCursor]];
+				_trickleCursor = (_trickleCursor + 1) % _trickleConnections.size();
+				if (connection.fd == -1)
+					continue;
+				const char byte = connection.sent < _prefix.size() ? _prefix[connection.sent] : 'a';
+				if (send(connection.fd, &byte, 1, MSG_NOSIGNAL) == 1)
+					connection.sent++;
+				else if (errno != EAGAIN)
+					_drop(connection, true);
+			}
+		}
+
+		void _poll(const std::chrono::milliseconds timeout) {
+			epoll_event events[MAX_EVENTS];
+			const int count = epoll_wait(_epollFd, events, MAX_EVENTS, static_cast<int>(timeout.count()));
+			for (int i = 0; i < count; ++i) _onEvent(_connections[events[i].data.u64], events[i].events);
+			_trickle(Clock::now());
+		}
+
+		void _runFor(const std::chrono::milliseconds duration) {
+			const auto end = Clock::now() + duration;
+			while (Clock::now() < end && !stopRequested) _poll(TICK);
+		}
+
+		const Options& _options;
+		int _epollFd = -1;
+		std::string _prefix;
+		std::vector<Connection> _connections;
+		std::vector<size_t> _trickleConnections;
+		size_t _trickleCursor = 0;
+		double _trickleDue = 0;
+		Clock::time_point _lastTrickle = Clock::now();
+		size_t _pending = 0;
+		size_t _open = 0;
+		size_t _connectErrors = 0;
+		size_t _closedByServer = 0;
+};
+
+void usage(const char* program) {
+	std::fprintf(stderr,
+				 "usage: %s --pid PID [options] http://127.0.0.1[:port]/path\n"
+				 "  -p, --pid PID          server process to sample\n"
+				 "  -i, --idle N           connections that never send anything (default 1000)\n"
+				 "  -s, --trickle N        connections that send one header byte per interval (default 1000)\n"
+				 "  -I, --interval TIME    trickle interval per connection (default 1s)\n"
+				 "  -r, --ramp N           new connections per second (default 2000)\n"
+				 "  -S, --sources N        spread connections over 127.0.0.1..N (default 1)\n"
+				 "  -W, --window TIME      measurement window per phase (default 5s)\n"
+				 "      --settle TIME      wait before each window (default 1s)\n"
+				 "  -M, --metrics PATH     count loop wakeups with the server's metrics location\n"
+				 "      --host NAME        Host header (default host:port of the URL)\n"
+				 "      --name NAME        scenario name in the report\n",
+				 program);
+}
+
+void parseUrl(const std::string& url, Options& options) {
+	const std::string scheme = "http://";
+	if (url.compare(0, scheme.size(), scheme) != 0)
+		throw std::invalid_argument("only http:// URLs are supported: " + url);
+	const size_t pathStart = url.find('/', scheme.size());
+	const std::string authority = url.substr(scheme.size(), pathStart - scheme.size());
+	const size_t colon = authority.find(':');
+	options.host = authority.substr(0, colon);
+	options.port = colon == std::string::npos ? 80 : std::atoi(authority.c_str() + colon + 1);
+	options.path = pathStart == std::string::npos ? "/" : url.substr(pathStart);
+	in_addr address{};
+	if (inet_pton(AF_INET, options.host.c_str(), &address) != 1)
+		throw std::invalid_argument("the target must be an IPv4 address: " + options.host);
+}
+
+void raiseFileLimit(const size_t connections) {
+	rlimit limit{};
+	if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur >= connections + 64)
+		return;
+	limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, connections + 64);
+	setrlimit(RLIMIT_NOFILE, &limit);
+	if (limit.rlim_cur < connections + 64)
+		std::fprintf(stderr, "warning: file descriptor limit %llu is too low for %zu connections\n",
+					 static_cast<unsigned long long>(limit.rlim_cur), connections);
+}
+
+std::string report(const Options& options, const std::vector<Phase>& phases, const ConnectionBench& bench) {
+	std::ostringstream json;
+	json.setf(std::ios::fixed);
+	json.precision(1);
+	json << "{\"name\":\"" << options.name << "\",\"target\":\"" << options.host << ":" << options.port
+		 << "\",\"idle\":" << options.idle << ",\"trickle\":" << options.trickle
+		 << ",\"trickle_interval_ms\":" << options.interval.count() << ",\"wakeups\":\""
+		 << (options.metricsPath.empty() ? "context_switches" : "metrics") << "\",\"phases\":[";
+	for (size_t i = 0; i < phases.size(); ++i) {
+		const Phase& phase = phases[i];
+		json << (i ? "," : "") << "{\"phase\":\"" << phase.name << "\",\"open\":" << phase.open
+			 << ",\"rss_kb\":" << phase.end.rssKb << ",\"fds\":" << phase.end.fds
+			 << ",\"cpu_percent\":" << phase.cpuPercent << ",\"wakeups_per_s\":" << phase.wakeupsPerSecond << "}";
+	}
+	json << "]";
+	// Growth of the resident set per connection added by a phase
+	for (size_t i = 1; i < phases.size(); ++i) {
+		const size_t added = phases[i].open > phases[i - 1].open ? phases[i].open - phases[i - 1].open : 0;
+		const double growth =
+			(static_cast<double>(phases[i].end.rssKb) - static_cast<double>(phases[i - 1].end.rssKb)) * 1024;
+		json << ",\"bytes_per_" << phases[i].name
+			 << "_connection\":" << (added ? growth / static_cast<double>(added) : 0);
+	}
+	json << ",\"connect_errors\":" << bench.connectErrors() << ",\"closed_by_server\":" << bench.closedByServer()
+		 << "}";
+	return json.str();
+}
+}  // namespace
+
+/**
+ * @brief Idle connection harness, prints one JSON object with the server's cost per open connection
+ */
+int main(const int argc, char* argv[]) {
+	enum LongOption { SETTLE = 256, HOST, NAME };
+	static const option longOptions[] = {{"pid", required_argument, nullptr, 'p'},
+										 {"idle", required_argument, nullptr, 'i'},
+										 {"trickle", required_argument, nullptr, 's'},
+										 {"interval", required_argument, nullptr, 'I'},
+										 {"ramp", required_argument, nullptr, 'r'},
+										 {"sources", required_argument, nullptr, 'S'},
+										 {"window", required_argument, nullptr, 'W'},
+										 {"metrics", required_argument, nullptr, 'M'},
+										 {"settle", required_argument, nullptr, SETTLE},
+										 {"host", required_argument, nullptr, HOST},
+										 {"name", required_argument, nullptr, NAME},
+										 {"help", no_argument, nullptr, 'h'},
+										 {nullptr, 0, nullptr, 0}};
+
+	Options options;
+	try {
+		int opt;
+		while ((opt = getopt_long(argc, argv, "p:i:s:I:r:S:W:M:h", longOptions, nullptr)) != -1) {
+			switch (opt) {
+				case 'p':
+					options.pid = static_cast<pid_t>(std::atoi(optarg));
+					break;
+				case 'i':
+					options.idle = std::strtoull(optarg, nullptr, 10);
+					break;
+				case 's':
+					options.trickle = std::strtoull(optarg, nullptr, 10);
+					break;
+				case 'I':
+					options.interval = std::max(parseTime(optarg), std::chrono::milliseconds(1));
+					break;
+				case 'r':
+					options.rampRate = std::max(1.0, std::strtod(optarg, nullptr));
+					break;
+				case 'S':
+					options.sources = std::max<size_t>(1, std::strtoull(optarg, nullptr, 10));
+					break;
+				case 'W':
+					options.window = std::max(parseTime(optarg), std::chrono::milliseconds(100));
+					break;
+				case 'M':
+					options.metricsPath = optarg;
+					break;
+				case SETTLE:
+					options.settle = parseTime(optarg);
+					break;
+				case HOST:
+					options.hostHeader = optarg;
+					break;
+				case NAME:
+					options.name = optarg;
+					break;
+				default:
+					usage(argv[0]);
+					return opt == 'h' ? 0 : 1;
+			}
+		}
+		if (optind != argc - 1 || options.pid <= 0) {
+			usage(argv[0]);
+			return 1;
+		}
+		parseUrl(argv[optind], options);
+	} catch (const std::exception& e) {
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, stopSignalHandler);
+	signal(SIGTERM, stopSignalHandler);
+	raiseFileLimit(options.idle + options.trickle);
+
+	try {
+		ConnectionBench bench(options);
+		std::vector<Phase> phases;
+		phases.push_back(bench.measure("empty"));
+		bench.openConnections(options.idle, false);
+		phases.push_back(bench.measure("idle"));
+		bench.openConnections(options.trickle, true);
+		phases.push_back(bench.measure("trickle"));
+		std::printf("%s\n", report(options, phases, bench).c_str());
+	} catch (const std::exception& e) {
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
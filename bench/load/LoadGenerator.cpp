@@ -0,0 +1,517 @@
+#include "LoadGenerator.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+constexpr size_t READ_BUFFER_SIZE = 64 * 1024;
+constexpr size_t MAX_EVENTS = 256;
+constexpr auto IDLE_WAIT = std::chrono::milliseconds(10);
+constexpr auto RECONNECT_DELAY = std::chrono::milliseconds(100);
+constexpr const char* BOUNDARY = "loadgen-boundary";
+constexpr size_t UPLOAD_NAME_DIGITS = 16;
+
+sockaddr_in resolve(const std::string& host, const int port) {
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(static_cast<uint16_t>(port));
+	if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) == 1)
+		return address;
+	addrinfo hints{};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* result = nullptr;
+	if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || !result)
+		throw std::runtime_error("cannot resolve " + host);
+	address.sin_addr = reinterpret_cast<sockaddr_in*>(result->ai_addr)->sin_addr;
+	freeaddrinfo(result);
+	return address;
+}
+}  // namespace
+
+void LoadResult::merge(const LoadResult& other) {
+	responses += other.responses;
+	bytesIn += other.bytesIn;
+	bytesOut += other.bytesOut;
+	for (int i = 0; i < ERROR_COUNT; ++i) errors[i] += other.errors[i];
+	minLatency = std::min(minLatency, other.minLatency);
+	maxLatency = std::max(maxLatency, other.maxLatency);
+	for (const auto& [code, count] : other.status) status[code] += count;
+	for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) latency.counts[i] += other.latency.counts[i];
+	latency.count += other.latency.count;
+	latency.sum += other.latency.sum;
+}
+
+const char* LoadResult::errorName(const Error error) {
+	switch (error) {
+		case CONNECT:
+			return "connect";
+		case READ:
+			return "read";
+		case WRITE:
+			return "write";
+		case TIMEOUT:
+			return "timeout";
+		case CLOSED:
+			return "closed";
+		case PARSE:
+			return "parse";
+		default:
+			return "unknown";
+	}
+}
+
+LoadGenerator::LoadGenerator(const LoadOptions& options, const size_t id, const size_t connections, const double rate,
+							 std::atomic<uint64_t>& budget, std::atomic<bool>& stop)
+	: _options(options), _id(id), _rate(rate), _budget(budget), _stop(stop), _connections(connections) {
+	_epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (_epollFd == -1)
+		throw std::runtime_error(std::string("epoll_create1: ") + strerror(errno));
+	_buildRequests();
+	for (auto& connection : _connections) {
+		if (_options.method == "HEAD")
+			connection.reader.expectNoBody();
+	}
+}
+
+LoadGenerator::~LoadGenerator() {
+	for (auto& connection : _connections) _close(connection);
+	if (_epollFd != -1)
+		close(_epollFd);
+}
+
+/**
+ * @brief Render the request for every path once, the hot loop only copies bytes
+ */
+void LoadGenerator::_buildRequests() {
+	const std::string host = _options.hostHeader.empty() ? _options.host + ":" + std::to_string(_options.port)
+														 : _options.hostHeader;
+	std::string framing;
+	std::string body;
+	const std::string payload(_options.bodySize, 'x');
+	switch (_options.body) {
+		case LoadOptions::Body::NONE:
+			break;
+		case LoadOptions::Body::RAW:
+			framing = "Content-Type: application/octet-stream\r\nContent-Length: " + std::to_string(payload.size()) +
+					  "\r\n";
+			body = payload;
+			break;
+		case LoadOptions::Body::CHUNKED: {
+			framing = "Content-Type: application/octet-stream\r\nTransfer-Encoding: chunked\r\n";
+			const size_t chunkSize = std::max<size_t>(1, _options.chunkSize);
+			for (size_t offset = 0; offset < payload.size(); offset += chunkSize) {
+				const size_t length = std::min(chunkSize, payload.size() - offset);
+				char size[32];
+				std::snprintf(size, sizeof(size), "%zx\r\n", length);
+				body += size;
+				body.append(payload, offset, length);
+				body += "\r\n";
+			}
+			body += "0\r\n\r\n";
+			break;
+		}
+		case LoadOptions::Body::MULTIPART: {
+			body = std::string("--") + BOUNDARY +
+				   "\r\nContent-Disposition: form-data; name=\"file\"; filename=\"loadgen-";
+			const size_t nameStart = body.size();
+			body += std::string(UPLOAD_NAME_DIGITS, '0') + ".bin\"\r\nContent-Type: application/octet-stream\r\n\r\n";
+			body += payload + "\r\n--" + BOUNDARY + "--\r\n";
+			_filenameFromEnd = body.size() - nameStart;
+			framing = std::string("Content-Type: multipart/form-data; boundary=") + BOUNDARY +
+					  "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n";
+			break;
+		}
+	}
+
+	for (const auto& path : _options.paths) {
+		std::string request = _options.method + " " + path + " HTTP/1.1\r\nHost: " + host + "\r\n";
+		for (const auto& header : _options.headers) request += header + "\r\n";
+		if (!_options.keepAlive)
+			request += "Connection: close\r\n";
+		request += framing + "\r\n" + body;
+		_requests.push_back(std::move(request));
+	}
+}
+
+bool LoadGenerator::_connect(Connection& connection) {
+	static const sockaddr_in address = resolve(_options.host, _options.port);
+
+	connection.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (connection.fd == -1) {
+		++_result.errors[LoadResult::CONNECT];
+		connection.retryAt = Clock::now() + RECONNECT_DELAY;
+		return false;
+	}
+	const int one = 1;
+	setsockopt(connection.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	if (connect(connection.fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == -1 &&
+		errno != EINPROGRESS) {
+		close(connection.fd);
+		connection.fd = -1;
+		++_result.errors[LoadResult::CONNECT];
+		connection.retryAt = Clock::now() + RECONNECT_DELAY;
+		return false;
+	}
+
+	epoll_event event{};
+	event.events = EPOLLIN | EPOLLOUT;
+	event.data.u64 = static_cast<uint64_t>(&connection - _connections.data());
+	epoll_ctl(_epollFd, EPOLL_CTL_ADD, connection.fd, &event);
+	connection.writeInterest = true;
+	connection.connected = false;
+	connection.lastProgress = Clock::now();
+	return true;
+}
+
+void LoadGenerator::_close(Connection& connection) {
+	if (connection.fd != -1) {
+		epoll_ctl(_epollFd, EPOLL_CTL_DEL, connection.fd, nullptr);
+		close(connection.fd);
+	}
+	connection.fd = -1;
+	connection.connected = false;
+	connection.out.clear();
+	connection.outOffset = 0;
+	connection.inflight.clear();
+	connection.reader.reset();
+	connection.writeInterest = false;
+}
+
+/**
+ * @brief Drop the connection after a failure, the requests in flight on it are lost
+ */
+void LoadGenerator::_reconnect(Connection& connection, const LoadResult::Error error) {
+	const size_t lost = connection.inflight.size();
+	_result.errors[error] += std::max<size_t>(lost, 1);
+	_returnRequests(lost);
+	_close(connection);
+	if (error == LoadResult::CONNECT)
+		connection.retryAt = Clock::now() + RECONNECT_DELAY;
+	else
+		_connect(connection);
+}
+
+/**
+ * @brief Reserve one request of the `-n` budget
+ */
+bool LoadGenerator::_takeRequest() {
+	if (_options.requests == 0)
+		return true;
+	uint64_t left = _budget.load(std::memory_order_relaxed);
+	while (left > 0) {
+		if (_budget.compare_exchange_weak(left, left - 1, std::memory_order_relaxed))
+			return true;
+	}
+	return false;
+}
+
+void LoadGenerator::_returnRequests(const size_t count) {
+	if (_options.requests != 0 && count > 0 && _rate == 0)
+		_budget.fetch_add(count, std::memory_order_relaxed);
+}
+
+bool LoadGenerator::_canSend(const Connection& connection) const {
+	if (!connection.connected || connection.inflight.size() >= _options.pipeline)
+		return false;
+	// Without keep-alive the connection carries exactly one request
+	return _options.keepAlive || (connection.inflight.empty() && connection.reader.idle());
+}
+
+void LoadGenerator::_enqueue(Connection& connection, const Clock::time_point startedAt) {
+	const std::string& request = _requests[_nextPath];
+	_nextPath = (_nextPath + 1) % _requests.size();
+	connection.out += request;
+	if (_filenameFromEnd != 0) {
+		char name[UPLOAD_NAME_DIGITS + 1];
+		// Unique over processes and workers, the server refuses to overwrite an upload
+		std::snprintf(name, sizeof(name), "%05x%03zx%08llx", static_cast<unsigned>(getpid()) & 0xfffff, _id & 0xfff,
+					  static_cast<unsigned long long>(_sequence++ & 0xffffffffULL));
+		connection.out.replace(connection.out.size() - _filenameFromEnd, UPLOAD_NAME_DIGITS, name);
+	}
+	connection.inflight.push_back(startedAt);
+}
+
+/**
+ * @brief Closed loop: top the connection up to `pipeline` requests in flight
+ */
+void LoadGenerator::_fill(Connection& connection) {
+	if (_rate != 0 || _stop.load(std::memory_order_relaxed))
+		return;
+	const auto now = Clock::now();
+	bool added = false;
+	while (_canSend(connection) && _takeRequest()) {
+		_enqueue(connection, now);
+		added = true;
+	}
+	if (added)
+		_flush(connection);
+}
+
+/**
+ * @brief Open loop: start every request whose scheduled time has come
+ */
+void LoadGenerator::_schedule(const Clock::time_point now) {
+	while (true) {
+		const auto due = _dueTime();
+		if (due > now || !_takeRequest())
+			break;
+		_backlog.push_back(due);
+		++_scheduled;
+	}
+	_dispatchBacklog();
+}
+
+/**
+ * @brief Scheduled start of the next open loop request
+ */
+Clock::time_point LoadGenerator::_dueTime() const {
+	return _start + std::chrono::nanoseconds(std::llround(static_cast<double>(_scheduled) * 1e9 / _rate));
+}
+
+void LoadGenerator::_dispatchBacklog() {
+	while (!_backlog.empty() && !_idle.empty()) {
+		const size_t index = _idle.front();
+		_idle.pop_front();
+		Connection& connection = _connections[index];
+		bool added = false;
+		while (!_backlog.empty() && _canSend(connection)) {
+			_enqueue(connection, _backlog.front());
+			_backlog.pop_front();
+			added = true;
+		}
+		if (added && _flush(connection) && _canSend(connection))
+			_idle.push_back(index);
+	}
+}
+
+/**
+ * @brief Write as much of the pending requests as the socket takes
+ * @return false if the connection was dropped
+ */
+bool LoadGenerator::_flush(Connection& connection) {
+	while (connection.outOffset < connection.out.size()) {
+		const ssize_t sent = send(connection.fd, connection.out.data() + connection.outOffset,
+								  connection.out.size() - connection.outOffset, MSG_NOSIGNAL);
+		if (sent > 0) {
+			connection.outOffset += static_cast<size_t>(sent);
+			connection.lastProgress = Clock::now();
+			if (connection.lastProgress >= _measureFrom)
+				_result.bytesOut += static_cast<uint64_t>(sent);
+			continue;
+		}
+		if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (sent == -1 && errno == EINTR)
+			continue;
+		_reconnect(connection, LoadResult::WRITE);
+		return false;
+	}
+	if (connection.outOffset == connection.out.size()) {
+		connection.out.clear();
+		connection.outOffset = 0;
+	}
+	_updateInterest(connection);
+	return true;
+}
+
+void LoadGenerator::_updateInterest(Connection& connection) {
+	const bool wantsWrite = !connection.connected || connection.outOffset < connection.out.size();
+	if (wantsWrite == connection.writeInterest)
+		return;
+	epoll_event event{};
+	event.events = wantsWrite ? EPOLLIN | EPOLLOUT : EPOLLIN;
+	event.data.u64 = static_cast<uint64_t>(&connection - _connections.data());
+	epoll_ctl(_epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+	connection.writeInterest = wantsWrite;
+}
+
+void LoadGenerator::_onWritable(Connection& connection) {
+	if (!connection.connected) {
+		int error = 0;
+		socklen_t length = sizeof(error);
+		if (getsockopt(connection.fd, SOL_SOCKET, SO_ERROR, &error, &length) == -1 || error != 0) {
+			_reconnect(connection, LoadResult::CONNECT);
+			return;
+		}
+		connection.connected = true;
+		connection.lastProgress = Clock::now();
+		if (_rate != 0)
+			_idle.push_back(static_cast<size_t>(&connection - _connections.data()));
+		_fill(connection);
+		if (connection.fd != -1)
+			_updateInterest(connection);
+		return;
+	}
+	_flush(connection);
+}
+
+void LoadGenerator::_onReadable(Connection& connection) {
+	char buffer[READ_BUFFER_SIZE];
+	while (connection.fd != -1) {
+		const ssize_t received = recv(connection.fd, buffer, sizeof(buffer), 0);
+		if (received == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				_reconnect(connection, LoadResult::READ);
+			return;
+		}
+		if (received == 0) {
+			if (connection.reader.finishOnClose() &&
+				!_complete(connection, connection.reader.status(), true))
+				return;
+			if (!connection.inflight.empty() || !connection.reader.idle()) {
+				_reconnect(connection, LoadResult::CLOSED);
+				return;
+			}
+			// Idle keep-alive connection closed by the server
+			_close(connection);
+			_connect(connection);
+			return;
+		}
+		connection.lastProgress = Clock::now();
+		if (connection.lastProgress >= _measureFrom)
+			_result.bytesIn += static_cast<uint64_t>(received);
+
+		size_t offset = 0;
+		while (offset < static_cast<size_t>(received)) {
+			if (connection.inflight.empty()) {
+				_reconnect(connection, LoadResult::PARSE);
+				return;
+			}
+			size_t consumed = 0;
+			const auto result =
+				connection.reader.feed(buffer + offset, static_cast<size_t>(received) - offset, consumed);
+			offset += consumed;
+			if (result == ResponseReader::Result::ERROR) {
+				_reconnect(connection, LoadResult::PARSE);
+				return;
+			}
+			if (result == ResponseReader::Result::COMPLETE &&
+				!_complete(connection, connection.reader.status(), connection.reader.closeAfter()))
+				return;
+		}
+	}
+}
+
+/**
+ * @brief Account for the oldest request in flight and reuse or replace the connection
+ * @return false if the connection was closed
+ */
+bool LoadGenerator::_complete(Connection& connection, const int status, const bool closeAfter) {
+	const auto now = Clock::now();
+	const auto startedAt = connection.inflight.front();
+	connection.inflight.pop_front();
+	connection.reader.reset();
+	if (startedAt >= _measureFrom) {
+		const auto latency =
+			static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - startedAt).count());
+		_latency.record(latency);
+		_result.minLatency = std::min(_result.minLatency, latency);
+		_result.maxLatency = std::max(_result.maxLatency, latency);
+		++_result.status[status];
+		++_result.responses;
+	}
+
+	if (closeAfter || !_options.keepAlive) {
+		if (!connection.inflight.empty()) {
+			_reconnect(connection, LoadResult::CLOSED);
+			return false;
+		}
+		_close(connection);
+		_connect(connection);
+		return false;
+	}
+	if (_rate != 0) {
+		if (_canSend(connection))
+			_idle.push_back(static_cast<size_t>(&connection - _connections.data()));
+	} else {
+		_fill(connection);
+	}
+	return connection.fd != -1;
+}
+
+/**
+ * @brief Drop connections without progress for `timeout` and retry failed connects
+ */
+void LoadGenerator::_checkTimeouts(const Clock::time_point now) {
+	for (auto& connection : _connections) {
+		if (connection.fd == -1) {
+			if (now >= connection.retryAt)
+				_connect(connection);
+			continue;
+		}
+		const bool waiting = !connection.connected || !connection.inflight.empty();
+		if (waiting && now - connection.lastProgress > _options.timeout)
+			_reconnect(connection, connection.connected ? LoadResult::TIMEOUT : LoadResult::CONNECT);
+	}
+}
+
+bool LoadGenerator::_busy() const {
+	if (!_backlog.empty())
+		return true;
+	for (const auto& connection : _connections) {
+		if (!connection.inflight.empty())
+			return true;
+	}
+	return false;
+}
+
+void LoadGenerator::run(const Clock::time_point start, const Clock::time_point measureFrom,
+						const Clock::time_point end) {
+	_start = start;
+	_measureFrom = measureFrom;
+	for (auto& connection : _connections) _connect(connection);
+
+	epoll_event events[MAX_EVENTS];
+	auto nextTimeoutCheck = start;
+	while (!_stop.load(std::memory_order_relaxed)) {
+		auto now = Clock::now();
+		if (now >= end)
+			break;
+		if (_options.requests != 0 && _budget.load(std::memory_order_relaxed) == 0 && !_busy())
+			break;
+		if (now >= nextTimeoutCheck) {
+			_checkTimeouts(now);
+			nextTimeoutCheck = now + IDLE_WAIT;
+		}
+		if (_rate != 0)
+			_schedule(now);
+
+		// Open loop: wake up in time for the next scheduled request
+		Clock::duration wait = std::min<Clock::duration>(IDLE_WAIT, end - now);
+		if (_rate != 0)
+			wait = std::max(std::min(wait, _dueTime() - now), Clock::duration::zero());
+		const int timeout = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(wait).count());
+		const int ready = epoll_wait(_epollFd, events, MAX_EVENTS, timeout);
+		if (ready == -1 && errno != EINTR)
+			throw std::runtime_error(std::string("epoll_wait: ") + strerror(errno));
+
+		for (int i = 0; i < ready; ++i) {
+			Connection& connection = _connections[events[i].data.u64];
+			if (connection.fd == -1)
+				continue;
+			if (events[i].events & (EPOLLOUT | EPOLLERR))
+				_onWritable(connection);
+			if (connection.fd != -1 && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+				_onReadable(connection);
+		}
+		if (_rate != 0)
+			_dispatchBacklog();
+	}
+	_finishedAt = std::min(Clock::now(), end);
+	_result.latency.add(_latency);
+}
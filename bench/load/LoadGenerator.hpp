@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "LatencyHistogram.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief Everything that describes one load run, filled in from the command line
+ */
+struct LoadOptions {
+		enum class Body { NONE, RAW, CHUNKED, MULTIPART };
+
+		std::string name;
+		std::string host = "127.0.0.1";
+		int port = 8080;
+		std::string hostHeader;
+		std::vector<std::string> paths;
+		std::string method = "GET";
+		std::vector<std::string> headers;
+		size_t connections = 64;
+		size_t threads = 1;
+		size_t pipeline = 1;
+		bool keepAlive = true;
+		double rate = 0;  // requests per second over all threads, 0 = closed loop
+		uint64_t requests = 0;	// stop after this many responses, 0 = run for `duration`
+		std::chrono::milliseconds duration{10000};
+		std::chrono::milliseconds warmup{0};
+		std::chrono::milliseconds timeout{5000};
+		Body body = Body::NONE;
+		size_t bodySize = 0;
+		size_t chunkSize = 4096;
+};
+
+/**
+ * @brief Counters of one worker, merged into the report at the end
+ */
+struct LoadResult {
+		enum Error { CONNECT, READ, WRITE, TIMEOUT, CLOSED, PARSE, ERROR_COUNT };
+
+		uint64_t responses = 0;
+		uint64_t bytesIn = 0;
+		uint64_t bytesOut = 0;
+		uint64_t errors[ERROR_COUNT] = {};
+		uint64_t minLatency = UINT64_MAX;
+		uint64_t maxLatency = 0;
+		std::map<int, uint64_t> status;
+		LatencyHistogram::Snapshot latency;
+
+		void merge(const LoadResult& other);
+		[[nodiscard]] static const char* errorName(Error error);
+};
+
+/**
+ * @brief Incremental parser of the responses on one connection, pipelined responses included
+ */
+class ResponseReader {
+	public:
+		enum class Result { NEED_MORE, COMPLETE, ERROR };
+
+		void reset();
+		void expectNoBody(const bool noBody = true) { _headRequest = noBody; }
+		/**
+		 * @brief Consume bytes from `data` until a response is complete
+		 * @param consumed set to the number of bytes used, the rest belongs to the next response
+		 */
+		Result feed(const char* data, size_t size, size_t& consumed);
+		/**
+		 * @brief The peer closed the connection, completes a response delimited by the close
+		 */
+		[[nodiscard]] bool finishOnClose();
+
+		[[nodiscard]] int status() const { return _status; }
+		[[nodiscard]] uint64_t bodyBytes() const { return _bodyBytes; }
+		[[nodiscard]] bool closeAfter() const { return _closeAfter; }
+		[[nodiscard]] bool idle() const { return _state == State::HEADER && _header.empty(); }
+
+	private:
+		enum class State { HEADER, BODY, CHUNK_SIZE, CHUNK_DATA, CHUNK_DATA_END, TRAILER, UNTIL_CLOSE };
+
+		bool _parseHeader();
+
+		State _state = State::HEADER;
+		std::string _header;
+		std::string _line;
+		uint64_t _remaining = 0;
+		uint64_t _bodyBytes = 0;  // decoded body, without the chunk framing
+		int _status = 0;
+		bool _closeAfter = false;
+		bool _headRequest = false;
+};
+
+/**
+ * @brief One worker thread: its own epoll instance and share of the connections and of the request rate.
+ *
+ * In closed loop mode every connection keeps `pipeline` requests in flight and sends the next one as soon as
+ * a response completes. In open loop mode requests are started on a fixed schedule whether or not the server
+ * keeps up; requests that find no free connection wait in a backlog and their latency is measured from the
+ * scheduled start, so a stalling server is not hidden by the generator slowing down (coordinated omission).
+ */
+class LoadGenerator {
+	public:
+		LoadGenerator(const LoadOptions& options, size_t id, size_t connections, double rate,
+					  std::atomic<uint64_t>& budget, std::atomic<bool>& stop);
+		~LoadGenerator();
+		LoadGenerator(const LoadGenerator&) = delete;
+		LoadGenerator& operator=(const LoadGenerator&) = delete;
+
+		void run(Clock::time_point start, Clock::time_point measureFrom, Clock::time_point end);
+		[[nodiscard]] const LoadResult& result() const { return _result; }
+		[[nodiscard]] Clock::time_point finishedAt() const { return _finishedAt; }
+
+	private:
+		struct Connection {
+				int fd = -1;
+				bool connected = false;
+				std::string out;
+				size_t outOffset = 0;
+				std::deque<Clock::time_point> inflight;	 // start time of every request sent and not answered
+				ResponseReader reader;
+				Clock::time_point lastProgress;
+				Clock::time_point retryAt;	// reconnect after a failed connect
+				bool writeInterest = false;
+		};
+
+		bool _connect(Connection& connection);
+		void _close(Connection& connection);
+		void _reconnect(Connection& connection, LoadResult::Error error);
+		void _buildRequests();
+		bool _takeRequest();
+		void _returnRequests(size_t count);
+		void _enqueue(Connection& connection, Clock::time_point startedAt);
+		void _onReadable(Connection& connection);
+		void _onWritable(Connection& connection);
+		bool _flush(Connection& connection);
+		void _updateInterest(Connection& connection);
+		bool _complete(Connection& connection, int status, bool closeAfter);
+		void _fill(Connection& connection);
+		void _schedule(Clock::time_point now);
+		void _dispatchBacklog();
+		[[nodiscard]] Clock::time_point _dueTime() const;
+		void _checkTimeouts(Clock::time_point now);
+		[[nodiscard]] bool _canSend(const Connection& connection) const;
+		[[nodiscard]] bool _busy() const;
+
+		const LoadOptions& _options;
+		size_t _id;
+		double _rate;
+		std::atomic<uint64_t>& _budget;
+		std::atomic<bool>& _stop;
+		int _epollFd = -1;
+		std::vector<Connection> _connections;
+		std::deque<Clock::time_point> _backlog;	 // open loop: scheduled requests waiting for a connection
+		std::deque<size_t> _idle;				 // open loop: connections that may be able to take a request
+		Clock::time_point _start;
+		Clock::time_point _measureFrom;
+		Clock::time_point _finishedAt;
+		uint64_t _scheduled = 0;
+		uint64_t _sequence = 0;
+		std::vector<std::string> _requests;	 // one prebuilt request per path
+		size_t _nextPath = 0;
+		size_t _filenameFromEnd = 0;  // multipart: position of the unique upload name, from the end of a request
+		LatencyHistogram _latency;
+		LoadResult _result;
+};
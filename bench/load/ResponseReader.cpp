@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+#include "LoadGenerator.hpp"
+
+namespace {
+constexpr size_t MAX_HEADER_SIZE = 64 * 1024;
+
+/**
+ * @brief Read one CRLF terminated line into `line`
+ * @return true once the line is complete, without the line break
+ */
+bool takeLine(std::string& line, const char* data, const size_t size, size_t& consumed) {
+	const char* end = static_cast<const char*>(std::memchr(data + consumed, '\n', size - consumed));
+	if (!end) {
+		line.append(data + consumed, size - consumed);
+		consumed = size;
+		return false;
+	}
+	line.append(data + consumed, end - (data + consumed));
+	consumed = end - data + 1;
+	if (!line.empty() && line.back() == '\r')
+		line.pop_back();
+	return true;
+}
+
+bool headerIs(const std::string& line, const char* name, size_t& valueStart) {
+	const size_t length = std::strlen(name);
+	if (line.size() <= length || line[length] != ':' || strncasecmp(line.c_str(), name, length) != 0)
+		return false;
+	valueStart = line.find_first_not_of(" \t", length + 1);
+	return valueStart != std::string::npos;
+}
+}  // namespace
+
+void ResponseReader::reset() {
+	_state = State::HEADER;
+	_header.clear();
+	_line.clear();
+	_remaining = 0;
+	_bodyBytes = 0;
+	_status = 0;
+	_closeAfter = false;
+}
+
+ResponseReader::Result ResponseReader::feed(const char* data, const size_t size, size_t& consumed) {
+	consumed = 0;
+	while (consumed < size) {
+		switch (_state) {
+			case State::HEADER: {
+				const size_t searchFrom = _header.size() < 3 ? 0 : _header.size() - 3;
+				const size_t take = std::min(size - consumed, MAX_HEADER_SIZE + 4 - _header.size());
+				_header.append(data + consumed, take);
+				const size_t end = _header.find("\r\n\r\n", searchFrom);
+				if (end == std::string::npos) {
+					consumed += take;
+					if (_header.size() >= MAX_HEADER_SIZE)
+						return Result::ERROR;
+					break;
+				}
+				// Give back what belongs to the body or to the next response
+				consumed += take - (_header.size() - end - 4);
+				_header.resize(end + 4);
+				if (!_parseHeader())
+					return Result::ERROR;
+				if (_status < 200 && _status != 101) {
+					// Interim response, the real one follows
+					reset();
+					break;
+				}
+				if (_state == State::BODY && _remaining == 0)
+					return Result::COMPLETE;
+				if (_state == State::HEADER)
+					return Result::COMPLETE;
+				break;
+			}
+			case State::BODY:
+			case State::CHUNK_DATA:
+			case State::CHUNK_DATA_END: {
+				const uint64_t take = std::min<uint64_t>(_remaining, size - consumed);
+				_remaining -= take;
+				consumed += take;
+				if (_state != State::CHUNK_DATA_END)
+					_bodyBytes += take;
+				if (_remaining > 0)
+					break;
+				if (_state == State::BODY)
+					return Result::COMPLETE;
+				if (_state == State::CHUNK_DATA) {
+					_state = State::CHUNK_DATA_END;
+					_remaining = 2;
+				} else {
+					_state = State::CHUNK_SIZE;
+				}
+				break;
+			}
+			case State::CHUNK_SIZE: {
+				if (!takeLine(_line, data, size, consumed))
+					break;
+				char* end = nullptr;
+				const uint64_t chunkSize = std::strtoull(_line.c_str(), &end, 16);
+				if (end == _line.c_str())
+					return Result::ERROR;
+				_line.clear();
+				_state = chunkSize == 0 ? State::TRAILER : State::CHUNK_DATA;
+				_remaining = chunkSize;
+				break;
+			}
+			case State::TRAILER: {
+				if (!takeLine(_line, data, size, consumed))
+					break;
+				const bool last = _line.empty();
+				_line.clear();
+				if (last)
+					return Result::COMPLETE;
+				break;
+			}
+			case State::UNTIL_CLOSE:
+				_bodyBytes += size - consumed;
+				consumed = size;
+				break;
+		}
+	}
+	return Result::NEED_MORE;
+}
+
+bool ResponseReader::finishOnClose() { return _state == State::UNTIL_CLOSE; }
+
+/**
+ * @brief Read the status and the framing of the body from the header
+ */
+bool ResponseReader::_parseHeader() {
+	if (_header.compare(0, 7, "HTTP/1.") != 0 || _header.size() < 12)
+		return false;
+	_status = std::atoi(_header.c_str() + 9);
+	if (_status < 100 || _status > 999)
+		return false;
+	_closeAfter = _header[7] == '0';
+
+	bool chunked = false;
+	bool hasLength = false;
+	uint64_t length = 0;
+	size_t lineStart = _header.find("\r\n") + 2;
+	while (lineStart < _header.size()) {
+		const size_t lineEnd = _header.find("\r\n", lineStart);
+		if (lineEnd == std::string::npos || lineEnd == lineStart)
+			break;
+		const std::string line = _header.substr(lineStart, lineEnd - lineStart);
+		size_t value = 0;
+		if (headerIs(line, "Content-Length", value)) {
+			hasLength = true;
+			length = std::strtoull(line.c_str() + value, nullptr, 10);
+		} else if (headerIs(line, "Transfer-Encoding", value)) {
+			chunked = strcasestr(line.c_str() + value, "chunked") != nullptr;
+		} else if (headerIs(line, "Connection", value)) {
+			if (strcasestr(line.c_str() + value, "close"))
+				_closeAfter = true;
+			else if (strcasestr(line.c_str() + value, "keep-alive"))
+				_closeAfter = false;
+		}
+		lineStart = lineEnd + 2;
+	}
+
+	if (_headRequest || _status < 200 || _status == 204 || _status == 304)
+		_state = State::HEADER;
+	else if (chunked)
+		_state = State::CHUNK_SIZE;
+	else if (hasLength) {
+		_state = State::BODY;
+		_remaining = length;
+	} else {
+		_state = State::UNTIL_CLOSE;
+		_closeAfter = true;
+	}
+	return true;
+}
@@ -0,0 +1,291 @@
+#include <getopt.h>
+#include <sys/resource.h>
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "LoadGenerator.hpp"
+
+namespace {
+std::atomic<bool> stopRequested(false);
+
+void stopSignalHandler(const int) { stopRequested = true; }
+
+void usage(const char* program) {
+	std::fprintf(stderr,
+				 "usage: %s [options] http://host[:port]/path [/other/path...]\n"
+				 "  -c, --connections N   open connections (default 64)\n"
+				 "  -t, --threads N       worker threads, each with its own epoll instance (default 1)\n"
+				 "  -d, --duration TIME   measured run time, e.g. 10s, 500ms (default 10s)\n"
+				 "  -w, --warmup TIME     run before measuring (default 0)\n"
+				 "  -n, --requests N      stop after N requests\n"
+				 "  -r, --rate N          open loop: start N requests per second (default: closed loop)\n"
+				 "  -P, --pipeline N      requests in flight per connection (default 1)\n"
+				 "  -m, --method METHOD   request method (default GET)\n"
+				 "  -H, --header LINE     add a request header\n"
+				 "  -b, --body SIZE       send a body of SIZE bytes\n"
+				 "      --chunked         send the body with Transfer-Encoding: chunked\n"
+				 "      --chunk-size N    size of the chunks (default 4096)\n"
+				 "      --multipart       send the body as a multipart/form-data file upload\n"
+				 "  -k, --no-keepalive    one request per connection\n"
+				 "  -T, --timeout TIME    drop connections without progress for TIME (default 5s)\n"
+				 "      --host NAME       Host header (default host:port of the URL)\n"
+				 "      --name NAME       scenario name in the report\n",
+				 program);
+}
+
+std::chrono::milliseconds parseTime(const char* value) {
+	char* end = nullptr;
+	const double number = std::strtod(value, &end);
+	if (end == value || number < 0)
+		throw std::invalid_argument(std::string("invalid time: ") + value);
+	const std::string unit(end);
+	double factor = 1000;
+	if (unit == "ms")
+		factor = 1;
+	else if (unit == "m")
+		factor = 60000;
+	else if (!unit.empty() && unit != "s")
+		throw std::invalid_argument(std::string("invalid time unit: ") + value);
+	return std::chrono::milliseconds(static_cast<int64_t>(number * factor));
+}
+
+size_t parseSize(const char* value) {
+	char* end = nullptr;
+	const unsigned long long number = std::strtoull(value, &end, 10);
+	size_t factor = 1;
+	if (*end == 'k' || *end == 'K')
+		factor = 1024;
+	else if (*end == 'm' || *end == 'M')
+		factor = 1024 * 1024;
+	else if (*end != '\0')
+		throw std::invalid_argument(std::string("invalid size: ") + value);
+	return static_cast<size_t>(number) * factor;
+}
+
+/**
+ * @brief Split `http://host[:port]/path` and add the path to the request rotation
+ */
+void parseUrl(const std::string& url, LoadOptions& options, const bool first) {
+	if (url.front() == '/') {
+		options.paths.push_back(url);
+		return;
+	}
+	const std::string scheme = "http://";
+	if (url.compare(0, scheme.size(), scheme) != 0)
+		throw std::invalid_argument("only http:// URLs are supported: " + url);
+	const size_t pathStart = url.find('/', scheme.size());
+	const std::string authority = url.substr(scheme.size(), pathStart - scheme.size());
+	if (first) {
+		const size_t colon = authority.find(':');
+		options.host = authority.substr(0, colon);
+		options.port = colon == std::string::npos ? 80 : std::atoi(authority.c_str() + colon + 1);
+	}
+	options.paths.push_back(pathStart == std::string::npos ? "/" : url.substr(pathStart));
+}
+
+/**
+ * @brief Many connections need many file descriptors
+ */
+void raiseFileLimit(const size_t connections) {
+	rlimit limit{};
+	if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur >= connections + 64)
+		return;
+	limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, connections + 64);
+	setrlimit(RLIMIT_NOFILE, &limit);
+}
+
+std::string jsonString(const std::string& value) {
+	std::string out = "\"";
+	for (const char c : value) {
+		if (c == '"' || c == '\\')
+			out += '\\';
+		if (static_cast<unsigned char>(c) < 0x20)
+			continue;
+		out += c;
+	}
+	return out + "\"";
+}
+
+std::string report(const LoadOptions& options, const LoadResult& result, const double seconds) {
+	static constexpr double QUANTILES[] = {0.5, 0.75, 0.9, 0.99, 0.999, 0.9999};
+	static constexpr const char* QUANTILE_NAMES[] = {"p50", "p75", "p90", "p99", "p999", "p9999"};
+
+	std::ostringstream json;
+	json.setf(std::ios::fixed);
+	json.precision(1);
+	json << "{\"name\":" << jsonString(options.name) << ",\"target\":"
+		 << jsonString(options.host + ":" + std::to_string(options.port)) << ",\"paths\":[";
+	for (size_t i = 0; i < options.paths.size(); ++i) json << (i ? "," : "") << jsonString(options.paths[i]);
+	json << "],\"method\":" << jsonString(options.method) << ",\"mode\":\"" << (options.rate != 0 ? "open" : "closed")
+		 << "\",\"connections\":" << options.connections << ",\"threads\":" << options.threads
+		 << ",\"pipeline\":" << options.pipeline << ",\"keep_alive\":" << (options.keepAlive ? "true" : "false")
+		 << ",\"rate\":" << options.rate << ",\"body_bytes\":" << options.bodySize;
+	json << ",\"duration_s\":" << seconds << ",\"requests\":" << result.responses
+		 << ",\"throughput_rps\":" << (seconds > 0 ? static_cast<double>(result.responses) / seconds : 0)
+		 << ",\"bytes_in\":" << result.bytesIn << ",\"bytes_out\":" << result.bytesOut << ",\"status\":{";
+	bool first = true;
+	for (const auto& [code, count] : result.status) {
+		json << (first ? "" : ",") << "\"" << code << "\":" << count;
+		first = false;
+	}
+	json << "},\"errors\":{";
+	for (int i = 0; i < LoadResult::ERROR_COUNT; ++i)
+		json << (i ? "," : "") << "\"" << LoadResult::errorName(static_cast<LoadResult::Error>(i))
+			 << "\":" << result.errors[i];
+	const auto& latency = result.latency;
+	json << "},\"latency_us\":{\"min\":" << (latency.count ? result.minLatency : 0) << ",\"mean\":"
+		 << (latency.count ? static_cast<double>(latency.sum) / static_cast<double>(latency.count) : 0);
+	for (size_t i = 0; i < std::size(QUANTILES); ++i)
+		json << ",\"" << QUANTILE_NAMES[i] << "\":" << latency.valueAtQuantile(QUANTILES[i]);
+	json << ",\"max\":" << result.maxLatency << "}}";
+	return json.str();
+}
+}  // namespace
+
+/**
+ * @brief HTTP load generator, prints one JSON object with throughput and latency percentiles per run
+ */
+int main(const int argc, char* argv[]) {
+	enum LongOption { CHUNKED = 256, CHUNK_SIZE, MULTIPART, HOST, NAME };
+	static const option longOptions[] = {{"connections", required_argument, nullptr, 'c'},
+										 {"threads", required_argument, nullptr, 't'},
+										 {"duration", required_argument, nullptr, 'd'},
+										 {"warmup", required_argument, nullptr, 'w'},
+										 {"requests", required_argument, nullptr, 'n'},
+										 {"rate", required_argument, nullptr, 'r'},
+										 {"pipeline", required_argument, nullptr, 'P'},
+										 {"method", required_argument, nullptr, 'm'},
+										 {"header", required_argument, nullptr, 'H'},
+										 {"body", required_argument, nullptr, 'b'},
+										 {"chunked", no_argument, nullptr, CHUNKED},
+										 {"chunk-size", required_argument, nullptr, CHUNK_SIZE},
+										 {"multipart", no_argument, nullptr, MULTIPART},
+										 {"no-keepalive", no_argument, nullptr, 'k'},
+										 {"timeout", required_argument, nullptr, 'T'},
+										 {"host", required_argument, nullptr, HOST},
+										 {"name", required_argument, nullptr, NAME},
+										 {"help", no_argument, nullptr, 'h'},
+										 {nullptr, 0, nullptr, 0}};
+
+	LoadOptions options;
+	bool durationSet = false;
+	try {
+		int opt;
+		while ((opt = getopt_long(argc, argv, "c:t:d:w:n:r:P:m:H:b:kT:h", longOptions, nullptr)) != -1) {
+			switch (opt) {
+				case 'c':
+					options.connections = std::max<size_t>(1, parseSize(optarg));
+					break;
+				case 't':
+					options.threads = std::max<size_t>(1, parseSize(optarg));
+					break;
+				case 'd':
+					options.duration = parseTime(optarg);
+					durationSet = true;
+					break;
+				case 'w':
+					options.warmup = parseTime(optarg);
+					break;
+				case 'n':
+					options.requests = parseSize(optarg);
+					break;
+				case 'r':
+					options.rate = std::strtod(optarg, nullptr);
+					break;
+				case 'P':
+					options.pipeline = std::max<size_t>(1, parseSize(optarg));
+					break;
+				case 'm':
+					options.method = optarg;
+					break;
+				case 'H':
+					options.headers.emplace_back(optarg);
+					break;
+				case 'b':
+					options.bodySize = parseSize(optarg);
+					if (options.body == LoadOptions::Body::NONE)
+						options.body = LoadOptions::Body::RAW;
+					break;
+				case CHUNKED:
+					options.body = LoadOptions::Body::CHUNKED;
+					break;
+				case CHUNK_SIZE:
+					options.chunkSize = parseSize(optarg);
+					break;
+				case MULTIPART:
+					options.body = LoadOptions::Body::MULTIPART;
+					break;
+				case 'k':
+					options.keepAlive = false;
+					break;
+				case 'T':
+					options.timeout = parseTime(optarg);
+					break;
+				case HOST:
+					options.hostHeader = optarg;
+					break;
+				case NAME:
+					options.name = optarg;
+					break;
+				default:
+					usage(argv[0]);
+					return opt == 'h' ? 0 : 1;
+			}
+		}
+		for (int i = optind; i < argc; ++i) parseUrl(argv[i], options, i == optind);
+	} catch (const std::exception& e) {
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	if (options.paths.empty()) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (options.requests != 0 && !durationSet)
+		options.duration = std::chrono::hours(1);
+	options.threads = std::min(options.threads, options.connections);
+
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, stopSignalHandler);
+	signal(SIGTERM, stopSignalHandler);
+	raiseFileLimit(options.connections);
+
+	std::atomic<uint64_t> budget(options.requests);
+	std::vector<std::unique_ptr<LoadGenerator>> generators;
+	try {
+		for (size_t i = 0; i < options.threads; ++i) {
+			const size_t connections =
+				options.connections / options.threads + (i < options.connections % options.threads ? 1 : 0);
+			generators.push_back(std::make_unique<LoadGenerator>(
+				options, i, connections, options.rate / static_cast<double>(options.threads), budget, stopRequested));
+		}
+	} catch (const std::exception& e) {
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	const auto start = Clock::now();
+	const auto measureFrom = start + options.warmup;
+	const auto end = measureFrom + options.duration;
+	std::vector<std::thread> threads;
+	for (auto& generator : generators)
+		threads.emplace_back([&generator, start, measureFrom, end] { generator->run(start, measureFrom, end); });
+	for (auto& thread : threads) thread.join();
+
+	LoadResult total;
+	auto finishedAt = measureFrom;
+	for (const auto& generator : generators) {
+		total.merge(generator->result());
+		finishedAt = std::max(finishedAt, generator->finishedAt());
+	}
+	const double seconds = std::chrono::duration<double>(finishedAt - measureFrom).count();
+	std::printf("%s\n", report(options, total, seconds).c_str());
+	return 0;
+}
@@ -0,0 +1,76 @@
+#!/bin/sh
+# Standard load scenarios against the example configurations, one JSON line per scenario on stdout.
+# Run from the repository root after `make && make bench`, or through `make bench-run`.
+#
+#   DURATION=10s CONNECTIONS=64 THREADS=2 sh bench/load/scenarios.sh [name_filter] > results.jsonl
+
+DURATION=${DURATION:-10s}
+WARMUP=${WARMUP:-1s}
+CONNECTIONS=${CONNECTIONS:-64}
+THREADS=${THREADS:-1}
+RATE=${RATE:-5000}
+FILTER=$1
+LOADGEN=./loadgen
+SERVER=./webserv
+SERVER_PID=
+
+start_server() {
+	$SERVER "$1" > /dev/null 2>&1 &
+	SERVER_PID=$!
+	# Wait until the listening socket accepts connections
+	for _ in 1 2 3 4 5 6 7 8 9 10; do
+		if $LOADGEN -c 1 -n 1 -T 1s --host localhost "http://127.0.0.1:$2/" > /dev/null 2>&1; then
+			return 0
+		fi
+		sleep 0.2
+	done
+	echo "server with $1 did not start" >&2
+	return 1
+}
+
+stop_server() {
+	[ -n "$SERVER_PID" ] && kill "$SERVER_PID" 2> /dev/null && wait "$SERVER_PID" 2> /dev/null
+	SERVER_PID=
+}
+
+trap stop_server EXIT INT TERM
+
+# scenario <name> <loadgen arguments...>
+scenario() {
+	name=$1
+	shift
+	case "$name" in
+		*"$FILTER"*) ;;
+		*) return 0 ;;
+	esac
+	echo "running $name" >&2
+	$LOADGEN --name "$name" --host localhost -t "$THREADS" -w "$WARMUP" -d "$DURATION" "$@"
+}
+
+# Static files, CGI and the connection handling, config/siege.conf (port 80)
+if start_server config/siege.conf 80; then
+	scenario static-keepalive -c "$CONNECTIONS" http://127.0.0.1:80/index.html
+	scenario static-close -c "$CONNECTIONS" --no-keepalive http://127.0.0.1:80/index.html
+	scenario static-pipelined -c "$CONNECTIONS" -P 8 http://127.0.0.1:80/index.html
+	scenario static-open-loop -c "$CONNECTIONS" -r "$RATE" http://127.0.0.1:80/index.html
+	scenario not-found -c "$CONNECTIONS" http://127.0.0.1:80/missing.html
+	scenario cgi -c 8 http://127.0.0.1:80/cgi-bin/test.py
+	scenario cgi-open-loop -c 32 -r 50 http://127.0.0.1:80/cgi-bin/test.py
+	stop_server
+fi
+
+# Autoindex and chunked request bodies, examples/complete/complete.conf (ports 80 and 8080)
+if start_server examples/complete/complete.conf 8080; then
+	scenario autoindex -c "$CONNECTIONS" http://127.0.0.1:8080/test/images/icons/
+	scenario mixed -c "$CONNECTIONS" http://127.0.0.1:8080/index.html /styles.css /script.js /favicon.ico /test/
+	scenario cgi-post-chunked -c 8 -m POST -b 4k --chunked --chunk-size 4k http://127.0.0.1:8080/test/scripts/test.py
+	stop_server
+fi
+
+# File uploads, examples/uploadthing/.conf (port 80)
+if start_server examples/uploadthing/.conf 80; then
+	scenario upload-64k -c 16 -m POST -b 64k --multipart http://127.0.0.1:80/
+	scenario upload-1m -c 4 -m POST -b 1m --multipart http://127.0.0.1:80/
+	stop_server
+	rm -f examples/uploadthing/uploads/loadgen-*.bin
+fi
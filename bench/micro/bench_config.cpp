@@ -0,0 +1,47 @@
+#include <string>
+
+#include "Lexer.hpp"
+#include "Parser.hpp"
+#include "microbench.hpp"
+
+/*
+ * Configuration loading: tokenizing and parsing a file with a few servers and many locations, the cost paid at
+ * startup and on every reload.
+ */
+namespace {
+std::string configSource(const size_t servers, const size_t locations) {
+	std::string source = "http {\n\tcgi_max_processes 16;\n";
+	for (size_t s = 0; s < servers; s++) {
+		source += "\tserver {\n\t\tlisten " + std::to_string(8080 + s) +
+				  ";\n\t\tserver_name localhost example.com;\n\t\troot /var/www;\n\t\tindex /index.html;\n"
+				  "\t\tclient_max_body_size 10m;\n\t\trequest_timeout 30s;\n\t\terror_page 404 /404.html;\n";
+		for (size_t l = 0; l < locations; l++) {
+			source += "\t\tlocation /section" + std::to_string(l) +
+					  " {\n\t\t\tallow_methods GET POST;\n\t\t\tautoindex on;\n"
+					  "\t\t\tcgi .py /usr/bin/python3;\n\t\t}\n";
+		}
+		source += "\t}\n";
+	}
+	return source + "}\n";
+}
+
+const std::string source = configSource(4, 50);
+}  // namespace
+
+BENCHMARK(config_lex_4x50_locations) {
+	for (size_t i = 0; i < iterations; i++) {
+		Lexer lexer("bench.conf", source);
+		size_t tokens = 0;
+		while (lexer.nextToken().type != TOKEN_EOF) tokens++;
+		microbench::doNotOptimize(tokens);
+	}
+}
+
+BENCHMARK(config_parse_4x50_locations) {
+	for (size_t i = 0; i < iterations; i++) {
+		Lexer lexer("bench.conf", source);
+		Parser parser(lexer);
+		const auto servers = parser.parse();
+		microbench::doNotOptimize(servers.size());
+	}
+}
@@ -0,0 +1,246 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "AutoindexStream.hpp"
+#include "ClientConnection.hpp"
+#include "HttpRequest.hpp"
+#include "HttpResponse.hpp"
+#include "RequestHandler.hpp"
+#include "ServerConfig.hpp"
+#include "microbench.hpp"
+#include "mimetypes.hpp"
+
+/*
+ * Request path of the server: header parsing, body decoding, routing and response serialization.
+ */
+namespace {
+const std::string rawHeader =
+	"GET /static/css/site.css?v=42 HTTP/1.1\r\n"
+	"Host: localhost:8080\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+	"Accept: text/css,*/*;q=0.1\r\n"
+	"Accept-Language: en-US,en;q=0.5\r\n"
+	"Accept-Encoding: gzip, deflate, br\r\n"
+	"Referer: http://localhost:8080/index.html\r\n"
+	"Connection: keep-alive\r\n"
+	"Cookie: session=8f14e45fceea167a5a36dedd4bea2543; theme=dark\r\n"
+	"Cache-Control: no-cache\r\n";
+
+ServerConfig serverConfig() {
+	ServerConfig config;
+	config.setPort(8080);
+	config.addServerName("localhost");
+	return config;
+}
+
+/**
+ * @brief `count` routes below a common prefix, as generated location blocks tend to look
+ */
+std::vector<Route> routes(const size_t count) {
+	std::vector<Route> result;
+	Route root;
+	root.setPath("/");
+	result.push_back(root);
+	for (size_t i = 0; i < count - 1; i++) {
+		Route route;
+		route.setPath("/api/v1/resource" + std::to_string(i));
+		result.push_back(route);
+	}
+	return result;
+}
+
+void routeMatch(const size_t iterations, const size_t count) {
+	const RouteTable table(routes(count));
+	const std::string location = "/api/v1/resource" + std::to_string(count / 2) + "/items/17";
+	for (size_t i = 0; i < iterations; i++) {
+		microbench::doNotOptimize(table.find(location));
+	}
+}
+
+/**
+ * @brief Feed one request through a ClientConnection on a socket pair until its body is complete
+ */
+void receiveRequest(const size_t iterations, const std::string& request) {
+	const auto listener = std::make_shared<const ListenerConfig>(
+		ListenerConfig{std::make_shared<const VirtualHosts>(std::vector<ServerConfig>{serverConfig()})});
+	for (size_t i = 0; i < iterations; i++) {
+		int fds[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+			return;
+		if (write(fds[1], request.data(), request.size()) != static_cast<ssize_t>(request.size())) {
+			close(fds[1]);
+			return;
+		}
+		ClientConnection connection(fds[0], sockaddr_in{}, listener);
+		while (connection.getStatus() != ClientConnection::Status::READY_TO_SEND && !connection.isDisconnected())
+			connection.handleClient();
+		microbench::doNotOptimize(connection.getStatus());
+		close(fds[1]);
+	}
+}
+
+std::string bodyRequest(const bool chunked, const size_t chunkSize, const size_t chunks) {
+	std::string request = "POST /upload HTTP/1.1\r\nHost: localhost:8080\r\n";
+	request += chunked ? "Transfer-Encoding: chunked\r\n\r\n"
+					   : "Content-Length: " + std::to_string(chunkSize * chunks) + "\r\n\r\n";
+	const std::string data(chunkSize, 'x');
+	for (size_t i = 0; i < chunks; i++) {
+		if (chunked) {
+			std::ostringstream size;
+			size << std::hex << chunkSize;
+			request += size.str() + "\r\n" + data + "\r\n";
+		} else {
+			request += data;
+		}
+	}
+	if (chunked)
+		request += "0\r\n\r\n";
+	return request;
+}
+}  // namespace
+
+BENCHMARK(http_request_parse) {
+	for (size_t i = 0; i < iterations; i++) {
+		const HttpRequest request(rawHeader);
+		microbench::doNotOptimize(request.getBodyType());
+	}
+}
+
+BENCHMARK(http_find_header_end) {
+	const std::string raw = rawHeader + "\r\n";
+	const std::vector<char> buffer(raw.begin(), raw.end());
+	for (size_t i = 0; i < iterations; i++) {
+		microbench::doNotOptimize(ClientConnection::findHeaderEnd(buffer));
+	}
+}
+
+// The content-length variant is the baseline: same connection setup and body size without the chunk framing
+BENCHMARK(http_body_content_length_4x1k) { receiveRequest(iterations, bodyRequest(false, 1024, 4)); }
+
+BENCHMARK(http_body_chunked_1x4k) { receiveRequest(iterations, bodyRequest(true, 4096, 1)); }
+
+BENCHMARK(http_body_chunked_4x1k) { receiveRequest(iterations, bodyRequest(true, 1024, 4)); }
+
+BENCHMARK(http_route_match_10) { routeMatch(iterations, 10); }
+
+BENCHMARK(http_route_match_100) { routeMatch(iterations, 100); }
+
+BENCHMARK(http_route_match_1000) { routeMatch(iterations, 1000); }
+
+BENCHMARK(http_response_to_string) {
+	const std::string body(2048, 'x');
+	for (size_t i = 0; i < iterations; i++) {
+		HttpResponse response;
+		response.setStatus(Http::OK);
+		response.setBody(body);
+		response.addHeader("Content-Type", "text/html");
+		response.addHeader("Connection", "keep-alive");
+		response.setDefaultHeaders();
+		const std::string wire = response.toString();
+		microbench::doNotOptimize(wire.size());
+	}
+}
+
+BENCHMARK(http_mime_type) {
+	static const std::string names[] = {"index.html", "site.css", "app.js", "photo.jpeg", "archive.tar.gz", "README"};
+	for (size_t i = 0; i < iterations; i++) {
+		const std::string_view type = getMimeType(names[i % std::size(names)]);
+		microbench::doNotOptimize(type.size());
+	}
+}
+
+BENCHMARK(http_autoindex_100_entries) {
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "webserv_microbench_autoindex";
+	std::filesystem::create_directories(directory);
+	for (int i = 0; i < 100; i++) std::ofstream(directory / ("file" + std::to_string(i) + ".txt")) << i;
+	const ServerConfig config = serverConfig();
+	const RequestHandler handler(config);
+	for (size_t i = 0; i < iterations; i++) {
+		const std::string html = handler.buildDirectoryListingHTML(directory.string());
+		microbench::doNotOptimize(html.size());
+	}
+	std::filesystem::remove_all(directory);
+}
+
+namespace {
+/**
+ * @brief Directory with 1000 files, created before the benchmarks run (the harness times the whole body) and
+ * removed at exit
+ */
+struct LargeDirectory {
+		std::filesystem::path path = std::filesystem::temp_directory_path() / "webserv_microbench_autoindex1k";
+		LargeDirectory() {
+			std::filesystem::create_directories(path);
+			for (int i = 0; i < 1000; i++) std::ofstream(path / ("file" + std::to_string(i) + ".txt")) << i;
+		}
+		~LargeDirectory() { std::filesystem::remove_all(path); }
+};
+const LargeDirectory largeDirectory;
+
+std::string jsonListing(const std::string& path) {
+	AutoindexStream::Options options;
+	options.json = true;
+	std::string json;
+	const auto stream = AutoindexStream::open(path, "/files/", options, false);
+	std::string chunk;
+	while (stream && stream->read(chunk, SIZE_MAX) != BodyStream::Status::END) json += chunk;
+	return json;
+}
+
+/**
+ * @brief List the large directory, unchanged or changed before every listing (`uncached`)
+ */
+void autoindexLarge(const size_t iterations, const bool uncached, const bool json = false) {
+	const ServerConfig config = serverConfig();
+	const RequestHandler handler(config);
+	const auto modified = std::filesystem::last_write_time(largeDirectory.path);
+	for (size_t i = 0; i < iterations; i++) {
+		if (uncached)
+			std::filesystem::last_write_time(largeDirectory.path, modified + std::chrono::seconds(i + 1));
+		const std::string listing = json ? jsonListing(largeDirectory.path.string())
+										 : handler.buildDirectoryListingHTML(largeDirectory.path.string());
+		microbench::doNotOptimize(listing.size());
+	}
+}
+}  // namespace
+
+BENCHMARK(http_autoindex_1k_entries) { autoindexLarge(iterations, false); }
+
+BENCHMARK(http_autoindex_1k_entries_uncached) { autoindexLarge(iterations, true); }
+
+BENCHMARK(http_autoindex_1k_entries_json) { autoindexLarge(iterations, false, true); }
+
+BENCHMARK(http_autoindex_1k_entries_json_uncached) { autoindexLarge(iterations, true, true); }
+
+BENCHMARK(http_error_response_builtin) {
+	ServerConfig config = serverConfig();
+	config.loadErrorPages();
+	RequestHandler handler(config);
+	for (size_t i = 0; i < iterations; i++) {
+		const HttpResponse response = handler.buildDefaultResponse(Http::NOT_FOUND);
+		microbench::doNotOptimize(response.getBody().size());
+	}
+}
+
+BENCHMARK(http_error_response_error_page) {
+	// The server resolves error pages below the working directory
+	const std::filesystem::path directory = "webserv_microbench_errors";
+	std::filesystem::create_directories(directory);
+	std::ofstream(directory / "404.html") << std::string(1024, 'x');
+	ServerConfig config = serverConfig();
+	config.setRoot("/" + directory.string());
+	config.setErrorPages({{404, "404.html"}});
+	config.loadErrorPages();
+	RequestHandler handler(config);
+	for (size_t i = 0; i < iterations; i++) {
+		const HttpResponse response = handler.buildDefaultResponse(Http::NOT_FOUND);
+		microbench::doNotOptimize(response.getBody().size());
+	}
+	std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,71 @@
+#include <array>
+
+#include "Logger.hpp"
+#include "ft_iomanip.hpp"
+#include "microbench.hpp"
+
+/*
+ * Logging cost of one keep-alive GET request with the runtime level above DEBUG/INFO, the common production
+ * setup: the same statements as on the request path of ClientConnection and RequestHandler, once with the
+ * previous eager macros (message built, then filtered inside Logger::log) and once with the lazy ones.
+ */
+namespace {
+const int fd = 7;
+const size_t bytes = 87;
+const std::string uri = "/index.html";
+
+std::string connectionLog(const std::string& msg) {
+	static const std::array<std::string, 6> colors = {CYAN, GREEN, YELLOW, BLUE, MAGENTA, ORANGE};
+	return COLOR(colors[fd % colors.size()], "ClientCon " + std::to_string(fd)) + "\t | " + msg;
+}
+
+#define EAGER(level, msg) Logger::getInstance().log(msg, level)
+
+#define REQUEST_LOGS(LOG)                                                                                     \
+	LOG(DEBUG, connectionLog("Handling client with status: HEADER"));                                         \
+	LOG(DEBUG, connectionLog("Receiving header from client"));                                                \
+	LOG(DEBUG, connectionLog("Read " + std::to_string(bytes) + " bytes"));                                    \
+	LOG(DEBUG, connectionLog("Header buffer size after read: " + std::to_string(bytes)));                     \
+	LOG(DEBUG, connectionLog("Header extracted from buffer"));                                                \
+	LOG(DEBUG, connectionLog("Header received with size: " + std::to_string(bytes - 1)));                     \
+	LOG(DEBUG, "  |- Decoded URI:         " + uri);                                                           \
+	LOG(INFO, connectionLog("Server config found for host: localhost:8080"));                                 \
+	LOG(DEBUG, connectionLog("Parsed HTTP request header successfully"));                                     \
+	LOG(DEBUG, connectionLog("Request has no body"));                                                         \
+	LOG(INFO, "Getting best match for the corresponding location path");                                     \
+	LOG(DEBUG, "  |- best match:   " + uri);                                                                  \
+	LOG(DEBUG, connectionLog("Building response for request"));                                               \
+	LOG(DEBUG, connectionLog("Sent " + std::to_string(bytes * 3) + " bytes to client"));                      \
+	LOG(INFO, connectionLog("Sending response with status code: " + std::to_string(200)));                    \
+	LOG(INFO, connectionLog("Connection is keep-alive"))
+
+struct QuietLogger {
+		LogLevel previous = Logger::getInstance().getLevel();
+		QuietLogger() { Logger::getInstance().setLevel(WARN); }
+		~QuietLogger() { Logger::getInstance().setLevel(previous); }
+};
+}  // namespace
+
+BENCHMARK(log_request_eager_filtered) {
+	QuietLogger quiet;
+	for (size_t i = 0; i < iterations; i++) {
+		REQUEST_LOGS(EAGER);
+	}
+}
+
+BENCHMARK(log_request_lazy_filtered) {
+	QuietLogger quiet;
+	for (size_t i = 0; i < iterations; i++) {
+		REQUEST_LOGS(LOG_AT);
+		microbench::doNotOptimize(i);
+	}
+}
+
+BENCHMARK(log_level_check) {
+	QuietLogger quiet;
+	size_t enabled = 0;
+	for (size_t i = 0; i < iterations; i++) {
+		enabled += Logger::getInstance().isEnabled(DEBUG);
+		microbench::doNotOptimize(enabled);
+	}
+}
@@ -0,0 +1,38 @@
+#include <chrono>
+#include <string>
+
+#include "Metrics.hpp"
+#include "microbench.hpp"
+
+/*
+ * Metrics cost of one keep-alive GET request: the counters ClientConnection touches on the request path,
+ * and the scrape that sums everything up.
+ */
+namespace {
+const std::string host = "0.0.0.0";
+const std::string route = "/static";
+}  // namespace
+
+BENCHMARK(metrics_histogram_record) {
+	LatencyHistogram histogram;
+	for (size_t i = 0; i < iterations; i++) {
+		histogram.record(40 + (i & 1023));
+	}
+	microbench::doNotOptimize(histogram);
+}
+
+BENCHMARK(metrics_request) {
+	Metrics& metrics = Metrics::getInstance();
+	for (size_t i = 0; i < iterations; i++) {
+		metrics.bytesReceived(87);
+		metrics.bytesSent(312);
+		metrics.recordRequest(host, 8080, route, 200, std::chrono::microseconds(40 + (i & 1023)));
+	}
+}
+
+BENCHMARK(metrics_render) {
+	for (size_t i = 0; i < iterations; i++) {
+		const std::string text = Metrics::getInstance().render();
+		microbench::doNotOptimize(text.size());
+	}
+}
@@ -0,0 +1,87 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "Logger.hpp"
+#include "globals.hpp"
+#include "microbench.hpp"
+
+// Defined next to the server's main(), which is not linked into the benchmarks
+std::atomic<bool> stopServer(false);
+
+namespace {
+thread_local size_t allocationCount = 0;
+}  // namespace
+
+// Count every allocation of the benchmarks, operator new[] and the sized/nothrow forms end up here as well
+void* operator new(const size_t size) {
+	++allocationCount;
+	if (void* memory = std::malloc(size ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+
+namespace microbench {
+
+size_t allocations() { return allocationCount; }
+
+std::vector<Benchmark>& registry() {
+	static std::vector<Benchmark> benchmarks;
+	return benchmarks;
+}
+
+Registrar::Registrar(const std::string& name, Body body) { registry().push_back({name, std::move(body)}); }
+
+}  // namespace microbench
+
+namespace {
+constexpr auto MIN_RUN_TIME = std::chrono::milliseconds(200);
+
+struct Measurement {
+		size_t iterations = 1;
+		double nsPerOp = 0;
+		double allocationsPerOp = 0;
+};
+
+Measurement measure(const microbench::Body& body) {
+	Measurement result;
+	while (true) {
+		const size_t allocationsBefore = microbench::allocations();
+		const auto start = std::chrono::steady_clock::now();
+		body(result.iterations);
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+		if (elapsed >= MIN_RUN_TIME || result.iterations >= (size_t(1) << 40)) {
+			const auto iterations = static_cast<double>(result.iterations);
+			result.nsPerOp = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+			result.allocationsPerOp = static_cast<double>(microbench::allocations() - allocationsBefore) / iterations;
+			return result;
+		}
+		result.iterations *= 2;
+	}
+}
+}  // namespace
+
+/**
+ * @brief Run all benchmarks, or only those whose name contains one of the arguments
+ */
+int main(const int argc, const char* argv[]) {
+	// The code under test logs on its request path, keep the output readable
+	Logger::getInstance().setLevel(ERROR);
+	std::printf("%-40s %14s %12s %10s\n", "benchmark", "iterations", "ns/op", "allocs/op");
+	for (const auto& benchmark : microbench::registry()) {
+		bool selected = argc < 2;
+		for (int i = 1; i < argc; i++) selected |= std::strstr(benchmark.name.c_str(), argv[i]) != nullptr;
+		if (!selected)
+			continue;
+		const Measurement result = measure(benchmark.body);
+		std::printf("%-40s %14zu %12.1f %10.2f\n", benchmark.name.c_str(), result.iterations, result.nsPerOp,
+					result.allocationsPerOp);
+	}
+	return 0;
+}
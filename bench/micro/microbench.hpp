@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Minimal self-contained microbenchmark harness.
+ *
+ * A benchmark body runs its operation `iterations` times; the runner grows the iteration count until a run
+ * takes long enough to be measured and reports the time and the heap allocations per operation.
+ */
+namespace microbench {
+
+using Body = std::function<void(size_t iterations)>;
+
+struct Benchmark {
+		std::string name;
+		Body body;
+};
+
+std::vector<Benchmark>& registry();
+
+/**
+ * @brief Calls of the global operator new on the calling thread so far
+ */
+size_t allocations();
+
+struct Registrar {
+		Registrar(const std::string& name, Body body);
+};
+
+/**
+ * @brief Keep the optimizer from discarding a computed value
+ */
+template <typename T>
+inline void doNotOptimize(const T& value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}  // namespace microbench
+
+#define BENCHMARK(name)                                                      \
+	static void name(size_t iterations);                                     \
+	static const microbench::Registrar name##_registrar(#name, name);        \
+	static void name(size_t iterations)
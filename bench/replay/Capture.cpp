@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "Replay.hpp"
+#include "TrafficCapture.hpp"
+
+namespace {
+class Cursor {
+	public:
+		explicit Cursor(const std::string& data) : _data(data) {}
+
+		[[nodiscard]] bool has(const size_t bytes) const { return _data.size() - _position >= bytes; }
+
+		uint64_t integer(const size_t bytes) {
+			uint64_t value = 0;
+			for (size_t i = 0; i < bytes; ++i)
+				value |= static_cast<uint64_t>(static_cast<unsigned char>(_data[_position + i])) << (8 * i);
+			_position += bytes;
+			return value;
+		}
+
+		std::string bytes(const size_t size) {
+			std::string value = _data.substr(_position, size);
+			_position += size;
+			return value;
+		}
+
+		[[nodiscard]] size_t position() const { return _position; }
+		void skip(const size_t bytes) { _position += bytes; }
+
+	private:
+		const std::string& _data;
+		size_t _position = 0;
+};
+}  // namespace
+
+std::vector<CapturedConnection> loadCapture(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		throw std::runtime_error("cannot open " + path);
+	const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (data.size() < sizeof(TrafficCapture::MAGIC) ||
+		std::memcmp(data.data(), TrafficCapture::MAGIC, sizeof(TrafficCapture::MAGIC)) != 0)
+		throw std::runtime_error(path + " is not a traffic capture");
+
+	std::vector<CapturedConnection> connections;
+	std::unordered_map<uint32_t, size_t> byId;
+	Cursor cursor(data);
+	cursor.skip(sizeof(TrafficCapture::MAGIC));
+	while (cursor.has(TrafficCapture::RECORD_HEADER_SIZE)) {
+		const size_t recordStart = cursor.position();
+		const auto type = static_cast<TrafficCapture::RecordType>(cursor.integer(1));
+		const auto id = static_cast<uint32_t>(cursor.integer(4));
+		const uint64_t at = cursor.integer(8);
+
+		// Connections opened before the file was (re)opened have no OPEN record
+		auto it = byId.find(id);
+		if (it == byId.end()) {
+			it = byId.emplace(id, connections.size()).first;
+			connections.emplace_back();
+			connections.back().id = id;
+			connections.back().openedAt = at;
+		}
+		CapturedConnection& connection = connections[it->second];
+
+		bool complete = true;
+		switch (type) {
+			case TrafficCapture::OPEN:
+				if ((complete = cursor.has(2)))
+					connection.port = static_cast<uint16_t>(cursor.integer(2));
+				break;
+			case TrafficCapture::DATA: {
+				if (!(complete = cursor.has(4)))
+					break;
+				const size_t size = cursor.integer(4);
+				if (!(complete = cursor.has(size)))
+					break;
+				connection.sends.push_back({at, connection.responses.size(), cursor.bytes(size)});
+				break;
+			}
+			case TrafficCapture::RESPONSE: {
+				if (!(complete = cursor.has(2 + 1 + 8)))
+					break;
+				CapturedConnection::Response response;
+				response.status = static_cast<int>(cursor.integer(2));
+				response.withoutBody = cursor.integer(1) & TrafficCapture::RESPONSE_WITHOUT_BODY;
+				response.bodyBytes = cursor.integer(8);
+				connection.responses.push_back(response);
+				break;
+			}
+			case TrafficCapture::CLOSE:
+				break;
+			default:
+				throw std::runtime_error("unknown record type " + std::to_string(type) + " at offset " +
+										 std::to_string(recordStart) + " of " + path);
+		}
+		if (!complete) {
+			std::fprintf(stderr, "warning: %s ends in the middle of a record\n", path.c_str());
+			break;
+		}
+	}
+
+	// Connections that never sent anything have nothing to replay
+	connections.erase(std::remove_if(connections.begin(), connections.end(),
+									 [](const CapturedConnection& connection) { return connection.sends.empty(); }),
+					  connections.end());
+	std::stable_sort(connections.begin(), connections.end(),
+					 [](const CapturedConnection& a, const CapturedConnection& b) { return a.openedAt < b.openedAt; });
+	return connections;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "LatencyHistogram.hpp"
+#include "LoadGenerator.hpp"
+
+/**
+ * @brief One client connection of a capture: what it sent and when, and what the server answered
+ */
+struct CapturedConnection {
+		/**
+		 * @brief Bytes received in one read on the server
+		 */
+		struct Send {
+				uint64_t at = 0;		 // microseconds since the start of the capture
+				size_t responses = 0;	 // responses sent on the connection before, the client had them
+				std::string data;
+		};
+
+		struct Response {
+				int status = 0;
+				bool withoutBody = false;
+				uint64_t bodyBytes = 0;
+		};
+
+		uint32_t id = 0;
+		uint16_t port = 0;
+		uint64_t openedAt = 0;
+		std::vector<Send> sends;
+		std::vector<Response> responses;
+};
+
+/**
+ * @brief Read a file written by `traffic_capture`, connections in the order they were opened. A record cut
+ * off at the end (the server was still writing) is ignored.
+ */
+std::vector<CapturedConnection> loadCapture(const std::string& path);
+
+struct ReplayOptions {
+		std::string capture;
+		std::string host = "127.0.0.1";
+		int port = 0;  // 0 = the port each connection was captured on
+		double speed = 1;  // 2 = twice as fast as captured, 0 = as fast as the responses allow
+		size_t connections = 1024;	// open at the same time
+		std::chrono::milliseconds timeout{5000};
+		size_t diffs = 10;	// mismatches to print
+};
+
+/**
+ * @brief Counters of a replay, compared against the responses in the capture
+ */
+struct ReplayResult {
+		enum Error { CONNECT, READ, TIMEOUT, CLOSED, PARSE, ERROR_COUNT };
+
+		uint64_t connections = 0;
+		uint64_t sends = 0;
+		uint64_t bytesOut = 0;
+		uint64_t expected = 0;
+		uint64_t responses = 0;
+		uint64_t matched = 0;
+		uint64_t statusMismatches = 0;
+		uint64_t lengthMismatches = 0;
+		uint64_t missing = 0;
+		uint64_t unexpected = 0;
+		uint64_t errors[ERROR_COUNT] = {};
+		LatencyHistogram::Snapshot latency;
+
+		[[nodiscard]] static const char* errorName(Error error);
+};
+
+/**
+ * @brief Replays every captured connection on a connection of its own, with the captured bytes in the
+ * captured order and read boundaries, so keep-alive reuse and pipelining are the same as in the capture.
+ *
+ * A send is due at its captured time divided by the speed, and never before the responses the client had
+ * received at that point arrived. With speed 0 only the second condition holds, which replays the workload
+ * as fast as the server answers.
+ */
+class Replayer {
+	public:
+		Replayer(const ReplayOptions& options, const std::vector<CapturedConnection>& capture);
+		~Replayer();
+		Replayer(const Replayer&) = delete;
+		Replayer& operator=(const Replayer&) = delete;
+
+		void run(const volatile bool& stop);
+		[[nodiscard]] ReplayResult result() const;
+		[[nodiscard]] double seconds() const;
+
+	private:
+		struct Connection {
+				const CapturedConnection* captured = nullptr;
+				int fd = -1;
+				bool connected = false;
+				size_t nextSend = 0;
+				std::string out;
+				size_t outOffset = 0;
+				size_t received = 0;
+				ResponseReader reader;
+				Clock::time_point sentAt;
+				Clock::time_point lastProgress;
+		};
+
+		[[nodiscard]] Clock::time_point _due(uint64_t at) const;
+		void _open(Connection& connection);
+		void _finish(Connection& connection, ReplayResult::Error error);
+		void _send(Connection& connection, Clock::time_point now);
+		void _onReadable(Connection& connection);
+		void _onResponse(Connection& connection);
+		bool _done(const Connection& connection) const;
+
+		const ReplayOptions& _options;
+		const std::vector<CapturedConnection>& _capture;
+		int _epollFd = -1;
+		std::vector<Connection> _connections;
+		size_t _firstOpen = 0;
+		size_t _nextOpen = 0;
+		size_t _active = 0;
+		Clock::time_point _start;
+		Clock::time_point _end;
+		LatencyHistogram _latency;
+		ReplayResult _result;
+};
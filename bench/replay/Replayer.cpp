@@ -0,0 +1,312 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include "Replay.hpp"
+
+namespace {
+constexpr size_t READ_BUFFER_SIZE = 64 * 1024;
+constexpr size_t MAX_EVENTS = 256;
+constexpr auto IDLE_WAIT = std::chrono::milliseconds(10);
+}  // namespace
+
+const char* ReplayResult::errorName(const Error error) {
+	switch (error) {
+		case CONNECT:
+			return "connect";
+		case READ:
+			return "read";
+		case TIMEOUT:
+			return "timeout";
+		case CLOSED:
+			return "closed";
+		case PARSE:
+			return "parse";
+		default:
+			return "unknown";
+	}
+}
+
+Replayer::Replayer(const ReplayOptions& options, const std::vector<CapturedConnection>& capture)
+	: _options(options), _capture(capture), _connections(capture.size()) {
+	_epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (_epollFd == -1)
+		throw std::runtime_error(std::string("epoll_create1: ") + std::strerror(errno));
+	for (size_t i = 0; i < capture.size(); ++i) {
+		_connections[i].captured = &capture[i];
+		_result.expected += capture[i].responses.size();
+	}
+	_result.connections = capture.size();
+}
+
+Replayer::~Replayer() {
+	for (const Connection& connection : _connections) {
+		if (connection.fd != -1)
+			close(connection.fd);
+	}
+	close(_epollFd);
+}
+
+void Replayer::run(const volatile bool& stop) {
+	_start = Clock::now();
+	epoll_event events[MAX_EVENTS];
+	while (!stop) {
+		const Clock::time_point now = Clock::now();
+		while (_nextOpen < _connections.size() && _active < _options.connections &&
+			   _due(_capture[_nextOpen].openedAt) <= now)
+			_open(_connections[_nextOpen++]);
+		if (_nextOpen == _connections.size() && _active == 0)
+			break;
+
+		Clock::time_point wakeAt = now + IDLE_WAIT;
+		if (_nextOpen < _connections.size() && _active < _options.connections)
+			wakeAt = std::min(wakeAt, _due(_capture[_nextOpen].openedAt));
+		// Connections finish roughly in the order they were opened, skip the closed ones at the front
+		while (_firstOpen < _nextOpen && _connections[_firstOpen].fd == -1) _firstOpen++;
+		for (size_t i = _firstOpen; i < _nextOpen; ++i) {
+			Connection& connection = _connections[i];
+			if (connection.fd == -1 || !connection.connected)
+				continue;
+			_send(connection, now);
+			if (connection.fd == -1)
+				continue;
+			const auto& sends = connection.captured->sends;
+			const size_t awaited =
+				connection.nextSend < sends.size() ? sends[connection.nextSend].responses : sends.size();
+			const bool waiting = connection.outOffset < connection.out.size() ||
+								 connection.received < std::min(awaited, connection.captured->responses.size());
+			if (waiting && now - connection.lastProgress > _options.timeout)
+				_finish(connection, ReplayResult::TIMEOUT);
+			else if (!waiting && connection.nextSend < sends.size())
+				wakeAt = std::min(wakeAt, _due(sends[connection.nextSend].at));
+		}
+
+		const auto wait = std::chrono::ceil<std::chrono::milliseconds>(wakeAt - Clock::now()).count();
+		const int count = epoll_wait(_epollFd, events, MAX_EVENTS, static_cast<int>(std::max<int64_t>(0, wait)));
+		for (int i = 0; i < count; ++i) {
+			Connection& connection = _connections[events[i].data.u64];
+			if (connection.fd == -1)
+				continue;
+			if (!connection.connected && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+				int error = 0;
+				socklen_t length = sizeof(error);
+				getsockopt(connection.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+				if (error != 0) {
+					_finish(connection, ReplayResult::CONNECT);
+					continue;
+				}
+				connection.connected = true;
+				connection.lastProgress = Clock::now();
+				epoll_event event{};
+				event.events = EPOLLIN | EPOLLRDHUP;
+				event.data.u64 = events[i].data.u64;
+				epoll_ctl(_epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+			}
+			if (events[i].events & EPOLLOUT)
+				_send(connection, Clock::now());
+			if (connection.fd != -1 && (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+				_onReadable(connection);
+		}
+	}
+	_end = Clock::now();
+}
+
+ReplayResult Replayer::result() const {
+	ReplayResult result = _result;
+	result.latency.add(_latency);
+	return result;
+}
+
+double Replayer::seconds() const { return std::chrono::duration<double>(_end - _start).count(); }
+
+/**
+ * @brief Wall clock time of a point in the capture
+ */
+Clock::time_point Replayer::_due(const uint64_t at) const {
+	if (_options.speed <= 0)
+		return _start;
+	return _start + std::chrono::duration_cast<Clock::duration>(
+						std::chrono::duration<double, std::micro>(static_cast<double>(at) / _options.speed));
+}
+
+void Replayer::_open(Connection& connection) {
+	const int port = _options.port != 0 ? _options.port : connection.captured->port;
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(static_cast<uint16_t>(port));
+	inet_pton(AF_INET, _options.host.c_str(), &address.sin_addr);
+
+	connection.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	_active++;
+	if (connection.fd == -1 || port == 0 ||
+		(::connect(connection.fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 &&
+		 errno != EINPROGRESS)) {
+		_finish(connection, ReplayResult::CONNECT);
+		return;
+	}
+	epoll_event event{};
+	event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+	event.data.u64 = static_cast<uint64_t>(&connection - _connections.data());
+	epoll_ctl(_epollFd, EPOLL_CTL_ADD, connection.fd, &event);
+	connection.lastProgress = Clock::now();
+	connection.reader.expectNoBody(!connection.captured->responses.empty() &&
+								   connection.captured->responses.front().withoutBody);
+}
+
+/**
+ * @brief Close the connection, every response that did not arrive counts as missing
+ * @param error ERROR_COUNT if the connection ended as captured
+ */
+void Replayer::_finish(Connection& connection, const ReplayResult::Error error) {
+	if (error != ReplayResult::ERROR_COUNT)
+		_result.errors[error]++;
+	const size_t expected = connection.captured->responses.size();
+	_result.missing += expected - std::min(connection.received, expected);
+	if (connection.fd != -1)
+		close(connection.fd);
+	connection.fd = -1;
+	connection.out.clear();
+	_active--;
+}
+
+/**
+ * @brief Queue every send that is due and whose responses arrived, then write as much as the socket takes
+ */
+void Replayer::_send(Connection& connection, const Clock::time_point now) {
+	const auto& sends = connection.captured->sends;
+	bool queued = false;
+	while (connection.nextSend < sends.size()) {
+		const CapturedConnection::Send& send = sends[connection.nextSend];
+		if (connection.received < send.responses || _due(send.at) > now)
+			break;
+		connection.out += send.data;
+		connection.nextSend++;
+		_result.sends++;
+		queued = true;
+	}
+	if (queued) {
+		connection.sentAt = now;
+		connection.lastProgress = now;
+	}
+
+	const bool pending = connection.outOffset < connection.out.size();
+	while (connection.outOffset < connection.out.size()) {
+		const ssize_t sent = ::send(connection.fd, connection.out.data() + connection.outOffset,
+									connection.out.size() - connection.outOffset, MSG_NOSIGNAL);
+		if (sent == -1 && errno == EAGAIN)
+			break;
+		if (sent <= 0) {
+			_finish(connection, ReplayResult::CLOSED);
+			return;
+		}
+		connection.outOffset += sent;
+		_result.bytesOut += sent;
+		connection.lastProgress = now;
+	}
+	const bool blocked = connection.outOffset < connection.out.size();
+	if (!blocked) {
+		connection.out.clear();
+		connection.outOffset = 0;
+	}
+	// Only ask for writability while data is stuck in the buffer
+	if (pending || blocked) {
+		epoll_event event{};
+		event.events = blocked ? EPOLLIN | EPOLLRDHUP | EPOLLOUT : EPOLLIN | EPOLLRDHUP;
+		event.data.u64 = static_cast<uint64_t>(&connection - _connections.data());
+		epoll_ctl(_epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+	}
+	if (_done(connection))
+		_finish(connection, ReplayResult::ERROR_COUNT);
+}
+
+void Replayer::_onReadable(Connection& connection) {
+	char buffer[READ_BUFFER_SIZE];
+	while (connection.fd != -1) {
+		const ssize_t received = recv(connection.fd, buffer, sizeof(buffer), 0);
+		if (received == -1 && errno == EAGAIN)
+			return;
+		if (received == -1) {
+			_finish(connection, ReplayResult::READ);
+			return;
+		}
+		if (received == 0) {
+			if (connection.reader.finishOnClose())
+				_onResponse(connection);
+			_finish(connection, _done(connection) ? ReplayResult::ERROR_COUNT : ReplayResult::CLOSED);
+			return;
+		}
+		connection.lastProgress = Clock::now();
+		size_t offset = 0;
+		while (offset < static_cast<size_t>(received)) {
+			size_t consumed = 0;
+			const ResponseReader::Result result = connection.reader.feed(buffer + offset, received - offset, consumed);
+			offset += consumed;
+			if (result == ResponseReader::Result::ERROR) {
+				_finish(connection, ReplayResult::PARSE);
+				return;
+			}
+			if (result == ResponseReader::Result::COMPLETE)
+				_onResponse(connection);
+		}
+		if (_done(connection)) {
+			_finish(connection, ReplayResult::ERROR_COUNT);
+			return;
+		}
+	}
+}
+
+/**
+ * @brief Compare a complete response with the captured one at the same position
+ */
+void Replayer::_onResponse(Connection& connection) {
+	const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - connection.sentAt);
+	_latency.record(static_cast<uint64_t>(std::max<int64_t>(0, latency.count())));
+	_result.responses++;
+
+	const auto& expected = connection.captured->responses;
+	const int status = connection.reader.status();
+	const uint64_t bodyBytes = connection.reader.bodyBytes();
+	bool differs = true;
+	if (connection.received >= expected.size())
+		_result.unexpected++;
+	else if (expected[connection.received].status != status)
+		_result.statusMismatches++;
+	else if (expected[connection.received].bodyBytes != bodyBytes)
+		_result.lengthMismatches++;
+	else {
+		_result.matched++;
+		differs = false;
+	}
+	const uint64_t differences = _result.unexpected + _result.statusMismatches + _result.lengthMismatches;
+	if (differs && differences <= _options.diffs) {
+		if (connection.received >= expected.size())
+			std::fprintf(stderr, "connection %u response %zu: unexpected %d with %llu body bytes\n",
+						 connection.captured->id, connection.received, status,
+						 static_cast<unsigned long long>(bodyBytes));
+		else
+			std::fprintf(stderr, "connection %u response %zu: captured %d with %llu body bytes, got %d with %llu\n",
+						 connection.captured->id, connection.received, expected[connection.received].status,
+						 static_cast<unsigned long long>(expected[connection.received].bodyBytes), status,
+						 static_cast<unsigned long long>(bodyBytes));
+	}
+
+	connection.received++;
+	connection.reader.reset();
+	connection.reader.expectNoBody(connection.received < expected.size() &&
+								   expected[connection.received].withoutBody);
+}
+
+/**
+ * @brief Everything was sent and every captured response arrived
+ */
+bool Replayer::_done(const Connection& connection) const {
+	return connection.nextSend == connection.captured->sends.size() && connection.out.empty() &&
+		   connection.received >= connection.captured->responses.size() && connection.reader.idle();
+}
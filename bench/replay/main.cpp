@@ -0,0 +1,137 @@
+#include <getopt.h>
+#include <sys/resource.h>
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+#include "Replay.hpp"
+
+namespace {
+volatile bool stopRequested = false;
+
+void stopSignalHandler(const int) { stopRequested = true; }
+
+void usage(const char* program) {
+	std::fprintf(stderr,
+				 "usage: %s [options] capture_file [host[:port]]\n"
+				 "  host defaults to 127.0.0.1, port to the port every connection was captured on\n"
+				 "  -s, --speed FACTOR      replay FACTOR times as fast as captured (default 1)\n"
+				 "  -m, --max               replay as fast as the server answers\n"
+				 "  -c, --connections N     connections open at the same time (default 1024)\n"
+				 "  -T, --timeout TIME      give up on a connection without progress, in ms (default 5000)\n"
+				 "  -D, --diffs N           print the first N differing responses (default 10)\n",
+				 program);
+}
+
+void raiseFileLimit(const size_t connections) {
+	rlimit limit{};
+	if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur >= connections + 64)
+		return;
+	limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, connections + 64);
+	setrlimit(RLIMIT_NOFILE, &limit);
+}
+
+std::string report(const ReplayOptions& options, const ReplayResult& result, const double seconds) {
+	static constexpr double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+	static constexpr const char* QUANTILE_NAMES[] = {"p50", "p90", "p99", "p999"};
+
+	std::ostringstream json;
+	json.setf(std::ios::fixed);
+	json.precision(1);
+	json << "{\"capture\":\"" << options.capture << "\",\"target\":\"" << options.host;
+	if (options.port != 0)
+		json << ":" << options.port;
+	json << "\",\"speed\":" << (options.speed > 0 ? std::to_string(options.speed) : "\"max\"")
+		 << ",\"connections\":" << result.connections << ",\"sends\":" << result.sends
+		 << ",\"bytes_out\":" << result.bytesOut << ",\"duration_s\":" << seconds
+		 << ",\"throughput_rps\":" << (seconds > 0 ? static_cast<double>(result.responses) / seconds : 0)
+		 << ",\"expected\":" << result.expected << ",\"responses\":" << result.responses
+		 << ",\"matched\":" << result.matched << ",\"status_mismatch\":" << result.statusMismatches
+		 << ",\"length_mismatch\":" << result.lengthMismatches << ",\"missing\":" << result.missing
+		 << ",\"unexpected\":" << result.unexpected << ",\"errors\":{";
+	for (int i = 0; i < ReplayResult::ERROR_COUNT; ++i)
+		json << (i ? "," : "") << "\"" << ReplayResult::errorName(static_cast<ReplayResult::Error>(i))
+			 << "\":" << result.errors[i];
+	const auto& latency = result.latency;
+	json << "},\"latency_us\":{\"mean\":"
+		 << (latency.count ? static_cast<double>(latency.sum) / static_cast<double>(latency.count) : 0);
+	for (size_t i = 0; i < std::size(QUANTILES); ++i)
+		json << ",\"" << QUANTILE_NAMES[i] << "\":" << latency.valueAtQuantile(QUANTILES[i]);
+	json << "}}";
+	return json.str();
+}
+}  // namespace
+
+/**
+ * @brief Replays a `traffic_capture` file against a server and compares the responses with the captured ones
+ */
+int main(const int argc, char* argv[]) {
+	static const option longOptions[] = {{"speed", required_argument, nullptr, 's'},
+										 {"max", no_argument, nullptr, 'm'},
+										 {"connections", required_argument, nullptr, 'c'},
+										 {"timeout", required_argument, nullptr, 'T'},
+										 {"diffs", required_argument, nullptr, 'D'},
+										 {"help", no_argument, nullptr, 'h'},
+										 {nullptr, 0, nullptr, 0}};
+
+	ReplayOptions options;
+	int opt;
+	while ((opt = getopt_long(argc, argv, "s:mc:T:D:h", longOptions, nullptr)) != -1) {
+		switch (opt) {
+			case 's':
+				options.speed = std::strtod(optarg, nullptr);
+				if (options.speed <= 0) {
+					std::fprintf(stderr, "invalid speed: %s\n", optarg);
+					return 1;
+				}
+				break;
+			case 'm':
+				options.speed = 0;
+				break;
+			case 'c':
+				options.connections = std::max<size_t>(1, std::strtoull(optarg, nullptr, 10));
+				break;
+			case 'T':
+				options.timeout = std::chrono::milliseconds(std::strtoull(optarg, nullptr, 10));
+				break;
+			case 'D':
+				options.diffs = std::strtoull(optarg, nullptr, 10);
+				break;
+			default:
+				usage(argv[0]);
+				return opt == 'h' ? 0 : 1;
+		}
+	}
+	if (optind >= argc || argc - optind > 2) {
+		usage(argv[0]);
+		return 1;
+	}
+	options.capture = argv[optind];
+	if (optind + 1 < argc) {
+		const std::string target = argv[optind + 1];
+		const size_t colon = target.find(':');
+		options.host = target.substr(0, colon);
+		if (colon != std::string::npos)
+			options.port = std::atoi(target.c_str() + colon + 1);
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, stopSignalHandler);
+	signal(SIGTERM, stopSignalHandler);
+	raiseFileLimit(options.connections);
+
+	try {
+		const std::vector<CapturedConnection> capture = loadCapture(options.capture);
+		Replayer replayer(options, capture);
+		replayer.run(stopRequested);
+		std::printf("%s\n", report(options, replayer.result(), replayer.seconds()).c_str());
+		const ReplayResult result = replayer.result();
+		return result.matched == result.expected && result.unexpected == 0 ? 0 : 2;
+	} catch (const std::exception& e) {
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+}
@@ -1,30 +1,46 @@
 #pragma once
 #include <netinet/in.h>
 
+#include <chrono>
+#include <optional>
 #include <string>
 
+#include "AccessLog.hpp"
+#include "ConnectionTable.hpp"
 #include "HttpRequest.hpp"
 #include "HttpResponse.hpp"
+#include "IoWait.hpp"
 #include "RequestHandler.hpp"
+#include "RequestTiming.hpp"
+#include "VirtualHosts.hpp"
 
 class ClientConnection {
 	public:
 		enum class Status { HEADER, BODY, READY_TO_SEND, SENDING_RESPONSE };
 
-		explicit ClientConnection(int clientFd, sockaddr_in clientAddr, std::vector<ServerConfig> configs);
+		explicit ClientConnection(int clientFd, sockaddr_in clientAddr, std::shared_ptr<const ListenerConfig> listener);
 		~ClientConnection();
 
 		void handleClient();
 		void sendResponse();
 		[[nodiscard]] bool isDisconnected() const;
+		[[nodiscard]] bool isWaiting() const;
+		[[nodiscard]] bool isWriting() const;
+		[[nodiscard]] bool hasBufferedRequest() const;
+		void describe(ConnectionTable::Row& row) const;
+		void drain();
+		[[nodiscard]] bool isDrained() const;
 
 		[[nodiscard]] Status getStatus() const;
+		[[nodiscard]] std::optional<IoWait> getWait() const;
+
+		static std::optional<size_t> findHeaderEnd(const std::vector<char>& buffer);
 
 	private:
 		int _clientFd;
 		bool _disconnected;
-		ServerConfig& _currentConfig;
-		std::vector<ServerConfig> _configs;
+		std::shared_ptr<const ListenerConfig> _listener;
+		ServerConfigSnapshot _configs;	// keeps the configs alive, the request handler points into them
 		sockaddr_in _clientAddr;
 		std::vector<char> _headerBuffer;
 		std::vector<char> _bodyBuffer;
@@ -36,23 +52,53 @@ class ClientConnection {
 		HttpResponse _response = HttpResponse();
 
 		bool _readingChunkSize = true;
+		bool _readingChunkTrailer = false;
 		size_t _chunkSizeRemaining = 0;
 		size_t _bytesSendToClient = 0;
+		std::string _sendBuffer;
+
+		// Drain loops: the socket has no more data to read or no room to write, and what is left to read now
+		bool _wouldBlock = false;
+		size_t _readBudget = 0;
+
+		// The response cannot go on before what getWait() reports happened (CGI output, upstream data)
+		bool _pending = false;
+
+		// For the access log and the metrics
+		RequestTiming _timing;
+		size_t _responseHeaderSize = 0;
+		size_t _responseBytesSent = 0;
+		std::string _routePath;
+
+		// The server shuts down gracefully: the response in progress is the last one
+		bool _draining = false;
+
+		// Id in the traffic capture, 0 if capturing is off
+		uint32_t _captureId = 0;
+
+		// For the connection table
+		const std::chrono::steady_clock::time_point _acceptedAt = std::chrono::steady_clock::now();
+		std::chrono::steady_clock::time_point _lastActivity = _acceptedAt;
 
 		void _handleCompleteChunkedBodyRead();
 		bool _readChunkData();
 		bool _readChunkTerminator();
+		bool _readChunkTrailer();
 		void _readRequestBodyIfChunked();
 		bool _parseChunkSize();
 		void _receiveBody();
 		bool _extractHeaderIfComplete(std::vector<char>& header);
 		void _logHeader() const;
 		bool _readData(int fd, std::vector<char>& buffer, size_t bytesToRead);
+		[[nodiscard]] size_t _framingReadSize() const;
 		bool _receiveHeader();
 		void _readRequestBodyIfContentLength();
 		void _handleCompleteBodyRead();
+		void _updateConfig();
 		bool _parseHttpRequestHeader(const std::string& header);
 		bool _sendDataToClient(const std::string& data, size_t offset, size_t length);
-		static std::optional<size_t> _findHeaderEnd(const std::vector<char>& buffer);
+		bool _pullBodyStream();
+		void _finishRequest();
+		[[nodiscard]] AccessLog::Entry _accessLogEntry() const;
 		[[nodiscard]] std::string _log(const std::string& msg) const;
 };
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "HttpStatus.hpp"
+
+/**
+ * @brief Bodies of the error responses of one server, rendered and read once when the configuration is loaded.
+ *
+ * The `error_page` files are read here, a reload reads them again. Statuses without a page of their own get the
+ * built-in page, which is rendered here as well. The bodies are immutable and shared with the responses, so error
+ * responses neither touch the disk nor copy the page.
+ */
+class ErrorPages {
+	public:
+		using Page = std::shared_ptr<const std::string>;
+
+		ErrorPages() = default;
+		ErrorPages(const std::map<int, std::string>& pages, const std::string& root);
+
+		[[nodiscard]] Page find(Http::Status code) const;
+
+		[[nodiscard]] static std::string render(Http::Status code);
+
+	private:
+		std::unordered_map<int, Page> _pages;
+};
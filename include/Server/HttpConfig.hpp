@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+#include "Logger.hpp"
+#include "TrafficCapture.hpp"
+#include "UpstreamConfig.hpp"
+
+/**
+ * @brief Settings declared directly inside the `http { ... }` block, shared by every server
+ */
+class HttpConfig {
+		size_t _cgiMaxProcesses = 0;
+		size_t _cgiQueueSize = 64;
+		size_t _cgiQueueTimeout = 5000;
+		std::vector<UpstreamConfig> _upstreams;
+		bool _logAsync = false;
+		LogLevel _logLevel = LOG_LEVEL;
+		TrafficCaptureConfig _trafficCapture;
+
+	public:
+		HttpConfig() = default;
+
+		// Getters
+		[[nodiscard]] size_t getCgiMaxProcesses() const;
+		[[nodiscard]] size_t getCgiQueueSize() const;
+		[[nodiscard]] size_t getCgiQueueTimeout() const;
+		[[nodiscard]] const std::vector<UpstreamConfig>& getUpstreams() const;
+		[[nodiscard]] bool getLogAsync() const;
+		[[nodiscard]] LogLevel getLogLevel() const;
+		[[nodiscard]] const TrafficCaptureConfig& getTrafficCapture() const;
+
+		// Setters
+		void setCgiMaxProcesses(size_t max);
+		void setCgiQueueSize(size_t size);
+		void setCgiQueueTimeout(size_t timeout);
+		void addUpstream(const UpstreamConfig& upstream);
+		void setLogAsync(bool async);
+		void setLogLevel(LogLevel level);
+		void setTrafficCapture(const TrafficCaptureConfig& capture);
+
+		// Overload "<<" operator to print HttpConfig details
+		friend std::ostream& operator<<(std::ostream& os, const HttpConfig& config);
+};
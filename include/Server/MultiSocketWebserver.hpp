@@ -1,8 +1,14 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "ConnectionTable.hpp"
+#include "IoWait.hpp"
 #include "PollFdManager.hpp"
 #include "ServerConfig.hpp"
 
@@ -10,15 +16,54 @@ class ClientConnection;
 class Socket;
 
 class MultiSocketWebserver {
+	public:
+		/**
+		 * @brief Configuration read again for a reload
+		 */
+		struct LoadedConfig {
+				std::vector<std::vector<ServerConfig>> servers;	 // grouped by listening socket
+				std::function<void()> applyHttp;				 // applies the `http` block, opens the access logs
+		};
+
+		/**
+		 * @return std::nullopt if the configuration is invalid (the errors are logged)
+		 */
+		using ConfigLoader = std::function<std::optional<LoadedConfig>()>;
+
+	private:
 		std::vector<std::vector<ServerConfig>> _server_configs_vector;
 		std::unordered_map<int, std::unique_ptr<Socket>> _sockets;
 		std::unordered_map<int, std::unique_ptr<ClientConnection>> _clients;
+		std::unordered_map<int, IoWait> _waits;	// connections whose response waits, by client descriptor
+		std::unordered_map<int, int> _waitFds;	// descriptor a response waits for -> client descriptor
 		PollFdManager& _polls;
+		std::shared_ptr<ConnectionTable::Stream> _connectionDump;  // SIGUSR2 dump in progress
+		ConfigLoader _configLoader;
+		std::vector<std::string> _upgradeCommand;  // argv this process was started with
+		pid_t _upgradePid = 0;					   // new binary of an upgrade in progress
+		bool _draining = false;
+
+		static std::atomic<bool> _reloadRequested;
+		static std::atomic<bool> _upgradeRequested;
+		static std::atomic<bool> _drainRequested;
 
 		void _acceptConnection(int server_fd);
 		bool _handleClientData(int client_fd);
+		void _updateEvents(int fd, short events);
+		void _setWait(int clientFd, const std::optional<IoWait>& wait);
+		void _resumeClient(int clientFd);
+		void _resumeExpiredWaits();
+		void _resumeWokenWaits();
+		[[nodiscard]] int _waitTimeout(int timeout) const;
+		void _closeClient(int fd);
 		[[nodiscard]] bool isServerFd(int fd) const;
 		static void _setSocketTimeouts(int socketFd, size_t timeoutSec);
+		void _continueConnectionDump();
+		void _reload();
+		void _upgrade();
+		void _checkUpgrade();
+		void _startDrain();
+		size_t _closeIdleClients();
 
 	public:
 		explicit MultiSocketWebserver(std::vector<std::vector<ServerConfig>> servers_config);
@@ -28,4 +73,10 @@ class MultiSocketWebserver {
 		bool _handleClientWrite(int fd);
 		void run();
 		void initSockets();
+		void setConfigLoader(ConfigLoader loader);
+		void setUpgradeCommand(std::vector<std::string> argv);
+
+		static void requestReload();
+		static void requestUpgrade();
+		static void requestDrain();
 };
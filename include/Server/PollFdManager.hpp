@@ -11,7 +11,8 @@ class PollFdManager {
 		PollFdManager(const PollFdManager&) = delete;
 		PollFdManager& operator=(const PollFdManager&) = delete;
 
-		void addFd(int fd);
+		void addFd(int fd, short events = POLLIN);
+		void setEvents(int fd, short events);
 		void removeFd(int fd);
 
 		pollfd* data();
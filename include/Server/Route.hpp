@@ -13,27 +13,54 @@
 #pragma once
 
 #include <iostream>
-#include <map>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+#include "HttpMethod.hpp"
+#include "mimetypes.hpp"
 #include "misc/ft_iomanip.hpp"
 
 class Route {
+	public:
+		// Flags for `cgi_cache_use_stale`
+		enum CacheUseStale { STALE_OFF = 0, STALE_UPDATING = 1, STALE_ERROR = 2, STALE_TIMEOUT = 4 };
+		// How the path of the location is compared: `location /a`, `location = /a`, `location ~ re`, `location ~* re`
+		enum Match { PREFIX, EXACT, REGEX, REGEX_CASELESS };
+		// Default format of the directory listing, `Accept` can ask for the other one
+		enum AutoindexFormat { AUTOINDEX_HTML, AUTOINDEX_JSON };
+		// Extension (`.py`) -> CGI executable, in configuration order. Routes have a handful, a scan beats hashing.
+		using CgiHandlers = std::vector<std::pair<std::string, std::string>>;
+
 	private:
 		std::string _path;
+		Match _match = PREFIX;
 		std::string _alias;
-		std::vector<std::string> _methods;
+		Http::MethodMask _methods = 0;
 		std::string _root;
 		std::string _index;
 		bool _autoindex;
+		AutoindexFormat _autoindexFormat = AUTOINDEX_HTML;
 		std::string _uploadDir;
-		std::map<std::string, std::string> _cgiHandlers;
+		CgiHandlers _cgiHandlers;
+		MimeTypeOverrides _types;
+		std::string _headerBlock;		  // `add_header` lines, rendered once, for success and redirect statuses
+		std::string _alwaysHeaderBlock;	  // the lines marked `always`, for every other status
 		int _code;
 		std::string _redirect;
 		size_t _clientMaxBodySize = 0;
 		size_t _clientBodyBufferSize = 8192;
 		size_t _clientHeaderBufferSize = 1024;
+		size_t _cgiMaxProcesses = 0;
+		size_t _cgiCacheTtl = 0;
+		std::vector<std::string> _cgiCacheKeyHeaders;
+		int _cgiCacheUseStale = STALE_OFF;
+		std::string _proxyPass;
+		std::string _proxyPassUri;
+		size_t _proxyTimeout = 60000;
+		bool _metrics = false;
+		bool _connectionTable = false;
 
 	public:
 		// Constructor
@@ -41,33 +68,62 @@ class Route {
 
 		// Getters
 		[[nodiscard]] const std::string& getPath() const;
+		[[nodiscard]] Match getMatch() const;
 		[[nodiscard]] const std::string& getAlias() const;
-		[[nodiscard]] const std::vector<std::string>& getMethods() const;
+		[[nodiscard]] Http::MethodMask getMethods() const;
+		[[nodiscard]] bool isMethodAllowed(Http::Method method) const;
 		[[nodiscard]] const std::string& getRoot() const;
 		[[nodiscard]] const std::string& getIndex() const;
 		[[nodiscard]] bool isAutoindex() const;
+		[[nodiscard]] AutoindexFormat getAutoindexFormat() const;
 		[[nodiscard]] const std::string& getUploadDir() const;
-		[[nodiscard]] const std::map<std::string, std::string>& getCgiHandlers() const;
+		[[nodiscard]] const CgiHandlers& getCgiHandlers() const;
+		[[nodiscard]] const std::string* getCgiHandler(std::string_view extension) const;
+		[[nodiscard]] const MimeTypeOverrides& getTypes() const;
+		[[nodiscard]] std::string_view getMimeType(std::string_view fileName) const;
+		[[nodiscard]] std::string_view getHeaderBlock(int status) const;
 		[[nodiscard]] int getCode() const;
 		[[nodiscard]] const std::string& getRedirect() const;
 		[[nodiscard]] size_t getClientMaxBodySize() const;
 		[[nodiscard]] size_t getClientBodyBufferSize() const;
 		[[nodiscard]] size_t getClientHeaderBufferSize() const;
+		[[nodiscard]] size_t getCgiMaxProcesses() const;
+		[[nodiscard]] size_t getCgiCacheTtl() const;
+		[[nodiscard]] const std::vector<std::string>& getCgiCacheKeyHeaders() const;
+		[[nodiscard]] int getCgiCacheUseStale() const;
+		[[nodiscard]] const std::string& getProxyPass() const;
+		[[nodiscard]] const std::string& getProxyPassUri() const;
+		[[nodiscard]] size_t getProxyTimeout() const;
+		[[nodiscard]] bool isMetrics() const;
+		[[nodiscard]] bool isConnectionTable() const;
 
 		// Setters
 		void setPath(const std::string& path);
+		void setMatch(Match match);
 		void setAlias(const std::string& alias);
-		void setMethods(const std::vector<std::string>& methods);
+		void setMethods(Http::MethodMask methods);
 		void setRoot(const std::string& root);
 		void setIndex(const std::string& index);
 		void setAutoindex(bool autoindex);
+		void setAutoindexFormat(AutoindexFormat format);
 		void setUploadDir(const std::string& dir);
-		void setCgiHandlers(const std::map<std::string, std::string>& handlers);
+		bool addCgiHandler(const std::string& extension, const std::string& executable);
+		void addType(const std::string& extension, const std::string& type);
+		void addHeader(const std::string& name, const std::string& value, bool always);
 		void setCode(int code);
 		void setRedirect(const std::string& redirect);
 		void setClientMaxBodySize(size_t size);
 		void setClientBodyBufferSize(size_t size);
 		void setClientHeaderBufferSize(size_t size);
+		void setCgiMaxProcesses(size_t max);
+		void setCgiCacheTtl(size_t ttl);
+		void setCgiCacheKeyHeaders(const std::vector<std::string>& headers);
+		void setCgiCacheUseStale(int flags);
+		void setProxyPass(const std::string& upstream);
+		void setProxyPassUri(const std::string& uri);
+		void setProxyTimeout(size_t timeout);
+		void setMetrics(bool metrics);
+		void setConnectionTable(bool connectionTable);
 
 		// Overload "<<" operator to print Route details
 		friend std::ostream& operator<<(std::ostream& os, const Route& route);
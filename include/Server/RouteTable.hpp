@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Route.hpp"
+
+/**
+ * @brief Locations of one server, compiled once when the configuration is loaded.
+ *
+ * A request location is matched like nginx does: an exact location (`location = /a`) wins, otherwise the
+ * longest prefix location is remembered, then the regex locations (`location ~ re`, `location ~* re`) are tried
+ * in configuration order and the first match wins, and finally the remembered prefix location is used.
+ *
+ * Prefix locations live in a radix tree, so finding the longest prefix costs one walk down the location instead
+ * of a comparison with every route. Regexes are compiled here and never again.
+ */
+class RouteTable {
+	public:
+		struct Match {
+				const Route* route = nullptr;  // nullptr if no location matches
+				size_t length = 0;			   // bytes of the location covered by the path of a prefix or exact route
+		};
+
+		RouteTable() = default;
+		explicit RouteTable(std::vector<Route> routes);
+		// The tree and the indexes point into `_routes`
+		RouteTable(const RouteTable&) = delete;
+		RouteTable& operator=(const RouteTable&) = delete;
+
+		[[nodiscard]] Match find(std::string_view location) const;
+		[[nodiscard]] const std::vector<Route>& routes() const;
+
+	private:
+		struct Node {
+				std::string label;	// edge from the parent
+				const Route* route = nullptr;
+				std::vector<std::pair<char, uint32_t>> children;  // first byte of the child's label, node index
+		};
+
+		void _insert(std::string_view path, const Route* route);
+		[[nodiscard]] uint32_t _child(uint32_t node, char first) const;
+
+		std::vector<Route> _routes;
+		std::vector<Node> _nodes = std::vector<Node>(1);  // the root has an empty label
+		std::unordered_map<std::string_view, const Route*> _exact;
+		std::vector<std::pair<std::regex, const Route*>> _regexes;
+};
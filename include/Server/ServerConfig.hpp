@@ -15,13 +15,17 @@
 
 #include <filesystem>
 #include <map>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
 
+#include "AccessLog.hpp"
+#include "ErrorPages.hpp"
 #include "HttpRequest.hpp"
 #include "HttpStatus.hpp"
 #include "Route.hpp"
+#include "RouteTable.hpp"
 
 class ServerConfig {
 		int _port;
@@ -37,9 +41,14 @@ class ServerConfig {
 		std::string _root;
 		std::string _uploadDir;
 		std::vector<std::string> _serverNames = {};
+		bool _defaultServer = false;
 
-		std::vector<Route> _routes;
+		std::shared_ptr<const RouteTable> _routes;	// shared by the copies of the config, it is never modified
 		std::map<int, std::string> _errorPages;
+		std::shared_ptr<const ErrorPages> _loadedErrorPages;  // bodies of `_errorPages`, read by loadErrorPages
+
+		AccessLogConfig _accessLog;
+		SlowLogConfig _slowLog;
 
 	public:
 		// Constructor
@@ -55,10 +64,14 @@ class ServerConfig {
 		[[nodiscard]] const std::string& getIndex() const;
 		[[nodiscard]] const std::string& getRoot() const;
 		[[nodiscard]] const std::string& getUploadDir() const;
-		[[nodiscard]] std::vector<std::string> getServerNames() const;
+		[[nodiscard]] const std::vector<std::string>& getServerNames() const;
+		[[nodiscard]] bool isDefaultServer() const;
 		[[nodiscard]] const std::vector<Route>& getRoutes() const;
+		[[nodiscard]] const RouteTable& getRouteTable() const;
 		[[nodiscard]] const std::map<int, std::string>& getErrorPages() const;
-		[[nodiscard]] std::optional<std::string> getErrorPage(Http::Status code) const;
+		[[nodiscard]] const ErrorPages& getLoadedErrorPages() const;
+		[[nodiscard]] const AccessLogConfig& getAccessLog() const;
+		[[nodiscard]] const SlowLogConfig& getSlowLog() const;
 
 		// Setters
 		void setPort(int port);
@@ -72,9 +85,14 @@ class ServerConfig {
 		void setUploadDir(const std::string& dir);
 		void setRoutes(const std::vector<Route>& routes);
 		void setErrorPages(const std::map<int, std::string>& pages);
+		void loadErrorPages();
+		void setAccessLog(const AccessLogConfig& accessLog);
+		void setSlowLog(const SlowLogConfig& slowLog);
+		void setDefaultServer(bool defaultServer);
 
 		void addServerName(const std::string& name);
 
 		// Overload "<<" operator to print ServerConfig details
 		friend std::ostream& operator<<(std::ostream& os, const ServerConfig& server);
 };
+
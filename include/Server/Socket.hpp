@@ -3,26 +3,39 @@
 
 #include <netinet/in.h>
 
-#include "ServerConfig.hpp"
+#include <unordered_map>
+
+#include "VirtualHosts.hpp"
 
 class Socket {
 	public:
-		explicit Socket(std::vector<ServerConfig> configs);
+		// Listening sockets handed to a new binary on an upgrade: `fd=host:port;` for every socket
+		static constexpr const char *INHERITED_ENV = "WEBSERV_LISTEN_FDS";
+
+		explicit Socket(ServerConfigSnapshot configs);
 		~Socket();
 
 		void bind();
 		void listen() const;
 		[[nodiscard]] int getSocketFd() const;
-		[[nodiscard]] std::vector<ServerConfig> getConfig() const;
+		[[nodiscard]] const ServerConfigSnapshot &getConfig() const;
+		[[nodiscard]] const std::shared_ptr<ListenerConfig> &getListener() const;
+		[[nodiscard]] std::string getAddress() const;
+		void setConfig(ServerConfigSnapshot configs);
+
+		static bool loadInherited();
+		static void closeUnusedInherited();
 
 	private:
 		void setupAddress();
 		void setSocketOpt() const;
 		int _socketFd;
 		int _port;
-		ServerConfig &_default_config;
-		std::vector<ServerConfig> _configs;
+		std::string _host;
+		std::shared_ptr<ListenerConfig> _listener;
 		sockaddr_in _addr;
+
+		static std::unordered_map<std::string, int> _inherited;
 };
 
 uint32_t my_inet_addr(const std::string &ipStr);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief An `upstream <name> { ... }` block: a group of backend servers for `proxy_pass`
+ */
+class UpstreamConfig {
+	public:
+		enum class Balance { ROUND_ROBIN, LEAST_CONN, HASH };
+
+		struct Server {
+				std::string host;
+				int port = 80;
+				size_t weight = 1;
+				size_t maxFails = 1;
+				size_t failTimeout = 10000;	 // ms
+		};
+
+	private:
+		std::string _name;
+		std::vector<Server> _servers;
+		Balance _balance = Balance::ROUND_ROBIN;
+		std::string _hashKey;
+		size_t _keepalive = 16;
+
+	public:
+		UpstreamConfig() = default;
+		explicit UpstreamConfig(const std::string& name);
+
+		// Getters
+		[[nodiscard]] const std::string& getName() const;
+		[[nodiscard]] const std::vector<Server>& getServers() const;
+		[[nodiscard]] Balance getBalance() const;
+		[[nodiscard]] const std::string& getHashKey() const;
+		[[nodiscard]] size_t getKeepalive() const;
+
+		// Setters
+		void setName(const std::string& name);
+		void addServer(const Server& server);
+		void setBalance(Balance balance);
+		void setHashKey(const std::string& key);
+		void setKeepalive(size_t keepalive);
+
+		// Overload "<<" operator to print UpstreamConfig details
+		friend std::ostream& operator<<(std::ostream& os, const UpstreamConfig& config);
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+#include <regex>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ServerConfig.hpp"
+
+/**
+ * @brief Server configs of one listening socket, indexed by `server_name` once when the configuration is loaded.
+ *
+ * The Host of a request is looked up like nginx does: exact name, longest `*.example.com` wildcard, longest
+ * `www.example.*` wildcard, first matching `~regex` in configuration order, and finally the default server
+ * (`listen ... default_server`, otherwise the first server of the socket). `.example.com` is short for
+ * `example.com *.example.com`. Names are case insensitive, the port of the Host header is ignored.
+ */
+class VirtualHosts {
+	public:
+		static constexpr size_t MAX_HOST_NAME = 255;
+
+		explicit VirtualHosts(std::vector<ServerConfig> servers);
+		// The index points into `_servers`
+		VirtualHosts(const VirtualHosts&) = delete;
+		VirtualHosts& operator=(const VirtualHosts&) = delete;
+
+		[[nodiscard]] const ServerConfig& find(std::string_view host) const;
+		[[nodiscard]] const ServerConfig& defaultServer() const;
+		[[nodiscard]] const std::vector<ServerConfig>& servers() const;
+
+		[[nodiscard]] static std::string_view hostName(std::string_view host);
+
+	private:
+		using Index = std::unordered_map<std::string_view, const ServerConfig*>;
+
+		std::vector<ServerConfig> _servers;
+		const ServerConfig* _default = nullptr;
+		Index _exact;
+		Index _suffixes;  // `*.example.com` as `.example.com`
+		Index _prefixes;  // `www.example.*` as `www.example.`
+		std::vector<std::pair<std::regex, const ServerConfig*>> _regexes;
+};
+
+/**
+ * @brief Parsed, immutable server configs of one listening socket. Shared by the socket and every connection
+ * accepted on it, so accepting a connection and matching a request never copy a ServerConfig.
+ */
+using ServerConfigSnapshot = std::shared_ptr<const VirtualHosts>;
+
+/**
+ * @brief The current snapshot of a listening socket. A reload (SIGHUP) swaps the snapshot inside, connections
+ * accepted on the socket pick it up at the start of their next request.
+ */
+struct ListenerConfig {
+		ServerConfigSnapshot servers;
+};
@@ -41,9 +41,31 @@ enum eTokenType {
 	TOKEN_ERROR_PAGE,
 	TOKEN_ALLOW_METHODS,
 	TOKEN_AUTOINDEX,
+	TOKEN_AUTOINDEX_FORMAT,
 	TOKEN_ALIAS,
 	TOKEN_CGI,
 	TOKEN_RETURN,
+	TOKEN_CGI_MAX_PROCESSES,
+	TOKEN_CGI_QUEUE_SIZE,
+	TOKEN_CGI_QUEUE_TIMEOUT,
+	TOKEN_CGI_CACHE_TTL,
+	TOKEN_CGI_CACHE_KEY_HEADERS,
+	TOKEN_CGI_CACHE_USE_STALE,
+	TOKEN_UPSTREAM,
+	TOKEN_LEAST_CONN,
+	TOKEN_HASH,
+	TOKEN_KEEPALIVE,
+	TOKEN_PROXY_PASS,
+	TOKEN_PROXY_TIMEOUT,
+	TOKEN_LOG_ASYNC,
+	TOKEN_LOG_LEVEL,
+	TOKEN_ACCESS_LOG,
+	TOKEN_SLOW_LOG,
+	TOKEN_METRICS,
+	TOKEN_CONNECTION_TABLE,
+	TOKEN_TRAFFIC_CAPTURE,
+	TOKEN_TYPES,
+	TOKEN_ADD_HEADER,
 
 	TOKEN_IP_V4,
 	TOKEN_NUMBER,
@@ -74,9 +96,31 @@ const std::map<eTokenType, std::string> tokenToString = {{TOKEN_HTTP, "http"},
 														 {TOKEN_ERROR_PAGE, "error_page"},
 														 {TOKEN_ALLOW_METHODS, "allow_methods"},
 														 {TOKEN_AUTOINDEX, "autoindex"},
+														 {TOKEN_AUTOINDEX_FORMAT, "autoindex_format"},
 														 {TOKEN_ALIAS, "alias"},
 														 {TOKEN_CGI, "cgi"},
 														 {TOKEN_RETURN, "return"},
+														 {TOKEN_CGI_MAX_PROCESSES, "cgi_max_processes"},
+														 {TOKEN_CGI_QUEUE_SIZE, "cgi_queue_size"},
+														 {TOKEN_CGI_QUEUE_TIMEOUT, "cgi_queue_timeout"},
+														 {TOKEN_CGI_CACHE_TTL, "cgi_cache_ttl"},
+														 {TOKEN_CGI_CACHE_KEY_HEADERS, "cgi_cache_key_headers"},
+														 {TOKEN_CGI_CACHE_USE_STALE, "cgi_cache_use_stale"},
+														 {TOKEN_UPSTREAM, "upstream"},
+														 {TOKEN_LEAST_CONN, "least_conn"},
+														 {TOKEN_HASH, "hash"},
+														 {TOKEN_KEEPALIVE, "keepalive"},
+														 {TOKEN_PROXY_PASS, "proxy_pass"},
+														 {TOKEN_PROXY_TIMEOUT, "proxy_timeout"},
+														 {TOKEN_LOG_ASYNC, "log_async"},
+														 {TOKEN_LOG_LEVEL, "log_level"},
+														 {TOKEN_ACCESS_LOG, "access_log"},
+														 {TOKEN_SLOW_LOG, "slow_log"},
+														 {TOKEN_METRICS, "metrics"},
+														 {TOKEN_CONNECTION_TABLE, "connection_table"},
+														 {TOKEN_TRAFFIC_CAPTURE, "traffic_capture"},
+														 {TOKEN_TYPES, "types"},
+														 {TOKEN_ADD_HEADER, "add_header"},
 
 														 {TOKEN_IP_V4, "ip_v4"},
 														 {TOKEN_NUMBER, "number"},
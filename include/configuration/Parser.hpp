@@ -15,8 +15,10 @@
 #include <iostream>
 #include <regex>
 #include <sstream>
+#include <unordered_set>
 #include <vector>
 
+#include "HttpConfig.hpp"
 #include "Lexer.hpp"
 #include "ParsingErrors.hpp"
 #include "Route.hpp"
@@ -31,16 +33,30 @@ class Parser {
 		Lexer& _lexer;
 		Token _currentToken;
 		std::vector<std::string> _parsingErrors;
+		HttpConfig _httpConfig;
+		std::unordered_set<std::string> _defaultServers;  // host:port of every `listen ... default_server`
 
 		void expect(eTokenType type);
 		static std::vector<std::vector<ServerConfig>> splitServerConfigs(
 			const std::vector<ServerConfig>& serverConfigs);
+		void parseHttpOption();
+		void parseUpstream();
+		void parseUpstreamServer(UpstreamConfig& upstream);
+		void resolveProxyPasses(const std::vector<ServerConfig>& servers);
 		ServerConfig parseServer();
+		void parseServerName(ServerConfig& server);
+		AccessLogConfig parseAccessLog();
+		SlowLogConfig parseSlowLog();
+		TrafficCaptureConfig parseTrafficCapture();
 		Route parseRoute();
+		void parseTypes(Route& route);
+		void parseAddHeader(Route& route);
+		size_t parseTimeValue();
 
 	public:
 		Parser(Lexer& lexer);
 		std::vector<std::vector<ServerConfig>> parse();
+		[[nodiscard]] const HttpConfig& getHttpConfig() const;
 
 		void reportError(eParsingErrors error, std::string expected, std::string found);
 		void flushErrors() const;
@@ -21,39 +21,89 @@ enum eParsingErrors {
 	INVALID_UNIT,
 
 	LISTEN_MISSING_VALUES,
+	DUPLICATE_DEFAULT_SERVER,
+
+	LOCATION_BAD_VALUE,
 
 	CGI_BAD_EXTENSION,
 	CGI_BAD_EXECUTABLE,
 
 	AUTOINDEX_BAD_VALUE,
+	AUTOINDEX_FORMAT_BAD_VALUE,
+	METRICS_BAD_VALUE,
+	CONNECTION_TABLE_BAD_VALUE,
+
+	CGI_CACHE_BAD_STALE_VALUE,
+
+	TYPES_BAD_VALUE,
+	ADD_HEADER_BAD_VALUE,
+
+	UPSTREAM_BAD_SERVER,
+	UPSTREAM_NO_SERVERS,
+	PROXY_PASS_BAD_VALUE,
+
+	LOG_LEVEL_BAD_VALUE,
+	ACCESS_LOG_BAD_VALUE,
+	SLOW_LOG_BAD_VALUE,
+	TRAFFIC_CAPTURE_BAD_VALUE,
 
 	ALLOW_METHODS_MISSING_VALUES,
+	ALLOW_METHODS_BAD_VALUE,
 
-	SERVER_NAME_MISSING_VALUES
+	SERVER_NAME_MISSING_VALUES,
+	SERVER_NAME_BAD_VALUE
 };
 
 #define ERROR_NAME 0
 #define ERROR_TEXT 1
 
+#define POSSIBLE_HTTP_CONFIGS                                                                      \
+	"'server', 'upstream', 'cgi_max_processes', 'cgi_queue_size', 'cgi_queue_timeout', 'log_async', " \
+	"'log_level' or 'traffic_capture'"
+#define POSSIBLE_UPSTREAM_CONFIGS "'server', 'least_conn', 'hash' or 'keepalive'"
 #define POSSIBLE_SERVER_CONFIGS                                                                                 \
 	"'location', 'listen', 'server_name', 'root', 'index', 'client_max_body_size', 'client_body_buffer_size', " \
-	"'client_header_buffer_size', 'uplaod_dir', 'request_timeout' or 'error_page'"
+	"'client_header_buffer_size', 'uplaod_dir', 'request_timeout', 'error_page', 'access_log' or 'slow_log'"
 #define POSSIBLE_ROUTE_CONFIGS                                                                                        \
 	"'root', 'index', 'client_max_body_size', 'client_body_buffer_size', 'client_header_buffer_size', 'uplaod_dir', " \
-	"'allow_methods', 'autoindex', 'alias', 'cgi' or 'return'"
+	"'allow_methods', 'autoindex', 'autoindex_format', 'alias', 'cgi', 'cgi_max_processes', 'cgi_cache_ttl', "        \
+	"'cgi_cache_key_headers', 'cgi_cache_use_stale', 'proxy_pass', 'proxy_timeout', 'metrics', 'connection_table', "  \
+	"'types', 'add_header' or 'return'"
 
 const std::map<eParsingErrors, std::vector<std::string> > parsingErrorsMessages = {
 	{UNEXPECTED_TOKEN, {"UNEXPECTED_TOKEN", "expected: "}},
 	{INVALID_UNIT, {"INVALID_UNIT", "expected: "}},
 
 	{LISTEN_MISSING_VALUES, {"LISTEN_MISSING_VALUES", "expected: "}},
+	{DUPLICATE_DEFAULT_SERVER, {"DUPLICATE_DEFAULT_SERVER", "expected: "}},
+
+	{LOCATION_BAD_VALUE, {"LOCATION_BAD_VALUE", "expected: "}},
 
 	{CGI_BAD_EXTENSION, {"CGI_BAD_EXTENSION", "expected: "}},
 	{CGI_BAD_EXECUTABLE, {"CGI_BAD_EXECUTABLE", "expected: "}},
 
 	{AUTOINDEX_BAD_VALUE, {"AUTOINDEX_BAD_VALUE", "expected: "}},
+	{AUTOINDEX_FORMAT_BAD_VALUE, {"AUTOINDEX_FORMAT_BAD_VALUE", "expected: "}},
+	{METRICS_BAD_VALUE, {"METRICS_BAD_VALUE", "expected: "}},
+	{CONNECTION_TABLE_BAD_VALUE, {"CONNECTION_TABLE_BAD_VALUE", "expected: "}},
+
+	{CGI_CACHE_BAD_STALE_VALUE, {"CGI_CACHE_BAD_STALE_VALUE", "expected: "}},
+
+	{TYPES_BAD_VALUE, {"TYPES_BAD_VALUE", "expected: "}},
+	{ADD_HEADER_BAD_VALUE, {"ADD_HEADER_BAD_VALUE", "expected: "}},
+
+	{UPSTREAM_BAD_SERVER, {"UPSTREAM_BAD_SERVER", "expected: "}},
+	{UPSTREAM_NO_SERVERS, {"UPSTREAM_NO_SERVERS", "expected: "}},
+	{PROXY_PASS_BAD_VALUE, {"PROXY_PASS_BAD_VALUE", "expected: "}},
+
+	{LOG_LEVEL_BAD_VALUE, {"LOG_LEVEL_BAD_VALUE", "expected: "}},
+	{ACCESS_LOG_BAD_VALUE, {"ACCESS_LOG_BAD_VALUE", "expected: "}},
+	{SLOW_LOG_BAD_VALUE, {"SLOW_LOG_BAD_VALUE", "expected: "}},
+	{TRAFFIC_CAPTURE_BAD_VALUE, {"TRAFFIC_CAPTURE_BAD_VALUE", "expected: "}},
 
 	{ALLOW_METHODS_MISSING_VALUES, {"ALLOW_METHODS_MISSING_VALUES", "expected: "}},
+	{ALLOW_METHODS_BAD_VALUE, {"ALLOW_METHODS_BAD_VALUE", "expected: "}},
 
 	{SERVER_NAME_MISSING_VALUES, {"SERVER_NAME_MISSING_VALUES", "expected: "}},
+	{SERVER_NAME_BAD_VALUE, {"SERVER_NAME_BAD_VALUE", "expected: "}},
 };
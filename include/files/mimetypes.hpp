@@ -13,7 +13,24 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
-std::string getMimeType(const std::string& fileName);
+// Extension (lower case, without the dot) -> MIME type, from the `types` blocks of a location
+using MimeTypeOverrides = std::vector<std::pair<std::string, std::string>>;
 
-std::string getFileExtension(const std::string& fileName);
+constexpr std::string_view DEFAULT_MIME_TYPE = "application/octet-stream";
+
+/**
+ * @brief Type of a file by its extension, case insensitive: the overrides first, then the built-in table.
+ * Allocation free, the view points into the built-in table or the overrides.
+ */
+std::string_view getMimeType(std::string_view fileName, const MimeTypeOverrides& overrides = {});
+
+/**
+ * @brief Built-in type of an extension (without the dot), empty if it is unknown
+ */
+std::string_view findMimeType(std::string_view extension);
+
+std::string_view getFileExtension(std::string_view fileName);
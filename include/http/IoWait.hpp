@@ -0,0 +1,17 @@
+#pragma once
+
+#include <chrono>
+
+/**
+ * @brief What a response that cannot make progress right now waits for, so that the event loop does not spin on
+ * it: a descriptor to become ready (a CGI pipe, an upstream connection) and at the latest the deadline (a timeout
+ * to enforce, or a wakeup that no descriptor announces). The default, a deadline in the past, asks to be called
+ * again on the next loop iteration.
+ */
+struct IoWait {
+		using Clock = std::chrono::steady_clock;
+
+		int fd = -1;  // -1 if only the deadline counts
+		short events = 0;
+		Clock::time_point deadline;
+};
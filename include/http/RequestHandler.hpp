@@ -16,33 +16,48 @@
 
 #include <chrono>
 
+#include "CgiCache.hpp"
+#include "CgiLimiter.hpp"
 #include "HttpRequest.hpp"
 #include "HttpResponse.hpp"
+#include "IoWait.hpp"
+#include "ProxyRequest.hpp"
 #include "Route.hpp"
 #include "optional"
 
 enum cgiState { NONE, WRITING, WAITING, READING, FINISHED };
+enum cgiCacheRole { CACHE_NONE, CACHE_BYPASS, CACHE_FILL, CACHE_WAIT, CACHE_HIT };
 
 class ServerConfig;
 
 class RequestHandler {
 		HttpRequest _request;
 		HttpResponse _response = HttpResponse();
-		ServerConfig& _serverConfig;
-		Route _matchedRoute;
+		const ServerConfig* _serverConfig;	 // points into the connection's config snapshot
+		const Route* _matchedRoute;
 
 		bool _parsingDone = false;
+		std::chrono::steady_clock::time_point _routeMatchedAt;
 
 		long long _bytesReadFromFile = 0;
 		long long _bytesWrittenToFile = 0;
 
 		bool _cgi_valid = false;
 		pid_t _cgi_pid = 0;
-		std::chrono::milliseconds _cgi_startTime = std::chrono::milliseconds(0);
+		std::chrono::steady_clock::time_point _cgi_startTime;
 		cgiState _cgi_state = cgiState::NONE;
 		int _cgi_pipeIn[2] = {0, 0};
 		int _cgi_pipeOut[2] = {0, 0};
+		size_t _cgi_bodyOffset = 0;	 // how much of the request body the child got while WRITING
 		int _cgi_status = 0;
+		CgiLimiter::Ticket _cgi_ticket;
+		cgiCacheRole _cgi_cacheRole = CACHE_NONE;
+		std::string _cgi_cacheKey;
+		std::chrono::steady_clock::time_point _cgi_cacheWaitStart;
+
+		std::shared_ptr<ProxyRequest> _proxy;
+
+		int _waiter = -1;  // see setWaiter()
 
 		std::string _fileName = "";
 
@@ -50,8 +65,20 @@ class RequestHandler {
 		void findMatchingRoute();
 
 		// CGI handler
-		[[nodiscard]] bool checkRequestCGI(Route& route);
+		[[nodiscard]] bool checkRequestCGI(const Route& route);
 		void handleRequestCGIExecution(const Route& route);
+		[[nodiscard]] bool admitRequestCGI(const Route& route);
+		void writeRequestCGIBody();
+		void readRequestCGIOutput();
+		void finishRequestCGI();
+		[[nodiscard]] std::string buildCGICacheKey() const;
+		[[nodiscard]] bool lookupCGICache();
+		void storeCGICache();
+
+		// Proxy handler
+		[[nodiscard]] bool handleProxyRequest();
+		[[nodiscard]] std::string buildProxyRequest() const;
+		[[nodiscard]] std::string buildProxyHashKey(const std::string& key) const;
 
 		// Request handlers
 		// GET request handlers
@@ -66,24 +93,38 @@ class RequestHandler {
 		[[nodiscard]] bool handleFileUpload();
 
 		// DELETE request handler
-		void handleDeleteRequest();
+		bool handleDeleteRequest();
+
+		// Handler of each implemented method, indexed by Http::Method
+		using MethodHandler = bool (RequestHandler::*)();
+		static const MethodHandler METHOD_HANDLERS[Http::METHOD_COUNT];
 
 		// Autoindex handler
 		void handleAutoindex(const std::string& path);
-		[[nodiscard]] std::string buildDirectoryListingHTML(const std::string& path) const;
 
 		// Redirect Request
 		[[nodiscard]] HttpResponse handleRedirectRequest();
 
+		// Metrics and connection table locations
+		[[nodiscard]] bool handleMetricsRequest();
+		[[nodiscard]] bool handleConnectionTableRequest();
+
 	public:
-		~RequestHandler() = default;
+		~RequestHandler();
 		RequestHandler(const RequestHandler& other) = delete;
 		RequestHandler& operator=(const RequestHandler& other) = delete;
 
-		RequestHandler(ServerConfig& serverConfig);
-		[[nodiscard]] ServerConfig& getConfig() const;
-		void setConfig(const ServerConfig& server_config) const;
+		explicit RequestHandler(const ServerConfig& serverConfig);
+		[[nodiscard]] const ServerConfig& getConfig() const;
+		[[nodiscard]] const Route& getMatchedRoute() const;
+		[[nodiscard]] std::chrono::steady_clock::time_point getRouteMatchedAt() const;
+		[[nodiscard]] pid_t getCgiPid() const;
+		[[nodiscard]] cgiState getCgiState() const;
+		void setConfig(const ServerConfig& server_config);
+		void setWaiter(int waiter);
 		bool handleRequest(const HttpRequest& request);
+		[[nodiscard]] IoWait getWait() const;
 		HttpResponse getResponse();
 		HttpResponse buildDefaultResponse(Http::Status code, std::optional<HttpRequest> request = std::nullopt);
+		[[nodiscard]] std::string buildDirectoryListingHTML(const std::string& path) const;
 };
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "BodyStream.hpp"
+#include "DirectoryListing.hpp"
+
+/**
+ * @brief Renders an autoindex listing as an HTML page or as JSON, a batch of rows per read(), optionally in
+ * chunked transfer coding.
+ *
+ * An uncached directory is read a batch of entries per read() before the rows are rendered; the head of the
+ * page goes out first. The query string picks the order and a page of the HTML listing: `sort=name|size|time`,
+ * `order=asc|desc`, `page=<n>` (from 1) and `per_page=<n>`. The JSON listing is always in name order and paged
+ * by a cursor: `limit=<n>` entries after `cursor=<next of the previous page>`.
+ */
+class AutoindexStream : public BodyStream {
+	public:
+		struct Options {
+				DirectoryListing::Sort sort = DirectoryListing::Sort::NAME;
+				bool descending = false;
+				size_t page = 0;	  // 0: all entries
+				size_t perPage = 0;	  // 0: AUTOINDEX_PAGE_SIZE_DEFAULT
+				bool json = false;
+				std::string cursor;	 // JSON: name of the last entry of the previous page
+				size_t limit = 0;	 // JSON: 0: all entries
+		};
+
+		[[nodiscard]] static std::shared_ptr<AutoindexStream> open(const std::string& path, std::string location,
+																   const Options& options, bool chunked);
+		[[nodiscard]] static Options parseQuery(std::string_view query);
+
+		AutoindexStream(std::shared_ptr<const DirectoryListing> listing,
+						std::unique_ptr<DirectoryListing::Reader> reader, std::string location, const Options& options,
+						bool chunked);
+		Status read(std::string& chunk, size_t maxSize) override;
+
+	private:
+		enum class Phase { HEAD, READ, ROWS, DONE };
+
+		void _startRows();
+		void _appendHead(std::string& out) const;
+		void _appendRow(std::string& out, const DirectoryListing::Entry& entry) const;
+		void _appendFoot(std::string& out) const;
+		void _appendJsonHead(std::string& out) const;
+		void _appendJsonRow(std::string& out, const DirectoryListing::Entry& entry) const;
+		void _appendJsonFoot(std::string& out) const;
+		void _appendQuery(std::string& out, DirectoryListing::Sort sort, bool descending, size_t page) const;
+
+		std::shared_ptr<const DirectoryListing> _listing;
+		std::unique_ptr<DirectoryListing::Reader> _reader;
+		std::string _location;
+		std::string _linkBase;	// percent-encoded location with a trailing `/`
+		Options _options;
+		bool _chunked;
+		Phase _phase = Phase::HEAD;
+		size_t _first = 0;
+		size_t _next = 0;
+		size_t _end = 0;
+};
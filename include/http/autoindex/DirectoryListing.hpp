@@ -0,0 +1,96 @@
+#pragma once
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Entries of one directory, as shown by autoindex.
+ *
+ * A directory is read a batch of entries at a time with one stat per entry (`Reader`), so a directory with many
+ * entries never stalls the event loop. Finished listings are immutable and cached by path (`Cache`) while the
+ * directory is not modified, i.e. until an entry is added, removed or renamed. Sizes and times of the entries
+ * are those of the moment the directory was read; their texts for the HTML page are formatted on first use.
+ */
+class DirectoryListing {
+	public:
+		struct Entry {
+				std::string name;  // with a trailing `/` for directories
+				bool directory = false;
+				uintmax_t size = 0;
+				std::time_t modified = 0;
+		};
+		struct Text {
+				char size[16] = {};		 // `1.50 KB`, `-` for directories
+				char modified[20] = {};	 // `2024-12-10 17:05:53`, local time
+		};
+		enum class Sort { NAME, SIZE, TIME };
+
+		class Reader {
+			public:
+				explicit Reader(const std::string& path);
+				~Reader();
+				Reader(const Reader&) = delete;
+				Reader& operator=(const Reader&) = delete;
+
+				[[nodiscard]] bool isOpen() const;
+				bool read(size_t count);
+				[[nodiscard]] std::shared_ptr<const DirectoryListing> finish();
+
+			private:
+				std::string _path;
+				DIR* _dir = nullptr;
+				struct stat _stat {};
+				std::vector<Entry> _entries;
+		};
+
+		class Cache {
+			public:
+				static Cache& getInstance();
+				Cache(const Cache&) = delete;
+				Cache& operator=(const Cache&) = delete;
+
+				[[nodiscard]] std::shared_ptr<const DirectoryListing> find(const std::string& path,
+																		   const struct stat& directory);
+				void store(const std::string& path, std::shared_ptr<const DirectoryListing> listing);
+
+			private:
+				struct Slot {
+						std::shared_ptr<const DirectoryListing> listing;
+						uint64_t usedAt = 0;
+				};
+
+				Cache() = default;
+				~Cache() = default;
+
+				std::unordered_map<std::string, Slot> _slots;
+				uint64_t _clock = 0;
+		};
+
+		DirectoryListing(const struct stat& directory, std::vector<Entry> entries);
+
+		[[nodiscard]] size_t size() const;
+		[[nodiscard]] const Entry& at(size_t index, Sort sort, bool descending) const;
+		[[nodiscard]] const Text& text(const Entry& entry) const;
+		[[nodiscard]] size_t after(std::string_view name) const;
+		[[nodiscard]] bool isCurrent(const struct stat& directory) const;
+
+	private:
+		[[nodiscard]] const std::vector<uint32_t>& _order(Sort sort) const;
+
+		dev_t _device;
+		ino_t _inode;
+		timespec _modified;
+		std::vector<Entry> _entries;  // by name
+		// Orders by size and time and the texts, built on first use. Listings are only used by the event loop.
+		mutable std::vector<uint32_t> _bySize;
+		mutable std::vector<uint32_t> _byTime;
+		mutable std::vector<Text> _texts;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "HttpResponse.hpp"
+
+/**
+ * @brief Short lived in-memory cache for CGI responses (microcache).
+ *
+ * Entries are keyed by method, host, URI, query and the headers selected per location. Concurrent
+ * misses for the same key are collapsed: the first request fills the entry while the others wait
+ * for its result (or get the stale copy if allowed). They are handed to the event loop (takeReady())
+ * once the fill is done.
+ */
+class CgiCache {
+	public:
+		enum class Lookup {
+			HIT,	// fresh entry copied into the response
+			STALE,	// expired entry copied into the response, another request refreshes it
+			FILL,	// caller has to run the CGI and hand the result to complete()
+			WAIT,	// another request is filling the entry, retry once woken by takeReady()
+			PASS	// response is known to be uncacheable, run the CGI without the cache
+		};
+
+		struct Counters {
+				size_t hits = 0;
+				size_t stale = 0;
+				size_t misses = 0;
+				size_t bypasses = 0;
+				size_t stores = 0;
+				size_t evictions = 0;
+		};
+
+		static CgiCache& getInstance();
+		CgiCache(const CgiCache&) = delete;
+		CgiCache& operator=(const CgiCache&) = delete;
+
+		Lookup lookup(const std::string& key, bool staleWhileUpdating, HttpResponse& response, int waiter);
+		void complete(const std::string& key, const HttpResponse& response, std::chrono::milliseconds ttl);
+		bool serveStale(const std::string& key, HttpResponse& response);
+		void abandon(const std::string& key);
+		void forget(const std::string& key, int waiter);
+		[[nodiscard]] std::vector<int> takeReady();
+
+		[[nodiscard]] const Counters& getCounters() const;
+		[[nodiscard]] size_t size() const;
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct Entry {
+				HttpResponse response;
+				bool hasResponse = false;
+				bool filling = false;
+				Clock::time_point storedAt;
+				Clock::time_point expiresAt;
+				Clock::time_point passUntil;
+				std::vector<int> waiters;  // requests that got WAIT
+		};
+
+		CgiCache() = default;
+		~CgiCache() = default;
+
+		static std::chrono::milliseconds _freshnessFromHeaders(const HttpResponse& response,
+															   std::chrono::milliseconds ttl);
+		static void _setAge(HttpResponse& response, const Entry& entry, Clock::time_point now);
+		void _evict(Clock::time_point now);
+		void _wakeWaiters(Entry& entry);
+
+		std::unordered_map<std::string, Entry> _entries;
+		std::vector<int> _ready;
+		Counters _counters;
+};
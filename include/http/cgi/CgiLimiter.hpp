@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Admission control for CGI children.
+ *
+ * Bounds the number of concurrently running CGI processes globally and per route. Requests that
+ * cannot start immediately wait in a bounded FIFO queue; they are rejected when the queue is full
+ * or when they waited longer than the queue timeout. When a slot is released, the next waiter that
+ * fits is handed to the event loop (takeReady()).
+ */
+class CgiLimiter {
+	public:
+		enum class Admission { GRANTED, QUEUED, REJECTED, TIMED_OUT };
+
+		/**
+		 * @brief Per request admission state, owned by the RequestHandler
+		 */
+		struct Ticket {
+				enum class State { IDLE, QUEUED, RUNNING };
+
+				uint64_t id = 0;
+				State state = State::IDLE;
+				std::string routeKey;  // set by the RequestHandler before the first acquire()
+				int waiter = -1;  // handed back by takeReady() when a queued ticket may be admitted
+				std::chrono::steady_clock::time_point deadline;	 // end of the queue timeout while QUEUED
+		};
+
+		struct Counters {
+				size_t running = 0;
+				size_t queued = 0;
+				size_t admitted = 0;
+				size_t rejected = 0;
+				size_t timedOut = 0;
+		};
+
+		static CgiLimiter& getInstance();
+		CgiLimiter(const CgiLimiter&) = delete;
+		CgiLimiter& operator=(const CgiLimiter&) = delete;
+
+		void configure(size_t maxProcesses, size_t queueSize, size_t queueTimeoutMs);
+
+		Admission acquire(Ticket& ticket, size_t routeMaxProcesses);
+		void release(Ticket& ticket);
+		[[nodiscard]] std::vector<int> takeReady();
+
+		[[nodiscard]] size_t getRetryAfter() const;
+		[[nodiscard]] const Counters& getCounters() const;
+		[[nodiscard]] const std::unordered_map<std::string, Counters>& getRouteCounters() const;
+
+	private:
+		struct Waiter {
+				uint64_t id;
+				std::string routeKey;
+				size_t routeMaxProcesses;
+				std::chrono::steady_clock::time_point enqueuedAt;
+				int waiter;
+				bool woken = false;
+		};
+
+		CgiLimiter() = default;
+		~CgiLimiter() = default;
+
+		[[nodiscard]] bool _hasCapacity(const std::string& routeKey, size_t routeMaxProcesses) const;
+		void _grant(Ticket& ticket, const std::string& routeKey);
+		void _dequeue(uint64_t id);
+		void _wakeNext();
+
+		size_t _maxProcesses = 0;
+		size_t _queueSize = 64;
+		std::chrono::milliseconds _queueTimeout = std::chrono::milliseconds(5000);
+
+		uint64_t _nextId = 1;
+		std::deque<Waiter> _queue;
+		std::vector<int> _ready;
+		Counters _counters;
+		std::unordered_map<std::string, Counters> _routeCounters;
+};
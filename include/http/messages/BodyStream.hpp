@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "IoWait.hpp"
+
+/**
+ * @brief Source of a response body that is produced while the response is being sent (e.g. a proxied
+ * upstream response). The ClientConnection pulls from it whenever the previous piece has been sent.
+ */
+class BodyStream {
+	public:
+		enum class Status {
+			DATA,	// `chunk` holds the next piece of the body
+			AGAIN,	// nothing available right now, ask again once getWait() is satisfied
+			END,	// the body is complete
+			ERROR	// the body cannot be completed, the connection has to be closed
+		};
+
+		virtual ~BodyStream() = default;
+
+		/**
+		 * @brief Replace `chunk` with the next piece of the body, at most `maxSize` bytes
+		 */
+		virtual Status read(std::string& chunk, size_t maxSize) = 0;
+
+		/**
+		 * @brief What a read() that returned AGAIN waits for, by default nothing: it is asked again right away
+		 */
+		[[nodiscard]] virtual IoWait getWait() const { return {}; }
+};
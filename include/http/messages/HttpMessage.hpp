@@ -14,6 +14,7 @@
 
 #include <iostream>
 #include <map>
+#include <memory>
 #include <string>
 
 /**
@@ -28,7 +29,7 @@ class HttpMessage {
 		[[nodiscard]] std::string getHttpVersion() const;
 		[[nodiscard]] std::map<std::string, std::string> getHeaders() const;
 		[[nodiscard]] std::string getHeader(const std::string &key) const;
-		[[nodiscard]] std::string getBody() const;
+		[[nodiscard]] const std::string &getBody() const;
 		std::string &getBodyRef();
 		[[nodiscard]] bool hasHeader(const std::string &key) const;
 
@@ -36,6 +37,7 @@ class HttpMessage {
 		void setHttpVersion(const std::string &httpVersion);
 		void setHeaders(const std::map<std::string, std::string> &headers);
 		void setBody(const std::string &body);
+		void setSharedBody(std::shared_ptr<const std::string> body);
 		void appendToBody(const std::string &newData);
 
 		// Add a header to the message
@@ -46,4 +48,9 @@ class HttpMessage {
 		std::string _httpVersion = "HTTP/1.1";
 		std::map<std::string, std::string> _headers;
 		std::string _body;
+		// Immutable body owned elsewhere (e.g. an error page), used instead of `_body` until the body is changed
+		std::shared_ptr<const std::string> _sharedBody;
+
+	private:
+		void _unshareBody();
 };
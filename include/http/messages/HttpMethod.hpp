@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace Http {
+
+/**
+ * @brief Request methods known to the parser. Only GET, POST and DELETE are implemented, the others are answered
+ * with `501 Not Implemented`.
+ */
+enum class Method : uint8_t { GET, POST, DELETE, HEAD, PUT, OPTIONS, TRACE, CONNECT, PATCH, UNKNOWN };
+
+constexpr size_t METHOD_COUNT = static_cast<size_t>(Method::UNKNOWN);
+
+// Set of methods, one bit per Method
+using MethodMask = uint16_t;
+
+constexpr std::string_view METHOD_NAMES[METHOD_COUNT] = {"GET",		"POST",	 "DELETE",	"HEAD", "PUT",
+														 "OPTIONS", "TRACE", "CONNECT", "PATCH"};
+
+constexpr MethodMask methodBit(const Method method) {
+	return method == Method::UNKNOWN ? 0 : static_cast<MethodMask>(1u << static_cast<unsigned>(method));
+}
+
+constexpr Method methodFromString(const std::string_view name) {
+	for (size_t i = 0; i < METHOD_COUNT; ++i) {
+		if (METHOD_NAMES[i] == name)
+			return static_cast<Method>(i);
+	}
+	return Method::UNKNOWN;
+}
+
+constexpr std::string_view methodName(const Method method) {
+	return method == Method::UNKNOWN ? std::string_view("UNKNOWN") : METHOD_NAMES[static_cast<size_t>(method)];
+}
+
+constexpr bool isImplemented(const Method method) {
+	return method == Method::GET || method == Method::POST || method == Method::DELETE;
+}
+
+}  // namespace Http
@@ -12,10 +12,10 @@
 
 #pragma once
 
-#include <unordered_set>
 #include <vector>
 
 #include "HttpMessage.hpp"
+#include "HttpMethod.hpp"
 
 /**
  * @brief Represents an HTTP request
@@ -29,8 +29,11 @@ class HttpRequest : public HttpMessage {
 		~HttpRequest() override = default;
 
 		// Getters
-		[[nodiscard]] std::string getMethod() const;
+		[[nodiscard]] const std::string &getMethod() const;
+		[[nodiscard]] Http::Method getMethodType() const { return _methodType; }
 		[[nodiscard]] std::string getRequestUri() const;
+		[[nodiscard]] const std::string &getRawRequestUri() const;
+		[[nodiscard]] const std::string &getClientAddress() const;
 		[[nodiscard]] std::string getServerSidePath() const;
 		[[nodiscard]] bool getIsFile() const;
 		[[nodiscard]] std::string getResourceExtension() const;
@@ -49,6 +52,7 @@ class HttpRequest : public HttpMessage {
 		void setResourceExtension(const std::string &resourceExtension);
 		void setQueryString(const std::string &queryString);
 		void setLocation(const std::string &location);
+		void setClientAddress(const std::string &clientAddress);
 
 		// Error 400
 		class BadRequest final : public std::exception {
@@ -72,7 +76,10 @@ class HttpRequest : public HttpMessage {
 
 	private:
 		std::string _method;
+		Http::Method _methodType = Http::Method::UNKNOWN;
 		std::string _requestUri;
+		std::string _rawRequestUri;
+		std::string _clientAddress;
 		std::string _rawRequest;
 		std::string _serverSidePath;
 		bool _isFile{};
@@ -88,9 +95,6 @@ class HttpRequest : public HttpMessage {
 		void _validateHeaders() const;
 		void _initBodyType();
 
-		std::unordered_set<std::string> _supportedMethods = {"GET", "POST", "DELETE"};
-		std::unordered_set<std::string> _unsupportedMethods = {"PUT", "HEAD", "OPTIONS", "TRACE", "CONNECT", "PATCH"};
-		std::unordered_set<std::string> _supportedVersions = {"HTTP/1.0", "HTTP/1.1"};
 };
 
 std::ostream &operator<<(std::ostream &os, const HttpRequest &request);
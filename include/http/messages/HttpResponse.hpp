@@ -12,6 +12,10 @@
 
 #pragma once
 
+#include <memory>
+#include <string_view>
+
+#include "BodyStream.hpp"
 #include "HttpMessage.hpp"
 #include "HttpStatus.hpp"
 
@@ -31,13 +35,26 @@ class HttpResponse : public HttpMessage {
 		// Setters
 		void setStatus(Http::Status status);
 		void setDefaultHeaders();
+		void setBodyStream(std::shared_ptr<BodyStream> stream);
+		void setHeaderBlock(std::string_view block);
 
 		// Getters
 		[[nodiscard]] Http::Status getStatus() const;
+		[[nodiscard]] const std::shared_ptr<BodyStream> &getBodyStream() const;
+		[[nodiscard]] bool hasBodyStream() const;
 
 		// Member Functions
 		[[nodiscard]] std::string toString() const;
+		[[nodiscard]] std::string headerToString() const;
+
+		[[nodiscard]] static std::string_view currentDate();
 
 	private:
+		[[nodiscard]] std::string _serialize(bool withBody) const;
+
 		Http::Status _status = Http::Status::NONE;
+		std::shared_ptr<BodyStream> _bodyStream;
+		// Pre-rendered header lines of the matched route, owned by the route. Only valid until the response is
+		// serialized, which happens right after the request handler hands the response over.
+		std::string_view _headerBlock;
 };
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BodyStream.hpp"
+#include "HttpResponse.hpp"
+#include "Upstream.hpp"
+
+/**
+ * @brief One request forwarded to an upstream.
+ *
+ * process() is called whenever the upstream connection is ready (see getWait()) until the response head has
+ * arrived: it picks a peer, connects (or reuses a pooled connection) and sends the request without blocking.
+ * Afterwards the object is the BodyStream of the response and relays the upstream body piece by piece. Once the
+ * body is complete, the upstream connection goes back into the pool if it can carry another request.
+ */
+class ProxyRequest : public BodyStream {
+	public:
+		ProxyRequest(std::shared_ptr<Upstream> upstream, std::string hashKey, std::string head, std::string_view body,
+					 bool retryable, std::chrono::milliseconds timeout, bool dechunk);
+		~ProxyRequest() override;
+		ProxyRequest(const ProxyRequest&) = delete;
+		ProxyRequest& operator=(const ProxyRequest&) = delete;
+
+		[[nodiscard]] bool process();
+		[[nodiscard]] Http::Status getError() const;
+		[[nodiscard]] const HttpResponse& getResponse() const;
+		[[nodiscard]] bool hasBody() const;
+		[[nodiscard]] bool closesConnection() const;
+
+		Status read(std::string& chunk, size_t maxSize) override;
+		[[nodiscard]] IoWait getWait() const override;
+
+	private:
+		enum class State { CONNECT, CONNECTING, SENDING, RECEIVING_HEADER, STREAMING, DONE, FAILED };
+		enum class Framing { NONE, LENGTH, CHUNKED, CLOSE };
+		enum class ChunkState { SIZE_LINE, DATA, DATA_END, TRAILER };
+		using Clock = std::chrono::steady_clock;
+
+		void _connect();
+		bool _checkConnected();
+		bool _send();
+		bool _receiveHeader();
+		void _parseHeader(size_t headerEnd);
+		size_t _frame(const char* data, size_t size, std::string& out);
+		size_t _decodeChunked(const char* data, size_t size, std::string& out);
+		void _fail(Http::Status status, bool peerFault);
+		BodyStream::Status _abort(const std::string& reason);
+		void _releaseConnection(bool reusable);
+		[[nodiscard]] bool _timedOut(std::chrono::milliseconds timeout) const;
+
+		std::shared_ptr<Upstream> _upstream;
+		std::string _hashKey;
+		std::string _head;
+		std::string_view _body;	 // the client's request body, sent as it is after the head
+		bool _retryable;
+		std::chrono::milliseconds _timeout;
+		bool _dechunk;
+
+		State _state = State::CONNECT;
+		Http::Status _error = Http::Status::NONE;
+		Http::Status _lastError = Http::Status::BAD_GATEWAY;
+		size_t _peer = Upstream::NO_PEER;
+		std::vector<bool> _tried;
+		size_t _attempts = 0;
+		int _fd = -1;
+		bool _reused = false;
+		size_t _sent = 0;
+		Clock::time_point _lastActivity;
+
+		std::string _header;
+		std::string _buffered;
+		std::vector<char> _readBuffer;
+		HttpResponse _response;
+		Framing _framing = Framing::NONE;
+		size_t _remaining = 0;
+		ChunkState _chunkState = ChunkState::SIZE_LINE;
+		std::string _chunkLine;
+		bool _complete = false;
+		bool _invalidBody = false;
+		bool _upstreamKeepAlive = false;
+		bool _closeClient = false;
+};
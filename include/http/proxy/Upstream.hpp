@@ -0,0 +1,73 @@
+#pragma once
+
+#include <netinet/in.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "UpstreamConfig.hpp"
+
+/**
+ * @brief Runtime state of an `upstream` block: peer selection, passive health tracking and a pool of idle
+ * keep-alive connections per peer.
+ *
+ * A peer that fails `max_fails` times within `fail_timeout` is ejected for `fail_timeout`; afterwards it
+ * gets traffic again and is ejected on the next failure until one request succeeds.
+ */
+class Upstream {
+	public:
+		static constexpr size_t NO_PEER = static_cast<size_t>(-1);
+
+		struct Peer {
+				std::string name;
+				sockaddr_in address{};
+				bool resolved = false;
+				size_t weight = 1;
+				long currentWeight = 0;
+				size_t maxFails = 1;
+				std::chrono::milliseconds failTimeout{10000};
+
+				size_t active = 0;
+				size_t fails = 0;
+				std::chrono::steady_clock::time_point firstFailAt;
+				std::chrono::steady_clock::time_point ejectedUntil;
+				std::vector<int> idle;
+		};
+
+		explicit Upstream(const UpstreamConfig& config);
+		~Upstream();
+		Upstream(const Upstream&) = delete;
+		Upstream& operator=(const Upstream&) = delete;
+
+		[[nodiscard]] const std::string& getName() const;
+		[[nodiscard]] const std::string& getHashKey() const;
+		[[nodiscard]] size_t getPeerCount() const;
+		[[nodiscard]] const Peer& getPeer(size_t index) const;
+
+		[[nodiscard]] size_t select(const std::string& hashKey, const std::vector<bool>& exclude);
+		[[nodiscard]] int acquire(size_t peer, bool& reused);
+		void release(size_t peer, int fd, bool reusable);
+		void reportSuccess(size_t peer);
+		void reportFailure(size_t peer);
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		[[nodiscard]] bool _isAvailable(size_t peer, const std::vector<bool>& exclude, Clock::time_point now) const;
+		[[nodiscard]] size_t _selectRoundRobin(const std::vector<bool>& exclude, Clock::time_point now);
+		[[nodiscard]] size_t _selectLeastConn(const std::vector<bool>& exclude, Clock::time_point now);
+		[[nodiscard]] size_t _selectHash(const std::string& key, const std::vector<bool>& exclude,
+										 Clock::time_point now) const;
+		void _buildRing();
+		static uint32_t _hash(const std::string& key);
+
+		std::string _name;
+		UpstreamConfig::Balance _balance;
+		std::string _hashKey;
+		size_t _keepalive;
+		std::vector<Peer> _peers;
+		std::vector<std::pair<uint32_t, size_t>> _ring;	 // consistent hash ring: point -> peer
+		size_t _next = 0;
+};
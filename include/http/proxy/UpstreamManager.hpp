@@ -0,0 +1,29 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Upstream.hpp"
+#include "UpstreamConfig.hpp"
+
+/**
+ * @brief Owns the runtime Upstream of every `upstream` block (including the implicit ones created for
+ * `proxy_pass <host>:<port>`)
+ */
+class UpstreamManager {
+	public:
+		static UpstreamManager& getInstance();
+		UpstreamManager(const UpstreamManager&) = delete;
+		UpstreamManager& operator=(const UpstreamManager&) = delete;
+
+		void configure(const std::vector<UpstreamConfig>& upstreams);
+		[[nodiscard]] std::shared_ptr<Upstream> get(const std::string& name) const;
+
+	private:
+		UpstreamManager() = default;
+		~UpstreamManager() = default;
+
+		std::unordered_map<std::string, std::shared_ptr<Upstream>> _upstreams;
+};
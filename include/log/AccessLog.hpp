@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "RequestTiming.hpp"
+
+/**
+ * @brief `access_log` settings of a server block
+ */
+struct AccessLogConfig {
+		enum class Format { COMBINED, JSON };
+
+		std::string path;  // empty = off
+		Format format = Format::COMBINED;
+		size_t bufferSize = 64 * 1024;
+		size_t flushInterval = 1000;  // ms
+};
+
+/**
+ * @brief `slow_log` settings of a server block
+ */
+struct SlowLogConfig {
+		std::string path;		  // empty = off
+		size_t threshold = 1000;  // ms
+};
+
+/**
+ * @brief Buffered access log shared by all servers.
+ *
+ * Lines are collected in one in-memory buffer per file and written when the buffer is full or its oldest
+ * line is older than the flush interval, so a request never causes a write on its own. SIGUSR1 makes the
+ * event loop reopen all files (log rotation). configure() opens the files of the loaded configuration and
+ * closes the ones it no longer uses.
+ */
+class AccessLog {
+	public:
+		/**
+		 * @brief One completed request
+		 */
+		struct Entry {
+				std::string clientAddress;
+				std::string method;
+				std::string uri;
+				std::string version;
+				std::string host;
+				std::string referer;
+				std::string userAgent;
+				int status = 0;
+				size_t bodyBytes = 0;
+				std::chrono::microseconds duration{0};
+		};
+
+		static AccessLog& getInstance();
+		AccessLog(const AccessLog&) = delete;
+		AccessLog& operator=(const AccessLog&) = delete;
+
+		void configure(const std::vector<AccessLogConfig>& configs);
+		void write(const AccessLogConfig& config, const Entry& entry);
+		void writeSlow(const SlowLogConfig& config, const Entry& entry, const RequestTiming& timing);
+		int tick();
+		void flushAll();
+
+		static void requestReopen();
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct File {
+				int fd = -1;
+				std::string buffer;
+				size_t bufferSize = 0;
+				std::chrono::milliseconds flushInterval{0};
+				Clock::time_point firstBufferedAt;
+				bool configured = false;  // closed once flushed otherwise, e.g. written by a request of an old config
+		};
+
+		AccessLog() = default;
+		~AccessLog();
+
+		File& _open(const AccessLogConfig& config);
+		void _flush(const std::string& path, File& file);
+		static void _close(File& file);
+		void _reopen();
+		void _formatCombined(std::string& out, const Entry& entry);
+		void _formatJson(std::string& out, const Entry& entry);
+		void _updateTime();
+
+		std::unordered_map<std::string, File> _files;
+
+		static std::atomic<bool> _reopenRequested;
+
+		std::time_t _cachedSecond = -1;
+		std::string _cachedLocalTime;	// 19/Oct/2026:12:00:00 +0000
+		std::string _cachedIsoTime;		// 2026-10-19T12:00:00+0000
+};
@@ -12,10 +12,16 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <ctime>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 #include "ft_iomanip.hpp"
 
@@ -31,16 +37,22 @@
 #define WARN_PREFIX WARN_COLOR "[WARN]" RESET_COLOR
 #define ERROR_PREFIX ERROR_COLOR "[ERROR]" RESET_COLOR
 
+// Build time minimum: calls below it are compiled out (`make LOG_LEVEL=INFO`)
 #ifndef LOG_LEVEL
 #define LOG_LEVEL DEBUG
 #endif
 
 enum LogLevel { TRACE, DEBUG, INFO, WARN, ERROR };
 
+/**
+ * @brief Logs synchronously by default. In async mode (`log_async on;`) log() only copies the message into a
+ * bounded lock-free ring buffer; a background thread formats the records and writes them in batches. When the
+ * buffer is full new records are dropped and counted.
+ */
 class Logger {
 	public:
 		Logger() = default;
-		~Logger() = default;
+		~Logger();
 		Logger(const Logger&) = delete;
 		Logger& operator=(const Logger&) = delete;
 
@@ -51,15 +63,80 @@ class Logger {
 		void setOutputToFile(const std::string& filename);
 		void setOutputToConsole();
 
+		/**
+		 * @brief Runtime level check, inline so that the log macros can skip building the message
+		 */
+		[[nodiscard]] bool isEnabled(const LogLevel level) const {
+			return level >= _level.load(std::memory_order_relaxed);
+		}
+		void setLevel(LogLevel level);
+		[[nodiscard]] LogLevel getLevel() const;
+		void increaseVerbosity();
+		void decreaseVerbosity();
+
+		void startAsync();
+		void stopAsync();
+		[[nodiscard]] bool isAsync() const;
+		[[nodiscard]] size_t getDroppedCount() const;
+
 	private:
+		using Clock = std::chrono::system_clock;
+
+		struct Record {
+				std::atomic<size_t> sequence{0};
+				Clock::time_point time;
+				LogLevel level = INFO;
+				std::string msg;
+		};
+
+		bool _push(const std::string& msg, LogLevel level);
+		bool _pop(std::string& out);
+		[[nodiscard]] bool _hasRecord() const;
+		void _writerLoop();
+		void _format(std::string& out, Clock::time_point time, LogLevel level, const std::string& msg);
+		void _output(const std::string& lines);
+		static void _atforkChild();
+
 		bool outputToFile = false;
 		std::ofstream logFile;
+
+		// Changed from signal handlers, hence lock-free
+		std::atomic<int> _level{LOG_LEVEL};
+		static_assert(std::atomic<int>::is_always_lock_free);
+
+		// Ring buffer (multi producer, single consumer): a slot is free for position p when its sequence is p,
+		// and holds the record of position p when its sequence is p + 1
+		std::unique_ptr<Record[]> _ring;
+		size_t _mask = 0;
+		std::atomic<size_t> _head{0};
+		size_t _tail = 0;
+
+		std::atomic<bool> _async{false};
+		std::atomic<bool> _running{false};
+		std::atomic<size_t> _dropped{0};
+		size_t _reportedDrops = 0;
+		std::unique_ptr<std::thread> _writer;
+
+		// The writer sleeps on the condition variable while the buffer is empty. Producers only take the mutex to
+		// wake it when it announced that it is about to sleep.
+		std::mutex _wakeupMutex;
+		std::condition_variable _wakeup;
+		std::atomic<bool> _writerIdle{false};
 };
 
 std::ostream& operator<<(std::ostream& os, LogLevel level);
 
-#define LOG_TRACE(msg) Logger::getInstance().log(msg, TRACE)
-#define LOG_DEBUG(msg) Logger::getInstance().log(msg, DEBUG)
-#define LOG_INFO(msg) Logger::getInstance().log(msg, INFO)
-#define LOG_WARN(msg) Logger::getInstance().log(msg, WARN)
-#define LOG_ERROR(msg) Logger::getInstance().log(msg, ERROR)
\ No newline at end of file
+// The message is only evaluated if the level is enabled
+#define LOG_AT(level, msg)                                    \
+	do {                                                      \
+		if constexpr ((level) >= LOG_LEVEL) {                 \
+			if (Logger::getInstance().isEnabled(level))       \
+				Logger::getInstance().log(msg, level);        \
+		}                                                     \
+	} while (0)
+
+#define LOG_TRACE(msg) LOG_AT(TRACE, msg)
+#define LOG_DEBUG(msg) LOG_AT(DEBUG, msg)
+#define LOG_INFO(msg) LOG_AT(INFO, msg)
+#define LOG_WARN(msg) LOG_AT(WARN, msg)
+#define LOG_ERROR(msg) LOG_AT(ERROR, msg)
\ No newline at end of file
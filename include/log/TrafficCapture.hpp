@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief `traffic_capture` settings of the http block
+ */
+struct TrafficCaptureConfig {
+		std::string path;  // empty = off
+		size_t bufferSize = 256 * 1024;
+		size_t flushInterval = 1000;  // ms
+};
+
+/**
+ * @brief Records the raw bytes every client sends, with timestamps, into a binary file for `replay`.
+ *
+ * The file starts with the 8 byte `MAGIC`, followed by records of a `RECORD_HEADER_SIZE` byte header (type,
+ * connection id, microseconds since the file was opened; all integers little endian) and a payload:
+ *
+ *   OPEN      uint16 port of the listening socket
+ *   DATA      uint32 length, the received bytes
+ *   RESPONSE  uint16 status, uint8 flags, uint64 body bytes sent
+ *   CLOSE     -
+ *
+ * Records are buffered like the access log and written when the buffer is full or on the flush interval.
+ * SIGUSR1 reopens the file together with the access logs.
+ */
+class TrafficCapture {
+	public:
+		enum RecordType : uint8_t { OPEN = 1, DATA = 2, RESPONSE = 3, CLOSE = 4 };
+		static constexpr char MAGIC[8] = {'W', 'S', 'C', 'A', 'P', '\0', '\0', '\1'};
+		static constexpr size_t RECORD_HEADER_SIZE = 1 + 4 + 8;
+		static constexpr uint8_t RESPONSE_WITHOUT_BODY = 1;	 // answer to HEAD, the client expects no body
+
+		static TrafficCapture& getInstance();
+		TrafficCapture(const TrafficCapture&) = delete;
+		TrafficCapture& operator=(const TrafficCapture&) = delete;
+
+		void configure(const TrafficCaptureConfig& config);
+		[[nodiscard]] bool enabled() const { return _fd != -1; }
+
+		uint32_t connectionOpened(uint16_t port);
+		void received(uint32_t connection, const char* data, size_t size);
+		void responded(uint32_t connection, int status, bool withoutBody, uint64_t bodyBytes);
+		void connectionClosed(uint32_t connection);
+
+		int tick();
+		void flush();
+
+		static void requestReopen();
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		TrafficCapture() = default;
+		~TrafficCapture();
+
+		void _open();
+		void _appendHeader(RecordType type, uint32_t connection);
+		void _appendInteger(uint64_t value, size_t bytes);
+		void _recordAdded();
+
+		TrafficCaptureConfig _config;
+		int _fd = -1;
+		std::string _buffer;
+		Clock::time_point _openedAt;
+		Clock::time_point _firstBufferedAt;
+		uint32_t _nextConnection = 1;  // 0 means not captured
+
+		static std::atomic<bool> _reopenRequested;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BodyStream.hpp"
+
+/**
+ * @brief Live view of the client connections of the event loop, for the `connection_table` location and the
+ * SIGUSR2 dump.
+ *
+ * The event loop registers how to list and describe its connections. A dump takes a snapshot of the file
+ * descriptors only and renders a few rows at a time, so a large table never stalls the loop; connections
+ * that closed in the meantime are skipped.
+ */
+class ConnectionTable {
+	public:
+		struct Row {
+				int fd = -1;
+				std::string peer;
+				const char* status = "";
+				size_t headerBuffered = 0;
+				size_t bodyBuffered = 0;
+				size_t bytesSent = 0;
+				std::string requestLine;
+				std::chrono::milliseconds age{0};
+				std::chrono::milliseconds idle{0};
+				pid_t cgiPid = 0;
+				const char* cgiState = "";
+		};
+		using Lister = std::function<std::vector<int>()>;
+		using Describer = std::function<bool(int fd, Row& row)>;
+
+		/**
+		 * @brief Renders the table a batch of rows per read(), optionally in chunked transfer coding
+		 */
+		class Stream : public BodyStream {
+			public:
+				Stream(std::vector<int> fds, bool chunked);
+				Status read(std::string& chunk, size_t maxSize) override;
+
+			private:
+				std::vector<int> _fds;
+				size_t _next = 0;
+				bool _chunked;
+				bool _headerSent = false;
+				bool _done = false;
+		};
+
+		static ConnectionTable& getInstance();
+		ConnectionTable(const ConnectionTable&) = delete;
+		ConnectionTable& operator=(const ConnectionTable&) = delete;
+
+		void setSource(Lister lister, Describer describer);
+		[[nodiscard]] std::shared_ptr<Stream> stream(bool chunked) const;
+		[[nodiscard]] bool describe(int fd, Row& row) const;
+
+		static void requestDump();
+		static bool takeDumpRequest();
+
+	private:
+		ConnectionTable() = default;
+		~ConnectionTable() = default;
+
+		Lister _lister;
+		Describer _describer;
+
+		static std::atomic<bool> _dumpRequested;
+};
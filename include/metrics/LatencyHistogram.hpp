@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Log-linear latency histogram in microseconds (HdrHistogram layout with 3 significant bits).
+ *
+ * Every power of two is split into 8 linear sub-buckets, so a recorded value is known to within 12.5%
+ * over the whole range from 1 us to ~38 hours, with a fixed 280 counters and no allocation.
+ *
+ * Counters are written by a single thread (the owner of the Metrics shard) with relaxed load/store pairs,
+ * which compile to plain increments; a reader on another thread sees each counter atomically.
+ */
+class LatencyHistogram {
+	public:
+		static constexpr unsigned SUB_BUCKET_BITS = 3;
+		static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+		static constexpr unsigned MAX_VALUE_BITS = 37;
+		static constexpr uint64_t MAX_VALUE = (uint64_t(1) << MAX_VALUE_BITS) - 1;
+		static constexpr size_t BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+		/**
+		 * @brief Plain copy of one or more histograms, used for rendering
+		 */
+		struct Snapshot {
+				std::array<uint64_t, BUCKET_COUNT> counts{};
+				uint64_t count = 0;
+				uint64_t sum = 0;
+
+				void add(const LatencyHistogram& histogram);
+				[[nodiscard]] uint64_t countAtOrBelow(uint64_t value) const;
+				[[nodiscard]] uint64_t valueAtQuantile(double quantile) const;
+		};
+
+		void record(uint64_t value) {
+			if (value > MAX_VALUE)
+				value = MAX_VALUE;
+			_increment(_counts[indexOf(value)], 1);
+			_increment(_count, 1);
+			_increment(_sum, value);
+		}
+
+		static constexpr size_t indexOf(const uint64_t value) {
+			if (value < 2 * SUB_BUCKETS)
+				return static_cast<size_t>(value);
+			const unsigned shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+			return (shift + 1) * SUB_BUCKETS + static_cast<size_t>((value >> shift) - SUB_BUCKETS);
+		}
+
+		/**
+		 * @brief Largest value that falls into the bucket
+		 */
+		static constexpr uint64_t highestValueOf(const size_t index) {
+			if (index < 2 * SUB_BUCKETS)
+				return index;
+			const unsigned shift = static_cast<unsigned>(index / SUB_BUCKETS) - 1;
+			const uint64_t subBucket = index % SUB_BUCKETS + SUB_BUCKETS;
+			return ((subBucket + 1) << shift) - 1;
+		}
+
+	private:
+		static void _increment(std::atomic<uint64_t>& counter, const uint64_t amount) {
+			counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		}
+
+		std::array<std::atomic<uint64_t>, BUCKET_COUNT> _counts{};
+		std::atomic<uint64_t> _count{0};
+		std::atomic<uint64_t> _sum{0};
+};
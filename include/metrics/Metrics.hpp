@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "LatencyHistogram.hpp"
+#include "RequestTiming.hpp"
+
+/**
+ * @brief Server wide counters and per-route latency histograms, exposed in the Prometheus text format.
+ *
+ * Every thread that records gets its own shard of counters, so the hot path is a handful of plain
+ * increments without locks or shared cache lines. The shards are only summed up when the metrics
+ * location is scraped.
+ */
+class Metrics {
+	public:
+		/**
+		 * @brief Connection states at the time of the scrape, filled in by the event loop
+		 */
+		struct ConnectionCounts {
+				size_t active = 0;
+				size_t reading = 0;
+				size_t writing = 0;
+				size_t waiting = 0;
+		};
+		using ConnectionCollector = std::function<ConnectionCounts()>;
+
+		static Metrics& getInstance();
+		Metrics(const Metrics&) = delete;
+		Metrics& operator=(const Metrics&) = delete;
+
+		void connectionAccepted();
+		void loopWakeup();
+		void bytesReceived(size_t bytes);
+		void bytesSent(size_t bytes);
+		void cgiSpawned();
+		void cgiTimedOut();
+		void recordRequest(const std::string& host, int port, const std::string& route, int status,
+						   std::chrono::microseconds duration);
+		void recordPhases(const RequestTiming& timing);
+
+		void setConnectionCollector(ConnectionCollector collector);
+
+		[[nodiscard]] std::string render() const;
+
+	private:
+		/**
+		 * @brief Counter written by a single thread, readable from any thread
+		 */
+		class Counter {
+			public:
+				void add(const uint64_t amount) {
+					_value.store(_value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+				}
+				[[nodiscard]] uint64_t get() const { return _value.load(std::memory_order_relaxed); }
+
+			private:
+				std::atomic<uint64_t> _value{0};
+		};
+
+		struct RouteStats {
+				std::string server;
+				std::string route;
+				Counter requests[5];  // 1xx .. 5xx
+				LatencyHistogram latency;
+		};
+
+		struct Shard {
+				Counter accepted;
+				Counter loopWakeups;
+				Counter bytesIn;
+				Counter bytesOut;
+				Counter cgiSpawned;
+				Counter cgiTimeouts;
+				LatencyHistogram phases[RequestTiming::MARK_COUNT];
+				// Only the owning thread inserts, the mutex keeps the map stable while it is scraped
+				mutable std::mutex routesMutex;
+				std::map<std::string, std::unique_ptr<RouteStats>, std::less<>> routes;
+				std::string keyBuffer;
+		};
+
+		Metrics() = default;
+		~Metrics() = default;
+
+		Shard& _local();
+
+		mutable std::mutex _mutex;
+		std::vector<std::unique_ptr<Shard>> _shards;  // never shrinks, counters of finished threads stay
+		ConnectionCollector _connectionCollector;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+
+/**
+ * @brief Monotonic timestamps of the steps of one request on a connection.
+ *
+ * The time between a mark and the previous mark that was reached is the phase named after the mark, e.g.
+ * HANDLER_DONE - ROUTE_MATCHED is the `handler` phase. Marks that were not reached (a 400 never gets routed,
+ * a GET has no body) stay unset and their phase is reported as missing.
+ */
+struct RequestTiming {
+		using Clock = std::chrono::steady_clock;
+
+		enum Mark {
+			ACCEPTED,			  // connection accepted, or previous response sent on a keep-alive connection
+			FIRST_BYTE,			  // first byte of the request read
+			HEADER_DONE,		  // header complete and parsed
+			BODY_DONE,			  // body complete
+			ROUTE_MATCHED,		  // location selected
+			HANDLER_DONE,		  // response built
+			FIRST_RESPONSE_BYTE,  // first byte of the response sent
+			LAST_BYTE,			  // last byte of the response sent
+			MARK_COUNT
+		};
+
+		std::array<Clock::time_point, MARK_COUNT> marks{};
+
+		void mark(const Mark mark, const Clock::time_point at = Clock::now()) { marks[mark] = at; }
+		[[nodiscard]] bool has(const Mark mark) const { return marks[mark] != Clock::time_point(); }
+		void reset(Clock::time_point accepted);
+
+		[[nodiscard]] std::chrono::microseconds phase(Mark mark) const;
+		[[nodiscard]] std::chrono::microseconds total() const;
+		[[nodiscard]] static const char* phaseName(Mark mark);
+};
@@ -27,8 +27,36 @@
 
 #define DEFAULT_POLL_TIMEOUT 5000
 #define DEFAULT_CGI_TIMEOUT_MS 5000
+#define CGI_REAP_INTERVAL_MS 10  // the CGI closed its output but has not exited yet
 
 #define SIZE_BYTES_TO_SEND_BACK size_t(1024 * 1024)
 #define GET_READ_SIZE size_t(1024 * 1024)
 #define POST_WRITE_SIZE size_t(1024 * 1024)
 #define CGI_READ_BUFFER_SIZE size_t(1024 * 1024)
+#define CLIENT_READ_BUFFER_SIZE size_t(256 * 1024)
+
+// Per connection and event loop wakeup: bytes read, bytes written and pipelined requests answered
+#define CLIENT_READ_BUDGET size_t(1024 * 1024)
+#define CLIENT_WRITE_BUDGET size_t(2 * 1024 * 1024)
+#define CLIENT_PIPELINE_BUDGET 16
+
+#define CGI_CACHE_MAX_ENTRIES size_t(1024)
+#define CGI_CACHE_MAX_ENTRY_SIZE size_t(1024 * 1024)
+#define CGI_CACHE_MAX_STALE_MS 60000
+
+#define PROXY_CONNECT_TIMEOUT_MS 5000
+#define PROXY_BUFFER_SIZE size_t(64 * 1024)
+#define PROXY_HEADER_BUFFER_SIZE size_t(16 * 1024)
+
+#define LOG_RING_SIZE size_t(8192)
+#define LOG_BATCH_SIZE size_t(512)
+
+#define CONNECTION_TABLE_BATCH_BYTES size_t(16 * 1024)
+
+#define AUTOINDEX_READ_BATCH size_t(512)
+#define AUTOINDEX_BATCH_BYTES size_t(16 * 1024)
+#define AUTOINDEX_CACHE_MAX_ENTRIES size_t(64)
+#define AUTOINDEX_PAGE_SIZE_DEFAULT size_t(100)
+
+// While draining, connections idle for this long are closed
+#define DRAIN_IDLE_TIMEOUT_MS 1000
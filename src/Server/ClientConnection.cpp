@@ -10,14 +10,17 @@
 #include <cstring>	// For strerror
 #include <webserv.hpp>
 
+#include "AccessLog.hpp"
 #include "HttpRequest.hpp"
 #include "HttpResponse.hpp"
 #include "Logger.hpp"
+#include "Metrics.hpp"
 #include "ServerConfig.hpp"
+#include "TrafficCapture.hpp"
 #include "ft_toString.hpp"
 
 namespace {
-std::string statusToString(const ClientConnection::Status status) {
+const char* statusToString(const ClientConnection::Status status) {
 	switch (status) {
 		case ClientConnection::Status::HEADER:
 			return "HEADER";
@@ -31,50 +34,85 @@ std::string statusToString(const ClientConnection::Status status) {
 			return "UNKNOWN";
 	}
 }
+
+const char* cgiStateToString(const cgiState state) {
+	switch (state) {
+		case NONE:
+			return "-";
+		case WRITING:
+			return "WRITING";
+		case WAITING:
+			return "WAITING";
+		case READING:
+			return "READING";
+		case FINISHED:
+			return "FINISHED";
+		default:
+			return "UNKNOWN";
+	}
+}
 }  // namespace
 
-ClientConnection::ClientConnection(const int clientFd, const sockaddr_in clientAddr, std::vector<ServerConfig> configs)
+ClientConnection::ClientConnection(const int clientFd, const sockaddr_in clientAddr,
+								   std::shared_ptr<const ListenerConfig> listener)
 	: _clientFd(clientFd),
 	  _disconnected(false),
-	  _currentConfig(configs.front()),
-	  _configs(std::move(configs)),
+	  _listener(std::move(listener)),
+	  _configs(_listener->servers),
 	  _clientAddr(clientAddr),
-	  _requestHandler(_currentConfig) {
+	  _requestHandler(_configs->defaultServer()) {
+	_requestHandler.setWaiter(_clientFd);
+	_timing.reset(RequestTiming::Clock::now());
 	LOG_INFO(_log("New client connection established"));
 	LOG_INFO("Client address: " + std::string(my_inet_ntoa(_clientAddr.sin_addr)) +
 			 " Port: " + std::to_string(ntohs(_clientAddr.sin_port)));
 
-	if (fcntl(_clientFd, F_SETFL, O_NONBLOCK) == -1) {
-		LOG_ERROR(_log("Failed to set client socket to non-blocking: " + std::string(strerror(errno))));
+	// Close on exec: neither CGI children nor the new binary of an upgrade may keep the connection open
+	if (fcntl(_clientFd, F_SETFL, O_NONBLOCK) == -1 || fcntl(_clientFd, F_SETFD, FD_CLOEXEC) == -1) {
+		LOG_ERROR(_log("Failed to set client socket flags: " + std::string(strerror(errno))));
 		_disconnected = true;
 		close(_clientFd);
 	} else {
 		LOG_DEBUG(_log("Client socket set to non-blocking mode"));
 	}
 
-	_headerBuffer.reserve(_currentConfig.getClientHeaderBufferSize());
+	_headerBuffer.reserve(_requestHandler.getConfig().getClientHeaderBufferSize());
+	if (!_disconnected)
+		_captureId = TrafficCapture::getInstance().connectionOpened(_requestHandler.getConfig().getPort());
 }
 
 ClientConnection::~ClientConnection() {
 	LOG_INFO(_log("Closing client connection"));
+	TrafficCapture::getInstance().connectionClosed(_captureId);
 	if (_clientFd != -1) {
 		close(_clientFd);
 		_clientFd = -1;
 	}
 }
 
+/**
+ * @brief Read until the socket would block, the request is complete or the read budget of this wakeup is spent:
+ * a busy client makes progress in fewer wakeups without starving the others
+ */
 void ClientConnection::handleClient() {
-	LOG_DEBUG(_log("Handling client with status: " + statusToString(_status)));
-	switch (_status) {
-		case Status::HEADER:
-			_receiveHeader();
-			break;
-		case Status::BODY:
-			_receiveBody();
-			break;
-		case Status::READY_TO_SEND:
-		case Status::SENDING_RESPONSE:
-			// Nothing to do here
+	LOG_DEBUG(_log("Handling client with status: " + std::string(statusToString(_status))));
+	_wouldBlock = false;
+	_readBudget = CLIENT_READ_BUDGET;
+	while (!_disconnected && !_wouldBlock && _readBudget > 0) {
+		const Status status = _status;
+		const size_t budget = _readBudget;
+		switch (_status) {
+			case Status::HEADER:
+				_receiveHeader();
+				break;
+			case Status::BODY:
+				_receiveBody();
+				break;
+			case Status::READY_TO_SEND:
+			case Status::SENDING_RESPONSE:
+				return;
+		}
+		if (_status == status && _readBudget == budget)
 			break;
 	}
 }
@@ -85,8 +123,14 @@ bool ClientConnection::_receiveHeader() {
 	// Attempt to read data into the header buffer
 	size_t remainingHeaderSize = _requestHandler.getConfig().getClientHeaderBufferSize() - _headerBuffer.size();
 	LOG_TRACE(_log("Remaining header size: " + std::to_string(remainingHeaderSize)));
-	if (!_readData(_clientFd, _headerBuffer, remainingHeaderSize)) {
-		return false;
+	const bool firstRead = _headerBuffer.empty();
+	// A pipelined request may be complete in the buffer already
+	if (firstRead || !findHeaderEnd(_headerBuffer)) {
+		if (!_readData(_clientFd, _headerBuffer, remainingHeaderSize)) {
+			return false;
+		}
+		if (firstRead)
+			_timing.mark(RequestTiming::FIRST_BYTE);
 	}
 
 	LOG_TRACE(_log("Header content: \n" + std::string(_headerBuffer.begin(), _headerBuffer.end())));
@@ -97,6 +141,7 @@ bool ClientConnection::_receiveHeader() {
 		return false;
 	}
 
+	_timing.mark(RequestTiming::HEADER_DONE);
 	LOG_DEBUG(_log("Header received with size: " + std::to_string(header.size())));
 	LOG_DEBUG(_log("Header: \n" + std::string(header.begin(), header.end())));
 
@@ -109,6 +154,7 @@ bool ClientConnection::_receiveHeader() {
 
 	if (_request.getBodyType() == HttpRequest::BodyType::NO_BODY) {
 		LOG_DEBUG(_log("Request has no body"));
+		_timing.mark(RequestTiming::BODY_DONE, _timing.marks[RequestTiming::HEADER_DONE]);
 		_status = Status::READY_TO_SEND;
 		_logHeader();
 		return true;
@@ -117,7 +163,7 @@ bool ClientConnection::_receiveHeader() {
 	if (_request.getBodyType() == HttpRequest::BodyType::CHUNKED ||
 		_request.getBodyType() == HttpRequest::BodyType::CONTENT_LENGTH) {
 		LOG_DEBUG(_log("Request has body"));
-		_bodyBuffer.reserve(_currentConfig.getClientMaxBodySize());
+		_bodyBuffer.reserve(_requestHandler.getConfig().getClientMaxBodySize());
 		_bodyBuffer.clear();
 		if (_headerBuffer.empty()) {
 			LOG_DEBUG(_log("No additional data in header buffer"));
@@ -135,12 +181,29 @@ bool ClientConnection::_receiveHeader() {
 
 ClientConnection::Status ClientConnection::getStatus() const { return _status; }
 
+/**
+ * @brief What the response waits for while the request handler or the body stream cannot go on. The connection
+ * waits for that instead of POLLOUT, which would be reported right away.
+ */
+std::optional<IoWait> ClientConnection::getWait() const {
+	if (!_pending)
+		return std::nullopt;
+	if (_response.hasBodyStream())
+		return _response.getBodyStream()->getWait();
+	return _requestHandler.getWait();
+}
+
 void ClientConnection::_handleCompleteChunkedBodyRead() {
 	LOG_DEBUG(_log("Finished reading chunked request body"));
 
-	// LOG_DEBUG(_log("Request body: \n" + _request.getBody()));
-	// _readingChunkSize = true;
+	// Data after the body belongs to the next request on the connection
+	_headerBuffer.assign(_bodyBuffer.begin(), _bodyBuffer.end());
+	_bodyBuffer.clear();
+	_readingChunkSize = true;
+	_readingChunkTrailer = false;
+	_chunkSizeRemaining = 0;
 	// Set the status to ready to send
+	_timing.mark(RequestTiming::BODY_DONE);
 	_status = Status::READY_TO_SEND;
 }
 
@@ -151,6 +214,7 @@ bool ClientConnection::_readChunkData() {
 		LOG_DEBUG(_log("Chunk fully read"));
 		_request.appendToBody(std::string(_bodyBuffer.begin(), _bodyBuffer.begin() + _chunkSizeRemaining));
 		_bodyBuffer.erase(_bodyBuffer.begin(), _bodyBuffer.begin() + _chunkSizeRemaining);
+		_chunkSizeRemaining = 0;
 		return true;
 	}
 
@@ -173,6 +237,9 @@ bool ClientConnection::_readChunkData() {
 		return false;
 	}
 
+	if (_bodyBuffer.size() >= _chunkSizeRemaining)
+		return _readChunkData();
+
 	// If the chunk isn't fully read yet, return to wait for more data
 	LOG_DEBUG(_log("Partial chunk received, waiting for remaining data"));
 	return false;
@@ -184,11 +251,11 @@ bool ClientConnection::_readChunkTerminator() {
 	std::string bufferContent(_bodyBuffer.begin(), _bodyBuffer.end());
 	size_t pos = bufferContent.find("\r\n");
 	if (pos == std::string::npos) {
-		LOG_ERROR("No CRLF found in buffer");
+		LOG_DEBUG(_log("No CRLF found in buffer"));
 		// We do not have a full chunk terminator yet, attempt to read more data.
 
-		// Try to read a minimal amount (e.g., 1 byte) to see if we can complete the chunk terminator.
-		if (!_readData(_clientFd, _bodyBuffer, 1)) {
+		// Read what is there, data after the terminator stays buffered for the next steps.
+		if (!_readData(_clientFd, _bodyBuffer, _framingReadSize())) {
 			// If no data is read, it means we don't have enough data yet.
 			return false;
 		}
@@ -207,29 +274,62 @@ bool ClientConnection::_readChunkTerminator() {
 	return true;
 }
 
+/**
+ * @brief Skip the trailer fields after the last chunk, up to the empty line that ends the chunked body
+ * @return true once the empty line is consumed, false while more data is needed
+ */
+bool ClientConnection::_readChunkTrailer() {
+	LOG_DEBUG(_log("Reading chunk trailer"));
+	while (true) {
+		const std::string bufferContent(_bodyBuffer.begin(), _bodyBuffer.end());
+		const size_t pos = bufferContent.find("\r\n");
+		if (pos == std::string::npos) {
+			// Like for the chunk terminator, read a minimal amount and look again
+			if (!_readData(_clientFd, _bodyBuffer, 1))
+				return false;
+			continue;
+		}
+		_bodyBuffer.erase(_bodyBuffer.begin(), _bodyBuffer.begin() + pos + 2);
+		if (pos == 0)
+			return true;
+		LOG_DEBUG(_log("Skipped trailer field: " + bufferContent.substr(0, pos)));
+	}
+}
+
+/**
+ * @brief Decode as many chunks as the buffered data allows. Every step resumes where the previous call
+ * stopped: chunk size line, chunk data (`_chunkSizeRemaining` > 0), the CRLF after the data or the trailer.
+ */
 void ClientConnection::_readRequestBodyIfChunked() {
 	LOG_DEBUG(_log("Reading chunked request body"));
 
-	// If we are currently reading the chunk size
-	if (_readingChunkSize) {
-		if (!_parseChunkSize()) {
-			// If we can't parse a full chunk size yet (need more data), return to avoid blocking.
+	while (_status == Status::BODY && !_disconnected) {
+		// The last chunk is followed by the trailer fields, which are skipped, and an empty line
+		if (_readingChunkTrailer) {
+			if (_readChunkTrailer())
+				_handleCompleteChunkedBodyRead();
 			return;
 		}
 
-		if (_chunkSizeRemaining == 0) {
-			// Reached the final chunk (size = 0). The message body is complete.
-			_handleCompleteChunkedBodyRead();
-			return;
-		}
+		// If we are currently reading the chunk size
+		if (_readingChunkSize) {
+			if (!_parseChunkSize()) {
+				// If we can't parse a full chunk size yet (need more data), return to avoid blocking.
+				return;
+			}
 
-		// Now that we have a chunk size, move on to reading chunk data.
-		_readingChunkSize = false;
-	}
+			if (_chunkSizeRemaining == 0) {
+				// Reached the final chunk (size = 0). The message body is complete after the trailer.
+				_readingChunkSize = false;
+				_readingChunkTrailer = true;
+				continue;
+			}
 
-	// If we're reading chunk data (not the chunk size)
-	if (!_readingChunkSize && _chunkSizeRemaining > 0) {
-		if (!_readChunkData()) {
+			// Now that we have a chunk size, move on to reading chunk data.
+			_readingChunkSize = false;
+		}
+
+		if (_chunkSizeRemaining > 0 && !_readChunkData()) {
 			// If we haven't read all the chunk data yet, return and wait for more data.
 			return;
 		}
@@ -242,10 +342,6 @@ void ClientConnection::_readRequestBodyIfChunked() {
 
 		// After successfully reading the chunk terminator, we should read the next chunk size.
 		_readingChunkSize = true;
-		// If `_readingChunkSize` is true, the next call to `_readRequestBodyIfChunked` will parse the next chunk size.
-		if (!_bodyBuffer.empty()) {
-			_readRequestBodyIfChunked();
-		}
 	}
 }
 
@@ -258,8 +354,8 @@ bool ClientConnection::_parseChunkSize() {
 	if (pos == std::string::npos) {
 		// We do not have a full chunk size line yet, attempt to read more data.
 
-		// Try to read a minimal amount (e.g., 1 byte) to see if we can complete the chunk size line.
-		if (!_readData(_clientFd, _bodyBuffer, 1)) {
+		// Read what is there, the chunk data after the line stays buffered for the next steps.
+		if (!_readData(_clientFd, _bodyBuffer, _framingReadSize())) {
 			// If no data is read, it means we don't have enough data yet.
 			return false;
 		}
@@ -359,12 +455,13 @@ void ClientConnection::_handleCompleteBodyRead() {
 	_request.setBody(std::string(_bodyBuffer.begin(), _bodyBuffer.end()));
 
 	// Update status to ready
+	_timing.mark(RequestTiming::BODY_DONE);
 	_status = Status::READY_TO_SEND;
 }
 
 bool ClientConnection::_extractHeaderIfComplete(std::vector<char>& header) {
 	// Check if header is complete and get the position of the end
-	const auto headerEndIndex = _findHeaderEnd(_headerBuffer);
+	const auto headerEndIndex = findHeaderEnd(_headerBuffer);
 
 	if (!headerEndIndex) {
 		// Header not complete
@@ -391,7 +488,19 @@ bool ClientConnection::_extractHeaderIfComplete(std::vector<char>& header) {
 	return true;
 }
 
+/**
+ * @brief Switch to the configs of a reload between two requests, the previous request is done with the old ones
+ */
+void ClientConnection::_updateConfig() {
+	if (_configs == _listener->servers)
+		return;
+	_configs = _listener->servers;
+	_requestHandler.setConfig(_configs->defaultServer());
+	LOG_DEBUG(_log("Using the reloaded configuration"));
+}
+
 bool ClientConnection::_parseHttpRequestHeader(const std::string& header) {
+	_updateConfig();
 	try {
 		_request = HttpRequest(header);
 	} catch (const HttpRequest::BadRequest& e) {
@@ -408,29 +517,14 @@ bool ClientConnection::_parseHttpRequestHeader(const std::string& header) {
 		return false;
 	}
 
-	bool isKnownHost = false;
-	// Check if there is a matching server config
-	for (const auto& config : _configs) {
-		for (const auto& serverName : config.getServerNames()) {
-			if (serverName + ":" + std::to_string(config.getPort()) == _request.getHeader("Host") ||
-				serverName == _request.getHeader("Host")) {
-				_currentConfig = config;
-				_requestHandler.setConfig(_currentConfig);
-				isKnownHost = true;
-				LOG_INFO(_log("Server config found for host: " + _request.getHeader("Host")));
-				break;
-			}
-		}
-		if (isKnownHost) {
-			break;
-		}
-	}
+	_request.setClientAddress(my_inet_ntoa(_clientAddr.sin_addr));
 
-	if (!isKnownHost) {
-		LOG_WARN(_log("No server config found for host: " + _request.getHeader("Host")));
-		_response = HttpResponse(Http::BAD_REQUEST);
+	if (!_request.hasHeader("Host") && _request.getHttpVersion() == "HTTP/1.1") {
+		LOG_WARN(_log("HTTP/1.1 request without Host header"));
+		_response = _requestHandler.buildDefaultResponse(Http::BAD_REQUEST);
 		return false;
 	}
+	_requestHandler.setConfig(_configs->find(_request.getHeader("Host")));
 
 	return true;
 }
@@ -439,11 +533,16 @@ void ClientConnection::sendResponse() {
 	if (_status != Status::READY_TO_SEND && _status != Status::SENDING_RESPONSE) {
 		return;
 	}
+	_pending = false;
 	if (!_response.getStatus()) {
 		if (_requestHandler.handleRequest(_request)) {
 			LOG_DEBUG(_log("Building response for request"));
+			_timing.mark(RequestTiming::ROUTE_MATCHED, _requestHandler.getRouteMatchedAt());
+			_timing.mark(RequestTiming::HANDLER_DONE);
+			_routePath = _requestHandler.getMatchedRoute().getPath();
 			_response = _requestHandler.getResponse();
 		} else {
+			_pending = true;
 			return;
 		}
 	}
@@ -451,34 +550,91 @@ void ClientConnection::sendResponse() {
 	if (_status == Status::READY_TO_SEND) {
 		_status = Status::SENDING_RESPONSE;
 		_bytesSendToClient = 0;
-	}
+		// A streamed body is sent piece by piece after the header
+		if (_draining)
+			_response.addHeader("Connection", "close");
+		_sendBuffer = _response.hasBodyStream() ? _response.headerToString() : _response.toString();
+		_responseHeaderSize = _sendBuffer.size() - (_response.hasBodyStream() ? 0 : _response.getBody().size());
+		_responseBytesSent = 0;
+	}
+
+	// Send until the socket would block, the response is complete or the write budget of this wakeup is spent
+	_wouldBlock = false;
+	size_t budget = CLIENT_WRITE_BUDGET;
+	while (!_disconnected && budget > 0) {
+		if (_bytesSendToClient == _sendBuffer.size() && _response.hasBodyStream() && !_pullBodyStream()) {
+			return;
+		}
 
-	const size_t remainingBytes = _response.toString().size() - _bytesSendToClient;
-	const size_t bytesToSend = std::min(SIZE_BYTES_TO_SEND_BACK, remainingBytes);
+		if (_bytesSendToClient < _sendBuffer.size()) {
+			const size_t bytesToSend = std::min(budget, _sendBuffer.size() - _bytesSendToClient);
+			const size_t sentBefore = _bytesSendToClient;
+			if (!_sendDataToClient(_sendBuffer, _bytesSendToClient, bytesToSend)) {
+				if (!_wouldBlock)
+					LOG_ERROR(_log("Failed to send chunk. Bytes sent so far: " + std::to_string(_bytesSendToClient)));
+				return;
+			}
+			budget -= _bytesSendToClient - sentBefore;
+			LOG_DEBUG(_log("Chunk sent successfully. Bytes sent in this chunk: " +
+						   std::to_string(_bytesSendToClient - sentBefore) +
+						   ", Total bytes sent: " + std::to_string(_bytesSendToClient)));
+		}
 
-	if (!_sendDataToClient(_response.toString(), _bytesSendToClient, bytesToSend)) {
-		LOG_ERROR(_log("Failed to send chunk. Bytes sent so far: " + std::to_string(_bytesSendToClient)));
-		return;
+		if (_bytesSendToClient == _sendBuffer.size() && !_response.hasBodyStream()) {
+			LOG_INFO(_log("Sending response with status code: " + std::to_string(_response.getStatus())));
+			LOG_TRACE(_log("Response: \n" + _sendBuffer));
+			_finishRequest();
+			_sendBuffer.clear();
+			_bytesSendToClient = 0;
+			if (_response.getHeader("Connection") == "keep-alive") {
+				LOG_INFO(_log("Connection is keep-alive"));
+				_status = Status::HEADER;
+				_disconnected = false;
+				_response = HttpResponse();
+				// A pipelined request may already be waiting in the header buffer
+				if (!_headerBuffer.empty())
+					_timing.mark(RequestTiming::FIRST_BYTE);
+			} else {
+				LOG_INFO(_log("Closing connection after response"));
+				_disconnected = true;
+			}
+			return;
+		}
 	}
+}
 
-	LOG_DEBUG(_log("Chunk sent successfully. Bytes sent in this chunk: " + std::to_string(bytesToSend) +
-				   ", Total bytes sent: " + std::to_string(_bytesSendToClient)));
-
-	if (_bytesSendToClient == _response.toString().size()) {
-		LOG_INFO(_log("Sending response with status code: " + std::to_string(_response.getStatus())));
-		LOG_TRACE(_log("Response: \n" + _response.toString()));
-		if (_response.getHeader("Connection") == "keep-alive") {
-			LOG_INFO(_log("Connection is keep-alive"));
-			_status = Status::HEADER;
-			_disconnected = false;
-			_response = HttpResponse();
-		} else {
-			LOG_INFO(_log("Closing connection after response"));
+/**
+ * @brief Replace the (completely sent) send buffer with the next piece of the streamed body
+ * @return true if there is something to send or the body is complete, false to try again later
+ */
+bool ClientConnection::_pullBodyStream() {
+	// The stream replaces the content of the buffer in any case
+	_bytesSendToClient = 0;
+	switch (_response.getBodyStream()->read(_sendBuffer, SIZE_BYTES_TO_SEND_BACK)) {
+		case BodyStream::Status::DATA:
+			return true;
+		case BodyStream::Status::AGAIN:
+			_pending = true;
+			return false;
+		case BodyStream::Status::END:
+			_response.setBodyStream(nullptr);
+			return true;
+		case BodyStream::Status::ERROR:
+		default:
+			// The header is already out, the only way to tell the client is to close the connection
+			LOG_ERROR(_log("Response body stream failed, closing connection"));
 			_disconnected = true;
-		}
+			return false;
 	}
 }
 
+/**
+ * @brief Read from the socket into the buffer, at most CLIENT_READ_BUFFER_SIZE bytes at a time. recv() goes to a
+ * scratch buffer and only the bytes received are appended, growing the vector by `bytesToRead` up front would
+ * zero-fill all of it on every read.
+ * @return false if nothing was read: the socket would block (`_wouldBlock`), the client is gone or the buffer is
+ * full (the response is 413)
+ */
 bool ClientConnection::_readData(const int fd, std::vector<char>& buffer, const size_t bytesToRead) {
 	if (buffer.capacity() < buffer.size() + bytesToRead) {
 		LOG_ERROR(_log("Buffer capacity is insufficient"));
@@ -487,26 +643,54 @@ bool ClientConnection::_readData(const int fd, std::vector<char>& buffer, const
 		// _disconnected = true;
 		return false;
 	}
-	std::vector<char> tmp(bytesToRead);
-
-	const ssize_t bytesRead = recv(fd, tmp.data(), bytesToRead, 0);
+	static char scratch[CLIENT_READ_BUFFER_SIZE];
+	const ssize_t bytesRead = recv(fd, scratch, std::min(bytesToRead, sizeof(scratch)), 0);
+	if (bytesRead > 0)
+		buffer.insert(buffer.end(), scratch, scratch + bytesRead);
 	if (bytesRead == 0) {
 		LOG_INFO(_log("Client disconnected"));
 		_disconnected = true;
 		return false;
 	}
+	if (bytesRead == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		// Everything that arrived is consumed, wait for the next POLLIN
+		_wouldBlock = true;
+		return false;
+	}
 	if (bytesRead == -1) {
 		LOG_ERROR(_log("Failed to receive data: " + std::string(strerror(errno))));
 		_disconnected = true;
 		return false;
 	}
-	buffer.insert(buffer.end(), tmp.begin(), tmp.begin() + bytesRead);
+	_readBudget -= std::min(static_cast<size_t>(bytesRead), _readBudget);
+	Metrics::getInstance().bytesReceived(bytesRead);
+	TrafficCapture::getInstance().received(_captureId, scratch, bytesRead);
+	_lastActivity = std::chrono::steady_clock::now();
 	LOG_DEBUG(_log("Read " + std::to_string(bytesRead) + " bytes"));
 	return true;
 }
 
+/**
+ * @brief How much to read for a chunk size line or the CRLF after chunk data: what fits into the body buffer, at
+ * least one byte so that a full buffer is reported
+ */
+size_t ClientConnection::_framingReadSize() const {
+	const size_t room = _bodyBuffer.capacity() - _bodyBuffer.size();
+	return std::max<size_t>(1, std::min(room, _requestHandler.getConfig().getClientBodyBufferSize()));
+}
+
+/**
+ * @return false if nothing was sent: the socket would block (`_wouldBlock`) or the client is gone
+ */
 bool ClientConnection::_sendDataToClient(const std::string& data, size_t offset, size_t length) {
+	if (_responseBytesSent == 0)
+		_timing.mark(RequestTiming::FIRST_RESPONSE_BYTE);
 	ssize_t bytesSent = send(_clientFd, data.data() + offset, length, 0);
+	if (bytesSent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		// The socket buffer is full, wait for the next POLLOUT
+		_wouldBlock = true;
+		return false;
+	}
 	if (bytesSent == -1) {
 		LOG_ERROR(_log("Failed to send data: " + std::string(strerror(errno))));
 		_disconnected = true;
@@ -519,10 +703,13 @@ bool ClientConnection::_sendDataToClient(const std::string& data, size_t offset,
 	}
 	LOG_DEBUG(_log("Sent " + std::to_string(bytesSent) + " bytes to client"));
 	_bytesSendToClient += bytesSent;
+	_responseBytesSent += bytesSent;
+	Metrics::getInstance().bytesSent(bytesSent);
+	_lastActivity = std::chrono::steady_clock::now();
 	return true;
 }
 
-std::optional<size_t> ClientConnection::_findHeaderEnd(const std::vector<char>& buffer) {
+std::optional<size_t> ClientConnection::findHeaderEnd(const std::vector<char>& buffer) {
 	const std::string pattern = "\r\n\r\n";
 	if (const auto position = std::search(buffer.begin(), buffer.end(), pattern.begin(), pattern.end());
 		position != buffer.end()) {
@@ -533,6 +720,109 @@ std::optional<size_t> ClientConnection::_findHeaderEnd(const std::vector<char>&
 
 bool ClientConnection::isDisconnected() const { return _disconnected; }
 
+/**
+ * @brief Graceful shutdown: the next response sent on the connection closes it
+ */
+void ClientConnection::drain() { _draining = true; }
+
+/**
+ * @brief While draining: idle long enough to be closed. A busy client gets to send its next request and is
+ * answered with `Connection: close`, instead of racing the close with that request.
+ */
+bool ClientConnection::isDrained() const {
+	return isWaiting() &&
+		   std::chrono::steady_clock::now() - _lastActivity >= std::chrono::milliseconds(DRAIN_IDLE_TIMEOUT_MS);
+}
+
+/**
+ * @brief Idle keep-alive connection: waiting for the first byte of the next request
+ */
+bool ClientConnection::isWaiting() const { return _status == Status::HEADER && _headerBuffer.empty(); }
+
+/**
+ * @brief A response is being prepared or sent, the connection waits for POLLOUT instead of POLLIN
+ */
+bool ClientConnection::isWriting() const {
+	return _status == Status::READY_TO_SEND || _status == Status::SENDING_RESPONSE;
+}
+
+/**
+ * @brief The header of the next request arrived with the previous one and is buffered already, there will be no
+ * POLLIN for it
+ */
+bool ClientConnection::hasBufferedRequest() const {
+	return _status == Status::HEADER && !_headerBuffer.empty() && findHeaderEnd(_headerBuffer);
+}
+
+/**
+ * @brief Fill in a row of the connection table
+ */
+void ClientConnection::describe(ConnectionTable::Row& row) const {
+	const auto now = std::chrono::steady_clock::now();
+	row.fd = _clientFd;
+	row.peer = std::string(my_inet_ntoa(_clientAddr.sin_addr)) + ":" + std::to_string(ntohs(_clientAddr.sin_port));
+	row.status = statusToString(_status);
+	row.headerBuffered = _headerBuffer.size();
+	row.bodyBuffered = _bodyBuffer.size();
+	row.bytesSent = _responseBytesSent;
+	// Between requests `_request` still holds the previous one
+	if (_status != Status::HEADER)
+		row.requestLine = _request.getMethod() + " " + _request.getRawRequestUri() + " " + _request.getHttpVersion();
+	row.age = std::chrono::duration_cast<std::chrono::milliseconds>(now - _acceptedAt);
+	row.idle = std::chrono::duration_cast<std::chrono::milliseconds>(now - _lastActivity);
+	row.cgiPid = _requestHandler.getCgiPid();
+	row.cgiState = cgiStateToString(_requestHandler.getCgiState());
+}
+
+/**
+ * @brief Account for the completely sent response: access log, metrics and slow log. Starts the timing of
+ * the next request on the connection.
+ */
+void ClientConnection::_finishRequest() {
+	const RequestTiming::Clock::time_point now = RequestTiming::Clock::now();
+	_timing.mark(RequestTiming::LAST_BYTE, now);
+	if (!_timing.has(RequestTiming::FIRST_BYTE))
+		_timing.mark(RequestTiming::FIRST_BYTE, _timing.marks[RequestTiming::ACCEPTED]);
+
+	const ServerConfig& config = _requestHandler.getConfig();
+	Metrics::getInstance().recordRequest(config.getHostIP(), config.getPort(), _routePath, _response.getStatus(),
+										 _timing.total());
+	Metrics::getInstance().recordPhases(_timing);
+
+	const AccessLogConfig& accessLog = config.getAccessLog();
+	const SlowLogConfig& slowLog = config.getSlowLog();
+	const bool isSlow = !slowLog.path.empty() && _timing.total() >= std::chrono::milliseconds(slowLog.threshold);
+	if (!accessLog.path.empty() || isSlow) {
+		const AccessLog::Entry entry = _accessLogEntry();
+		if (!accessLog.path.empty())
+			AccessLog::getInstance().write(accessLog, entry);
+		if (isSlow)
+			AccessLog::getInstance().writeSlow(slowLog, entry, _timing);
+	}
+
+	TrafficCapture::getInstance().responded(
+		_captureId, _response.getStatus(), _request.getMethodType() == Http::Method::HEAD,
+		_responseBytesSent > _responseHeaderSize ? _responseBytesSent - _responseHeaderSize : 0);
+
+	_routePath.clear();
+	_timing.reset(now);
+}
+
+AccessLog::Entry ClientConnection::_accessLogEntry() const {
+	AccessLog::Entry entry;
+	entry.clientAddress = my_inet_ntoa(_clientAddr.sin_addr);
+	entry.method = _request.getMethod();
+	entry.uri = _request.getRawRequestUri();
+	entry.version = _request.getHttpVersion();
+	entry.host = _request.getHeader("Host");
+	entry.referer = _request.getHeader("Referer");
+	entry.userAgent = _request.getHeader("User-Agent");
+	entry.status = _response.getStatus();
+	entry.bodyBytes = _responseBytesSent > _responseHeaderSize ? _responseBytesSent - _responseHeaderSize : 0;
+	entry.duration = _timing.total();
+	return entry;
+}
+
 void ClientConnection::_logHeader() const {
 	LOG_TRACE(_log("Request recieved:\n====================\n" + toString(_request) + "\n===================="));
 }
@@ -0,0 +1,58 @@
+#include "ErrorPages.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "Logger.hpp"
+
+/**
+ * @brief Read the `error_page` files, relative to the root of the server, and render the built-in page of every
+ * other known status. A page that cannot be read is reported once and the built-in page is used instead.
+ */
+ErrorPages::ErrorPages(const std::map<int, std::string>& pages, const std::string& root) {
+	for (const auto& [code, page] : pages) {
+		const std::string path = "." + root + "/" + page;
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open()) {
+			LOG_WARN("Failed to open error page " + path + ": " + std::string(strerror(errno)));
+			continue;
+		}
+		std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if (content.empty())
+			continue;
+		_pages.emplace(code, std::make_shared<const std::string>(std::move(content)));
+	}
+	for (int status = 100; status < 600; ++status) {
+		if (Http::reasonPhrase(status) != "Unknown" && _pages.count(status) == 0)
+			_pages.emplace(status, std::make_shared<const std::string>(render(static_cast<Http::Status>(status))));
+	}
+}
+
+/**
+ * @brief Body for an error response: the `error_page` of the server, otherwise the built-in page. nullptr for
+ * codes without a reason phrase, `render` builds those.
+ */
+ErrorPages::Page ErrorPages::find(const Http::Status code) const {
+	const auto it = _pages.find(code);
+	return it == _pages.end() ? nullptr : it->second;
+}
+
+/**
+ * @brief Built-in page of any status
+ */
+std::string ErrorPages::render(const Http::Status code) {
+	const std::string status = std::to_string(code);
+	std::string body = "<html><head><title>" + status + "</title><meta charset=\"utf-8\">";
+	body += R"(<meta name="viewport" content="width=device-width, initial-scale=1">)";
+	body += "</head><body><h1>Error " + status + ": ";
+	body += Http::reasonPhrase(code);
+	body += "</h1><img src=\"https://httpgoats.com/" + status + R"(.jpg" alt="Goat">)";
+	body += "</body><style>*{font-family:Arial,sans-serif;--background:#f2f2f2;--color:#030303;}";
+	body += "@media (prefers-color-scheme: dark){*{--background:#030303;--color:#f2f2f2;}}";
+	body += "body{display:flex;justify-content:center;align-items:center;height:100vh;margin:0;";
+	body += "flex-direction:column;background:var(--background);color:var(--color);}";
+	body += "h1{font-size:clamp(2rem,5vw,3rem);}";
+	body += "img{width:100%;max-width:500px;}</style></html>";
+	return body;
+}
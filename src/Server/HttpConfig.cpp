@@ -0,0 +1,48 @@
+#include "HttpConfig.hpp"
+
+#include <iomanip>
+
+// Getters
+size_t HttpConfig::getCgiMaxProcesses() const { return _cgiMaxProcesses; }
+
+size_t HttpConfig::getCgiQueueSize() const { return _cgiQueueSize; }
+
+size_t HttpConfig::getCgiQueueTimeout() const { return _cgiQueueTimeout; }
+
+const std::vector<UpstreamConfig>& HttpConfig::getUpstreams() const { return _upstreams; }
+
+bool HttpConfig::getLogAsync() const { return _logAsync; }
+
+LogLevel HttpConfig::getLogLevel() const { return _logLevel; }
+
+const TrafficCaptureConfig& HttpConfig::getTrafficCapture() const { return _trafficCapture; }
+
+// Setters
+void HttpConfig::setCgiMaxProcesses(const size_t max) { _cgiMaxProcesses = max; }
+
+void HttpConfig::setCgiQueueSize(const size_t size) { _cgiQueueSize = size; }
+
+void HttpConfig::setCgiQueueTimeout(const size_t timeout) { _cgiQueueTimeout = timeout; }
+
+void HttpConfig::addUpstream(const UpstreamConfig& upstream) { _upstreams.push_back(upstream); }
+
+void HttpConfig::setLogAsync(const bool async) { _logAsync = async; }
+
+void HttpConfig::setLogLevel(const LogLevel level) { _logLevel = level; }
+
+void HttpConfig::setTrafficCapture(const TrafficCaptureConfig& capture) { _trafficCapture = capture; }
+
+// Overload "<<" operator
+std::ostream& operator<<(std::ostream& os, const HttpConfig& config) {
+	os << "http\n";
+	os << std::left << std::setw(32) << "  |- cgi max processes: "
+	   << (config.getCgiMaxProcesses() ? std::to_string(config.getCgiMaxProcesses()) : "unlimited") << "\n";
+	os << std::left << std::setw(32) << "  |- cgi queue size: " << config.getCgiQueueSize() << "\n";
+	os << std::left << std::setw(32) << "  |- cgi queue timeout: " << config.getCgiQueueTimeout() << " ms\n";
+	os << std::left << std::setw(32) << "  |- log level: " << config.getLogLevel() << "\n";
+	os << std::left << std::setw(32) << "  |- log async: " << (config.getLogAsync() ? "on" : "off") << "\n";
+	os << std::left << std::setw(32) << "  |- traffic capture: "
+	   << (config.getTrafficCapture().path.empty() ? "off" : config.getTrafficCapture().path) << "\n";
+	for (const auto& upstream : config.getUpstreams()) os << upstream;
+	return os;
+}
@@ -1,28 +1,73 @@
 #include "MultiSocketWebserver.hpp"
 
 #include <sys/poll.h>
+#include <fcntl.h>
 #include <sys/sysctl.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <cstring>
 #include <random>
 
+#include "AccessLog.hpp"
+#include "CgiCache.hpp"
+#include "CgiLimiter.hpp"
 #include "ClientConnection.hpp"
 #include "Logger.hpp"
+#include "Metrics.hpp"
 #include "PollFdManager.hpp"
 #include "Socket.hpp"
+#include "TrafficCapture.hpp"
 #include "globals.hpp"
+#include "webserv.hpp"
+
+extern char** environ;
+
+std::atomic<bool> MultiSocketWebserver::_reloadRequested(false);
+std::atomic<bool> MultiSocketWebserver::_upgradeRequested(false);
+std::atomic<bool> MultiSocketWebserver::_drainRequested(false);
 
 MultiSocketWebserver::MultiSocketWebserver(std::vector<std::vector<ServerConfig>> servers_config)
 	: _polls(PollFdManager::getInstance()) {
 	_server_configs_vector = std::move(servers_config);
+	Metrics::getInstance().setConnectionCollector([this] {
+		Metrics::ConnectionCounts counts;
+		for (const auto& [fd, client] : _clients) {
+			counts.active++;
+			if (client->getStatus() == ClientConnection::Status::READY_TO_SEND ||
+				client->getStatus() == ClientConnection::Status::SENDING_RESPONSE)
+				counts.writing++;
+			else if (client->isWaiting())
+				counts.waiting++;
+			else
+				counts.reading++;
+		}
+		return counts;
+	});
+	ConnectionTable::getInstance().setSource(
+		[this] {
+			std::vector<int> fds;
+			fds.reserve(_clients.size());
+			for (const auto& [fd, client] : _clients) fds.push_back(fd);
+			return fds;
+		},
+		[this](const int fd, ConnectionTable::Row& row) {
+			const auto it = _clients.find(fd);
+			if (it == _clients.end())
+				return false;
+			it->second->describe(row);
+			return true;
+		});
 }
 
 void MultiSocketWebserver::initSockets() {
 	_sockets.reserve(_server_configs_vector.size());
 	for (const std::vector<ServerConfig>& serv : _server_configs_vector) {
 		try {
-			auto newSocket = std::make_unique<Socket>(serv);
+			auto newSocket = std::make_unique<Socket>(std::make_shared<const VirtualHosts>(serv));
 			int socketFd = newSocket->getSocketFd();
 			_sockets.emplace(socketFd, std::move(newSocket));
 			_polls.addFd(socketFd);
@@ -36,43 +81,102 @@ void MultiSocketWebserver::initSockets() {
 	}
 }
 
+void MultiSocketWebserver::setConfigLoader(ConfigLoader loader) { _configLoader = std::move(loader); }
+
+/**
+ * @brief SIGHUP reloads the configuration. Only sets a flag, safe to call from a signal handler.
+ */
+void MultiSocketWebserver::requestReload() { _reloadRequested = true; }
+
+void MultiSocketWebserver::setUpgradeCommand(std::vector<std::string> argv) { _upgradeCommand = std::move(argv); }
+
+/**
+ * @brief SIGALRM starts a new binary that takes over the listening sockets. Safe to call from a signal handler.
+ */
+void MultiSocketWebserver::requestUpgrade() { _upgradeRequested = true; }
+
+/**
+ * @brief SIGQUIT stops accepting and exits once the open connections are done. Safe to call from a signal handler.
+ */
+void MultiSocketWebserver::requestDrain() { _drainRequested = true; }
+
 MultiSocketWebserver::~MultiSocketWebserver() {
-	for (const auto& [fd, _] : _sockets) {
-		if (fd != -1) {
-			close(fd);
-		}
-	}
+	Metrics::getInstance().setConnectionCollector(nullptr);
+	ConnectionTable::getInstance().setSource(nullptr, nullptr);
 	_sockets.clear();
-
-	for (const auto& [fd, _] : _clients) {
-		if (fd != -1) {
-			close(fd);
-		}
-	}
 	_clients.clear();
 }
 
 void MultiSocketWebserver::run() {
 	while (stopServer == false) {
-		if (const int eventCount = poll(_polls.data(), _polls.size(), 5000); eventCount == -1 && !stopServer) {
-			LOG_ERROR("Poll failed: " + std::string(strerror(errno)));
+		_resumeWokenWaits();
+		if (_reloadRequested.exchange(false) && !_draining)
+			_reload();
+		if (_upgradeRequested.exchange(false) && !_draining)
+			_upgrade();
+		if (_upgradePid > 0)
+			_checkUpgrade();
+		if (_drainRequested.exchange(false) && !_draining)
+			_startDrain();
+		if (_draining && _closeIdleClients() == 0) {
+			LOG_INFO("All connections are done, exiting");
 			break;
 		}
+		if (ConnectionTable::takeDumpRequest() && !_connectionDump)
+			_connectionDump = ConnectionTable::getInstance().stream(false);
+		if (_connectionDump)
+			_continueConnectionDump();
+
+		// Wake up in time to flush the log and capture buffers, do not wait at all while a dump is in progress
+		int timeout = DEFAULT_POLL_TIMEOUT;
+		for (const int nextFlush : {AccessLog::getInstance().tick(), TrafficCapture::getInstance().tick()}) {
+			if (nextFlush != -1)
+				timeout = std::min(timeout, nextFlush);
+		}
+		if (_draining)
+			timeout = std::min(timeout, DRAIN_IDLE_TIMEOUT_MS);
+		if (_connectionDump)
+			timeout = 0;
+		if (const int eventCount = poll(_polls.data(), _polls.size(), _waitTimeout(timeout)); eventCount == -1) {
+			// Signals that do not stop the server (e.g. log level changes) interrupt the wait as well
+			if (errno == EINTR)
+				continue;
+			if (!stopServer) {
+				LOG_ERROR("Poll failed: " + std::string(strerror(errno)));
+				break;
+			}
+		}
+		Metrics::getInstance().loopWakeup();
 
 		for (auto& [fd, events, revents] : _polls.getPolls()) {
 			if (stopServer) {
 				break;
 			}
 			// Check if there are any events to process
+			if (revents == 0) {
+				continue;
+			}
+			// A CGI pipe or upstream connection a response waits for, POLLHUP included: the handler finds out
+			if (const auto wait = _waitFds.find(fd); wait != _waitFds.end()) {
+				_resumeClient(wait->second);
+				continue;
+			}
+			// Forgotten by an earlier handler of this iteration, e.g. the CGI pipe of a closed connection
+			if (!isServerFd(fd) && _clients.find(fd) == _clients.end()) {
+				continue;
+			}
 			if (revents & POLLIN) {
 				if (isServerFd(fd)) {
 					_acceptConnection(fd);
-				} else {
-					_handleClientData(fd);
+				} else if (!_handleClientData(fd)) {
+					continue;  // closed, the descriptor may already belong to a connection accepted meanwhile
 				}
 			}
-			if (revents & POLLOUT) {
-				_handleClientWrite(fd);
+			if ((revents & POLLOUT) && !_handleClientWrite(fd)) {
+				continue;
+			}
+			if (!isServerFd(fd) && !(revents & (POLLERR | POLLHUP | POLLNVAL | POLLPRI))) {
+				_updateEvents(fd, events);
 			}
 			if (revents & (POLLERR | POLLHUP | POLLNVAL | POLLPRI)) {
 				if (revents & POLLHUP) {
@@ -80,17 +184,16 @@ void MultiSocketWebserver::run() {
 				} else {
 					LOG_ERROR("Error on socket " + std::to_string(fd));
 				}
+				// The Socket and the ClientConnection close their descriptor themselves
 				if (isServerFd(fd)) {
 					_sockets.erase(fd);
+					_polls.removeFd(fd);
 				} else {
-					_clients.erase(fd);
-				}
-				if (fd != -1) {
-					close(fd);
+					_closeClient(fd);
 				}
-				_polls.removeFd(fd);
 			}
 		}
+		_resumeExpiredWaits();
 	}
 }
 
@@ -104,13 +207,14 @@ void MultiSocketWebserver::_acceptConnection(const int server_fd) {
 		return;
 	}
 
-	auto server_configs = _sockets.at(server_fd)->getConfig();
+	const std::shared_ptr<ListenerConfig>& listener = _sockets.at(server_fd)->getListener();
 
 	_setSocketTimeouts(clientFd, 5);
 
 	try {
-		_clients.emplace(clientFd, std::make_unique<ClientConnection>(clientFd, clientAddr, server_configs));
+		_clients.emplace(clientFd, std::make_unique<ClientConnection>(clientFd, clientAddr, listener));
 		_polls.addFd(clientFd);
+		Metrics::getInstance().connectionAccepted();
 		LOG_INFO("Accepted connection from " + std::string(my_inet_ntoa(clientAddr.sin_addr)) + " on socket " +
 				 std::to_string(clientFd));
 	} catch (const std::exception& e) {
@@ -119,6 +223,10 @@ void MultiSocketWebserver::_acceptConnection(const int server_fd) {
 	}
 }
 
+/**
+ * @brief Read what the client sent, a request read completely is answered right away
+ * @return false if the connection is closed
+ */
 bool MultiSocketWebserver::_handleClientData(const int client_fd) {
 	auto it = _clients.find(client_fd);
 	if (it == _clients.end()) {
@@ -127,23 +235,31 @@ bool MultiSocketWebserver::_handleClientData(const int client_fd) {
 	}
 
 	ClientConnection& client = *it->second;
-	if (client.getStatus() == ClientConnection::Status::READY_TO_SEND) {
-		return false;
+	if (client.isWriting()) {
+		return true;
 	}
 	client.handleClient();
 
 	if (client.isDisconnected()) {
-		_clients.erase(client_fd);
-		_polls.removeFd(client_fd);
+		_closeClient(client_fd);
 		LOG_DEBUG("Client disconnected from socket " + std::to_string(client_fd) + " after read");
-		return true;
+		return false;
 	}
 
+	// The socket is writable in all likelihood, waiting for POLLOUT would cost another wakeup
+	if (client.isWriting()) {
+		return _handleClientWrite(client_fd);
+	}
 	return true;
 }
 
 bool MultiSocketWebserver::isServerFd(int fd) const { return _sockets.find(fd) != _sockets.end(); }
 
+/**
+ * @brief Send the response, then answer the requests the client pipelined behind it, up to
+ * CLIENT_PIPELINE_BUDGET per wakeup
+ * @return false if the connection is closed
+ */
 bool MultiSocketWebserver::_handleClientWrite(int fd) {
 	auto it = _clients.find(fd);
 	if (it == _clients.end()) {
@@ -152,21 +268,282 @@ bool MultiSocketWebserver::_handleClientWrite(int fd) {
 	}
 
 	ClientConnection& client = *it->second;
-	if (client.getStatus() != ClientConnection::Status::READY_TO_SEND &&
-		client.getStatus() != ClientConnection::Status::SENDING_RESPONSE) {
-		return false;
+	for (int requests = 0; requests < CLIENT_PIPELINE_BUDGET; ++requests) {
+		if (client.hasBufferedRequest())
+			client.handleClient();
+		if (!client.isDisconnected() && client.isWriting())
+			client.sendResponse();
+		if (client.isDisconnected()) {
+			_closeClient(fd);
+			LOG_DEBUG("Client disconnected from socket " + std::to_string(fd) + " after write");
+			return false;
+		}
+		if (!client.hasBufferedRequest())
+			break;
 	}
 
-	client.sendResponse();
+	return true;
+}
 
-	if (client.isDisconnected()) {
-		_clients.erase(fd);
+/**
+ * @brief Wait for POLLOUT while there is a response to send and for POLLIN otherwise: idle connections do not wake
+ * up the event loop. A pipelined request left over by the pipeline budget is answered on the next POLLOUT. While
+ * the response waits for a CGI or an upstream, the connection only reports errors and what it waits for is polled.
+ * @param events what the connection waits for now
+ */
+void MultiSocketWebserver::_updateEvents(const int fd, const short events) {
+	const auto it = _clients.find(fd);
+	if (it == _clients.end())
+		return;
+	const ClientConnection& client = *it->second;
+	const std::optional<IoWait> wait = client.getWait();
+	_setWait(fd, wait);
+	short wanted = POLLIN;
+	if (wait)
+		wanted = 0;
+	else if (client.isWriting() || client.hasBufferedRequest())
+		wanted = POLLOUT;
+	if (wanted != events)
+		_polls.setEvents(fd, wanted);
+}
+
+/**
+ * @brief Register what the response of a connection waits for, or forget it (std::nullopt)
+ */
+void MultiSocketWebserver::_setWait(const int clientFd, const std::optional<IoWait>& wait) {
+	const auto it = _waits.find(clientFd);
+	const int previousFd = it != _waits.end() ? it->second.fd : -1;
+	const int fd = wait ? wait->fd : -1;
+	if (previousFd != -1 && previousFd != fd) {
+		_polls.removeFd(previousFd);
+		_waitFds.erase(previousFd);
+	}
+	if (fd != -1 && fd == previousFd) {
+		if (wait->events != it->second.events)
+			_polls.setEvents(fd, wait->events);
+	} else if (fd != -1) {
+		_polls.addFd(fd, wait->events);
+		_waitFds[fd] = clientFd;
+	}
+	if (wait)
+		_waits[clientFd] = *wait;
+	else if (it != _waits.end())
+		_waits.erase(it);
+}
+
+/**
+ * @brief Go on with a response whose wait is over
+ */
+void MultiSocketWebserver::_resumeClient(const int clientFd) {
+	if (_clients.find(clientFd) == _clients.end())
+		return;
+	_handleClientWrite(clientFd);
+	_updateEvents(clientFd, 0);	 // a waiting connection polls for no events
+}
+
+void MultiSocketWebserver::_resumeExpiredWaits() {
+	const IoWait::Clock::time_point now = IoWait::Clock::now();
+	std::vector<int> expired;
+	for (const auto& [fd, wait] : _waits) {
+		if (wait.deadline <= now)
+			expired.push_back(fd);
+	}
+	for (const int fd : expired) _resumeClient(fd);
+}
+
+/**
+ * @brief Go on with the responses other requests woke up: queued CGI requests a slot was released for, and
+ * requests that waited for a CGI cache entry to be filled
+ */
+void MultiSocketWebserver::_resumeWokenWaits() {
+	while (true) {
+		std::vector<int> woken = CgiLimiter::getInstance().takeReady();
+		for (const int fd : CgiCache::getInstance().takeReady()) woken.push_back(fd);
+		if (woken.empty())
+			break;
+		for (const int fd : woken) _resumeClient(fd);
+	}
+}
+
+/**
+ * @brief Shorten the poll timeout to the nearest deadline of a waiting response
+ */
+int MultiSocketWebserver::_waitTimeout(int timeout) const {
+	const IoWait::Clock::time_point now = IoWait::Clock::now();
+	for (const auto& [fd, wait] : _waits) {
+		const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(wait.deadline - now).count();
+		timeout = static_cast<int>(std::clamp<decltype(remaining)>(remaining, 0, timeout));
+	}
+	return timeout;
+}
+
+/**
+ * @brief Forget a connection, together with the descriptor its response waits for. The ClientConnection closes
+ * its socket, the RequestHandler its CGI pipes and upstream connection.
+ */
+void MultiSocketWebserver::_closeClient(const int fd) {
+	_setWait(fd, std::nullopt);
+	_clients.erase(fd);
+	_polls.removeFd(fd);
+}
+
+/**
+ * @brief Swap in a new configuration without dropping connections.
+ *
+ * A socket whose address is still configured keeps listening and gets the new server configs, new addresses are
+ * bound and the sockets of removed ones are closed. Connections keep the configs they use until their current
+ * request is done, then switch to the new ones (or keep the old ones if their socket was removed). If the
+ * configuration is invalid or a new address cannot be bound, the running configuration stays active.
+ */
+void MultiSocketWebserver::_reload() {
+	if (!_configLoader)
+		return;
+	LOG_INFO("Reloading configuration...");
+	std::optional<LoadedConfig> loaded = _configLoader();
+	if (!loaded) {
+		LOG_ERROR("Reload failed, keeping the current configuration");
+		return;
+	}
+
+	std::unordered_map<std::string, int> current;
+	for (const auto& [fd, socket] : _sockets) current.emplace(socket->getAddress(), fd);
+
+	// Bind all new addresses before changing anything, so a failure leaves the running configuration untouched
+	std::vector<std::pair<int, ServerConfigSnapshot>> kept;
+	std::vector<std::unique_ptr<Socket>> added;
+	for (const std::vector<ServerConfig>& servers : loaded->servers) {
+		auto snapshot = std::make_shared<const VirtualHosts>(servers);
+		const auto it = current.find(servers.front().getHostIP() + ":" + std::to_string(servers.front().getPort()));
+		if (it != current.end()) {
+			kept.emplace_back(it->second, std::move(snapshot));
+			current.erase(it);
+			continue;
+		}
+		try {
+			added.push_back(std::make_unique<Socket>(std::move(snapshot)));
+		} catch (const std::exception& e) {
+			LOG_ERROR("Reload failed, keeping the current configuration: " + std::string(e.what()));
+			return;
+		}
+	}
+
+	for (auto& [fd, snapshot] : kept) _sockets.at(fd)->setConfig(std::move(snapshot));
+	for (auto& socket : added) {
+		const int fd = socket->getSocketFd();
+		_sockets.emplace(fd, std::move(socket));
+		_polls.addFd(fd);
+	}
+	// What is left in `current` is no longer configured, connections accepted on it stay open
+	for (const auto& [address, fd] : current) {
+		LOG_INFO("Closing socket on " + address + ", it was removed from the configuration");
 		_polls.removeFd(fd);
-		LOG_DEBUG("Client disconnected from socket " + std::to_string(fd) + " after write");
-		return false;
+		_sockets.erase(fd);
 	}
+	_server_configs_vector = std::move(loaded->servers);
+	if (loaded->applyHttp)
+		loaded->applyHttp();
+	LOG_INFO("Configuration reloaded: " + std::to_string(kept.size()) + " sockets kept, " +
+			 std::to_string(added.size()) + " added, " + std::to_string(current.size()) + " closed");
+}
 
-	return true;
+/**
+ * @brief Start the binary at the path this process was started with, with the same arguments, and pass it the
+ * listening sockets. Once it listens on them it sends SIGQUIT, and this process drains its connections. If it
+ * exits before that (e.g. its configuration is invalid), this process keeps serving.
+ */
+void MultiSocketWebserver::_upgrade() {
+	if (_upgradePid > 0) {
+		LOG_WARN("Binary upgrade already in progress (pid " + std::to_string(_upgradePid) + ")");
+		return;
+	}
+	if (_upgradeCommand.empty())
+		return;
+
+	// Everything the child needs is built before fork, the logger thread may hold locks the child would wait for
+	std::string listenFds = std::string(Socket::INHERITED_ENV) + "=";
+	std::vector<int> fds;
+	for (const auto& [fd, socket] : _sockets) {
+		listenFds += std::to_string(fd) + "=" + socket->getAddress() + ";";
+		fds.push_back(fd);
+	}
+	std::vector<char*> envp;
+	const size_t nameLength = std::strlen(Socket::INHERITED_ENV);
+	for (char** var = environ; *var != nullptr; ++var) {
+		if (std::strncmp(*var, Socket::INHERITED_ENV, nameLength) != 0 || (*var)[nameLength] != '=')
+			envp.push_back(*var);
+	}
+	envp.push_back(listenFds.data());
+	envp.push_back(nullptr);
+	std::vector<char*> argv;
+	for (std::string& arg : _upgradeCommand) argv.push_back(arg.data());
+	argv.push_back(nullptr);
+
+	const pid_t pid = fork();
+	if (pid == -1) {
+		LOG_ERROR("Binary upgrade failed: fork: " + std::string(strerror(errno)));
+		return;
+	}
+	if (pid == 0) {
+		for (const int fd : fds) fcntl(fd, F_SETFD, 0);
+		execve(argv[0], argv.data(), envp.data());
+		_exit(127);
+	}
+	_upgradePid = pid;
+	LOG_INFO("Binary upgrade: started " + _upgradeCommand.front() + " (pid " + std::to_string(pid) + ")");
+}
+
+/**
+ * @brief Reap the new binary if it exited. Before it took over (SIGQUIT), the upgrade failed.
+ */
+void MultiSocketWebserver::_checkUpgrade() {
+	int status = 0;
+	if (waitpid(_upgradePid, &status, WNOHANG) != _upgradePid)
+		return;
+	if (!_draining)
+		LOG_ERROR("Binary upgrade failed: pid " + std::to_string(_upgradePid) + " exited with status " +
+				  std::to_string(WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status)) +
+				  ", keeping this process");
+	_upgradePid = 0;
+}
+
+/**
+ * @brief Graceful shutdown: close the listening sockets and let every connection finish its current request
+ */
+void MultiSocketWebserver::_startDrain() {
+	LOG_INFO("Stopped accepting, draining " + std::to_string(_clients.size()) + " connections");
+	_draining = true;
+	for (const auto& [fd, socket] : _sockets) _polls.removeFd(fd);
+	_sockets.clear();
+	for (const auto& [fd, client] : _clients) client->drain();
+}
+
+/**
+ * @brief While draining, close the connections that are idle
+ * @return number of connections that are still open
+ */
+size_t MultiSocketWebserver::_closeIdleClients() {
+	std::vector<int> idle;
+	for (const auto& [fd, client] : _clients) {
+		if (client->isDrained())
+			idle.push_back(fd);
+	}
+	for (const int fd : idle) _closeClient(fd);
+	return _clients.size();
+}
+
+/**
+ * @brief Log the next batch of rows of the connection table requested with SIGUSR2
+ */
+void MultiSocketWebserver::_continueConnectionDump() {
+	std::string rows;
+	if (_connectionDump->read(rows, CONNECTION_TABLE_BATCH_BYTES) != BodyStream::Status::DATA) {
+		_connectionDump.reset();
+		return;
+	}
+	if (!rows.empty()) {
+		rows.pop_back();  // the logger adds the line break
+		LOG_WARN("Connection table:\n" + rows);
+	}
 }
 
 void MultiSocketWebserver::_setSocketTimeouts(const int socketFd, const size_t timeoutSec) {
@@ -9,7 +9,16 @@ PollFdManager& PollFdManager::getInstance() {
 	return instance;
 }
 
-void PollFdManager::addFd(const int fd) { _pollFds.push_back({fd, static_cast<short>(POLLIN | POLLOUT), 0}); }
+void PollFdManager::addFd(const int fd, const short events) { _pollFds.push_back({fd, events, 0}); }
+
+/**
+ * @brief Change what poll waits for on a descriptor
+ */
+void PollFdManager::setEvents(const int fd, const short events) {
+	const auto it = std::find_if(_pollFds.begin(), _pollFds.end(), [fd](const pollfd& pfd) { return pfd.fd == fd; });
+	if (it != _pollFds.end())
+		it->events = events;
+}
 
 void PollFdManager::removeFd(int fd) {
 	_pollFds.erase(std::remove_if(_pollFds.begin(), _pollFds.end(), [fd](const pollfd& pfd) { return pfd.fd == fd; }),
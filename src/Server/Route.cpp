@@ -12,15 +12,21 @@
 
 #include "Route.hpp"
 
+#include <algorithm>
+
 // Constructor
 Route::Route() : _autoindex(false), _code(0) {}
 
 // Getters
 const std::string& Route::getPath() const { return _path; }
 
+Route::Match Route::getMatch() const { return _match; }
+
 const std::string& Route::getAlias() const { return _alias; }
 
-const std::vector<std::string>& Route::getMethods() const { return _methods; }
+Http::MethodMask Route::getMethods() const { return _methods; }
+
+bool Route::isMethodAllowed(const Http::Method method) const { return (_methods & Http::methodBit(method)) != 0; }
 
 const std::string& Route::getRoot() const { return _root; }
 
@@ -28,9 +34,48 @@ const std::string& Route::getIndex() const { return _index; }
 
 bool Route::isAutoindex() const { return _autoindex; }
 
+Route::AutoindexFormat Route::getAutoindexFormat() const { return _autoindexFormat; }
+
 const std::string& Route::getUploadDir() const { return _uploadDir; }
 
-const std::map<std::string, std::string>& Route::getCgiHandlers() const { return _cgiHandlers; }
+const Route::CgiHandlers& Route::getCgiHandlers() const { return _cgiHandlers; }
+
+const MimeTypeOverrides& Route::getTypes() const { return _types; }
+
+std::string_view Route::getMimeType(const std::string_view fileName) const { return ::getMimeType(fileName, _types); }
+
+/**
+ * @brief Pre-rendered `add_header` lines for a response status. Like nginx, headers without `always` are only
+ * added to 200, 201, 204, 206, 301, 302, 303, 304, 307 and 308 responses.
+ */
+std::string_view Route::getHeaderBlock(const int status) const {
+	switch (status) {
+		case 200:
+		case 201:
+		case 204:
+		case 206:
+		case 301:
+		case 302:
+		case 303:
+		case 304:
+		case 307:
+		case 308:
+			return _headerBlock;
+		default:
+			return _alwaysHeaderBlock;
+	}
+}
+
+/**
+ * @brief CGI executable for a file extension, nullptr if the route does not run the extension as a CGI
+ */
+const std::string* Route::getCgiHandler(const std::string_view extension) const {
+	for (const auto& [handlerExtension, executable] : _cgiHandlers) {
+		if (handlerExtension == extension)
+			return executable.empty() ? nullptr : &executable;
+	}
+	return nullptr;
+}
 
 int Route::getCode() const { return _code; }
 
@@ -42,12 +87,32 @@ size_t Route::getClientBodyBufferSize() const { return _clientBodyBufferSize; }
 
 size_t Route::getClientHeaderBufferSize() const { return _clientHeaderBufferSize; }
 
+size_t Route::getCgiMaxProcesses() const { return _cgiMaxProcesses; }
+
+size_t Route::getCgiCacheTtl() const { return _cgiCacheTtl; }
+
+const std::vector<std::string>& Route::getCgiCacheKeyHeaders() const { return _cgiCacheKeyHeaders; }
+
+int Route::getCgiCacheUseStale() const { return _cgiCacheUseStale; }
+
+const std::string& Route::getProxyPass() const { return _proxyPass; }
+
+const std::string& Route::getProxyPassUri() const { return _proxyPassUri; }
+
+size_t Route::getProxyTimeout() const { return _proxyTimeout; }
+
+bool Route::isMetrics() const { return _metrics; }
+
+bool Route::isConnectionTable() const { return _connectionTable; }
+
 // Setters
 void Route::setPath(const std::string& path) { _path = path; }
 
+void Route::setMatch(const Match match) { _match = match; }
+
 void Route::setAlias(const std::string& alias) { _alias = alias; }
 
-void Route::setMethods(const std::vector<std::string>& methods) { _methods = methods; }
+void Route::setMethods(const Http::MethodMask methods) { _methods = methods; }
 
 void Route::setRoot(const std::string& root) { _root = root; }
 
@@ -55,9 +120,43 @@ void Route::setIndex(const std::string& index) { _index = index; }
 
 void Route::setAutoindex(bool autoindex) { _autoindex = autoindex; }
 
+void Route::setAutoindexFormat(const AutoindexFormat format) { _autoindexFormat = format; }
+
 void Route::setUploadDir(const std::string& dir) { _uploadDir = dir; }
 
-void Route::setCgiHandlers(const std::map<std::string, std::string>& handlers) { _cgiHandlers = handlers; }
+/**
+ * @brief Type for an extension from a `types` block. A later block of the location overrides an earlier one.
+ */
+void Route::addType(const std::string& extension, const std::string& type) {
+	for (auto& [typeExtension, typeName] : _types) {
+		if (typeExtension == extension) {
+			typeName = type;
+			return;
+		}
+	}
+	_types.emplace_back(extension, type);
+}
+
+/**
+ * @brief Render an `add_header` line into the blocks copied into every response of the location
+ */
+void Route::addHeader(const std::string& name, const std::string& value, const bool always) {
+	const std::string line = name + ": " + value + "\r\n";
+	_headerBlock += line;
+	if (always)
+		_alwaysHeaderBlock += line;
+}
+
+/**
+ * @return false if the extension already has a handler, the first one is kept
+ */
+bool Route::addCgiHandler(const std::string& extension, const std::string& executable) {
+	if (std::any_of(_cgiHandlers.begin(), _cgiHandlers.end(),
+					[&extension](const auto& handler) { return handler.first == extension; }))
+		return false;
+	_cgiHandlers.emplace_back(extension, executable);
+	return true;
+}
 
 void Route::setCode(int code) { _code = code; }
 
@@ -69,16 +168,38 @@ void Route::setClientBodyBufferSize(const size_t size) { _clientBodyBufferSize =
 
 void Route::setClientHeaderBufferSize(const size_t size) { _clientHeaderBufferSize = size; }
 
+void Route::setCgiMaxProcesses(const size_t max) { _cgiMaxProcesses = max; }
+
+void Route::setCgiCacheTtl(const size_t ttl) { _cgiCacheTtl = ttl; }
+
+void Route::setCgiCacheKeyHeaders(const std::vector<std::string>& headers) { _cgiCacheKeyHeaders = headers; }
+
+void Route::setCgiCacheUseStale(const int flags) { _cgiCacheUseStale = flags; }
+
+void Route::setProxyPass(const std::string& upstream) { _proxyPass = upstream; }
+
+void Route::setProxyPassUri(const std::string& uri) { _proxyPassUri = uri; }
+
+void Route::setProxyTimeout(const size_t timeout) { _proxyTimeout = timeout; }
+
+void Route::setMetrics(const bool metrics) { _metrics = metrics; }
+
+void Route::setConnectionTable(const bool connectionTable) { _connectionTable = connectionTable; }
+
 // Overload "<<" operator
 std::ostream& operator<<(std::ostream& os, const Route& route) {
-	os << "path: " << COLOR(BLUE, route.getPath()) << "\n";
+	static const char* const modifiers[] = {"", "= ", "~ ", "~* "};
+	os << "path: " << modifiers[route.getMatch()] << COLOR(BLUE, route.getPath()) << "\n";
 
 	if (!route.getAlias().empty()) {
 		os << std::left << std::setw(24) << "      |- alias: " << route.getAlias() << "\n";
 	}
-	if (!route.getMethods().empty()) {
+	if (route.getMethods() != 0) {
 		os << std::left << std::setw(24) << "      |- methods: ";
-		for (const auto& method : route.getMethods()) os << method << " ";
+		for (size_t i = 0; i < Http::METHOD_COUNT; ++i) {
+			if (route.isMethodAllowed(static_cast<Http::Method>(i)))
+				os << Http::methodName(static_cast<Http::Method>(i)) << " ";
+		}
 		os << "\n";
 	}
 
@@ -90,6 +211,15 @@ std::ostream& operator<<(std::ostream& os, const Route& route) {
 	}
 
 	os << std::left << std::setw(24) << "      |- autoindex: " << (route.isAutoindex() ? "on" : "off") << "\n";
+	if (route.getAutoindexFormat() == Route::AUTOINDEX_JSON) {
+		os << std::left << std::setw(24) << "      |- autoindex format: " << "json" << "\n";
+	}
+	if (route.isMetrics()) {
+		os << std::left << std::setw(24) << "      |- metrics: " << "on" << "\n";
+	}
+	if (route.isConnectionTable()) {
+		os << std::left << std::setw(24) << "      |- connection table: " << "on" << "\n";
+	}
 
 	if (!route.getUploadDir().empty()) {
 		os << std::left << std::setw(24) << "      |- upload dir: " << route.getUploadDir() << "\n";
@@ -106,6 +236,46 @@ std::ostream& operator<<(std::ostream& os, const Route& route) {
 		for (const auto& handler : route.getCgiHandlers())
 			os << "        |- " << std::left << std::setw(6) << handler.first + ": " << handler.second << "\n";
 	}
+	if (!route.getTypes().empty()) {
+		os << "      |- types: \n";
+		for (const auto& [extension, type] : route.getTypes())
+			os << "        |- " << std::left << std::setw(6) << extension + ": " << type << "\n";
+	}
+	if (!route.getHeaderBlock(200).empty()) {
+		os << "      |- add_header: \n";
+		std::string_view block = route.getHeaderBlock(200);
+		for (size_t end = block.find("\r\n"); end != std::string_view::npos; end = block.find("\r\n")) {
+			os << "        |- " << block.substr(0, end) << "\n";
+			block.remove_prefix(end + 2);
+		}
+	}
+	if (route.getCgiMaxProcesses() != 0) {
+		os << std::left << std::setw(24) << "      |- cgi max processes: " << route.getCgiMaxProcesses() << "\n";
+	}
+	if (route.getCgiCacheTtl() != 0) {
+		os << std::left << std::setw(24) << "      |- cgi cache ttl: " << route.getCgiCacheTtl() << " ms\n";
+		if (!route.getCgiCacheKeyHeaders().empty()) {
+			os << std::left << std::setw(24) << "      |- cgi cache key: ";
+			for (const auto& header : route.getCgiCacheKeyHeaders()) os << header << " ";
+			os << "\n";
+		}
+		if (route.getCgiCacheUseStale() != Route::STALE_OFF) {
+			os << std::left << std::setw(24) << "      |- cgi cache stale: ";
+			if (route.getCgiCacheUseStale() & Route::STALE_UPDATING)
+				os << "updating ";
+			if (route.getCgiCacheUseStale() & Route::STALE_ERROR)
+				os << "error ";
+			if (route.getCgiCacheUseStale() & Route::STALE_TIMEOUT)
+				os << "timeout ";
+			os << "\n";
+		}
+	}
+
+	if (!route.getProxyPass().empty()) {
+		os << std::left << std::setw(24) << "      |- proxy pass: " << route.getProxyPass() << route.getProxyPassUri()
+		   << "\n";
+		os << std::left << std::setw(24) << "      |- proxy timeout: " << route.getProxyTimeout() << " ms\n";
+	}
 
 	if (route.getCode() != 0) {
 		os << std::left << std::setw(24) << "      |- code: " << RED << route.getCode() << RESET_COLOR << "\n";
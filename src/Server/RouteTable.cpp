@@ -0,0 +1,103 @@
+#include "RouteTable.hpp"
+
+#include <algorithm>
+
+namespace {
+constexpr uint32_t NO_NODE = 0;	 // the root is never a child
+}  // namespace
+
+RouteTable::RouteTable(std::vector<Route> routes) : _routes(std::move(routes)) {
+	for (const Route& route : _routes) {
+		switch (route.getMatch()) {
+			case Route::EXACT:
+				_exact.emplace(route.getPath(), &route);
+				break;
+			case Route::REGEX:
+			case Route::REGEX_CASELESS: {
+				auto flags = std::regex::ECMAScript | std::regex::optimize;
+				if (route.getMatch() == Route::REGEX_CASELESS)
+					flags |= std::regex::icase;
+				_regexes.emplace_back(std::regex(route.getPath(), flags), &route);
+				break;
+			}
+			default:
+				_insert(route.getPath(), &route);
+		}
+	}
+}
+
+/**
+ * @brief Route for a request location, see the class comment for the order
+ */
+RouteTable::Match RouteTable::find(const std::string_view location) const {
+	if (const auto it = _exact.find(location); it != _exact.end())
+		return {it->second, location.size()};
+
+	Match prefix{_nodes.front().route, 0};
+	uint32_t node = 0;
+	size_t depth = 0;
+	while (depth < location.size()) {
+		node = _child(node, location[depth]);
+		if (node == NO_NODE)
+			break;
+		const std::string& label = _nodes[node].label;
+		if (location.compare(depth, label.size(), label) != 0)
+			break;
+		depth += label.size();
+		if (_nodes[node].route)
+			prefix = {_nodes[node].route, depth};
+	}
+
+	for (const auto& [regex, route] : _regexes) {
+		if (std::regex_search(location.begin(), location.end(), regex))
+			return {route, 0};
+	}
+	return prefix;
+}
+
+const std::vector<Route>& RouteTable::routes() const { return _routes; }
+
+/**
+ * @brief Add a prefix route, splitting an edge where the path leaves it. The first route with a path wins, as it
+ * did with a linear search.
+ */
+void RouteTable::_insert(std::string_view path, const Route* route) {
+	uint32_t node = 0;
+	while (!path.empty()) {
+		const uint32_t child = _child(node, path.front());
+		if (child == NO_NODE) {
+			const auto index = static_cast<uint32_t>(_nodes.size());
+			_nodes.push_back({std::string(path), route, {}});
+			_nodes[node].children.emplace_back(path.front(), index);
+			return;
+		}
+
+		const std::string_view label = _nodes[child].label;
+		const size_t common = std::mismatch(label.begin(), label.end(), path.begin(), path.end()).first - label.begin();
+		if (common < label.size()) {
+			// The path ends or forks inside the edge: the rest of the edge becomes a node of its own
+			const auto tail = static_cast<uint32_t>(_nodes.size());
+			Node split{std::string(label.substr(common)), _nodes[child].route, std::move(_nodes[child].children)};
+			_nodes.push_back(std::move(split));
+			Node& shortened = _nodes[child];
+			shortened.label.resize(common);
+			shortened.route = nullptr;
+			shortened.children = {{_nodes[tail].label.front(), tail}};
+		}
+		node = child;
+		path.remove_prefix(common);
+	}
+	if (!_nodes[node].route)
+		_nodes[node].route = route;
+}
+
+/**
+ * @brief Child of `node` whose label starts with `first`, NO_NODE if there is none
+ */
+uint32_t RouteTable::_child(const uint32_t node, const char first) const {
+	for (const auto& [byte, child] : _nodes[node].children) {
+		if (byte == first)
+			return child;
+	}
+	return NO_NODE;
+}
@@ -17,7 +17,13 @@
 #include <vector>
 
 // Constructor
-ServerConfig::ServerConfig() : _port(80), _requestTimeout(60), _clientMaxBodySize(1048576), _host("0.0.0.0") {}
+ServerConfig::ServerConfig()
+	: _port(80),
+	  _requestTimeout(60),
+	  _clientMaxBodySize(1048576),
+	  _host("0.0.0.0"),
+	  _routes(std::make_shared<const RouteTable>()),
+	  _loadedErrorPages(std::make_shared<const ErrorPages>()) {}
 
 // Simple Getters
 int ServerConfig::getPort() const { return _port; }
@@ -38,20 +44,21 @@ const std::string& ServerConfig::getRoot() const { return _root; }
 
 const std::string& ServerConfig::getUploadDir() const { return _uploadDir; }
 
-std::vector<std::string> ServerConfig::getServerNames() const { return _serverNames; }
+const std::vector<std::string>& ServerConfig::getServerNames() const { return _serverNames; }
 
-const std::vector<Route>& ServerConfig::getRoutes() const { return _routes; }
+bool ServerConfig::isDefaultServer() const { return _defaultServer; }
+
+const std::vector<Route>& ServerConfig::getRoutes() const { return _routes->routes(); }
+
+const RouteTable& ServerConfig::getRouteTable() const { return *_routes; }
 
 const std::map<int, std::string>& ServerConfig::getErrorPages() const { return _errorPages; }
 
-// Custom Getters
-std::optional<std::string> ServerConfig::getErrorPage(const Http::Status code) const {
-	const auto it = _errorPages.find(code);
-	if (it == _errorPages.end()) {
-		return std::nullopt;
-	}
-	return it->second;
-}
+const AccessLogConfig& ServerConfig::getAccessLog() const { return _accessLog; }
+
+const SlowLogConfig& ServerConfig::getSlowLog() const { return _slowLog; }
+
+const ErrorPages& ServerConfig::getLoadedErrorPages() const { return *_loadedErrorPages; }
 
 // Setters
 void ServerConfig::setPort(const int port) { _port = port; }
@@ -72,10 +79,21 @@ void ServerConfig::setRoot(const std::string& root) { _root = root; }
 
 void ServerConfig::setUploadDir(const std::string& dir) { _uploadDir = dir; }
 
-void ServerConfig::setRoutes(const std::vector<Route>& routes) { _routes = routes; }
+void ServerConfig::setRoutes(const std::vector<Route>& routes) { _routes = std::make_shared<const RouteTable>(routes); }
 
 void ServerConfig::setErrorPages(const std::map<int, std::string>& pages) { _errorPages = pages; }
 
+/**
+ * @brief Read the error pages into memory, once the root of the server is known
+ */
+void ServerConfig::loadErrorPages() { _loadedErrorPages = std::make_shared<const ErrorPages>(_errorPages, _root); }
+
+void ServerConfig::setAccessLog(const AccessLogConfig& accessLog) { _accessLog = accessLog; }
+
+void ServerConfig::setSlowLog(const SlowLogConfig& slowLog) { _slowLog = slowLog; }
+
+void ServerConfig::setDefaultServer(const bool defaultServer) { _defaultServer = defaultServer; }
+
 void ServerConfig::addServerName(const std::string& name) {
 	if (std::find(_serverNames.begin(), _serverNames.end(), name) == _serverNames.end()) {
 		_serverNames.push_back(name);
@@ -85,7 +103,7 @@ void ServerConfig::addServerName(const std::string& name) {
 // Overload "<<" operator
 std::ostream& operator<<(std::ostream& os, const ServerConfig& server) {
 	os << std::left << std::setw(32) << COLOR(BLUE, server.getHostIP()) << BLUE << server.getHostIP() << ":"
-	   << server.getPort() << RESET_COLOR << "\n";
+	   << server.getPort() << RESET_COLOR << (server.isDefaultServer() ? " (default server)" : "") << "\n";
 
 	if (!server.getServerNames().empty()) {
 		os << "  |- server names: \n";
@@ -116,6 +134,16 @@ std::ostream& operator<<(std::ostream& os, const ServerConfig& server) {
 			os << std::left << std::setw(8) << "    |- " << page.first << " -> " << page.second << "\n";
 	}
 
+	if (const AccessLogConfig& accessLog = server.getAccessLog(); !accessLog.path.empty()) {
+		os << std::left << std::setw(32) << "  |- access log: " << accessLog.path
+		   << (accessLog.format == AccessLogConfig::Format::JSON ? " (json" : " (combined") << ", buffer "
+		   << accessLog.bufferSize << " bytes, flush " << accessLog.flushInterval << " ms)\n";
+	}
+	if (const SlowLogConfig& slowLog = server.getSlowLog(); !slowLog.path.empty()) {
+		os << std::left << std::setw(32) << "  |- slow log: " << slowLog.path << " (over " << slowLog.threshold
+		   << " ms)\n";
+	}
+
 	os << "  |- routes: \n";
 	for (const auto& route : server.getRoutes())
 		os << "    |- " << route << "\n";  // Use Route's overloaded << operator
@@ -1,5 +1,6 @@
 #include "Socket.hpp"
 
+#include <fcntl.h>
 #include <unistd.h>
 
 #include <cstdio>
@@ -11,22 +12,33 @@
 #include "Logger.hpp"
 #include "ServerConfig.hpp"
 
-Socket::Socket(std::vector<ServerConfig> configs)
+std::unordered_map<std::string, int> Socket::_inherited;
+
+Socket::Socket(ServerConfigSnapshot configs)
 	: _socketFd(-1),
-	  _port(configs.front().getPort()),
-	  _default_config(configs.front()),
-	  _configs(std::move(configs)),
+	  _port(configs->defaultServer().getPort()),
+	  _host(configs->defaultServer().getHostIP()),
+	  _listener(std::make_shared<ListenerConfig>(ListenerConfig{std::move(configs)})),
 	  _addr(sockaddr_in{}) {
-	LOG_INFO("Creating socket on IP " + _default_config.getHostIP() + " and port " + std::to_string(_port));
-	_socketFd = socket(AF_INET, SOCK_STREAM, 0);
-
-	if (_socketFd == -1)
-		throw std::runtime_error("Socket creation failed: " + std::string(strerror(errno)));
-
-	setSocketOpt();
 	setupAddress();
-	bind();
-	listen();
+	if (const auto it = _inherited.find(getAddress()); it != _inherited.end()) {
+		LOG_INFO("Using inherited socket " + std::to_string(it->second) + " on IP " + _host + " and port " +
+				 std::to_string(_port));
+		_socketFd = it->second;
+		_inherited.erase(it);
+	} else {
+		LOG_INFO("Creating socket on IP " + _host + " and port " + std::to_string(_port));
+		_socketFd = socket(AF_INET, SOCK_STREAM, 0);
+
+		if (_socketFd == -1)
+			throw std::runtime_error("Socket creation failed: " + std::string(strerror(errno)));
+
+		setSocketOpt();
+		bind();
+		listen();
+	}
+	// Neither CGI children nor a new binary get the socket by accident, an upgrade passes it on explicitly
+	fcntl(_socketFd, F_SETFD, FD_CLOEXEC);
 }
 
 Socket::~Socket() {
@@ -37,12 +49,12 @@ Socket::~Socket() {
 }
 
 void Socket::bind() {
-	LOG_DEBUG("Binding socket to IP " + _default_config.getHostIP() + " and port " + std::to_string(_port));
+	LOG_DEBUG("Binding socket to IP " + _host + " and port " + std::to_string(_port));
 	if (::bind(_socketFd, reinterpret_cast<sockaddr *>(&_addr), sizeof(_addr)) == -1) {
-		throw std::runtime_error("Bind failed on IP " + _default_config.getHostIP() + " and port " +
-								 std::to_string(_port) + ": " + std::string(strerror(errno)));
+		throw std::runtime_error("Bind failed on IP " + _host + " and port " + std::to_string(_port) + ": " +
+								 std::string(strerror(errno)));
 	}
-	LOG_INFO("Socket successfully bound to IP " + _default_config.getHostIP() + " and port " + std::to_string(_port));
+	LOG_INFO("Socket successfully bound to IP " + _host + " and port " + std::to_string(_port));
 }
 
 void Socket::listen() const {
@@ -55,10 +67,10 @@ void Socket::listen() const {
 int Socket::getSocketFd() const { return _socketFd; }
 
 void Socket::setupAddress() {
-	_addr = sockaddr_in{};												// Value-initialize sockaddr_in
-	_addr.sin_family = AF_INET;											// IPv4
-	_addr.sin_addr.s_addr = my_inet_addr(_default_config.getHostIP());	// Convert IP address to network byte order
-	_addr.sin_port = htons(_port);										// Convert port to network byte order
+	_addr = sockaddr_in{};						   // Value-initialize sockaddr_in
+	_addr.sin_family = AF_INET;					   // IPv4
+	_addr.sin_addr.s_addr = my_inet_addr(_host);  // Convert IP address to network byte order
+	_addr.sin_port = htons(_port);				   // Convert port to network byte order
 }
 
 void Socket::setSocketOpt() const {
@@ -69,7 +81,56 @@ void Socket::setSocketOpt() const {
 	}
 }
 
-std::vector<ServerConfig> Socket::getConfig() const { return _configs; }
+const ServerConfigSnapshot &Socket::getConfig() const { return _listener->servers; }
+
+const std::shared_ptr<ListenerConfig> &Socket::getListener() const { return _listener; }
+
+/**
+ * @brief `host:port` the socket listens on, the same for every server config of the socket
+ */
+std::string Socket::getAddress() const { return _host + ":" + std::to_string(_port); }
+
+/**
+ * @brief Swap in the server configs of a reload, connections still using the old ones keep them alive
+ */
+void Socket::setConfig(ServerConfigSnapshot configs) { _listener->servers = std::move(configs); }
+
+/**
+ * @brief Take over the listening sockets of the process that started this one for a binary upgrade. Sockets
+ * created afterwards for one of their addresses use the inherited socket instead of binding a new one.
+ * @return true if this process was started for an upgrade
+ */
+bool Socket::loadInherited() {
+	const char *value = std::getenv(INHERITED_ENV);
+	if (value == nullptr)
+		return false;
+	std::stringstream ss(value);
+	std::string entry;
+	while (std::getline(ss, entry, ';')) {
+		const size_t separator = entry.find('=');
+		if (separator == std::string::npos)
+			continue;
+		try {
+			_inherited[entry.substr(separator + 1)] = std::stoi(entry.substr(0, separator));
+		} catch (const std::exception &) {
+			LOG_WARN("Ignoring invalid inherited socket " + entry);
+		}
+	}
+	// CGI children must not see it
+	unsetenv(INHERITED_ENV);
+	return true;
+}
+
+/**
+ * @brief Close the inherited sockets of addresses that are no longer configured
+ */
+void Socket::closeUnusedInherited() {
+	for (const auto &[address, fd] : _inherited) {
+		LOG_INFO("Closing inherited socket on " + address + ", it is not configured");
+		close(fd);
+	}
+	_inherited.clear();
+}
 
 uint32_t my_inet_addr(const std::string &ipStr) {
 	uint32_t result = 0;
@@ -109,7 +170,7 @@ std::string my_inet_ntoa(const in_addr &in) {
 	// The address is stored in network byte order (big-endian).
 	// For example, 192.168.0.1 -> 0xC0A80001 in memory.
 
-	uint32_t ip = in.s_addr;  // 32-bit IP in network byte order
+	uint32_t ip = ntohl(in.s_addr);	 // 32-bit IP in host byte order
 
 	// Extract each octet by shifting and masking
 	unsigned char b1 = (ip >> 24) & 0xFF;
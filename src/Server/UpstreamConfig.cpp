@@ -0,0 +1,51 @@
+#include "UpstreamConfig.hpp"
+
+#include <iomanip>
+
+UpstreamConfig::UpstreamConfig(const std::string& name) : _name(name) {}
+
+// Getters
+const std::string& UpstreamConfig::getName() const { return _name; }
+
+const std::vector<UpstreamConfig::Server>& UpstreamConfig::getServers() const { return _servers; }
+
+UpstreamConfig::Balance UpstreamConfig::getBalance() const { return _balance; }
+
+const std::string& UpstreamConfig::getHashKey() const { return _hashKey; }
+
+size_t UpstreamConfig::getKeepalive() const { return _keepalive; }
+
+// Setters
+void UpstreamConfig::setName(const std::string& name) { _name = name; }
+
+void UpstreamConfig::addServer(const Server& server) { _servers.push_back(server); }
+
+void UpstreamConfig::setBalance(const Balance balance) { _balance = balance; }
+
+void UpstreamConfig::setHashKey(const std::string& key) { _hashKey = key; }
+
+void UpstreamConfig::setKeepalive(const size_t keepalive) { _keepalive = keepalive; }
+
+// Overload "<<" operator
+std::ostream& operator<<(std::ostream& os, const UpstreamConfig& config) {
+	os << "  |- upstream " << config.getName() << "\n";
+	os << std::left << std::setw(32) << "      |- balance: ";
+	switch (config.getBalance()) {
+		case UpstreamConfig::Balance::ROUND_ROBIN:
+			os << "round robin\n";
+			break;
+		case UpstreamConfig::Balance::LEAST_CONN:
+			os << "least connections\n";
+			break;
+		case UpstreamConfig::Balance::HASH:
+			os << "hash " << config.getHashKey() << "\n";
+			break;
+	}
+	os << std::left << std::setw(32) << "      |- keepalive: " << config.getKeepalive() << "\n";
+	for (const auto& server : config.getServers()) {
+		os << std::left << std::setw(32) << "      |- server: " << server.host << ":" << server.port
+		   << " weight=" << server.weight << " max_fails=" << server.maxFails
+		   << " fail_timeout=" << server.failTimeout << "ms\n";
+	}
+	return os;
+}
@@ -0,0 +1,89 @@
+#include "VirtualHosts.hpp"
+
+#include <cctype>
+
+VirtualHosts::VirtualHosts(std::vector<ServerConfig> servers) : _servers(std::move(servers)) {
+	_default = &_servers.front();
+	for (const ServerConfig& server : _servers) {
+		if (server.isDefaultServer()) {
+			_default = &server;
+			break;
+		}
+	}
+
+	// The keys are views into the names of `_servers`, which never change after this. The first server with a
+	// name wins, as it did with a linear search.
+	for (const ServerConfig& server : _servers) {
+		for (const std::string& name : server.getServerNames()) {
+			const std::string_view view(name);
+			if (view.empty())
+				continue;
+			if (view.front() == '~')
+				_regexes.emplace_back(std::regex(name.substr(1), std::regex::ECMAScript | std::regex::optimize),
+									  &server);
+			else if (view.size() > 1 && view.substr(0, 2) == "*.")
+				_suffixes.emplace(view.substr(1), &server);
+			else if (view.size() > 1 && view.substr(view.size() - 2) == ".*")
+				_prefixes.emplace(view.substr(0, view.size() - 1), &server);
+			else if (view.front() == '.') {
+				_exact.emplace(view.substr(1), &server);
+				_suffixes.emplace(view, &server);
+			} else
+				_exact.emplace(view, &server);
+		}
+	}
+}
+
+/**
+ * @brief Server for the Host header of a request, the default server if no name matches
+ */
+const ServerConfig& VirtualHosts::find(const std::string_view host) const {
+	const std::string_view hostname = hostName(host);
+	if (hostname.size() > MAX_HOST_NAME)
+		return *_default;
+	char buffer[MAX_HOST_NAME];
+	for (size_t i = 0; i < hostname.size(); ++i)
+		buffer[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(hostname[i])));
+	const std::string_view name(buffer, hostname.size());
+
+	if (const auto it = _exact.find(name); it != _exact.end())
+		return *it->second;
+	// The first dot gives the longest suffix
+	if (!_suffixes.empty()) {
+		for (size_t dot = name.find('.'); dot != std::string_view::npos; dot = name.find('.', dot + 1)) {
+			if (const auto it = _suffixes.find(name.substr(dot)); it != _suffixes.end())
+				return *it->second;
+		}
+	}
+	// The last dot gives the longest prefix
+	if (!_prefixes.empty()) {
+		for (size_t dot = name.rfind('.'); dot != std::string_view::npos && dot > 0; dot = name.rfind('.', dot - 1)) {
+			if (const auto it = _prefixes.find(name.substr(0, dot + 1)); it != _prefixes.end())
+				return *it->second;
+		}
+	}
+	for (const auto& [regex, server] : _regexes) {
+		if (std::regex_search(name.begin(), name.end(), regex))
+			return *server;
+	}
+	return *_default;
+}
+
+const ServerConfig& VirtualHosts::defaultServer() const { return *_default; }
+
+const std::vector<ServerConfig>& VirtualHosts::servers() const { return _servers; }
+
+/**
+ * @brief Host header without the port and a trailing dot: `Example.com.:8080` -> `Example.com`
+ */
+std::string_view VirtualHosts::hostName(std::string_view host) {
+	if (!host.empty() && host.front() == '[') {
+		// IPv6 literal, the colons belong to the address
+		const size_t end = host.find(']');
+		host = host.substr(0, end == std::string_view::npos ? host.size() : end + 1);
+	} else if (const size_t colon = host.rfind(':'); colon != std::string_view::npos)
+		host = host.substr(0, colon);
+	if (!host.empty() && host.back() == '.')
+		host.remove_suffix(1);
+	return host;
+}
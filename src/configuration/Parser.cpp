@@ -12,12 +12,60 @@
 
 #include "Parser.hpp"
 
+#include <algorithm>
+#include <cctype>
 #include <sstream>
+#include <string_view>
 #include <tuple>
 #include <unordered_map>
 
 #include "Logger.hpp"
 
+namespace {
+/**
+ * @brief Parses a duration written as a single word, e.g. `10s`, `500ms` or `1m` (default unit: seconds)
+ * @return the value in milliseconds
+ */
+size_t parseDurationWord(const std::string& word) {
+	size_t unitStart = 0;
+	const size_t value = std::stoul(word, &unitStart);
+	const std::string unit = word.substr(unitStart);
+	if (unit.empty() || unit == "s")
+		return value * 1000;
+	if (unit == "ms")
+		return value;
+	if (unit == "m")
+		return value * 60 * 1000;
+	if (unit == "h")
+		return value * 60 * 60 * 1000;
+	throw std::invalid_argument("invalid time unit: " + unit);
+}
+
+/**
+ * @brief Parses a size written as a single word, e.g. `64k` or `1m` (default unit: bytes)
+ */
+size_t parseSizeWord(const std::string& word) {
+	size_t unitStart = 0;
+	const size_t value = std::stoul(word, &unitStart);
+	const std::string unit = word.substr(unitStart);
+	if (unit.empty())
+		return value;
+	if (unit == "k" || unit == "K")
+		return value * 1024;
+	if (unit == "m" || unit == "M")
+		return value * 1024 * 1024;
+	throw std::invalid_argument("invalid size unit: " + unit);
+}
+
+// Values read with `nextTokenWhitespace` keep the whitespace around them
+std::string trim(const std::string& value) {
+	const size_t start = value.find_first_not_of(" \t\r\n");
+	if (start == std::string::npos)
+		return "";
+	return value.substr(start, value.find_last_not_of(" \t\r\n") - start + 1);
+}
+}  // namespace
+
 Parser::Parser(Lexer& lexer) : _lexer(lexer), _currentToken(lexer.nextToken()) {}
 
 void Parser::expect(eTokenType type) {
@@ -56,13 +104,18 @@ std::vector<std::vector<ServerConfig>> Parser::parse() {
 		throw std::runtime_error("Found some parsing errors");
 
 	try {
-		while ((_currentToken.type != TOKEN_CLOSE_BRACE && _currentToken.type != TOKEN_EOF) && !stopServer)
-			servers.push_back(parseServer());
+		while ((_currentToken.type != TOKEN_CLOSE_BRACE && _currentToken.type != TOKEN_EOF) && !stopServer) {
+			if (_currentToken.type == TOKEN_SERVER)
+				servers.push_back(parseServer());
+			else
+				parseHttpOption();
+		}
 	} catch (std::exception& e) {
 		throw std::runtime_error("Found some parsing errors");
 	}
 
 	expect(TOKEN_CLOSE_BRACE);
+	resolveProxyPasses(servers);
 
 	if (!_parsingErrors.empty())
 		throw std::runtime_error("Found some parsing errors");
@@ -70,11 +123,341 @@ std::vector<std::vector<ServerConfig>> Parser::parse() {
 	return splitServerConfigs(servers);
 }
 
+const HttpConfig& Parser::getHttpConfig() const { return _httpConfig; }
+
+void Parser::parseHttpOption() {
+	switch (_currentToken.type) {
+		case TOKEN_CGI_MAX_PROCESSES:
+			expect(TOKEN_CGI_MAX_PROCESSES);
+			_httpConfig.setCgiMaxProcesses(std::stoul(_currentToken.value));
+			expect(TOKEN_NUMBER);
+			expect(TOKEN_SEMICOLON);
+			break;
+
+		case TOKEN_CGI_QUEUE_SIZE:
+			expect(TOKEN_CGI_QUEUE_SIZE);
+			_httpConfig.setCgiQueueSize(std::stoul(_currentToken.value));
+			expect(TOKEN_NUMBER);
+			expect(TOKEN_SEMICOLON);
+			break;
+
+		case TOKEN_CGI_QUEUE_TIMEOUT:
+			expect(TOKEN_CGI_QUEUE_TIMEOUT);
+			_httpConfig.setCgiQueueTimeout(parseTimeValue());
+			expect(TOKEN_SEMICOLON);
+			break;
+
+		case TOKEN_UPSTREAM:
+			parseUpstream();
+			break;
+
+		case TOKEN_LOG_ASYNC:
+			expect(TOKEN_LOG_ASYNC);
+			if (_currentToken.type == TOKEN_ON) {
+				_httpConfig.setLogAsync(true);
+			} else if (_currentToken.type == TOKEN_OFF) {
+				_httpConfig.setLogAsync(false);
+			} else {
+				reportError(UNEXPECTED_TOKEN, "'on' or 'off'", _currentToken.value);
+			}
+			_currentToken = _lexer.nextToken();
+			expect(TOKEN_SEMICOLON);
+			break;
+
+		case TOKEN_LOG_LEVEL: {
+			expect(TOKEN_LOG_LEVEL);
+			static const std::map<std::string, LogLevel> levels = {
+				{"trace", TRACE}, {"debug", DEBUG}, {"info", INFO}, {"warn", WARN}, {"error", ERROR}};
+			if (const auto level = levels.find(_currentToken.value); level != levels.end())
+				_httpConfig.setLogLevel(level->second);
+			else
+				reportError(LOG_LEVEL_BAD_VALUE, "'trace', 'debug', 'info', 'warn' or 'error'", _currentToken.value);
+			expect(TOKEN_STRING);
+			expect(TOKEN_SEMICOLON);
+			break;
+		}
+
+		case TOKEN_TRAFFIC_CAPTURE:
+			_httpConfig.setTrafficCapture(parseTrafficCapture());
+			break;
+
+		default:
+			reportError(UNEXPECTED_TOKEN, POSSIBLE_HTTP_CONFIGS, _currentToken.value);
+			throw std::runtime_error("Found some parsing errors");
+	}
+}
+
+void Parser::parseUpstream() {
+	expect(TOKEN_UPSTREAM);
+	UpstreamConfig upstream(_currentToken.value);
+	expect(TOKEN_STRING);
+	expect(TOKEN_OPEN_BRACE);
+
+	while ((_currentToken.type != TOKEN_CLOSE_BRACE && _currentToken.type != TOKEN_EOF) && !stopServer) {
+		switch (_currentToken.type) {
+			case TOKEN_SERVER:
+				parseUpstreamServer(upstream);
+				break;
+
+			case TOKEN_LEAST_CONN:
+				expect(TOKEN_LEAST_CONN);
+				upstream.setBalance(UpstreamConfig::Balance::LEAST_CONN);
+				expect(TOKEN_SEMICOLON);
+				break;
+
+			case TOKEN_HASH: {
+				expect(TOKEN_HASH);
+				const std::string& key = _currentToken.value;
+				if (key != "$request_uri" && key != "$uri" && key != "$remote_addr" && key.rfind("$http_", 0) != 0)
+					reportError(UNEXPECTED_TOKEN, "'$request_uri', '$uri', '$remote_addr' or '$http_<name>'", key);
+				upstream.setBalance(UpstreamConfig::Balance::HASH);
+				upstream.setHashKey(key);
+				expect(TOKEN_STRING);
+				expect(TOKEN_SEMICOLON);
+				break;
+			}
+
+			case TOKEN_KEEPALIVE:
+				expect(TOKEN_KEEPALIVE);
+				upstream.setKeepalive(std::stoul(_currentToken.value));
+				expect(TOKEN_NUMBER);
+				expect(TOKEN_SEMICOLON);
+				break;
+
+			default:
+				reportError(UNEXPECTED_TOKEN, POSSIBLE_UPSTREAM_CONFIGS, _currentToken.value);
+				throw std::runtime_error("Found some parsing errors");
+		}
+	}
+	expect(TOKEN_CLOSE_BRACE);
+
+	if (upstream.getServers().empty())
+		reportError(UPSTREAM_NO_SERVERS, "at least one 'server' in upstream", upstream.getName());
+	_httpConfig.addUpstream(upstream);
+}
+
+/**
+ * @brief Parses `server <host>:<port> [weight=<n>] [max_fails=<n>] [fail_timeout=<time>];` inside an upstream
+ */
+void Parser::parseUpstreamServer(UpstreamConfig& upstream) {
+	expect(TOKEN_SERVER);
+	UpstreamConfig::Server server;
+
+	std::string address = _currentToken.value;
+	if (_currentToken.type == TOKEN_IP_V4) {
+		_currentToken = _lexer.nextToken();	 // Consume IP
+		if (_currentToken.type == TOKEN_STRING && _currentToken.value[0] == ':') {	// In the form ":8080"
+			address += _currentToken.value;
+			_currentToken = _lexer.nextToken();
+		}
+	} else if (_currentToken.type == TOKEN_STRING) {
+		_currentToken = _lexer.nextToken();
+	} else {
+		reportError(UPSTREAM_BAD_SERVER, "server <host>:<port>", _currentToken.value);
+		_currentToken = _lexer.nextToken();
+	}
+
+	try {
+		const size_t colon = address.find(':');
+		server.host = address.substr(0, colon);
+		if (colon != std::string::npos)
+			server.port = std::stoi(address.substr(colon + 1));
+
+		while (_currentToken.type == TOKEN_STRING) {
+			const size_t equal = _currentToken.value.find('=');
+			const std::string name = _currentToken.value.substr(0, equal);
+			const std::string value = equal == std::string::npos ? "" : _currentToken.value.substr(equal + 1);
+			if (name == "weight")
+				server.weight = std::max<size_t>(1, std::stoul(value));
+			else if (name == "max_fails")
+				server.maxFails = std::stoul(value);
+			else if (name == "fail_timeout")
+				server.failTimeout = parseDurationWord(value);
+			else
+				reportError(UPSTREAM_BAD_SERVER, "'weight=<n>', 'max_fails=<n>' or 'fail_timeout=<time>'",
+							_currentToken.value);
+			_currentToken = _lexer.nextToken();
+		}
+	} catch (const std::exception&) {
+		reportError(UPSTREAM_BAD_SERVER, "server <host>:<port> [weight=<n>] [max_fails=<n>] [fail_timeout=<time>]",
+					address + " " + _currentToken.value);
+		while (_currentToken.type == TOKEN_STRING) _currentToken = _lexer.nextToken();
+	}
+
+	if (server.host.empty() || server.port <= 0 || server.port > 65535)
+		reportError(UPSTREAM_BAD_SERVER, "server <host>:<port>", address);
+	upstream.addServer(server);
+	expect(TOKEN_SEMICOLON);
+}
+
+/**
+ * @brief Every `proxy_pass` has to name an upstream block or a `<host>:<port>`. The latter get an implicit
+ * upstream with a single server.
+ */
+void Parser::resolveProxyPasses(const std::vector<ServerConfig>& servers) {
+	for (const auto& server : servers) {
+		for (const auto& route : server.getRoutes()) {
+			const std::string& target = route.getProxyPass();
+			if (target.empty())
+				continue;
+
+			const auto& upstreams = _httpConfig.getUpstreams();
+			if (std::any_of(upstreams.begin(), upstreams.end(),
+							[&target](const UpstreamConfig& upstream) { return upstream.getName() == target; }))
+				continue;
+
+			const size_t colon = target.find(':');
+			UpstreamConfig::Server upstreamServer;
+			upstreamServer.host = target.substr(0, colon);
+			try {
+				if (colon != std::string::npos)
+					upstreamServer.port = std::stoi(target.substr(colon + 1));
+			} catch (const std::exception&) {
+				upstreamServer.port = 0;
+			}
+			if (upstreamServer.host.empty() || upstreamServer.port <= 0 || upstreamServer.port > 65535) {
+				reportError(PROXY_PASS_BAD_VALUE, "name of an upstream block or <host>:<port>", target);
+				continue;
+			}
+			UpstreamConfig upstream(target);
+			upstream.addServer(upstreamServer);
+			_httpConfig.addUpstream(upstream);
+		}
+	}
+}
+
+/**
+ * @brief Parses `access_log off;` or `access_log <path> [combined|json] [buffer=<size>] [flush=<time>];`
+ */
+AccessLogConfig Parser::parseAccessLog() {
+	expect(TOKEN_ACCESS_LOG);
+	AccessLogConfig accessLog;
+	if (_currentToken.type == TOKEN_OFF) {
+		_currentToken = _lexer.nextToken();
+		expect(TOKEN_SEMICOLON);
+		return accessLog;
+	}
+
+	accessLog.path = _currentToken.value;
+	expect(TOKEN_STRING);
+	while (_currentToken.type == TOKEN_STRING) {
+		const std::string& option = _currentToken.value;
+		try {
+			if (option == "combined")
+				accessLog.format = AccessLogConfig::Format::COMBINED;
+			else if (option == "json")
+				accessLog.format = AccessLogConfig::Format::JSON;
+			else if (option.rfind("buffer=", 0) == 0)
+				accessLog.bufferSize = parseSizeWord(option.substr(7));
+			else if (option.rfind("flush=", 0) == 0)
+				accessLog.flushInterval = parseDurationWord(option.substr(6));
+			else
+				reportError(ACCESS_LOG_BAD_VALUE, "'combined', 'json', 'buffer=<size>' or 'flush=<time>'", option);
+		} catch (const std::exception&) {
+			reportError(ACCESS_LOG_BAD_VALUE, "'buffer=<size>' or 'flush=<time>'", option);
+		}
+		_currentToken = _lexer.nextToken();
+	}
+	expect(TOKEN_SEMICOLON);
+	return accessLog;
+}
+
+/**
+ * @brief Parses `traffic_capture off;` or `traffic_capture <path> [buffer=<size>] [flush=<time>];`
+ */
+TrafficCaptureConfig Parser::parseTrafficCapture() {
+	expect(TOKEN_TRAFFIC_CAPTURE);
+	TrafficCaptureConfig capture;
+	if (_currentToken.type == TOKEN_OFF) {
+		_currentToken = _lexer.nextToken();
+		expect(TOKEN_SEMICOLON);
+		return capture;
+	}
+
+	capture.path = _currentToken.value;
+	expect(TOKEN_STRING);
+	while (_currentToken.type == TOKEN_STRING) {
+		const std::string& option = _currentToken.value;
+		try {
+			if (option.rfind("buffer=", 0) == 0)
+				capture.bufferSize = parseSizeWord(option.substr(7));
+			else if (option.rfind("flush=", 0) == 0)
+				capture.flushInterval = parseDurationWord(option.substr(6));
+			else
+				reportError(TRAFFIC_CAPTURE_BAD_VALUE, "'buffer=<size>' or 'flush=<time>'", option);
+		} catch (const std::exception&) {
+			reportError(TRAFFIC_CAPTURE_BAD_VALUE, "'buffer=<size>' or 'flush=<time>'", option);
+		}
+		_currentToken = _lexer.nextToken();
+	}
+	expect(TOKEN_SEMICOLON);
+	return capture;
+}
+
+/**
+ * @brief Parses `slow_log off;` or `slow_log <path> [threshold=<time>];`
+ */
+SlowLogConfig Parser::parseSlowLog() {
+	expect(TOKEN_SLOW_LOG);
+	SlowLogConfig slowLog;
+	if (_currentToken.type == TOKEN_OFF) {
+		_currentToken = _lexer.nextToken();
+		expect(TOKEN_SEMICOLON);
+		return slowLog;
+	}
+
+	slowLog.path = _currentToken.value;
+	expect(TOKEN_STRING);
+	while (_currentToken.type == TOKEN_STRING) {
+		const std::string& option = _currentToken.value;
+		try {
+			if (option.rfind("threshold=", 0) == 0)
+				slowLog.threshold = parseDurationWord(option.substr(10));
+			else
+				reportError(SLOW_LOG_BAD_VALUE, "'threshold=<time>'", option);
+		} catch (const std::exception&) {
+			reportError(SLOW_LOG_BAD_VALUE, "'threshold=<time>'", option);
+		}
+		_currentToken = _lexer.nextToken();
+	}
+	expect(TOKEN_SEMICOLON);
+	return slowLog;
+}
+
+/**
+ * @brief Parses a `<time_value>` (default unit: seconds)
+ * @return the value in milliseconds
+ */
+size_t Parser::parseTimeValue() {
+	size_t timeout = 0;
+	size_t msValue = 1000 * std::stoul(_currentToken.value);  // By default, read in seconds
+	expect(TOKEN_NUMBER);
+	while (_currentToken.type == TOKEN_STRING) {
+		if (_currentToken.value == "ms")  // 1/1000th of a second
+			msValue /= 1000;
+		else if (_currentToken.value == "m")  // 60 seconds
+			msValue *= 60;
+		else if (_currentToken.value == "h")  // 60 minutes
+			msValue *= 60 * 60;
+
+		_currentToken = _lexer.nextToken();	 // Moves past the suffix
+
+		if (_currentToken.type != TOKEN_NUMBER)
+			break;
+		timeout += msValue;
+		msValue = 1000 * std::stoul(_currentToken.value);
+
+		_currentToken = _lexer.nextToken();	 // Move past the number
+	}
+	return timeout + msValue;
+}
+
 ServerConfig Parser::parseServer() {
 	expect(TOKEN_SERVER);
 	expect(TOKEN_OPEN_BRACE);
 
 	ServerConfig server;
+	std::vector<Route> routes;
 
 	while ((_currentToken.type != TOKEN_CLOSE_BRACE && _currentToken.type != TOKEN_EOF) && !stopServer) {
 		switch (_currentToken.type) {
@@ -95,30 +478,17 @@ ServerConfig Parser::parseServer() {
 					reportError(LISTEN_MISSING_VALUES, "listen [host|port] or listen [host]:[port]", "listen [ ]");
 				}
 
+				if (_currentToken.type == TOKEN_STRING && _currentToken.value == "default_server") {
+					server.setDefaultServer(true);
+					_currentToken = _lexer.nextToken();
+				}
 				expect(TOKEN_SEMICOLON);
 				break;
 			}
 
-			case TOKEN_SERVER_NAME: {
-				_currentToken = _lexer.nextTokenWhitespace();
-
-				std::stringstream ss(_currentToken.value);
-				std::vector<std::string> server_names;
-				std::string tmp;
-
-				while (std::getline(ss, tmp, ' '))
-					if (!tmp.empty()) {
-						std::transform(tmp.begin(), tmp.end(), tmp.begin(), ::tolower);
-						server.addServerName(tmp);
-					}
-
-				if (server.getServerNames().empty())
-					reportError(SERVER_NAME_MISSING_VALUES, "name1 name2", "");
-
-				_currentToken = _lexer.nextToken();
-				expect(TOKEN_SEMICOLON);
+			case TOKEN_SERVER_NAME:
+				parseServerName(server);
 				break;
-			}
 
 			case TOKEN_ROOT:
 				expect(TOKEN_ROOT);
@@ -314,12 +684,17 @@ ServerConfig Parser::parseServer() {
 				break;
 			}
 
-			case TOKEN_LOCATION: {
-				std::vector<Route> routes = server.getRoutes();
+			case TOKEN_ACCESS_LOG:
+				server.setAccessLog(parseAccessLog());
+				break;
+
+			case TOKEN_SLOW_LOG:
+				server.setSlowLog(parseSlowLog());
+				break;
+
+			case TOKEN_LOCATION:
 				routes.push_back(parseRoute());
-				server.setRoutes(routes);
 				break;
-			}
 
 			default:
 				reportError(UNEXPECTED_TOKEN, POSSIBLE_SERVER_CONFIGS, _currentToken.value);
@@ -327,15 +702,166 @@ ServerConfig Parser::parseServer() {
 		}
 	}
 
+	// The routes are compiled once, after the last location
+	server.setRoutes(routes);
+	server.loadErrorPages();
+	if (server.isDefaultServer() &&
+		!_defaultServers.insert(server.getHostIP() + ":" + std::to_string(server.getPort())).second)
+		reportError(DUPLICATE_DEFAULT_SERVER, "one default_server per address",
+					server.getHostIP() + ":" + std::to_string(server.getPort()));
 	expect(TOKEN_CLOSE_BRACE);
 	return server;
 }
 
+/**
+ * @brief Parses `server_name name...;`. A name is exact (`example.com`), a wildcard (`*.example.com`,
+ * `www.example.*`, `.example.com`) or a regular expression (`~^www\d+\.example\.com$`).
+ */
+void Parser::parseServerName(ServerConfig& server) {
+	_currentToken = _lexer.nextTokenWhitespace();
+
+	std::stringstream ss(_currentToken.value);
+	std::string tmp;
+
+	while (std::getline(ss, tmp, ' ')) {
+		if (tmp.empty())
+			continue;
+		if (tmp[0] == '~') {
+			try {
+				std::regex(tmp.substr(1));
+			} catch (const std::regex_error& e) {
+				reportError(SERVER_NAME_BAD_VALUE, "a valid regular expression", tmp + " (" + e.what() + ")");
+			}
+			server.addServerName(tmp);
+			continue;
+		}
+		const size_t star = tmp.find('*');
+		const bool wildcard =
+			star != std::string::npos && tmp.size() > 2 && tmp.find('*', star + 1) == std::string::npos &&
+			((star == 0 && tmp[1] == '.') || (star == tmp.size() - 1 && tmp[star - 1] == '.'));
+		if (star != std::string::npos && !wildcard)
+			reportError(SERVER_NAME_BAD_VALUE, "'*' only as '*.example.com' or 'www.example.*'", tmp);
+		std::transform(tmp.begin(), tmp.end(), tmp.begin(), ::tolower);
+		server.addServerName(tmp);
+	}
+
+	if (server.getServerNames().empty())
+		reportError(SERVER_NAME_MISSING_VALUES, "name1 name2", "");
+
+	_currentToken = _lexer.nextToken();
+	expect(TOKEN_SEMICOLON);
+}
+
+/**
+ * @brief Parses `types { <mime type> <extension>...; ... }`. The entries are read up to the `;`, so extensions
+ * starting with a digit (`3gp`) stay one word.
+ */
+void Parser::parseTypes(Route& route) {
+	expect(TOKEN_TYPES);
+	if (_currentToken.type != TOKEN_OPEN_BRACE) {
+		reportError(UNEXPECTED_TOKEN, "{", _currentToken.value);
+		return;
+	}
+
+	while (!stopServer) {
+		_currentToken = _lexer.nextTokenWhitespace();
+		if (_currentToken.type == TOKEN_STRING) {
+			std::stringstream ss(_currentToken.value);
+			std::string type;
+			std::string extension;
+			ss >> type;
+			bool empty = true;
+			while (ss >> extension) {
+				if (extension.front() == '.')
+					extension.erase(0, 1);
+				std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+				route.addType(extension, type);
+				empty = false;
+			}
+			if (!type.empty() && (empty || type.find('/') == std::string::npos))
+				reportError(TYPES_BAD_VALUE, "<type>/<subtype> <extension>...", trim(_currentToken.value));
+		}
+		_currentToken = _lexer.nextToken();
+		if (_currentToken.type == TOKEN_CLOSE_BRACE)
+			break;
+		if (_currentToken.type != TOKEN_SEMICOLON) {
+			reportError(UNEXPECTED_TOKEN, "; or }", tokenToString.at(_currentToken.type));
+			return;
+		}
+	}
+	expect(TOKEN_CLOSE_BRACE);
+}
+
+/**
+ * @brief Parses `add_header <name> <value> [always];`. The value is read up to the `;` and may contain spaces,
+ * the line is rendered into the header block of the route here.
+ */
+void Parser::parseAddHeader(Route& route) {
+	if (_currentToken.type != TOKEN_ADD_HEADER)
+		reportError(UNEXPECTED_TOKEN, tokenToString.at(TOKEN_ADD_HEADER), _currentToken.value);
+	_currentToken = _lexer.nextTokenWhitespace();
+
+	const std::string line = trim(_currentToken.type == TOKEN_STRING ? _currentToken.value : "");
+	const size_t nameEnd = line.find_first_of(" \t");
+	const std::string name = line.substr(0, nameEnd);
+	std::string value = nameEnd == std::string::npos ? "" : trim(line.substr(nameEnd));
+	bool always = false;
+	if (value.size() > 6 && value.compare(value.size() - 6, 6, "always") == 0 &&
+		std::isspace(static_cast<unsigned char>(value[value.size() - 7]))) {
+		value = trim(value.substr(0, value.size() - 6));
+		always = true;
+	}
+	if (value.size() > 1 && (value.front() == '"' || value.front() == '\'') && value.back() == value.front())
+		value = value.substr(1, value.size() - 2);
+
+	const bool validName = !name.empty() && std::all_of(name.begin(), name.end(), [](const unsigned char c) {
+		return std::isalnum(c) || std::string_view("!#$%&'*+-.^_`|~").find(c) != std::string_view::npos;
+	});
+	if (!validName || value.empty() || value.find_first_of("\r\n") != std::string::npos)
+		reportError(ADD_HEADER_BAD_VALUE, "add_header <name> <value> [always]", line);
+	else
+		route.addHeader(name, value, always);
+
+	_currentToken = _lexer.nextToken();
+	expect(TOKEN_SEMICOLON);
+}
+
+/**
+ * @brief Parses `location [=|~|~*] path { ... }`. Regexes are read up to the `{` and checked here, so compiling
+ * the route table cannot fail.
+ */
 Route Parser::parseRoute() {
-	expect(TOKEN_LOCATION);
+	if (_currentToken.type != TOKEN_LOCATION)
+		reportError(UNEXPECTED_TOKEN, tokenToString.at(TOKEN_LOCATION), _currentToken.value);
+	_currentToken = _lexer.nextTokenWhitespace();
+
 	Route route;
-	route.setPath(_currentToken.value);
-	expect(TOKEN_STRING);
+	std::stringstream ss(_currentToken.type == TOKEN_STRING ? _currentToken.value : "");
+	std::string modifier;
+	std::string path;
+	std::string extra;
+	ss >> modifier >> path >> extra;
+	if (path.empty())
+		std::swap(modifier, path);
+	if (modifier == "=")
+		route.setMatch(Route::EXACT);
+	else if (modifier == "~")
+		route.setMatch(Route::REGEX);
+	else if (modifier == "~*")
+		route.setMatch(Route::REGEX_CASELESS);
+	if (path.empty() || path == "=" || path.front() == '~' || !extra.empty() ||
+		(!modifier.empty() && route.getMatch() == Route::PREFIX))
+		reportError(LOCATION_BAD_VALUE, "location [=|~|~*] <path>", trim(_currentToken.value));
+	if (route.getMatch() == Route::REGEX || route.getMatch() == Route::REGEX_CASELESS) {
+		try {
+			std::regex{path};
+		} catch (const std::regex_error& e) {
+			reportError(LOCATION_BAD_VALUE, "a valid regular expression", path + " (" + e.what() + ")");
+			route.setMatch(Route::PREFIX);
+		}
+	}
+	route.setPath(path);
+	_currentToken = _lexer.nextToken();
 	expect(TOKEN_OPEN_BRACE);
 
 	while ((_currentToken.type != TOKEN_CLOSE_BRACE && _currentToken.type != TOKEN_EOF) && !stopServer) {
@@ -343,12 +869,17 @@ Route Parser::parseRoute() {
 			case TOKEN_ALLOW_METHODS:
 				expect(TOKEN_ALLOW_METHODS);
 				{
-					std::vector<std::string> methods;
+					Http::MethodMask methods = 0;
+					bool empty = true;
 					while (_currentToken.type == TOKEN_STRING) {
-						methods.push_back(_currentToken.value);
+						const Http::Method method = Http::methodFromString(_currentToken.value);
+						if (method == Http::Method::UNKNOWN)
+							reportError(ALLOW_METHODS_BAD_VALUE, "'GET', 'POST' or 'DELETE'", _currentToken.value);
+						methods |= Http::methodBit(method);
+						empty = false;
 						_currentToken = _lexer.nextToken();
 					}
-					if (methods.empty())
+					if (empty)
 						reportError(ALLOW_METHODS_MISSING_VALUES, "at least one method: 'GET', 'POST' or 'DELETE'",
 									"None");
 					route.setMethods(methods);
@@ -376,6 +907,53 @@ Route Parser::parseRoute() {
 				expect(TOKEN_SEMICOLON);
 				break;
 
+			case TOKEN_AUTOINDEX_FORMAT:
+				expect(TOKEN_AUTOINDEX_FORMAT);
+				if (_currentToken.value == "html") {
+					route.setAutoindexFormat(Route::AUTOINDEX_HTML);
+				} else if (_currentToken.value == "json") {
+					route.setAutoindexFormat(Route::AUTOINDEX_JSON);
+				} else {
+					reportError(AUTOINDEX_FORMAT_BAD_VALUE, "'html' or 'json'", _currentToken.value);
+				}
+				expect(TOKEN_STRING);
+				expect(TOKEN_SEMICOLON);
+				break;
+
+			case TOKEN_TYPES:
+				parseTypes(route);
+				break;
+
+			case TOKEN_ADD_HEADER:
+				parseAddHeader(route);
+				break;
+
+			case TOKEN_METRICS:
+				expect(TOKEN_METRICS);
+				if (_currentToken.type == TOKEN_ON) {
+					route.setMetrics(true);
+				} else if (_currentToken.type == TOKEN_OFF) {
+					route.setMetrics(false);
+				} else {
+					reportError(METRICS_BAD_VALUE, "'on' or 'off'", _currentToken.value);
+				}
+				_currentToken = _lexer.nextToken();
+				expect(TOKEN_SEMICOLON);
+				break;
+
+			case TOKEN_CONNECTION_TABLE:
+				expect(TOKEN_CONNECTION_TABLE);
+				if (_currentToken.type == TOKEN_ON) {
+					route.setConnectionTable(true);
+				} else if (_currentToken.type == TOKEN_OFF) {
+					route.setConnectionTable(false);
+				} else {
+					reportError(CONNECTION_TABLE_BAD_VALUE, "'on' or 'off'", _currentToken.value);
+				}
+				_currentToken = _lexer.nextToken();
+				expect(TOKEN_SEMICOLON);
+				break;
+
 			case TOKEN_CGI: {
 				expect(TOKEN_CGI);
 				std::string ext = _currentToken.value;
@@ -388,10 +966,7 @@ Route Parser::parseRoute() {
 					reportError(CGI_BAD_EXECUTABLE, "CGI executable for " + ext + " must be a file", handler);
 
 				expect(TOKEN_STRING);
-				auto cgiHandlers = route.getCgiHandlers();
-				if (cgiHandlers.find(ext) == cgiHandlers.end())
-					cgiHandlers[ext] = handler;
-				route.setCgiHandlers(cgiHandlers);
+				route.addCgiHandler(ext, handler);
 				expect(TOKEN_SEMICOLON);
 				break;
 			}
@@ -545,6 +1120,75 @@ Route Parser::parseRoute() {
 				break;
 			}
 
+			case TOKEN_CGI_MAX_PROCESSES:
+				expect(TOKEN_CGI_MAX_PROCESSES);
+				route.setCgiMaxProcesses(std::stoul(_currentToken.value));
+				expect(TOKEN_NUMBER);
+				expect(TOKEN_SEMICOLON);
+				break;
+
+			case TOKEN_PROXY_PASS: {
+				expect(TOKEN_PROXY_PASS);
+				std::string target = _currentToken.value;
+				expect(TOKEN_STRING);
+				if (target.rfind("http://", 0) != 0) {
+					reportError(PROXY_PASS_BAD_VALUE, "http://<upstream>[/uri]", target);
+				} else {
+					target.erase(0, 7);
+					if (const size_t slash = target.find('/'); slash != std::string::npos) {
+						route.setProxyPassUri(target.substr(slash));
+						target.erase(slash);
+					}
+					route.setProxyPass(target);
+				}
+				expect(TOKEN_SEMICOLON);
+				break;
+			}
+
+			case TOKEN_PROXY_TIMEOUT:
+				expect(TOKEN_PROXY_TIMEOUT);
+				route.setProxyTimeout(parseTimeValue());
+				expect(TOKEN_SEMICOLON);
+				break;
+
+			case TOKEN_CGI_CACHE_TTL:
+				expect(TOKEN_CGI_CACHE_TTL);
+				route.setCgiCacheTtl(parseTimeValue());
+				expect(TOKEN_SEMICOLON);
+				break;
+
+			case TOKEN_CGI_CACHE_KEY_HEADERS: {
+				expect(TOKEN_CGI_CACHE_KEY_HEADERS);
+				std::vector<std::string> headers;
+				while (_currentToken.type == TOKEN_STRING) {
+					headers.push_back(_currentToken.value);
+					_currentToken = _lexer.nextToken();
+				}
+				route.setCgiCacheKeyHeaders(headers);
+				expect(TOKEN_SEMICOLON);
+				break;
+			}
+
+			case TOKEN_CGI_CACHE_USE_STALE: {
+				expect(TOKEN_CGI_CACHE_USE_STALE);
+				int flags = Route::STALE_OFF;
+				while (_currentToken.type == TOKEN_STRING || _currentToken.type == TOKEN_OFF) {
+					if (_currentToken.value == "updating")
+						flags |= Route::STALE_UPDATING;
+					else if (_currentToken.value == "error")
+						flags |= Route::STALE_ERROR;
+					else if (_currentToken.value == "timeout")
+						flags |= Route::STALE_TIMEOUT;
+					else if (_currentToken.value != "off")
+						reportError(CGI_CACHE_BAD_STALE_VALUE, "'off', 'updating', 'error' or 'timeout'",
+									_currentToken.value);
+					_currentToken = _lexer.nextToken();
+				}
+				route.setCgiCacheUseStale(flags);
+				expect(TOKEN_SEMICOLON);
+				break;
+			}
+
 			default:
 				reportError(UNEXPECTED_TOKEN, POSSIBLE_ROUTE_CONFIGS, _currentToken.value);
 				throw std::runtime_error("Found some parsing errors");
@@ -10,12 +10,19 @@
 /*                                                                            */
 /* ************************************************************************** */
 
+#include "mimetypes.hpp"
+
 #include <algorithm>
-#include <map>
-#include <string>
-#include <unordered_map>
+#include <cstdint>
+#include <iterator>
+
+namespace {
+struct MimeEntry {
+		std::string_view extension;	 // lower case, without the dot
+		std::string_view type;
+};
 
-const std::unordered_map<std::string, std::string> mimeTypes = {
+constexpr MimeEntry MIME_TYPES[] = {
 	// text
 	{"html", "text/html"},
 	{"htm", "text/html"},
@@ -27,6 +34,9 @@ const std::unordered_map<std::string, std::string> mimeTypes = {
 	{"jad", "text/vnd.sun.j2me.app-descriptor"},
 	{"wml", "text/vnd.wap.wml"},
 	{"htc", "text/x-component"},
+	{"js", "application/javascript"},
+	{"atom", "application/atom+xml"},
+	{"rss", "application/rss+xml"},
 
 	// images
 	{"gif", "image/gif"},
@@ -70,9 +80,7 @@ const std::unordered_map<std::string, std::string> mimeTypes = {
 	{"odp", "application/vnd.oasis.opendocument.presentation"},
 	{"ods", "application/vnd.oasis.opendocument.spreadsheet"},
 	{"odt", "application/vnd.oasis.opendocument.text"},
-	{"pptx",
-	 "application/"
-	 "vnd.openxmlformats-officedocument.presentationml.presentation"},
+	{"pptx", "application/vnd.openxmlformats-officedocument.presentationml.presentation"},
 	{"xlsx", "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet"},
 	{"docx", "application/vnd.openxmlformats-officedocument.wordprocessingml.document"},
 	{"wmlc", "application/vnd.wap.wmlc"},
@@ -139,22 +147,125 @@ const std::unordered_map<std::string, std::string> mimeTypes = {
 	{"wmv", "video/x-ms-wmv"},
 	{"avi", "video/x-msvideo"}};
 
-std::string getFileExtension(const std::string& fileName) {
-	std::size_t pos = fileName.find_last_of('.');
-	if (pos != std::string::npos) {
-		return fileName.substr(pos + 1);
+constexpr size_t MIME_COUNT = std::size(MIME_TYPES);
+
+constexpr char toLower(const char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; }
+
+/**
+ * @brief FNV-1a of the lower case extension, finished with the murmur3 mixer. Every seed gives another hash
+ * function of the family.
+ */
+constexpr uint32_t hashExtension(const std::string_view extension, const uint32_t seed) {
+	uint32_t hash = 2166136261u ^ (seed * 0x9e3779b9u);
+	for (const char c : extension) {
+		hash ^= static_cast<unsigned char>(toLower(c));
+		hash *= 16777619u;
 	}
-	return "";
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35u;
+	return hash ^ (hash >> 16);
 }
 
-std::string getMimeType(const std::string& fileName) {
-	std::string extension = getFileExtension(fileName);
+constexpr size_t MIME_BUCKETS = 64;
+constexpr size_t MIME_SLOTS = 256;
+static_assert(MIME_COUNT < MIME_SLOTS, "a slot stores the index of an entry + 1 in a byte");
 
-	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+/**
+ * @brief Perfect hash of MIME_TYPES (hash and displace): the plain hash of an extension picks a bucket, the seed
+ * of the bucket picks the slot. The seeds are chosen so that no two extensions share a slot.
+ */
+struct MimeHash {
+		uint8_t seeds[MIME_BUCKETS] = {};
+		uint8_t slots[MIME_SLOTS] = {};	 // index in MIME_TYPES + 1, 0 is empty
+		bool complete = false;
+};
+
+constexpr MimeHash buildMimeHash() {
+	MimeHash table{};
+	size_t bucketOf[MIME_COUNT] = {};
+	size_t bucketSize[MIME_BUCKETS] = {};
+	size_t largest = 0;
+	for (size_t i = 0; i < MIME_COUNT; ++i) {
+		bucketOf[i] = hashExtension(MIME_TYPES[i].extension, 0) % MIME_BUCKETS;
+		largest = std::max(largest, ++bucketSize[bucketOf[i]]);
+	}
+
+	// The largest buckets are the hardest to place, they go first
+	for (size_t size = largest; size > 0; --size) {
+		for (size_t bucket = 0; bucket < MIME_BUCKETS; ++bucket) {
+			if (bucketSize[bucket] != size)
+				continue;
+			bool placed = false;
+			for (uint32_t seed = 1; seed <= UINT8_MAX && !placed; ++seed) {
+				size_t taken[MIME_COUNT] = {};
+				size_t count = 0;
+				placed = true;
+				for (size_t i = 0; i < MIME_COUNT && placed; ++i) {
+					if (bucketOf[i] != bucket)
+						continue;
+					const size_t slot = hashExtension(MIME_TYPES[i].extension, seed) % MIME_SLOTS;
+					if (table.slots[slot] != 0) {
+						placed = false;
+						break;
+					}
+					table.slots[slot] = static_cast<uint8_t>(i + 1);
+					taken[count++] = slot;
+				}
+				if (placed)
+					table.seeds[bucket] = static_cast<uint8_t>(seed);
+				else {
+					for (size_t j = 0; j < count; ++j) table.slots[taken[j]] = 0;
+				}
+			}
+			if (!placed)
+				return table;
+		}
+	}
+	table.complete = true;
+	return table;
+}
+
+constexpr MimeHash MIME_HASH = buildMimeHash();
+static_assert(MIME_HASH.complete, "no perfect hash for MIME_TYPES, raise MIME_SLOTS or check for a duplicate");
+
+bool equalsLowerCase(const std::string_view lower, const std::string_view other) {
+	if (lower.size() != other.size())
+		return false;
+	for (size_t i = 0; i < lower.size(); ++i) {
+		if (lower[i] != toLower(other[i]))
+			return false;
+	}
+	return true;
+}
+}  // namespace
+
+/**
+ * @brief Extension of the last path segment, without the dot. Empty if the file has none.
+ */
+std::string_view getFileExtension(const std::string_view fileName) {
+	const size_t pos = fileName.find_last_of("./");
+	if (pos != std::string_view::npos && fileName[pos] == '.')
+		return fileName.substr(pos + 1);
+	return {};
+}
+
+std::string_view findMimeType(const std::string_view extension) {
+	const uint8_t seed = MIME_HASH.seeds[hashExtension(extension, 0) % MIME_BUCKETS];
+	const uint8_t index = MIME_HASH.slots[hashExtension(extension, seed) % MIME_SLOTS];
+	if (index == 0 || !equalsLowerCase(MIME_TYPES[index - 1].extension, extension))
+		return {};
+	return MIME_TYPES[index - 1].type;
+}
 
-	auto it = mimeTypes.find(extension);
-	if (it != mimeTypes.end()) {
-		return it->second;
+std::string_view getMimeType(const std::string_view fileName, const MimeTypeOverrides& overrides) {
+	const std::string_view extension = getFileExtension(fileName);
+	for (const auto& [overrideExtension, type] : overrides) {
+		if (equalsLowerCase(overrideExtension, extension))
+			return type;
 	}
-	return "application/octet-stream";
+	if (const std::string_view type = findMimeType(extension); !type.empty())
+		return type;
+	return DEFAULT_MIME_TYPE;
 }
@@ -15,7 +15,10 @@
 #include "Logger.hpp"
 #include "RequestHandler.hpp"
 
-void RequestHandler::handleDeleteRequest() {
+/**
+ * @return always true, the response is complete
+ */
+bool RequestHandler::handleDeleteRequest() {
 	LOG_DEBUG("Handling DELETE request");
 
 	const std::string& serverSidePath = _request.getServerSidePath();
@@ -23,7 +26,7 @@ void RequestHandler::handleDeleteRequest() {
 	if (!std::filesystem::exists(serverSidePath)) {
 		LOG_WARN("File or directory not found: " + serverSidePath);
 		_response = buildDefaultResponse(Http::NOT_FOUND);
-		return;
+		return true;
 	}
 
 	if (std::filesystem::is_directory(serverSidePath)) {
@@ -43,4 +46,5 @@ void RequestHandler::handleDeleteRequest() {
 		LOG_ERROR("Filesystem error: " + std::string(e.what()));
 		_response = buildDefaultResponse(Http::INTERNAL_SERVER_ERROR);
 	}
+	return true;
 }
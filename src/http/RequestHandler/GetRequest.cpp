@@ -56,6 +56,11 @@ bool RequestHandler::handleGetFile() {
 
 	file.seekg(0, std::ios::end);
 	const long long fileSize = file.tellg();
+	// Not a regular file, e.g. a directory opened as a file
+	if (fileSize < 0) {
+		_response = buildDefaultResponse(Http::FORBIDDEN);
+		return true;
+	}
 	file.seekg(_bytesReadFromFile, std::ios::beg);	// Set the offset
 
 	std::string content;
@@ -76,7 +81,7 @@ bool RequestHandler::handleGetFile() {
 
 	if (_bytesReadFromFile >= fileSize) {
 		// Set up the HTTP response
-		_response.addHeader("Content-Type", getMimeType(_request.getServerSidePath()));
+		_response.addHeader("Content-Type", std::string(_matchedRoute->getMimeType(_request.getServerSidePath())));
 		_response.addHeader("Content-Length", std::to_string(fileSize));
 		_response.setStatus(Http::OK);
 	}
@@ -85,17 +90,22 @@ bool RequestHandler::handleGetFile() {
 }
 
 bool RequestHandler::handleGetDirectory() {
-	// check index file
-	const std::string indexPath = _request.getServerSidePath() + "/" + _serverConfig.getIndex();
-	if (std::filesystem::exists(indexPath)) {
-		_request.setServerSidePath(indexPath);
-		return handleGetFile();
+	// Index file of the location, otherwise of the server. Without one the path is the directory itself.
+	const std::string& index =
+		_matchedRoute->getIndex().empty() ? _serverConfig->getIndex() : _matchedRoute->getIndex();
+	if (!index.empty()) {
+		const std::string indexPath = _request.getServerSidePath() + "/" + index;
+		std::error_code error;
+		if (std::filesystem::is_regular_file(indexPath, error)) {
+			_request.setServerSidePath(indexPath);
+			return handleGetFile();
+		}
 	}
 
 	// autoindex
-	LOG_DEBUG("Autoindex is " + std::string(_matchedRoute.isAutoindex() ? "enabled" : "disabled"));
-	LOG_DEBUG(_matchedRoute.getPath());
-	if (_matchedRoute.isAutoindex()) {
+	LOG_DEBUG("Autoindex is " + std::string(_matchedRoute->isAutoindex() ? "enabled" : "disabled"));
+	LOG_DEBUG(_matchedRoute->getPath());
+	if (_matchedRoute->isAutoindex()) {
 		handleAutoindex(_request.getServerSidePath());
 		return true;
 	}
@@ -176,14 +176,14 @@ bool RequestHandler::setFileNameAndBody(const std::string &part, const std::stri
 		_response = buildDefaultResponse(Http::BAD_REQUEST);
 		return true;
 	}
-	if (!_matchedRoute.getUploadDir().empty()) {
-		if (!_matchedRoute.getRoot().empty())
-			filename = buildpath(_matchedRoute.getUploadDir(), filename, _matchedRoute.getRoot());
+	if (!_matchedRoute->getUploadDir().empty()) {
+		if (!_matchedRoute->getRoot().empty())
+			filename = buildpath(_matchedRoute->getUploadDir(), filename, _matchedRoute->getRoot());
 		else
-			filename = buildpath(_matchedRoute.getUploadDir(), filename, _serverConfig.getRoot());
+			filename = buildpath(_matchedRoute->getUploadDir(), filename, _serverConfig->getRoot());
 	} else {
-		if (!_serverConfig.getUploadDir().empty())
-			filename = buildpath(_serverConfig.getUploadDir(), filename, _serverConfig.getRoot());
+		if (!_serverConfig->getUploadDir().empty())
+			filename = buildpath(_serverConfig->getUploadDir(), filename, _serverConfig->getRoot());
 		else {
 			_response = buildDefaultResponse(Http::FORBIDDEN);
 			return true;
@@ -14,8 +14,8 @@
 #include "RequestHandler.hpp"
 
 HttpResponse RequestHandler::handleRedirectRequest() {
-	int returnCode = _matchedRoute.getCode();
-	const std::string& redirectUrl = _matchedRoute.getRedirect();
+	int returnCode = _matchedRoute->getCode();
+	const std::string& redirectUrl = _matchedRoute->getRedirect();
 
 	if (!redirectUrl.empty()) {
 		LOG_INFO("Route has a return directive with redirection.");
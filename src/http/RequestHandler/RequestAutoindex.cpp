@@ -10,165 +10,119 @@
 /*                                                                            */
 /* ************************************************************************** */
 
-#include <chrono>  // << NEU: sicherstellen, dass <chrono> inkludiert wird
-#include <filesystem>
-#include <iomanip>
-#include <sstream>
+#include <strings.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+
+#include "AutoindexStream.hpp"
 #include "HttpResponse.hpp"
 #include "Logger.hpp"
 #include "RequestHandler.hpp"
 
-std::string humanReadableSize(const uintmax_t size) {
-	constexpr uintmax_t KB = 1024;
-	constexpr uintmax_t MB = KB * 1024;
-	constexpr uintmax_t GB = MB * 1024;
-	constexpr uintmax_t TB = GB * 1024;
-
-	std::ostringstream result;
-	if (size >= TB) {
-		result << std::fixed << std::setprecision(2) << static_cast<double>(size) / TB << " TB";
-	} else if (size >= GB) {
-		result << std::fixed << std::setprecision(2) << static_cast<double>(size) / GB << " GB";
-	} else if (size >= MB) {
-		result << std::fixed << std::setprecision(2) << static_cast<double>(size) / MB << " MB";
-	} else if (size >= KB) {
-		result << std::fixed << std::setprecision(2) << static_cast<double>(size) / KB << " KB";
-	} else {
-		result << size << " B";
-	}
-	return result.str();
+namespace {
+std::string_view trimmed(std::string_view text) {
+	while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+	while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) text.remove_suffix(1);
+	return text;
 }
 
-std::string formatTimestamp(const std::time_t time) {
-	const std::tm* tm = std::localtime(&time);
-	std::ostringstream ss;
-	ss << std::put_time(tm, "%Y-%m-%d %H:%M:%S");
-	return ss.str();
+bool equalsIgnoreCase(const std::string_view a, const std::string_view b) {
+	return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
 }
 
-std::string RequestHandler::buildDirectoryListingHTML(const std::string& path) const {
-	std::ostringstream html;
-
-	html << "<!DOCTYPE html>\n";
-	html << "<html>\n";
-	html << "<head>\n";
-	html << "<title>Index of " << path << "</title>\n";
-	html << "<meta charset=\"UTF-8\">\n";
-	html << "<meta name=\"viewport\" content=\"width=device-width, "
-			"initial-scale=1.0\">\n";
-	html << "</head>\n";
-	html << "<body>\n";
-	html << "<h1>Index of " << path << "</h1>\n";
-	html << "<hr>\n";
-	html << "<table>\n";
-	html << "<tr><th>Name</th><th>Size</th><th>Last Modified</th></tr>\n";
-	// TODO: check for server root
-	if (path != "/") {
-		html << "<tr><td><a href=\"..\">../</a></td><td>-</td><td>-</td></tr>\n";
-	}
-
-	for (const auto& entry : std::filesystem::directory_iterator(path)) {
-		std::string entryPath = entry.path().string();
-		std::string entryName = entry.path().filename().string();
-		if (entry.is_directory() && !entryName.empty() && entryName.back() != '/') {
-			entryName += "/";
+/**
+ * @brief Quality an `Accept` header gives a media type: the q of the most specific range that matches
+ * (`type/subtype` over a `type/` wildcard range over any type), 0 if none does
+ */
+double acceptQuality(std::string_view accept, const std::string_view type) {
+	const std::string_view major = type.substr(0, type.find('/') + 1);
+	int bestSpecificity = 0;
+	double quality = 0;
+	while (!accept.empty()) {
+		const size_t end = std::min(accept.find(','), accept.size());
+		std::string_view range = accept.substr(0, end);
+		accept.remove_prefix(std::min(end + 1, accept.size()));
+
+		std::string_view parameters;
+		if (const size_t semicolon = range.find(';'); semicolon != std::string_view::npos) {
+			parameters = range.substr(semicolon + 1);
+			range = range.substr(0, semicolon);
 		}
-
-		// Größe (falls kein Verzeichnis)
-		std::string entrySize =
-			entry.is_directory() ? "-" : humanReadableSize(std::filesystem::file_size(entry.path()));
-
-		// NEU: Portabler Zeit-Konvertierungscode
-		auto ftime = entry.last_write_time();
-		auto sctp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
-			ftime - decltype(ftime)::clock::now() + std::chrono::system_clock::now());
-		std::time_t entryTime = std::chrono::system_clock::to_time_t(sctp);
-
-		std::string entryTimeStr = formatTimestamp(entryTime);
-
-		std::string entryLink = _request.getLocation();
-		if (!entryLink.empty() && entryLink.back() != '/' && entryLink != ".." && entryLink != "." &&
-			entryLink != "/") {
-			entryLink += "/";
+		range = trimmed(range);
+		int specificity = 0;
+		if (equalsIgnoreCase(range, type))
+			specificity = 3;
+		else if (range.size() == major.size() + 1 && range.back() == '*' &&
+				 equalsIgnoreCase(range.substr(0, major.size()), major))
+			specificity = 2;
+		else if (range == "*/*")
+			specificity = 1;
+		if (specificity <= bestSpecificity)
+			continue;
+
+		bestSpecificity = specificity;
+		quality = 1;
+		while (!parameters.empty()) {
+			const size_t next = std::min(parameters.find(';'), parameters.size());
+			const std::string_view parameter = trimmed(parameters.substr(0, next));
+			parameters.remove_prefix(std::min(next + 1, parameters.size()));
+			if (parameter.size() > 2 && (parameter[0] == 'q' || parameter[0] == 'Q') && parameter[1] == '=')
+				quality = std::strtod(std::string(parameter.substr(2)).c_str(), nullptr);
 		}
-		entryLink += entryName;
-
-		html << "<tr>"
-			 << "<td><a href=\"" << entryLink << "\">" << entryName << "</a></td>"
-			 << "<td>" << entrySize << "</td>"
-			 << "<td>" << entryTimeStr << "</td>"
-			 << "</tr>\n";
 	}
+	return quality;
+}
+}  // namespace
 
-	html << "</table>\n";
-	html << "<hr>\n";
-	html << "</body>\n";
-
-	// Einfaches CSS:
-	html << "<style>\n";
-	html << "    * {\n";
-	html << "        --light: #f2f2f2;\n";
-	html << "        --dark: #ccc;\n";
-	html << "        --background: #f2f2f2;\n";
-	html << "        --color: #030303;\n";
-	html << "        --link-color: #0000EE;\n";
-	html << "    }\n";
-	html << "    @media (prefers-color-scheme: dark) {\n";
-	html << "        * {\n";
-	html << "            --light: #222;\n";
-	html << "            --dark: #3c3c3c;\n";
-	html << "            --background: #000;\n";
-	html << "            --color: #f2f2f2;\n";
-	html << "            --link-color: #33bbff;\n";
-	html << "        }\n";
-	html << "    }\n";
-	html << "    body {\n";
-	html << "        font-family: Courier, monospace;\n";
-	html << "        background-color: var(--background);\n";
-	html << "        color: var(--color);\n";
-	html << "    }\n";
-	html << "    table {\n";
-	html << "        width: 100%;\n";
-	html << "        border-collapse: collapse;\n";
-	html << "    }\n";
-	html << "    th, td {\n";
-	html << "        border: 1px solid var(--dark);\n";
-	html << "        text-align: left;\n";
-	html << "        padding: 8px;\n";
-	html << "    }\n";
-	html << "    tr:nth-child(even) {\n";
-	html << "        background-color: var(--dark);\n";
-	html << "    }\n";
-	html << "    a {\n";
-	html << "        color: var(--link-color);\n";
-	html << "        text-decoration: none;\n";
-	html << "    }\n";
-	html << "    a:hover {\n";
-	html << "        text-decoration: underline;\n";
-	html << "    }\n";
-	html << "    hr {\n";
-	html << "        border: 0;\n";
-	html << "        border-top: 1px solid var(--dark);\n";
-	html << "    }\n";
-	html << "</style>\n";
-
-	html << "</html>\n";
-
-	return html.str();
+/**
+ * @brief The whole listing of a directory at once, as the streamed response renders it (without chunked framing)
+ */
+std::string RequestHandler::buildDirectoryListingHTML(const std::string& path) const {
+	std::string html;
+	const auto stream = AutoindexStream::open(path, _request.getLocation(), AutoindexStream::Options(), false);
+	if (!stream)
+		return html;
+	std::string chunk;
+	for (BodyStream::Status status = stream->read(chunk, SIZE_MAX);
+		 status == BodyStream::Status::DATA || status == BodyStream::Status::AGAIN;
+		 status = stream->read(chunk, SIZE_MAX))
+		html += chunk;
+	return html;
 }
 
 /**
- * @brief Handle a request for a directory listing.
+ * @brief Handle a request for a directory listing. The listing is streamed a batch of rows at a time, from the
+ * cache if the directory did not change since it was last listed. It is HTML or JSON as `autoindex_format`
+ * says, unless the `Accept` header prefers the other one.
  * @param path The path to the directory
  */
 void RequestHandler::handleAutoindex(const std::string& path) {
-	if (std::filesystem::is_directory(path)) {
-		_response.setStatus(Http::OK);
-		_response.setBody(buildDirectoryListingHTML(path));
-		_response.addHeader("Content-Type", "text/html");
-		_response.setDefaultHeaders();
-	} else {
-		_response.setStatus(Http::NOT_FOUND);
+	// HTTP/1.0 has no chunked coding, the end of the body is marked by closing the connection
+	const bool chunked = _request.getHttpVersion() != "HTTP/1.0";
+	AutoindexStream::Options options = AutoindexStream::parseQuery(_request.getQueryString());
+	options.json = _matchedRoute->getAutoindexFormat() == Route::AUTOINDEX_JSON;
+	if (const std::string accept = _request.getHeader("Accept"); !accept.empty()) {
+		const double html = acceptQuality(accept, "text/html");
+		const double json = acceptQuality(accept, "application/json");
+		if (html != json)
+			options.json = json > html;
+	}
+	auto stream = AutoindexStream::open(path, _request.getLocation(), options, chunked);
+	if (!stream) {
+		LOG_INFO("Cannot list directory " + path + ": " + std::string(strerror(errno)));
+		_response = buildDefaultResponse(errno == ENOENT || errno == ENOTDIR ? Http::NOT_FOUND : Http::FORBIDDEN);
+		return;
 	}
+	_response.setStatus(Http::OK);
+	_response.setBodyStream(std::move(stream));
+	_response.addHeader("Content-Type", options.json ? "application/json" : "text/html");
+	_response.addHeader("Vary", "Accept");
+	if (chunked)
+		_response.addHeader("Transfer-Encoding", "chunked");
+	else
+		_response.addHeader("Connection", "close");
 }
@@ -23,7 +23,7 @@
  *
  * @param route
  */
-bool RequestHandler::checkRequestCGI(Route& route) {
+bool RequestHandler::checkRequestCGI(const Route& route) {
 	LOG_INFO("Entered checkRequestCGI");
 
 	if (_request.getIsFile()) {
@@ -32,13 +32,13 @@ bool RequestHandler::checkRequestCGI(Route& route) {
 		// Checks if this extensions has to be handled by a CGI
 		LOG_DEBUG("Checks if this extension has to be handled by a CGI");
 
-		if (route.getCgiHandlers().find(_request.getResourceExtension()) == route.getCgiHandlers().end() ||
-			route.getCgiHandlers().at(_request.getResourceExtension()).empty()) {
+		const std::string* executable = route.getCgiHandler(_request.getResourceExtension());
+		if (!executable) {
 			LOG_DEBUG("  |- No CGI handlers found for extension:  " + _request.getResourceExtension() + "\n");
 			return false;
 		} else {
 			LOG_DEBUG("  |- Found:            " + _request.getResourceExtension());
-			LOG_DEBUG("  |- Executable path:  " + route.getCgiHandlers().at(_request.getResourceExtension()) + "\n");
+			LOG_DEBUG("  |- Executable path:  " + *executable + "\n");
 			return true;
 		}
 
@@ -0,0 +1,96 @@
+#include "CgiCache.hpp"
+#include "Logger.hpp"
+#include "RequestHandler.hpp"
+#include "ServerConfig.hpp"
+#include "webserv.hpp"
+
+/**
+ * @brief Cache key: listening address, Host, method, URI (including the query string) and the values
+ * of the headers listed in `cgi_cache_key_headers`
+ */
+std::string RequestHandler::buildCGICacheKey() const {
+	std::string key = _serverConfig->getHostIP() + ":" + std::to_string(_serverConfig->getPort()) + " " +
+					  _request.getHeader("Host") + " " + _request.getMethod() + " " + _request.getRequestUri();
+	for (const auto& header : _matchedRoute->getCgiCacheKeyHeaders())
+		key += "\n" + header + ": " + _request.getHeader(header);
+	return key;
+}
+
+/**
+ * @brief Consult the CgiCache before running the CGI.
+ * @return true if the request can go on: either it was answered from the cache (state FINISHED) or
+ * the CGI has to run. false while another request is filling the same entry, until the CgiCache wakes this one.
+ */
+bool RequestHandler::lookupCGICache() {
+	if (_cgi_cacheRole == CACHE_BYPASS || _cgi_cacheRole == CACHE_FILL)
+		return true;
+
+	if (_cgi_cacheRole == CACHE_NONE) {
+		if (_matchedRoute->getCgiCacheTtl() == 0 || _request.getMethodType() != Http::Method::GET) {
+			_cgi_cacheRole = CACHE_BYPASS;
+			return true;
+		}
+		_cgi_cacheKey = buildCGICacheKey();
+		_cgi_cacheWaitStart = std::chrono::steady_clock::now();
+	}
+
+	const bool staleWhileUpdating = _matchedRoute->getCgiCacheUseStale() & Route::STALE_UPDATING;
+	switch (CgiCache::getInstance().lookup(_cgi_cacheKey, staleWhileUpdating, _response, _waiter)) {
+		case CgiCache::Lookup::HIT:
+			LOG_DEBUG("CGI cache hit");
+			_response.addHeader("X-Cache-Status", "HIT");
+			break;
+		case CgiCache::Lookup::STALE:
+			LOG_DEBUG("CGI cache hit (stale, entry is being updated)");
+			_response.addHeader("X-Cache-Status", "STALE");
+			break;
+		case CgiCache::Lookup::FILL:
+			_cgi_cacheRole = CACHE_FILL;
+			return true;
+		case CgiCache::Lookup::PASS:
+			_cgi_cacheRole = CACHE_BYPASS;
+			return true;
+		case CgiCache::Lookup::WAIT:
+			if (std::chrono::steady_clock::now() - _cgi_cacheWaitStart >
+				std::chrono::milliseconds(DEFAULT_CGI_TIMEOUT_MS)) {
+				LOG_WARN("Gave up waiting for the CGI cache entry to be filled, running the CGI");
+				CgiCache::getInstance().forget(_cgi_cacheKey, _waiter);
+				_cgi_cacheRole = CACHE_BYPASS;
+				return true;
+			}
+			_cgi_cacheRole = CACHE_WAIT;
+			return false;
+	}
+	_cgi_cacheRole = CACHE_HIT;
+	_cgi_state = FINISHED;
+	return true;
+}
+
+/**
+ * @brief Hand the CGI result to the CgiCache if this request was filling an entry. Falls back to the
+ * stale copy on errors and timeouts when `cgi_cache_use_stale` allows it.
+ */
+void RequestHandler::storeCGICache() {
+	if (_cgi_cacheRole == CACHE_BYPASS) {
+		if (_matchedRoute->getCgiCacheTtl() != 0)
+			_response.addHeader("X-Cache-Status", "BYPASS");
+		return;
+	}
+	if (_cgi_cacheRole != CACHE_FILL)
+		return;
+
+	CgiCache& cache = CgiCache::getInstance();
+	cache.complete(_cgi_cacheKey, _response, std::chrono::milliseconds(_matchedRoute->getCgiCacheTtl()));
+	_cgi_cacheRole = CACHE_NONE;
+
+	const int useStale = _matchedRoute->getCgiCacheUseStale();
+	const Http::Status status = _response.getStatus();
+	const bool staleAllowed = (status == Http::GATEWAY_TIMEOUT && (useStale & Route::STALE_TIMEOUT)) ||
+							  (status >= Http::INTERNAL_SERVER_ERROR && (useStale & Route::STALE_ERROR));
+	if (staleAllowed && cache.serveStale(_cgi_cacheKey, _response)) {
+		LOG_WARN("CGI failed with " + std::to_string(status) + ", serving stale cache entry");
+		_response.addHeader("X-Cache-Status", "STALE");
+		return;
+	}
+	_response.addHeader("X-Cache-Status", "MISS");
+}
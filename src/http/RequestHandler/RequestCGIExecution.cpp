@@ -10,7 +10,7 @@
 /*                                                                            */
 /* ************************************************************************** */
 
-#include <poll.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -20,15 +20,64 @@
 #include <cstring>
 #include <thread>
 
+#include "CgiLimiter.hpp"
 #include "Logger.hpp"
+#include "Metrics.hpp"
 #include "RequestHandler.hpp"
 #include "Route.hpp"
+#include "ServerConfig.hpp"
 #include "webserv.hpp"
 
+/**
+ * @brief Ask the CgiLimiter for a slot before forking.
+ * @return true if the child may be started now. Otherwise the request is either still queued
+ * (state stays NONE, retried once the CgiLimiter wakes it) or rejected with 503 (state FINISHED).
+ */
+bool RequestHandler::admitRequestCGI(const Route& route) {
+	// Built once per request, a queued request is admitted again on every wakeup
+	if (_cgi_ticket.state == CgiLimiter::Ticket::State::IDLE)
+		_cgi_ticket.routeKey =
+			_serverConfig->getHostIP() + ":" + std::to_string(_serverConfig->getPort()) + route.getPath();
+
+	_cgi_ticket.waiter = _waiter;
+	switch (CgiLimiter::getInstance().acquire(_cgi_ticket, route.getCgiMaxProcesses())) {
+		case CgiLimiter::Admission::GRANTED:
+			return true;
+		case CgiLimiter::Admission::QUEUED:
+			return false;
+		case CgiLimiter::Admission::REJECTED:
+		case CgiLimiter::Admission::TIMED_OUT:
+			break;
+	}
+	_response = buildDefaultResponse(Http::SERVICE_UNAVAILABLE);
+	_response.addHeader("Retry-After", std::to_string(CgiLimiter::getInstance().getRetryAfter()));
+	_cgi_state = FINISHED;
+	return false;
+}
+
+/**
+ * @brief Make sure the child is gone and give its slot back to the CgiLimiter
+ */
+void RequestHandler::finishRequestCGI() {
+	if (_cgi_pid > 0) {
+		LOG_DEBUG("Killing CGI process with PID: " + std::to_string(_cgi_pid));
+		kill(_cgi_pid, SIGKILL);
+		waitpid(_cgi_pid, nullptr, 0);
+		_cgi_pid = 0;
+	}
+	CgiLimiter::getInstance().release(_cgi_ticket);
+}
+
 void RequestHandler::handleRequestCGIExecution(const Route& route) {
 	_cgi_valid = true;
+	if (_cgi_state == FINISHED)	 // answered from the CgiCache
+		return;
 	if (!_cgi_state) {
-		const std::string cgiPath = route.getCgiHandlers().at(_request.getResourceExtension());
+		if (!admitRequestCGI(route))
+			return;
+
+		// checkRequestCGI found the handler
+		const std::string cgiPath = *route.getCgiHandler(_request.getResourceExtension());
 
 		// Create environment variables for CGI
 		LOG_INFO("Create environment variables for CGI");
@@ -59,6 +108,9 @@ void RequestHandler::handleRequestCGIExecution(const Route& route) {
 
 		pipe(_cgi_pipeIn);
 		pipe(_cgi_pipeOut);
+		// Other CGI children and the new binary of an upgrade must not hold the pipes open, dup2 clears the flag
+		for (const int fd : {_cgi_pipeIn[0], _cgi_pipeIn[1], _cgi_pipeOut[0], _cgi_pipeOut[1]})
+			fcntl(fd, F_SETFD, FD_CLOEXEC);
 
 		const pid_t pid = fork();
 		if (pid == 0) {
@@ -91,136 +143,108 @@ void RequestHandler::handleRequestCGIExecution(const Route& route) {
 		}
 		close(_cgi_pipeIn[0]);
 		close(_cgi_pipeOut[1]);
+		fcntl(_cgi_pipeOut[0], F_SETFL, O_NONBLOCK);
 		_cgi_pid = pid;
-		if (_request.getMethod() == "POST") {
+		Metrics::getInstance().cgiSpawned();
+		if (_request.getMethodType() == Http::Method::POST) {
+			// The body is written as the pipe takes it, from the event loop
+			fcntl(_cgi_pipeIn[1], F_SETFL, O_NONBLOCK);
+			_cgi_bodyOffset = 0;
 			_cgi_state = WRITING;
+			_cgi_startTime = std::chrono::steady_clock::now();
 		} else {
 			close(_cgi_pipeIn[1]);
 			_cgi_state = WAITING;
-			_cgi_startTime = std::chrono::duration_cast<std::chrono::milliseconds>(
-				std::chrono::high_resolution_clock::now().time_since_epoch());
+			_cgi_startTime = std::chrono::steady_clock::now();
 		}
 	}
-	if (_cgi_state == WRITING) {
-		LOG_DEBUG("Writing to CGI process");
-
-		size_t bytesToWrite = _request.getBody().size();
-		size_t offset = 0;
-		while (bytesToWrite > 0) {
-			pollfd pfd{};
-			pfd.fd = _cgi_pipeIn[1];
-			pfd.events = POLLOUT;
-
-			int pollret = poll(&pfd, 1, DEFAULT_POLL_TIMEOUT);
-			if (pollret < 0) {
-				LOG_ERROR("Poll error while writing to CGI process: " + std::string(strerror(errno)));
-				close(_cgi_pipeIn[1]);
-				_response = buildDefaultResponse(Http::INTERNAL_SERVER_ERROR);
-				_cgi_state = FINISHED;
-				return;
-			}
-			if (pollret == 0) {
-				LOG_WARN("Poll timeout while writing to CGI process");
-				close(_cgi_pipeIn[1]);
-				_response = buildDefaultResponse(Http::GATEWAY_TIMEOUT);
-				_cgi_state = FINISHED;
-				return;
-			}
-			if (pfd.revents & POLLOUT) {
-				size_t chunkSize = std::min(POST_WRITE_SIZE, bytesToWrite);
-				ssize_t written = write(_cgi_pipeIn[1], _request.getBody().c_str() + offset, chunkSize);
-				if (written == 0) {
-					LOG_WARN("Write to CGI process returned 0");
-					close(_cgi_pipeIn[1]);
-					_response = buildDefaultResponse(Http::INTERNAL_SERVER_ERROR);
-					_cgi_state = FINISHED;
-					return;
-				} else if (written < 0) {
-					LOG_ERROR("Write error to CGI process: " + std::string(strerror(errno)));
-					close(_cgi_pipeIn[1]);
-					_response = buildDefaultResponse(Http::INTERNAL_SERVER_ERROR);
-					_cgi_state = FINISHED;
-					return;
-				}
-				offset += written;
-				bytesToWrite -= written;
-			} else {
-				LOG_WARN("Unexpected poll revents: " + std::to_string(pfd.revents));
-				close(_cgi_pipeIn[1]);
-				_response = buildDefaultResponse(Http::INTERNAL_SERVER_ERROR);
-				_cgi_state = FINISHED;
-				return;
-			}
-		}
-		close(_cgi_pipeIn[1]);
-		_cgi_state = WAITING;
-		_cgi_startTime = std::chrono::duration_cast<std::chrono::milliseconds>(
-			std::chrono::high_resolution_clock::now().time_since_epoch());
-	}
-	if (_cgi_state == WAITING) {
+	if (_cgi_state == WRITING)
+		writeRequestCGIBody();
+	// Read the output while the child runs, a child that writes more than the pipe holds would never exit otherwise
+	if (_cgi_state == WAITING)
+		readRequestCGIOutput();
+	if (_cgi_state == WAITING || _cgi_state == READING) {
 		LOG_TRACE("Waiting for CGI process to finish");
-		pid_t result = waitpid(_cgi_pid, &_cgi_status, WNOHANG);
-		if (result == _cgi_pid) {
-			_cgi_state = READING;
-		} else {
-			auto now = std::chrono::high_resolution_clock::now();
-			auto elapsed_ms =
-				std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch() - _cgi_startTime).count();
-			if (elapsed_ms > DEFAULT_CGI_TIMEOUT_MS) {
-				LOG_ERROR("CGI execution timed out. Killing process...");
-				LOG_DEBUG("Killing CGI process with PID: " + std::to_string(_cgi_pid));
-				kill(_cgi_pid, SIGKILL);
-				waitpid(_cgi_pid, &_cgi_status, 0);	 // TODO: why is this needed?
-				_response = buildDefaultResponse(Http::GATEWAY_TIMEOUT);
-				_cgi_state = FINISHED;
+		if (_cgi_state == READING && waitpid(_cgi_pid, &_cgi_status, WNOHANG) == _cgi_pid) {
+			_cgi_pid = 0;
+			_response = HttpResponse(_response.getBody());
+			_response.setStatus(_cgi_status == 0 ? Http::OK : Http::INTERNAL_SERVER_ERROR);
+			if (_response.getStatus() == Http::INTERNAL_SERVER_ERROR) {
+				_response = buildDefaultResponse(Http::INTERNAL_SERVER_ERROR);
+				LOG_ERROR("CGI proces returned with error");
 			}
-		}
-	}
-	if (_cgi_state == cgiState::READING) {
-		LOG_DEBUG("Reading from CGI process");
-		char buffer[CGI_READ_BUFFER_SIZE];
-		pollfd pfd{};
-		pfd.fd = _cgi_pipeOut[0];
-		pfd.events = POLLIN;
-
-		int pollret = poll(&pfd, 1, DEFAULT_POLL_TIMEOUT);
-		if (pollret < 0) {
-			LOG_ERROR("Poll error while reading from CGI process: " + std::string(strerror(errno)));
-			close(_cgi_pipeOut[0]);
-			_response = buildDefaultResponse(Http::INTERNAL_SERVER_ERROR);
 			_cgi_state = FINISHED;
-			return;
-		}
-		if (pollret == 0) {
-			LOG_WARN("Poll timeout while reading from CGI process");
-			close(_cgi_pipeOut[0]);
+		} else if (std::chrono::steady_clock::now() - _cgi_startTime >
+				   std::chrono::milliseconds(DEFAULT_CGI_TIMEOUT_MS)) {
+			LOG_ERROR("CGI execution timed out. Killing process...");
+			Metrics::getInstance().cgiTimedOut();
+			LOG_DEBUG("Killing CGI process with PID: " + std::to_string(_cgi_pid));
+			kill(_cgi_pid, SIGKILL);
+			waitpid(_cgi_pid, &_cgi_status, 0);	 // TODO: why is this needed?
+			_cgi_pid = 0;
+			if (_cgi_state == WAITING)
+				close(_cgi_pipeOut[0]);
 			_response = buildDefaultResponse(Http::GATEWAY_TIMEOUT);
 			_cgi_state = FINISHED;
-			return;
 		}
-		if (pfd.revents & POLLIN) {
-			const ssize_t bytesRead = read(_cgi_pipeOut[0], buffer, sizeof(buffer));
-			if (bytesRead > 0) {
-				_response.appendToBody(std::string(buffer, bytesRead));
-			} else if (bytesRead == 0) {
-				_response = HttpResponse(_response.getBody());
-				_response.setStatus(_cgi_status == 0 ? Http::OK : Http::INTERNAL_SERVER_ERROR);
-				if (_response.getStatus() == Http::INTERNAL_SERVER_ERROR) {
-					_response = buildDefaultResponse(Http::INTERNAL_SERVER_ERROR);
-					LOG_ERROR("CGI proces returned with error");
-				}
-				close(_cgi_pipeOut[0]);
-				_cgi_state = FINISHED;
-			} else {
-				LOG_ERROR("Error reading from CGI process");
-				_response = buildDefaultResponse(Http::INTERNAL_SERVER_ERROR);
-				_cgi_state = FINISHED;
-			}
+	}
+}
+
+/**
+ * @brief Write as much of the request body to the child as its stdin pipe takes without blocking. Once the body is
+ * complete, the pipe is closed and the state is WAITING. A child that does not read its input is killed after
+ * the CGI timeout, like one that does not exit.
+ */
+void RequestHandler::writeRequestCGIBody() {
+	LOG_DEBUG("Writing to CGI process");
+	const std::string& body = _request.getBody();
+	while (_cgi_bodyOffset < body.size()) {
+		const size_t chunkSize = std::min(POST_WRITE_SIZE, body.size() - _cgi_bodyOffset);
+		const ssize_t written = write(_cgi_pipeIn[1], body.data() + _cgi_bodyOffset, chunkSize);
+		if (written > 0) {
+			_cgi_bodyOffset += written;
+			continue;
+		}
+		if (written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			if (std::chrono::steady_clock::now() - _cgi_startTime <= std::chrono::milliseconds(DEFAULT_CGI_TIMEOUT_MS))
+				return;	 // getWait() asks for POLLOUT on the pipe
+			LOG_WARN("Timeout while writing to CGI process");
+			Metrics::getInstance().cgiTimedOut();
+			_response = buildDefaultResponse(Http::GATEWAY_TIMEOUT);
 		} else {
-			LOG_WARN("Unexpected poll revents: " + std::to_string(pfd.revents));
-			close(_cgi_pipeOut[0]);
+			LOG_ERROR("Write error to CGI process: " + std::string(strerror(errno)));
 			_response = buildDefaultResponse(Http::INTERNAL_SERVER_ERROR);
-			_cgi_state = FINISHED;
 		}
+		close(_cgi_pipeIn[1]);
+		close(_cgi_pipeOut[0]);
+		_cgi_state = FINISHED;
+		return;
+	}
+	close(_cgi_pipeIn[1]);
+	_cgi_state = WAITING;
+	_cgi_startTime = std::chrono::steady_clock::now();
+}
+
+/**
+ * @brief Read what the child wrote so far without blocking. Once it closed its output, the state is READING and
+ * the child is about to exit.
+ */
+void RequestHandler::readRequestCGIOutput() {
+	LOG_DEBUG("Reading from CGI process");
+	static char buffer[CGI_READ_BUFFER_SIZE];
+	const ssize_t bytesRead = read(_cgi_pipeOut[0], buffer, sizeof(buffer));
+	if (bytesRead > 0) {
+		_response.appendToBody(std::string(buffer, bytesRead));
+		return;
+	}
+	if (bytesRead == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return;
+	close(_cgi_pipeOut[0]);
+	if (bytesRead == 0) {
+		_cgi_state = READING;
+		return;
 	}
+	LOG_ERROR("Error reading from CGI process: " + std::string(strerror(errno)));
+	_response = buildDefaultResponse(Http::INTERNAL_SERVER_ERROR);
+	_cgi_state = FINISHED;
 }
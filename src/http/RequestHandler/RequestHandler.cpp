@@ -12,22 +12,68 @@
 
 #include "RequestHandler.hpp"
 
+#include <poll.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <string>
 #include <vector>
 
 #include "Logger.hpp"
 #include "ServerConfig.hpp"
+#include "webserv.hpp"
+
+namespace {
+// Matched when no location of the server covers the request
+const Route NO_ROUTE;
+}  // namespace
+
+// Methods the request line parser rejects with 501 have no handler
+const RequestHandler::MethodHandler RequestHandler::METHOD_HANDLERS[Http::METHOD_COUNT] = {
+	&RequestHandler::handleGetRequest, &RequestHandler::handlePostRequest, &RequestHandler::handleDeleteRequest};
 
-RequestHandler::RequestHandler(ServerConfig& serverConfig) : _serverConfig(serverConfig) {
+RequestHandler::RequestHandler(const ServerConfig& serverConfig)
+	: _serverConfig(&serverConfig), _matchedRoute(&NO_ROUTE) {
 	LOG_INFO("RequestHandler created");
 }
 
+RequestHandler::~RequestHandler() {
+	// Connection closed while the CGI was still in flight
+	if (_cgi_state == WRITING)
+		close(_cgi_pipeIn[1]);
+	if (_cgi_state == WRITING || _cgi_state == WAITING)
+		close(_cgi_pipeOut[0]);
+	finishRequestCGI();
+	if (_cgi_cacheRole == CACHE_FILL)
+		CgiCache::getInstance().abandon(_cgi_cacheKey);
+	else if (_cgi_cacheRole == CACHE_WAIT)
+		CgiCache::getInstance().forget(_cgi_cacheKey, _waiter);
+}
+
 #pragma region Getters
 
-ServerConfig& RequestHandler::getConfig() const { return _serverConfig; }
+const ServerConfig& RequestHandler::getConfig() const { return *_serverConfig; }
+
+const Route& RequestHandler::getMatchedRoute() const { return *_matchedRoute; }
+
+std::chrono::steady_clock::time_point RequestHandler::getRouteMatchedAt() const { return _routeMatchedAt; }
+
+pid_t RequestHandler::getCgiPid() const { return _cgi_pid; }
+
+cgiState RequestHandler::getCgiState() const { return _cgi_state; }
 
-void RequestHandler::setConfig(const ServerConfig& server_config) const { _serverConfig = server_config; }
+/**
+ * @brief Also forgets the matched route, it may belong to configs that are about to be released
+ */
+void RequestHandler::setConfig(const ServerConfig& server_config) {
+	_serverConfig = &server_config;
+	_matchedRoute = &NO_ROUTE;
+}
+
+/**
+ * @brief Id the CgiLimiter and the CgiCache hand back to the event loop when a waiting request may go on
+ */
+void RequestHandler::setWaiter(const int waiter) { _waiter = waiter; }
 
 #pragma endregion
 
@@ -37,36 +83,24 @@ void RequestHandler::setConfig(const ServerConfig& server_config) const { _serve
 void RequestHandler::findMatchingRoute() {
 	// Match to the server's possible locations
 	LOG_INFO("Getting best match for the corresponding location path");
-	// Track the best match
-	Route matchedRoute;
-	size_t longestMatchLength = 0;
-	for (const auto& route : _serverConfig.getRoutes()) {
-		// Check if the current route is a prefix of the path
-		if (_request.getLocation().find(route.getPath()) == 0) {  // Route is a prefix of the path
-
-			// Select this route if it's the longest match so far
-			if (const size_t routeLength = route.getPath().size(); routeLength > longestMatchLength) {
-				matchedRoute = route;
-				longestMatchLength = routeLength;
-			}
-		}
-	}
-	_matchedRoute = matchedRoute;
-	LOG_DEBUG("  |- best match:   " + _matchedRoute.getPath() + "\n");
+	const RouteTable::Match match = _serverConfig->getRouteTable().find(_request.getLocation());
+	_matchedRoute = match.route ? match.route : &NO_ROUTE;
+	const size_t longestMatchLength = match.length;
+	LOG_DEBUG("  |- best match:   " + _matchedRoute->getPath() + "\n");
 
-	if (!_matchedRoute.getRoot().empty()) {
-		_request.setServerSidePath("." + _matchedRoute.getRoot() + "/" +
+	if (!_matchedRoute->getRoot().empty()) {
+		_request.setServerSidePath("." + _matchedRoute->getRoot() + "/" +
 								   _request.getLocation().erase(0, longestMatchLength));
 	} else
-		_request.setServerSidePath("." + _serverConfig.getRoot() + "/" + _request.getLocation());
+		_request.setServerSidePath("." + _serverConfig->getRoot() + "/" + _request.getLocation());
 
 	// if matches directly to a route, check for index file in the directory and change if applicable
 	if (_request.getLocation().back() == '/') {
 		std::string indexFile;
-		if (_matchedRoute.getIndex() != "") {
-			indexFile = _matchedRoute.getIndex();
+		if (_matchedRoute->getIndex() != "") {
+			indexFile = _matchedRoute->getIndex();
 		} else {
-			indexFile = _serverConfig.getIndex();
+			indexFile = _serverConfig->getIndex();
 		}
 		if (indexFile.empty()) {
 			return;
@@ -109,27 +143,30 @@ bool RequestHandler::handleRequest(const HttpRequest& request) {
 
 		// Find the best matching route
 		findMatchingRoute();
+		_routeMatchedAt = std::chrono::steady_clock::now();
 
 		const std::filesystem::path serverSidePath(_request.getServerSidePath());
 		LOG_DEBUG("  |- filesystem::path:        " + serverSidePath.generic_string() + "\n");
 
-		if (_matchedRoute.getCode() != 0) {
+		if (_matchedRoute->getCode() != 0) {
 			LOG_INFO("Route has a return directive.");
 			_response = handleRedirectRequest();
 			return true;
 		}
 
 		// check if method is allowed
-		if (std::find(_matchedRoute.getMethods().begin(), _matchedRoute.getMethods().end(), _request.getMethod()) ==
-			_matchedRoute.getMethods().end()) {
+		if (!_matchedRoute->isMethodAllowed(_request.getMethodType())) {
 			LOG_WARN("Method not allowed");
 			_response = buildDefaultResponse(Http::METHOD_NOT_ALLOWED);
 			return true;
 		}
 
 		// Check resource existence
-		if (_request.getMethod() != "POST" ||
-			!_matchedRoute.getCgiHandlers().empty()) {	// Check only if not POST or POST w/ CGI
+		const bool isProxied = !_matchedRoute->getProxyPass().empty();
+		const bool isMetrics = _matchedRoute->isMetrics() || _matchedRoute->isConnectionTable();
+		if (!isProxied && !isMetrics &&
+			(_request.getMethodType() != Http::Method::POST ||
+			 !_matchedRoute->getCgiHandlers().empty())) {  // Check only if not POST or POST w/ CGI
 			LOG_INFO("Checking resource existence");
 			if (!exists(serverSidePath)) {
 				_response = buildDefaultResponse(Http::NOT_FOUND);
@@ -143,20 +180,23 @@ bool RequestHandler::handleRequest(const HttpRequest& request) {
 			if (_request.getIsFile()) {
 				// Extracting file extension
 				LOG_INFO("Extracting resource extensions");
-				const size_t fileStart = _request.getServerSidePath().find_last_of('/');
-				LOG_DEBUG("  |- Resource from trailing '/':  " +
-						  _request.getServerSidePath().substr(fileStart + 1, _request.getServerSidePath().back()));
-				const std::string filename =
-					_request.getServerSidePath().substr(fileStart + 1, _request.getServerSidePath().back());
-				const size_t extensionStart = filename.find_first_of('.');
-				LOG_DEBUG("  |- Extension:                    " + filename.substr(extensionStart, filename.back()) +
-						  "\n");
-				_request.setResourceExtension(filename.substr(extensionStart, filename.back()));
+				const std::string& serverSide = _request.getServerSidePath();
+				const size_t fileStart = serverSide.find_last_of('/') + 1;	// npos + 1 == 0
+				const size_t extensionStart = serverSide.find_last_of('.');
+				_request.setResourceExtension(extensionStart != std::string::npos && extensionStart > fileStart
+												  ? serverSide.substr(extensionStart)
+												  : "");
+				LOG_DEBUG("  |- Extension:                    " + _request.getResourceExtension() + "\n");
 			}
 		}
-		if (!_matchedRoute.getCgiHandlers().empty()) {
+		if (isProxied) {
+			LOG_INFO("Route is proxied to upstream " + _matchedRoute->getProxyPass());
+			_cgi_valid = false;
+		} else if (isMetrics) {
+			_cgi_valid = false;
+		} else if (!_matchedRoute->getCgiHandlers().empty()) {
 			LOG_INFO("Checking for route's information's: CGI");
-			_cgi_valid = checkRequestCGI(_matchedRoute);
+			_cgi_valid = checkRequestCGI(*_matchedRoute);
 		} else {
 			LOG_DEBUG("  |- No CGI handlers found for extension:  " + _request.getResourceExtension());
 			_cgi_valid = false;
@@ -164,10 +204,26 @@ bool RequestHandler::handleRequest(const HttpRequest& request) {
 		_parsingDone = true;
 	}
 
+	if (!_matchedRoute->getProxyPass().empty()) {
+		if (!handleProxyRequest())
+			return false;
+		if (_request.getHttpVersion() == "HTTP/1.0")
+			_response.setHttpVersion("HTTP/1.0");
+		// Do not override a `Connection: close` required by the framing of the upstream response
+		if (!_request.getHeader("Connection").empty())
+			_response.addHeaderIfNew("Connection", _request.getHeader("Connection"));
+		_response.setDefaultHeaders();
+		return true;
+	}
+
 	if (_cgi_valid) {
-		handleRequestCGIExecution(_matchedRoute);
+		if (_cgi_state == NONE && !lookupCGICache())
+			return false;
+		handleRequestCGIExecution(*_matchedRoute);
 		if (_cgi_state != FINISHED)
 			return false;
+		finishRequestCGI();
+		storeCGICache();
 		if (!_request.getHeader("Connection").empty())
 			_response.addHeader("Connection", _request.getHeader("Connection"));
 		_response.setDefaultHeaders();
@@ -176,28 +232,53 @@ bool RequestHandler::handleRequest(const HttpRequest& request) {
 
 	bool isFinished = false;
 
-	if (_request.getMethod() == "GET")
-		isFinished = handleGetRequest();
-	else if (_request.getMethod() == "POST")
-		isFinished = handlePostRequest();
-	else if (_request.getMethod() == "DELETE") {
-		handleDeleteRequest();
-		isFinished = true;
-	}
+	if (_matchedRoute->isMetrics())
+		isFinished = handleMetricsRequest();
+	else if (_matchedRoute->isConnectionTable())
+		isFinished = handleConnectionTableRequest();
+	else if (const MethodHandler handler = METHOD_HANDLERS[static_cast<size_t>(_request.getMethodType())])
+		isFinished = (this->*handler)();
 
 	if (isFinished) {
 		if (_request.getHttpVersion() == "HTTP/1.0")
 			_response.setHttpVersion("HTTP/1.0");
+		// Do not override a `Connection: close` required by the framing of a streamed body
 		if (!_request.getHeader("Connection").empty())
-			_response.addHeader("Connection", _request.getHeader("Connection"));
+			_response.addHeaderIfNew("Connection", _request.getHeader("Connection"));
 		_response.setDefaultHeaders();
 	}
 	return isFinished;
 }
 
+/**
+ * @brief What handleRequest() waits for after it returned false: the upstream connection, another request filling
+ * the CgiCache entry or a slot of the CgiLimiter (both wake it with takeReady()), room in the stdin pipe of the CGI
+ * child, its output, or the child to exit once its output is complete. Everything else is resumed on the next loop
+ * iteration.
+ */
+IoWait RequestHandler::getWait() const {
+	if (_proxy)
+		return _proxy->getWait();
+	if (!_cgi_valid)
+		return {};
+	if (_cgi_cacheRole == CACHE_WAIT)
+		return {-1, 0, _cgi_cacheWaitStart + std::chrono::milliseconds(DEFAULT_CGI_TIMEOUT_MS)};
+	if (_cgi_ticket.state == CgiLimiter::Ticket::State::QUEUED)
+		return {-1, 0, _cgi_ticket.deadline};
+	const IoWait::Clock::time_point timeout = _cgi_startTime + std::chrono::milliseconds(DEFAULT_CGI_TIMEOUT_MS);
+	if (_cgi_state == WRITING)
+		return {_cgi_pipeIn[1], POLLOUT, timeout};
+	if (_cgi_state == WAITING)
+		return {_cgi_pipeOut[0], POLLIN, timeout};
+	if (_cgi_state == READING)
+		return {-1, 0, std::min(timeout, IoWait::Clock::now() + std::chrono::milliseconds(CGI_REAP_INTERVAL_MS))};
+	return {};
+}
+
 HttpResponse RequestHandler::getResponse() {
 	_bytesReadFromFile = 0;
 	HttpResponse tmp = _response;
+	tmp.setHeaderBlock(_matchedRoute->getHeaderBlock(tmp.getStatus()));
 	_response = HttpResponse();
 	_parsingDone = false;
 	_fileName = "";
@@ -211,7 +292,13 @@ HttpResponse RequestHandler::getResponse() {
 	_cgi_pipeOut[1] = 0;
 	_cgi_pipeIn[0] = 0;
 	_cgi_pipeIn[1] = 0;
-	_cgi_startTime = std::chrono::milliseconds(0);
+	_cgi_bodyOffset = 0;
+	_cgi_startTime = {};
+	if (_cgi_cacheRole == CACHE_FILL)
+		CgiCache::getInstance().abandon(_cgi_cacheKey);
+	_cgi_cacheRole = CACHE_NONE;
+	_cgi_cacheKey.clear();
+	_proxy.reset();
 
 	return tmp;
 }
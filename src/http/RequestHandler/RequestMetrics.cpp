@@ -0,0 +1,43 @@
+#include "ConnectionTable.hpp"
+#include "Logger.hpp"
+#include "Metrics.hpp"
+#include "RequestHandler.hpp"
+
+/**
+ * @brief Answer a request to a `metrics on` location with the current metrics in the Prometheus text format
+ */
+bool RequestHandler::handleMetricsRequest() {
+	if (_request.getMethodType() != Http::Method::GET) {
+		_response = buildDefaultResponse(Http::METHOD_NOT_ALLOWED);
+		return true;
+	}
+	LOG_DEBUG("Rendering metrics");
+	_response.setStatus(Http::OK);
+	_response.setBody(Metrics::getInstance().render());
+	_response.addHeader("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+	_response.addHeader("Cache-Control", "no-store");
+	return true;
+}
+
+/**
+ * @brief Answer a request to a `connection_table on` location with the table of open client connections.
+ * The table is streamed a batch of rows at a time.
+ */
+bool RequestHandler::handleConnectionTableRequest() {
+	if (_request.getMethodType() != Http::Method::GET) {
+		_response = buildDefaultResponse(Http::METHOD_NOT_ALLOWED);
+		return true;
+	}
+	LOG_DEBUG("Streaming connection table");
+	// HTTP/1.0 has no chunked coding, the end of the body is marked by closing the connection
+	const bool chunked = _request.getHttpVersion() != "HTTP/1.0";
+	_response.setStatus(Http::OK);
+	_response.setBodyStream(ConnectionTable::getInstance().stream(chunked));
+	_response.addHeader("Content-Type", "text/plain; charset=utf-8");
+	_response.addHeader("Cache-Control", "no-store");
+	if (chunked)
+		_response.addHeader("Transfer-Encoding", "chunked");
+	else
+		_response.addHeader("Connection", "close");
+	return true;
+}
@@ -0,0 +1,106 @@
+#include <algorithm>
+
+#include "Logger.hpp"
+#include "RequestHandler.hpp"
+#include "ServerConfig.hpp"
+#include "UpstreamManager.hpp"
+
+namespace {
+bool isHopByHopHeader(std::string name) {
+	std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+	return name == "connection" || name == "keep-alive" || name == "proxy-connection" || name == "te" ||
+		   name == "trailer" || name == "transfer-encoding" || name == "upgrade" || name == "content-length";
+}
+}  // namespace
+
+/**
+ * @brief Forward the request to the route's upstream. Called again whenever the upstream connection is ready
+ * (see getWait()) until the response head has arrived; the body is then streamed to the client by the
+ * ClientConnection.
+ * @return true once _response is ready
+ */
+bool RequestHandler::handleProxyRequest() {
+	if (!_proxy) {
+		const std::shared_ptr<Upstream> upstream = UpstreamManager::getInstance().get(_matchedRoute->getProxyPass());
+		if (!upstream) {
+			LOG_ERROR("Unknown upstream: " + _matchedRoute->getProxyPass());
+			_response = buildDefaultResponse(Http::BAD_GATEWAY);
+			return true;
+		}
+		// Only idempotent requests are sent again to another peer once they reached an upstream
+		_proxy = std::make_shared<ProxyRequest>(upstream, buildProxyHashKey(upstream->getHashKey()),
+												buildProxyRequest(), _request.getBody(),
+												_request.getMethodType() != Http::Method::POST,
+												std::chrono::milliseconds(_matchedRoute->getProxyTimeout()),
+												_request.getHttpVersion() == "HTTP/1.0");
+	}
+
+	if (!_proxy->process())
+		return false;
+
+	if (_proxy->getError() != Http::NONE) {
+		_response = buildDefaultResponse(_proxy->getError());
+	} else {
+		_response = _proxy->getResponse();
+		if (_proxy->hasBody())
+			_response.setBodyStream(_proxy);
+		if (_proxy->closesConnection())
+			_response.addHeader("Connection", "close");
+	}
+	_proxy.reset();
+	return true;
+}
+
+/**
+ * @brief Request line, end-to-end headers plus X-Forwarded-*. The (already received) body is sent from _request.
+ */
+std::string RequestHandler::buildProxyRequest() const {
+	std::string uri = _request.getRawRequestUri();
+	if (!_matchedRoute->getProxyPassUri().empty() && uri.rfind(_matchedRoute->getPath(), 0) == 0)
+		uri = _matchedRoute->getProxyPassUri() + uri.substr(_matchedRoute->getPath().size());
+
+	std::string request = _request.getMethod() + " " + uri + " HTTP/1.1\r\n";
+	std::string forwardedFor = _request.getClientAddress();
+	for (const auto& [key, value] : _request.getHeaders()) {
+		if (isHopByHopHeader(key))
+			continue;
+		if (key == "X-Forwarded-For") {
+			forwardedFor = value + ", " + forwardedFor;
+			continue;
+		}
+		request += key + ": " + value + "\r\n";
+	}
+	if (!_request.hasHeader("Host"))
+		request += "Host: " + _matchedRoute->getProxyPass() + "\r\n";
+	request += "X-Forwarded-For: " + forwardedFor + "\r\n";
+	request += "X-Real-IP: " + _request.getClientAddress() + "\r\n";
+	request += "X-Forwarded-Proto: http\r\n";
+	request += "Connection: keep-alive\r\n";
+	if (!_request.getBody().empty() || _request.getMethodType() == Http::Method::POST)
+		request += "Content-Length: " + std::to_string(_request.getBody().size()) + "\r\n";
+	request += "\r\n";
+	return request;
+}
+
+/**
+ * @brief Value of the upstream's `hash` key for this request
+ */
+std::string RequestHandler::buildProxyHashKey(const std::string& key) const {
+	if (key == "$request_uri")
+		return _request.getRawRequestUri();
+	if (key == "$uri")
+		return _request.getLocation();
+	if (key == "$remote_addr")
+		return _request.getClientAddress();
+	if (key.rfind("$http_", 0) == 0) {
+		// $http_x_user_id -> X-User-Id
+		for (const auto& [name, value] : _request.getHeaders()) {
+			std::string variable = name;
+			std::transform(variable.begin(), variable.end(), variable.begin(), ::tolower);
+			std::replace(variable.begin(), variable.end(), '-', '_');
+			if (variable == key.substr(6))
+				return value;
+		}
+	}
+	return "";
+}
@@ -23,8 +23,6 @@
 #include <sys/poll.h>
 #include <unistd.h>
 
-#include <cstring>
-#include <fstream>
 #include <optional>
 #include <string>
 
@@ -35,42 +33,11 @@ HttpResponse RequestHandler::buildDefaultResponse(Http::Status code, std::option
 		_request = request.value();
 	}
 
-	// Check if there's a configured error page for this status code
-	std::optional<std::string> errorPage = _serverConfig.getErrorPage(code);
-	try {
-		if (errorPage.has_value()) {
-			std::string path = "." + _serverConfig.getRoot() + "/" + errorPage.value();
-			std::filesystem::path fsPath(path);
-			LOG_DEBUG("Error page path: " + path);
-
-			if (std::ifstream file(fsPath); file.is_open()) {
-				std::string content((std::istreambuf_iterator(file)), std::istreambuf_iterator<char>());
-				response.setBody(content);
-				file.close();
-			} else {
-				LOG_ERROR("Failed to open error page: " + std::string(strerror(errno)));
-			}
-		}
-	} catch (const std::exception &e) {
-		LOG_ERROR("Error while getting custom error page: " + std::string(e.what()));
-	}
-
-	if (response.getBody().empty()) {
-		std::ostringstream body;
-		body << "<html><head><title>" << code << "</title><meta charset=\"utf-8\">"
-			 << R"(<meta name="viewport" content="width=device-width, initial-scale=1">)"
-			 << "</head><body><h1>Error " << code << ": " << getStatusMessage(code) << "</h1>"
-			 << "<img src=\"https://httpgoats.com/" << code << R"(.jpg" alt="Goat">)"
-			 << "</body><style>*{font-family:Arial,sans-serif;--background:#f2f2f2;--color:#030303;}"
-			 << "@media (prefers-color-scheme: dark){*{--background:#030303;--color:#f2f2f2;}}"
-			 << "body{display:flex;justify-content:center;align-items:center;height:100vh;margin:0;"
-			 << "flex-direction:column;background:var(--background);color:var(--color);}"
-			 << "h1{font-size:clamp(2rem,5vw,3rem);}"
-			 << "img{width:100%;max-width:500px;}</style></html>";
-
-		response.setBody(body.str());
-		response.addHeader("Content-Type", "text/html");
-	}
+	// Loaded when the configuration was read, the response shares the page
+	if (ErrorPages::Page page = _serverConfig->getLoadedErrorPages().find(code))
+		response.setSharedBody(std::move(page));
+	else
+		response.setBody(ErrorPages::render(code));
 
 	response.addHeader("Content-Length", std::to_string(response.getBody().size()));
 
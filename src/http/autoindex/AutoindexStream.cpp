@@ -0,0 +1,414 @@
+#include "AutoindexStream.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+
+#include "webserv.hpp"
+
+namespace {
+constexpr std::string_view STYLE =
+	"<style>\n"
+	"    * {\n"
+	"        --light: #f2f2f2;\n"
+	"        --dark: #ccc;\n"
+	"        --background: #f2f2f2;\n"
+	"        --color: #030303;\n"
+	"        --link-color: #0000EE;\n"
+	"    }\n"
+	"    @media (prefers-color-scheme: dark) {\n"
+	"        * {\n"
+	"            --light: #222;\n"
+	"            --dark: #3c3c3c;\n"
+	"            --background: #000;\n"
+	"            --color: #f2f2f2;\n"
+	"            --link-color: #33bbff;\n"
+	"        }\n"
+	"    }\n"
+	"    body {\n"
+	"        font-family: Courier, monospace;\n"
+	"        background-color: var(--background);\n"
+	"        color: var(--color);\n"
+	"    }\n"
+	"    table {\n"
+	"        width: 100%;\n"
+	"        border-collapse: collapse;\n"
+	"    }\n"
+	"    th, td {\n"
+	"        border: 1px solid var(--dark);\n"
+	"        text-align: left;\n"
+	"        padding: 8px;\n"
+	"    }\n"
+	"    tr:nth-child(even) {\n"
+	"        background-color: var(--dark);\n"
+	"    }\n"
+	"    a {\n"
+	"        color: var(--link-color);\n"
+	"        text-decoration: none;\n"
+	"    }\n"
+	"    a:hover {\n"
+	"        text-decoration: underline;\n"
+	"    }\n"
+	"    hr {\n"
+	"        border: 0;\n"
+	"        border-top: 1px solid var(--dark);\n"
+	"    }\n"
+	"</style>\n";
+
+constexpr std::string_view SORT_NAMES[] = {"name", "size", "time"};
+
+void appendEscaped(std::string& out, const std::string_view text) {
+	for (const char c : text) {
+		switch (c) {
+			case '&':
+				out += "&amp;";
+				break;
+			case '<':
+				out += "&lt;";
+				break;
+			case '>':
+				out += "&gt;";
+				break;
+			case '"':
+				out += "&quot;";
+				break;
+			default:
+				out += c;
+		}
+	}
+}
+
+/**
+ * @brief Percent-encode a path for a link, `/` and the unreserved characters stay as they are
+ */
+void appendEncoded(std::string& out, const std::string_view path) {
+	static constexpr char HEX[] = "0123456789ABCDEF";
+	for (const char c : path) {
+		const auto byte = static_cast<unsigned char>(c);
+		if (std::isalnum(byte) || c == '/' || c == '-' || c == '.' || c == '_' || c == '~') {
+			out += c;
+		} else {
+			out += '%';
+			out += HEX[byte >> 4];
+			out += HEX[byte & 0xF];
+		}
+	}
+}
+
+void appendChunk(std::string& out, const std::string& data) {
+	char size[20];
+	const int length = std::snprintf(size, sizeof(size), "%zx\r\n", data.size());
+	out.append(size, static_cast<size_t>(length));
+	out += data;
+	out += "\r\n";
+}
+
+/**
+ * @brief JSON string, the names of entries are passed through byte for byte apart from the escapes
+ */
+void appendJsonString(std::string& out, const std::string_view text) {
+	static constexpr char HEX[] = "0123456789abcdef";
+	out += '"';
+	for (const char c : text) {
+		const auto byte = static_cast<unsigned char>(c);
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if (byte < 0x20) {
+			out += "\\u00";
+			out += HEX[byte >> 4];
+			out += HEX[byte & 0xF];
+		} else
+			out += c;
+	}
+	out += '"';
+}
+
+void appendNumber(std::string& out, const uintmax_t number) {
+	char text[24];
+	const auto [end, error] = std::to_chars(text, text + sizeof(text), number);
+	out.append(text, end);
+}
+
+/**
+ * @brief Cursors are the hex-encoded entry name: the request target is percent-decoded before the query string is
+ * split, a name with `&` or `=` would not survive
+ */
+void appendCursor(std::string& out, const std::string_view name) {
+	static constexpr char HEX[] = "0123456789abcdef";
+	for (const char c : name) {
+		out += HEX[static_cast<unsigned char>(c) >> 4];
+		out += HEX[static_cast<unsigned char>(c) & 0xF];
+	}
+}
+
+std::string parseCursor(const std::string_view value) {
+	std::string name;
+	if (value.size() % 2 != 0)
+		return name;
+	name.reserve(value.size() / 2);
+	for (size_t i = 0; i < value.size(); i += 2) {
+		unsigned int byte = 0;
+		const auto [end, error] = std::from_chars(value.data() + i, value.data() + i + 2, byte, 16);
+		if (error != std::errc() || end != value.data() + i + 2)
+			return {};
+		name += static_cast<char>(byte);
+	}
+	return name;
+}
+
+size_t parseNumber(const std::string_view value) {
+	size_t number = 0;
+	const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), number);
+	return error == std::errc() && end == value.data() + value.size() ? number : 0;
+}
+}  // namespace
+
+/**
+ * @brief Stream for a directory, from the cache if the directory did not change since it was last read
+ * @return nullptr if the directory cannot be read, errno tells why
+ */
+std::shared_ptr<AutoindexStream> AutoindexStream::open(const std::string& path, std::string location,
+													   const Options& options, const bool chunked) {
+	struct stat directory {};
+	if (stat(path.c_str(), &directory) != 0)
+		return nullptr;
+	if (!S_ISDIR(directory.st_mode)) {
+		errno = ENOTDIR;
+		return nullptr;
+	}
+	if (auto listing = DirectoryListing::Cache::getInstance().find(path, directory))
+		return std::make_shared<AutoindexStream>(std::move(listing), nullptr, std::move(location), options, chunked);
+	auto reader = std::make_unique<DirectoryListing::Reader>(path);
+	if (!reader->isOpen())
+		return nullptr;
+	return std::make_shared<AutoindexStream>(nullptr, std::move(reader), std::move(location), options, chunked);
+}
+
+/**
+ * @brief Options from a query string, unknown parameters and values are ignored
+ */
+AutoindexStream::Options AutoindexStream::parseQuery(std::string_view query) {
+	Options options;
+	while (!query.empty()) {
+		const size_t end = std::min(query.find('&'), query.size());
+		const std::string_view parameter = query.substr(0, end);
+		query.remove_prefix(std::min(end + 1, query.size()));
+
+		const size_t equals = parameter.find('=');
+		if (equals == std::string_view::npos)
+			continue;
+		const std::string_view name = parameter.substr(0, equals);
+		const std::string_view value = parameter.substr(equals + 1);
+		if (name == "sort") {
+			for (size_t i = 0; i < std::size(SORT_NAMES); ++i) {
+				if (value == SORT_NAMES[i])
+					options.sort = static_cast<DirectoryListing::Sort>(i);
+			}
+		} else if (name == "order")
+			options.descending = value == "desc";
+		else if (name == "page")
+			options.page = parseNumber(value);
+		else if (name == "per_page")
+			options.perPage = parseNumber(value);
+		else if (name == "cursor")
+			options.cursor = parseCursor(value);
+		else if (name == "limit")
+			options.limit = parseNumber(value);
+	}
+	return options;
+}
+
+AutoindexStream::AutoindexStream(std::shared_ptr<const DirectoryListing> listing,
+								 std::unique_ptr<DirectoryListing::Reader> reader, std::string location,
+								 const Options& options, const bool chunked)
+	: _listing(std::move(listing)),
+	  _reader(std::move(reader)),
+	  _location(std::move(location)),
+	  _options(options),
+	  _chunked(chunked) {
+	appendEncoded(_linkBase, _location);
+	if (_linkBase.empty() || _linkBase.back() != '/')
+		_linkBase += '/';
+	if (_options.perPage == 0)
+		_options.perPage = AUTOINDEX_PAGE_SIZE_DEFAULT;
+}
+
+BodyStream::Status AutoindexStream::read(std::string& chunk, const size_t maxSize) {
+	chunk.clear();
+	if (_phase == Phase::DONE)
+		return Status::END;
+
+	std::string out;
+	if (_phase == Phase::HEAD) {
+		if (_options.json)
+			_appendJsonHead(out);
+		else
+			_appendHead(out);
+		_phase = Phase::READ;
+		if (_listing)
+			_startRows();
+	}
+	if (_phase == Phase::READ) {
+		if (!_reader->read(AUTOINDEX_READ_BATCH)) {
+			if (out.empty())
+				return Status::AGAIN;
+		} else {
+			_listing = _reader->finish();
+			_reader.reset();
+			_startRows();
+		}
+	}
+	if (_phase == Phase::ROWS) {
+		// A bounded batch per call keeps the event loop responsive for large directories
+		const size_t budget = std::min(maxSize, AUTOINDEX_BATCH_BYTES);
+		if (_options.json) {
+			while (_next < _end && out.size() < budget)
+				_appendJsonRow(out, _listing->at(_next++, DirectoryListing::Sort::NAME, false));
+		} else {
+			while (_next < _end && out.size() < budget)
+				_appendRow(out, _listing->at(_next++, _options.sort, _options.descending));
+		}
+		if (_next == _end) {
+			if (_options.json)
+				_appendJsonFoot(out);
+			else
+				_appendFoot(out);
+			_phase = Phase::DONE;
+		}
+	}
+
+	if (!_chunked) {
+		chunk = std::move(out);
+		return Status::DATA;
+	}
+	if (!out.empty())
+		appendChunk(chunk, out);
+	if (_phase == Phase::DONE)
+		chunk += "0\r\n\r\n";
+	return Status::DATA;
+}
+
+/**
+ * @brief The listing is complete, select the rows of the requested page
+ */
+void AutoindexStream::_startRows() {
+	_phase = Phase::ROWS;
+	_end = _listing->size();
+	if (_options.json) {
+		// Keyset pagination: entries added or removed meanwhile do not shift the following pages
+		_next = _options.cursor.empty() ? 0 : _listing->after(_options.cursor);
+		if (_options.limit != 0)
+			_end = _next + std::min(_options.limit, _end - _next);
+	} else if (_options.page != 0) {
+		const size_t skipped = _options.page - 1;
+		_next = skipped > _end / _options.perPage ? _end : std::min(skipped * _options.perPage, _end);
+		_end = _next + std::min(_options.perPage, _end - _next);
+	}
+	_first = _next;
+}
+
+void AutoindexStream::_appendHead(std::string& out) const {
+	out += "<!DOCTYPE html>\n<html>\n<head>\n<title>Index of ";
+	appendEscaped(out, _location);
+	out += "</title>\n<meta charset=\"UTF-8\">\n";
+	out += "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">\n";
+	out += "</head>\n<body>\n<h1>Index of ";
+	appendEscaped(out, _location);
+	out += "</h1>\n<hr>\n<table>\n<tr>";
+	// The column headers sort by their column, the current one toggles the order
+	static constexpr std::string_view TITLES[] = {"Name", "Size", "Last Modified"};
+	for (size_t i = 0; i < std::size(TITLES); ++i) {
+		const auto sort = static_cast<DirectoryListing::Sort>(i);
+		out += "<th><a href=\"";
+		_appendQuery(out, sort, sort == _options.sort && !_options.descending, _options.page != 0 ? 1 : 0);
+		out += "\">";
+		out += TITLES[i];
+		out += "</a></th>";
+	}
+	out += "</tr>\n";
+	if (_location != "/")
+		out += "<tr><td><a href=\"..\">../</a></td><td>-</td><td>-</td></tr>\n";
+}
+
+void AutoindexStream::_appendRow(std::string& out, const DirectoryListing::Entry& entry) const {
+	out += "<tr><td><a href=\"";
+	out += _linkBase;
+	appendEncoded(out, entry.name);
+	out += "\">";
+	appendEscaped(out, entry.name);
+	const DirectoryListing::Text& text = _listing->text(entry);
+	out += "</a></td><td>";
+	out += text.size;
+	out += "</td><td>";
+	out += text.modified;
+	out += "</td></tr>\n";
+}
+
+void AutoindexStream::_appendFoot(std::string& out) const {
+	out += "</table>\n";
+	if (_options.page != 0) {
+		const size_t pages = std::max<size_t>(1, (_listing->size() + _options.perPage - 1) / _options.perPage);
+		out += "<p>";
+		if (_options.page > 1) {
+			out += "<a href=\"";
+			_appendQuery(out, _options.sort, _options.descending, _options.page - 1);
+			out += "\">&laquo; previous</a> ";
+		}
+		out += "page " + std::to_string(_options.page) + " of " + std::to_string(pages);
+		if (_options.page < pages) {
+			out += " <a href=\"";
+			_appendQuery(out, _options.sort, _options.descending, _options.page + 1);
+			out += "\">next &raquo;</a>";
+		}
+		out += "</p>\n";
+	}
+	out += "<hr>\n</body>\n";
+	out += STYLE;
+	out += "</html>\n";
+}
+
+void AutoindexStream::_appendQuery(std::string& out, const DirectoryListing::Sort sort, const bool descending,
+								   const size_t page) const {
+	out += "?sort=";
+	out += SORT_NAMES[static_cast<size_t>(sort)];
+	out += descending ? "&amp;order=desc" : "&amp;order=asc";
+	if (page != 0)
+		out += "&amp;page=" + std::to_string(page) + "&amp;per_page=" + std::to_string(_options.perPage);
+}
+
+void AutoindexStream::_appendJsonHead(std::string& out) const {
+	out += "{\"path\":";
+	appendJsonString(out, _location);
+	out += ",\"entries\":[";
+}
+
+void AutoindexStream::_appendJsonRow(std::string& out, const DirectoryListing::Entry& entry) const {
+	if (_next != _first + 1)  // read() advanced _next past this entry already
+		out += ',';
+	out += "{\"name\":";
+	if (entry.directory) {
+		appendJsonString(out, std::string_view(entry.name).substr(0, entry.name.size() - 1));
+		out += ",\"type\":\"directory\"";
+	} else {
+		appendJsonString(out, entry.name);
+		out += ",\"type\":\"file\",\"size\":";
+		appendNumber(out, entry.size);
+	}
+	out += ",\"mtime\":";
+	appendNumber(out, static_cast<uintmax_t>(std::max<std::time_t>(entry.modified, 0)));
+	out += '}';
+}
+
+void AutoindexStream::_appendJsonFoot(std::string& out) const {
+	out += "],\"next\":";
+	if (_end < _listing->size() && _end > _first) {
+		out += '"';
+		appendCursor(out, _listing->at(_end - 1, DirectoryListing::Sort::NAME, false).name);
+		out += '"';
+	} else
+		out += "null";
+	out += "}\n";
+}
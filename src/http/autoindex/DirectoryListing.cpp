@@ -0,0 +1,225 @@
+#include "DirectoryListing.hpp"
+
+#include <fcntl.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+
+#include "Logger.hpp"
+#include "webserv.hpp"
+
+namespace {
+void formatSize(char (&out)[16], const uintmax_t size) {
+	static constexpr const char* UNITS[] = {"KB", "MB", "GB", "TB"};
+	if (size < 1024) {
+		std::snprintf(out, sizeof(out), "%ju B", size);
+		return;
+	}
+	double value = static_cast<double>(size) / 1024;
+	size_t unit = 0;
+	while (value >= 1024 && unit + 1 < std::size(UNITS)) {
+		value /= 1024;
+		++unit;
+	}
+	std::snprintf(out, sizeof(out), "%.2f %s", value, UNITS[unit]);
+}
+
+void formatTime(char (&out)[20], const std::time_t time) {
+	std::tm tm{};
+	if (!localtime_r(&time, &tm) || !std::strftime(out, sizeof(out), "%Y-%m-%d %H:%M:%S", &tm))
+		out[0] = '\0';
+}
+
+/**
+ * @brief Modification time including the nanoseconds, the field is `st_mtimespec` on macOS
+ */
+timespec modificationTime(const struct stat& st) {
+#ifdef __APPLE__
+	return st.st_mtimespec;
+#else
+	return st.st_mtim;
+#endif
+}
+}  // namespace
+
+#pragma region Reader
+
+/**
+ * @brief Open a directory for reading, check isOpen (errno tells why it failed)
+ */
+DirectoryListing::Reader::Reader(const std::string& path) : _path(path) {
+	_dir = opendir(path.c_str());
+	if (_dir && fstat(dirfd(_dir), &_stat) != 0) {
+		closedir(_dir);
+		_dir = nullptr;
+	}
+}
+
+DirectoryListing::Reader::~Reader() {
+	if (_dir)
+		closedir(_dir);
+}
+
+bool DirectoryListing::Reader::isOpen() const { return _dir != nullptr; }
+
+/**
+ * @brief Read up to `count` more entries. readdir fetches the entries from the kernel in large batches
+ * (getdents), each entry costs one stat relative to the directory.
+ * @return true once the whole directory has been read
+ */
+bool DirectoryListing::Reader::read(const size_t count) {
+	if (!_dir)
+		return true;
+	for (size_t i = 0; i < count; ++i) {
+		errno = 0;
+		const dirent* item = readdir(_dir);
+		if (!item) {
+			if (errno != 0)
+				LOG_WARN("Failed to read directory " + _path + ": " + std::string(strerror(errno)));
+			closedir(_dir);
+			_dir = nullptr;
+			return true;
+		}
+		if (std::strcmp(item->d_name, ".") == 0 || std::strcmp(item->d_name, "..") == 0)
+			continue;
+		// Follows symlinks like the listing always did, entries that cannot be stat'ed (dangling links) are skipped
+		struct stat st {};
+		if (fstatat(dirfd(_dir), item->d_name, &st, 0) != 0)
+			continue;
+
+		Entry entry;
+		entry.name = item->d_name;
+		entry.directory = S_ISDIR(st.st_mode);
+		entry.size = entry.directory ? 0 : static_cast<uintmax_t>(st.st_size);
+		entry.modified = st.st_mtime;
+		if (entry.directory)
+			entry.name += '/';
+		_entries.push_back(std::move(entry));
+	}
+	return false;
+}
+
+/**
+ * @brief The listing of the read directory, stored in the cache
+ */
+std::shared_ptr<const DirectoryListing> DirectoryListing::Reader::finish() {
+	auto listing = std::make_shared<const DirectoryListing>(_stat, std::move(_entries));
+	Cache::getInstance().store(_path, listing);
+	return listing;
+}
+
+#pragma endregion
+
+#pragma region Cache
+
+DirectoryListing::Cache& DirectoryListing::Cache::getInstance() {
+	static Cache instance;
+	return instance;
+}
+
+/**
+ * @brief Cached listing of a directory, nullptr if there is none or the directory changed since
+ */
+std::shared_ptr<const DirectoryListing> DirectoryListing::Cache::find(const std::string& path,
+																	  const struct stat& directory) {
+	const auto it = _slots.find(path);
+	if (it == _slots.end())
+		return nullptr;
+	if (!it->second.listing->isCurrent(directory)) {
+		_slots.erase(it);
+		return nullptr;
+	}
+	it->second.usedAt = ++_clock;
+	return it->second.listing;
+}
+
+/**
+ * @brief Keep a listing, the least recently used one makes room when the cache is full
+ */
+void DirectoryListing::Cache::store(const std::string& path, std::shared_ptr<const DirectoryListing> listing) {
+	if (_slots.size() >= AUTOINDEX_CACHE_MAX_ENTRIES && _slots.find(path) == _slots.end()) {
+		const auto oldest = std::min_element(_slots.begin(), _slots.end(), [](const auto& a, const auto& b) {
+			return a.second.usedAt < b.second.usedAt;
+		});
+		_slots.erase(oldest);
+	}
+	_slots[path] = Slot{std::move(listing), ++_clock};
+}
+
+#pragma endregion
+
+DirectoryListing::DirectoryListing(const struct stat& directory, std::vector<Entry> entries)
+	: _device(directory.st_dev),
+	  _inode(directory.st_ino),
+	  _modified(modificationTime(directory)),
+	  _entries(std::move(entries)) {
+	std::sort(_entries.begin(), _entries.end(), [](const Entry& a, const Entry& b) { return a.name < b.name; });
+}
+
+size_t DirectoryListing::size() const { return _entries.size(); }
+
+/**
+ * @brief Entry at a position of the listing in the given order
+ */
+const DirectoryListing::Entry& DirectoryListing::at(const size_t index, const Sort sort, const bool descending) const {
+	const size_t position = descending ? _entries.size() - 1 - index : index;
+	if (sort == Sort::NAME)
+		return _entries[position];
+	return _entries[_order(sort)[position]];
+}
+
+/**
+ * @brief Size and time of an entry of the listing as text, formatted once
+ */
+const DirectoryListing::Text& DirectoryListing::text(const Entry& entry) const {
+	if (_texts.empty())
+		_texts.resize(_entries.size());
+	Text& text = _texts[static_cast<size_t>(&entry - _entries.data())];
+	if (text.size[0] == '\0') {
+		if (entry.directory)
+			std::strcpy(text.size, "-");
+		else
+			formatSize(text.size, entry.size);
+		formatTime(text.modified, entry.modified);
+	}
+	return text;
+}
+
+/**
+ * @brief Position in name order of the first entry after `name`, which does not have to exist (anymore)
+ */
+size_t DirectoryListing::after(const std::string_view name) const {
+	const auto before = [](const std::string_view value, const Entry& entry) { return value < entry.name; };
+	const auto it = std::upper_bound(_entries.begin(), _entries.end(), name, before);
+	return static_cast<size_t>(it - _entries.begin());
+}
+
+/**
+ * @brief Whether the listing still shows the directory, which has been stat'ed just now
+ */
+bool DirectoryListing::isCurrent(const struct stat& directory) const {
+	const timespec modified = modificationTime(directory);
+	return directory.st_dev == _device && directory.st_ino == _inode && modified.tv_sec == _modified.tv_sec &&
+		   modified.tv_nsec == _modified.tv_nsec;
+}
+
+const std::vector<uint32_t>& DirectoryListing::_order(const Sort sort) const {
+	std::vector<uint32_t>& order = sort == Sort::SIZE ? _bySize : _byTime;
+	if (order.size() != _entries.size()) {
+		order.resize(_entries.size());
+		std::iota(order.begin(), order.end(), 0);
+		// Stable, so entries of the same size or time stay ordered by name
+		if (sort == Sort::SIZE)
+			std::stable_sort(order.begin(), order.end(), [this](const uint32_t a, const uint32_t b) {
+				return _entries[a].size < _entries[b].size;
+			});
+		else
+			std::stable_sort(order.begin(), order.end(), [this](const uint32_t a, const uint32_t b) {
+				return _entries[a].modified < _entries[b].modified;
+			});
+	}
+	return order;
+}
@@ -0,0 +1,226 @@
+#include "CgiCache.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+#include "Logger.hpp"
+#include "webserv.hpp"
+
+CgiCache& CgiCache::getInstance() {
+	static CgiCache instance;
+	return instance;
+}
+
+/**
+ * @brief Look up a key and take over the fill lock on a miss
+ * @param key cache key built by the RequestHandler
+ * @param staleWhileUpdating serve an expired entry while another request refreshes it
+ * @param response receives a copy of the cached response on HIT and STALE
+ * @param waiter handed back by takeReady() once the fill is done, on WAIT
+ */
+CgiCache::Lookup CgiCache::lookup(const std::string& key, const bool staleWhileUpdating, HttpResponse& response,
+								  const int waiter) {
+	const Clock::time_point now = Clock::now();
+
+	auto it = _entries.find(key);
+	if (it == _entries.end()) {
+		if (_entries.size() >= CGI_CACHE_MAX_ENTRIES)
+			_evict(now);
+		it = _entries.emplace(key, Entry()).first;
+	}
+
+	Entry& entry = it->second;
+	if (entry.passUntil > now) {
+		_counters.bypasses++;
+		return Lookup::PASS;
+	}
+	if (entry.hasResponse && now < entry.expiresAt) {
+		_counters.hits++;
+		response = entry.response;
+		_setAge(response, entry, now);
+		return Lookup::HIT;
+	}
+	if (entry.filling) {
+		if (staleWhileUpdating && entry.hasResponse &&
+			now - entry.expiresAt <= std::chrono::milliseconds(CGI_CACHE_MAX_STALE_MS)) {
+			_counters.stale++;
+			response = entry.response;
+			_setAge(response, entry, now);
+			return Lookup::STALE;
+		}
+		if (std::find(entry.waiters.begin(), entry.waiters.end(), waiter) == entry.waiters.end())
+			entry.waiters.push_back(waiter);
+		return Lookup::WAIT;
+	}
+	entry.filling = true;
+	_counters.misses++;
+	return Lookup::FILL;
+}
+
+/**
+ * @brief Hand the result of a FILL over to the cache and release the fill lock
+ * @param ttl the location's `cgi_cache_ttl`, overridden by `Cache-Control` from the script
+ */
+void CgiCache::complete(const std::string& key, const HttpResponse& response, const std::chrono::milliseconds ttl) {
+	const Clock::time_point now = Clock::now();
+	Entry& entry = _entries[key];
+	entry.filling = false;
+	_wakeWaiters(entry);
+
+	const Http::Status status = response.getStatus();
+	if (status != Http::OK && status != Http::MOVED_PERMANENTLY && status != Http::FOUND &&
+		status != Http::NOT_FOUND) {
+		// Errors are not cached, but the previous copy stays around for `cgi_cache_use_stale`
+		if (!entry.hasResponse)
+			_entries.erase(key);
+		return;
+	}
+
+	const std::chrono::milliseconds freshness = _freshnessFromHeaders(response, ttl);
+	if (freshness.count() <= 0 || response.getBody().size() > CGI_CACHE_MAX_ENTRY_SIZE) {
+		// Remember that this key is uncacheable so that concurrent requests do not queue up behind it
+		LOG_DEBUG("CGI response is not cacheable, bypassing cache for " + std::to_string(ttl.count()) + " ms");
+		entry.hasResponse = false;
+		entry.response = HttpResponse();
+		entry.passUntil = now + ttl;
+		return;
+	}
+
+	entry.response = response;
+	entry.hasResponse = true;
+	entry.storedAt = now;
+	entry.expiresAt = now + freshness;
+	_counters.stores++;
+	LOG_DEBUG("CGI response cached for " + std::to_string(freshness.count()) + " ms");
+}
+
+/**
+ * @brief Copy the last known response for a key, if it is not too old to be served anymore
+ * @return true if a stale response was copied
+ */
+bool CgiCache::serveStale(const std::string& key, HttpResponse& response) {
+	const Clock::time_point now = Clock::now();
+	const auto it = _entries.find(key);
+	if (it == _entries.end() || !it->second.hasResponse ||
+		now - it->second.expiresAt > std::chrono::milliseconds(CGI_CACHE_MAX_STALE_MS))
+		return false;
+	_counters.stale++;
+	response = it->second.response;
+	_setAge(response, it->second, now);
+	return true;
+}
+
+/**
+ * @brief Release the fill lock without a result (e.g. the filling connection went away)
+ */
+void CgiCache::abandon(const std::string& key) {
+	const auto it = _entries.find(key);
+	if (it == _entries.end())
+		return;
+	it->second.filling = false;
+	_wakeWaiters(it->second);
+	if (!it->second.hasResponse && it->second.passUntil <= Clock::now())
+		_entries.erase(it);
+}
+
+/**
+ * @brief Stop waiting for the fill of a key (e.g. the waiting connection went away)
+ */
+void CgiCache::forget(const std::string& key, const int waiter) {
+	const auto it = _entries.find(key);
+	if (it == _entries.end())
+		return;
+	std::vector<int>& waiters = it->second.waiters;
+	waiters.erase(std::remove(waiters.begin(), waiters.end(), waiter), waiters.end());
+}
+
+/**
+ * @brief Waiters of fills that are done, their requests look the key up again
+ */
+std::vector<int> CgiCache::takeReady() {
+	std::vector<int> ready;
+	ready.swap(_ready);
+	return ready;
+}
+
+const CgiCache::Counters& CgiCache::getCounters() const { return _counters; }
+
+size_t CgiCache::size() const { return _entries.size(); }
+
+/**
+ * @brief How long a response stays fresh: `s-maxage` or `max-age` from the script win over the
+ * configured ttl; `no-store`, `no-cache`, `private` and `Set-Cookie` make it uncacheable.
+ */
+std::chrono::milliseconds CgiCache::_freshnessFromHeaders(const HttpResponse& response,
+														   const std::chrono::milliseconds ttl) {
+	if (response.hasHeader("Set-Cookie"))
+		return std::chrono::milliseconds(0);
+
+	std::string cacheControl = response.getHeader("Cache-Control");
+	if (cacheControl.empty())
+		return ttl;
+	std::transform(cacheControl.begin(), cacheControl.end(), cacheControl.begin(), ::tolower);
+
+	long maxAge = -1;
+	long sharedMaxAge = -1;
+	std::istringstream directives(cacheControl);
+	std::string directive;
+	while (std::getline(directives, directive, ',')) {
+		directive.erase(0, directive.find_first_not_of(' '));
+		directive.erase(directive.find_last_not_of(' ') + 1);
+		if (directive == "no-store" || directive == "no-cache" || directive == "private")
+			return std::chrono::milliseconds(0);
+		try {
+			if (directive.rfind("s-maxage=", 0) == 0)
+				sharedMaxAge = std::stol(directive.substr(9));
+			else if (directive.rfind("max-age=", 0) == 0)
+				maxAge = std::stol(directive.substr(8));
+		} catch (const std::exception&) {
+			return std::chrono::milliseconds(0);
+		}
+	}
+	if (sharedMaxAge >= 0)
+		return std::chrono::seconds(sharedMaxAge);
+	if (maxAge >= 0)
+		return std::chrono::seconds(maxAge);
+	return ttl;
+}
+
+void CgiCache::_setAge(HttpResponse& response, const Entry& entry, const Clock::time_point now) {
+	const auto age = std::chrono::duration_cast<std::chrono::seconds>(now - entry.storedAt);
+	response.addHeader("Age", std::to_string(age.count()));
+}
+
+/**
+ * @brief Make room for a new entry: drop everything that cannot be served anymore, then the entry
+ * that expires first
+ */
+void CgiCache::_evict(const Clock::time_point now) {
+	const auto maxStale = std::chrono::milliseconds(CGI_CACHE_MAX_STALE_MS);
+	for (auto it = _entries.begin(); it != _entries.end();) {
+		const Entry& entry = it->second;
+		if (!entry.filling && entry.passUntil <= now && (!entry.hasResponse || now - entry.expiresAt > maxStale)) {
+			it = _entries.erase(it);
+			_counters.evictions++;
+		} else {
+			++it;
+		}
+	}
+	if (_entries.size() < CGI_CACHE_MAX_ENTRIES)
+		return;
+
+	auto oldest = _entries.end();
+	for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+		if (!it->second.filling && (oldest == _entries.end() || it->second.expiresAt < oldest->second.expiresAt))
+			oldest = it;
+	}
+	if (oldest != _entries.end()) {
+		_entries.erase(oldest);
+		_counters.evictions++;
+	}
+}
+
+void CgiCache::_wakeWaiters(Entry& entry) {
+	_ready.insert(_ready.end(), entry.waiters.begin(), entry.waiters.end());
+	entry.waiters.clear();
+}
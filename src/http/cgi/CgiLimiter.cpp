@@ -0,0 +1,175 @@
+#include "CgiLimiter.hpp"
+
+#include <algorithm>
+
+#include "Logger.hpp"
+
+CgiLimiter& CgiLimiter::getInstance() {
+	static CgiLimiter instance;
+	return instance;
+}
+
+/**
+ * @brief Apply the limits from the `http` block
+ * @param maxProcesses global limit of running CGI children (0 = unlimited)
+ * @param queueSize maximum number of requests waiting for a slot
+ * @param queueTimeoutMs maximum time a request may wait for a slot
+ */
+void CgiLimiter::configure(const size_t maxProcesses, const size_t queueSize, const size_t queueTimeoutMs) {
+	_maxProcesses = maxProcesses;
+	_queueSize = queueSize;
+	_queueTimeout = std::chrono::milliseconds(queueTimeoutMs);
+}
+
+/**
+ * @brief Try to obtain a slot for a CGI child. Called again while QUEUED, once the ticket's waiter is
+ * returned by takeReady() or its deadline passed.
+ * @param ticket the request's admission ticket, its routeKey identifies the route for the per-route limit
+ * @param routeMaxProcesses per-route limit (0 = unlimited)
+ * @return GRANTED when the child may be started, QUEUED when the caller has to retry later,
+ * REJECTED when the queue is full and TIMED_OUT when the request waited too long
+ */
+CgiLimiter::Admission CgiLimiter::acquire(Ticket& ticket, const size_t routeMaxProcesses) {
+	if (ticket.state == Ticket::State::RUNNING)
+		return Admission::GRANTED;
+
+	const std::string& routeKey = ticket.routeKey;
+	if (ticket.state == Ticket::State::IDLE) {
+		ticket.id = _nextId++;
+
+		// Only start right away if nobody who could use the free slot is waiting already
+		const bool waiterFirst = std::any_of(_queue.begin(), _queue.end(), [this](const Waiter& waiter) {
+			return _hasCapacity(waiter.routeKey, waiter.routeMaxProcesses);
+		});
+		if (!waiterFirst && _hasCapacity(routeKey, routeMaxProcesses)) {
+			_grant(ticket, routeKey);
+			return Admission::GRANTED;
+		}
+
+		if (_queue.size() >= _queueSize) {
+			_counters.rejected++;
+			_routeCounters[routeKey].rejected++;
+			LOG_WARN("CGI queue full, rejecting request (running: " + std::to_string(_counters.running) +
+					 ", queued: " + std::to_string(_counters.queued) +
+					 ", rejected: " + std::to_string(_counters.rejected) + ")");
+			return Admission::REJECTED;
+		}
+
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		_queue.push_back({ticket.id, routeKey, routeMaxProcesses, now, ticket.waiter});
+		ticket.state = Ticket::State::QUEUED;
+		ticket.deadline = now + _queueTimeout;
+		_counters.queued++;
+		_routeCounters[routeKey].queued++;
+		LOG_DEBUG("CGI request queued at position " + std::to_string(_queue.size()));
+		return Admission::QUEUED;
+	}
+
+	// QUEUED: the first waiter in FIFO order that fits into a free slot gets it
+	const auto own =
+		std::find_if(_queue.begin(), _queue.end(), [&ticket](const Waiter& waiter) { return waiter.id == ticket.id; });
+	if (own != _queue.end()) {
+		const bool earlierFits = std::any_of(_queue.begin(), own, [this](const Waiter& waiter) {
+			return _hasCapacity(waiter.routeKey, waiter.routeMaxProcesses);
+		});
+		if (!earlierFits && _hasCapacity(routeKey, routeMaxProcesses)) {
+			_dequeue(ticket.id);
+			_grant(ticket, routeKey);
+			_wakeNext();  // there may be room for more
+			return Admission::GRANTED;
+		}
+		if (std::chrono::steady_clock::now() - own->enqueuedAt > _queueTimeout) {
+			_dequeue(ticket.id);
+			ticket.state = Ticket::State::IDLE;
+			_counters.timedOut++;
+			_routeCounters[routeKey].timedOut++;
+			LOG_WARN("CGI request timed out in queue (timed out: " + std::to_string(_counters.timedOut) + ")");
+			return Admission::TIMED_OUT;
+		}
+		// No slot, or an earlier waiter gets it: the next release wakes this one again
+		own->woken = false;
+		return Admission::QUEUED;
+	}
+
+	// Ticket got lost (should not happen): treat as a fresh request
+	ticket.state = Ticket::State::IDLE;
+	return acquire(ticket, routeMaxProcesses);
+}
+
+/**
+ * @brief Give back a slot or leave the queue. Safe to call in any ticket state.
+ */
+void CgiLimiter::release(Ticket& ticket) {
+	if (ticket.state == Ticket::State::RUNNING) {
+		_counters.running--;
+		_routeCounters[ticket.routeKey].running--;
+	} else if (ticket.state == Ticket::State::QUEUED) {
+		_dequeue(ticket.id);
+	}
+	ticket.state = Ticket::State::IDLE;
+	_wakeNext();
+}
+
+/**
+ * @brief Waiters of queued tickets that may be admitted now, their requests call acquire() again
+ */
+std::vector<int> CgiLimiter::takeReady() {
+	std::vector<int> ready;
+	ready.swap(_ready);
+	return ready;
+}
+
+/**
+ * @brief Value for the `Retry-After` header of rejected requests, in seconds
+ */
+size_t CgiLimiter::getRetryAfter() const {
+	const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(_queueTimeout).count();
+	return seconds > 0 ? static_cast<size_t>(seconds) : 1;
+}
+
+const CgiLimiter::Counters& CgiLimiter::getCounters() const { return _counters; }
+
+const std::unordered_map<std::string, CgiLimiter::Counters>& CgiLimiter::getRouteCounters() const {
+	return _routeCounters;
+}
+
+bool CgiLimiter::_hasCapacity(const std::string& routeKey, const size_t routeMaxProcesses) const {
+	if (_maxProcesses != 0 && _counters.running >= _maxProcesses)
+		return false;
+	if (routeMaxProcesses == 0)
+		return true;
+	const auto it = _routeCounters.find(routeKey);
+	return it == _routeCounters.end() || it->second.running < routeMaxProcesses;
+}
+
+void CgiLimiter::_grant(Ticket& ticket, const std::string& routeKey) {
+	ticket.state = Ticket::State::RUNNING;
+	_counters.running++;
+	_counters.admitted++;
+	Counters& route = _routeCounters[routeKey];
+	route.running++;
+	route.admitted++;
+}
+
+void CgiLimiter::_dequeue(const uint64_t id) {
+	const auto it =
+		std::find_if(_queue.begin(), _queue.end(), [id](const Waiter& waiter) { return waiter.id == id; });
+	if (it == _queue.end())
+		return;
+	_counters.queued--;
+	_routeCounters[it->routeKey].queued--;
+	_queue.erase(it);
+}
+
+/**
+ * @brief Wake the first waiter that fits into a free slot and was not woken yet
+ */
+void CgiLimiter::_wakeNext() {
+	for (Waiter& waiter : _queue) {
+		if (!waiter.woken && _hasCapacity(waiter.routeKey, waiter.routeMaxProcesses)) {
+			waiter.woken = true;
+			_ready.push_back(waiter.waiter);
+			return;
+		}
+	}
+}
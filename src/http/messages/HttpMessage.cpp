@@ -25,9 +25,12 @@ std::string HttpMessage::getHeader(const std::string &key) const {
 	return "";
 }
 
-std::string HttpMessage::getBody() const { return _body; }
+const std::string &HttpMessage::getBody() const { return _sharedBody ? *_sharedBody : _body; }
 
-std::string &HttpMessage::getBodyRef() { return _body; }
+std::string &HttpMessage::getBodyRef() {
+	_unshareBody();
+	return _body;
+}
 
 bool HttpMessage::hasHeader(const std::string &key) const { return _headers.find(key) != _headers.end(); }
 
@@ -39,7 +42,18 @@ void HttpMessage::setHttpVersion(const std::string &httpVersion) { _httpVersion
 
 void HttpMessage::setHeaders(const std::map<std::string, std::string> &headers) { _headers = headers; }
 
-void HttpMessage::setBody(const std::string &body) { _body = body; }
+void HttpMessage::setBody(const std::string &body) {
+	_sharedBody.reset();
+	_body = body;
+}
+
+/**
+ * @brief Use a body that is owned elsewhere without copying it. It is copied on the first change.
+ */
+void HttpMessage::setSharedBody(std::shared_ptr<const std::string> body) {
+	_body.clear();
+	_sharedBody = std::move(body);
+}
 
 #pragma endregion
 
@@ -73,6 +87,16 @@ void HttpMessage::addHeaderIfNew(const std::string &key, const std::string &valu
  * @brief Append data to the message body
  * @param newData The data to append
  */
-void HttpMessage::appendToBody(const std::string &newData) { _body += newData; }
+void HttpMessage::appendToBody(const std::string &newData) {
+	_unshareBody();
+	_body += newData;
+}
+
+void HttpMessage::_unshareBody() {
+	if (!_sharedBody)
+		return;
+	_body = *_sharedBody;
+	_sharedBody.reset();
+}
 
 #pragma endregion
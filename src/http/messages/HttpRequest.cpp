@@ -30,12 +30,14 @@ HttpRequest::HttpRequest(const std::string &rawRequest) {
 	if (_method.empty() || _requestUri.empty() || _httpVersion.empty()) {
 		throw BadRequest();
 	}
+	_methodType = Http::methodFromString(_method);
+	_rawRequestUri = _requestUri;
 	_decodeURL();
 	_validateRequestLine();
 	while (std::getline(requestStream, line)) {
 		if (!line.empty() && line.back() == '\r')
 			line.pop_back();
-		if (line.empty())
+		if (line.empty() || line[0] == '\0')	// the ClientConnection null-terminates the header
 			break;
 		std::istringstream headerStream(line);
 		std::string key, value;
@@ -64,22 +66,22 @@ void HttpRequest::_initBodyType() {
 }
 
 void HttpRequest::_validateRequestLine() const {
-	if (_supportedMethods.find(_method) == _supportedMethods.end()) {
-		if (_unsupportedMethods.find(_method) != _unsupportedMethods.end()) {
-			LOG_WARN("Unsupported method: " + _method);
-			throw NotImplemented();
-		}
+	if (_methodType == Http::Method::UNKNOWN) {
 		LOG_WARN("Invalid method: " + _method);
 		throw BadRequest();
 	}
-	if (_supportedVersions.find(_httpVersion) == _supportedVersions.end()) {
+	if (!Http::isImplemented(_methodType)) {
+		LOG_WARN("Unsupported method: " + _method);
+		throw NotImplemented();
+	}
+	if (_httpVersion != "HTTP/1.0" && _httpVersion != "HTTP/1.1") {
 		LOG_WARN("Unsupported HTTP version: " + _httpVersion);
 		throw InvalidVersion();
 	}
 }
 
 void HttpRequest::_validateHeaders() const {
-	if (_method == "POST" && _bodyType == BodyType::NO_BODY) {
+	if (_methodType == Http::Method::POST && _bodyType == BodyType::NO_BODY) {
 		throw BadRequest();
 	}
 }
@@ -118,10 +120,17 @@ void HttpRequest::_decodeURL() {
 
 #pragma region Getters
 
-std::string HttpRequest::getMethod() const { return _method; }
+const std::string &HttpRequest::getMethod() const { return _method; }
 
 std::string HttpRequest::getRequestUri() const { return _requestUri; }
 
+/**
+ * @brief The request target as sent by the client (not percent-decoded)
+ */
+const std::string &HttpRequest::getRawRequestUri() const { return _rawRequestUri; }
+
+const std::string &HttpRequest::getClientAddress() const { return _clientAddress; }
+
 std::string HttpRequest::getServerSidePath() const { return _serverSidePath; }
 
 bool HttpRequest::getIsFile() const { return _isFile; }
@@ -136,7 +145,10 @@ std::string HttpRequest::getLocation() const { return _location; }
 
 #pragma region Setters
 
-void HttpRequest::setMethod(const std::string &method) { _method = method; }
+void HttpRequest::setMethod(const std::string &method) {
+	_method = method;
+	_methodType = Http::methodFromString(method);
+}
 
 void HttpRequest::setRequestUri(const std::string &requestUri) { _requestUri = requestUri; }
 
@@ -153,6 +165,8 @@ void HttpRequest::setQueryString(const std::string &queryString) { _queryString
 
 void HttpRequest::setLocation(const std::string &location) { _location = location; }
 
+void HttpRequest::setClientAddress(const std::string &clientAddress) { _clientAddress = clientAddress; }
+
 #pragma endregion
 
 #pragma region Print
@@ -12,12 +12,95 @@
 
 #include "HttpResponse.hpp"
 
-#include <chrono>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
 #include <string>
 
 #include "HttpStatus.hpp"
 #include "webserv.hpp"
 
+namespace {
+
+constexpr int FIRST_STATUS = 100;
+constexpr int STATUS_RANGE = 500;  // 100 to 599
+
+// `HTTP/1.1 NNN Reason\r\n`
+struct StatusLine {
+		char text[64] = {};
+		size_t size = 0;
+};
+
+constexpr bool hasReasonPhrase(const int status) { return Http::reasonPhrase(status) != "Unknown"; }
+
+constexpr size_t countStatusLines() {
+	size_t count = 0;
+	for (int status = FIRST_STATUS; status < FIRST_STATUS + STATUS_RANGE; ++status) count += hasReasonPhrase(status);
+	return count;
+}
+
+constexpr void append(StatusLine& line, const std::string_view text) {
+	for (const char c : text) line.text[line.size++] = c;
+}
+
+constexpr std::array<StatusLine, countStatusLines()> buildStatusLines() {
+	std::array<StatusLine, countStatusLines()> lines{};
+	size_t index = 0;
+	for (int status = FIRST_STATUS; status < FIRST_STATUS + STATUS_RANGE; ++status) {
+		if (!hasReasonPhrase(status))
+			continue;
+		StatusLine& line = lines[index++];
+		append(line, "HTTP/1.1 ");
+		const char digits[] = {static_cast<char>('0' + status / 100), static_cast<char>('0' + status / 10 % 10),
+							   static_cast<char>('0' + status % 10), ' '};
+		append(line, std::string_view(digits, sizeof(digits)));
+		append(line, Http::reasonPhrase(status));
+		append(line, "\r\n");
+	}
+	return lines;
+}
+
+// Index + 1 into STATUS_LINES for every status of the range, 0 for codes without a reason phrase
+constexpr std::array<uint8_t, STATUS_RANGE> buildStatusIndex() {
+	std::array<uint8_t, STATUS_RANGE> index{};
+	uint8_t next = 0;
+	for (int status = FIRST_STATUS; status < FIRST_STATUS + STATUS_RANGE; ++status) {
+		if (hasReasonPhrase(status))
+			index[status - FIRST_STATUS] = ++next;
+	}
+	return index;
+}
+
+constexpr auto STATUS_LINES = buildStatusLines();
+constexpr auto STATUS_INDEX = buildStatusIndex();
+static_assert(STATUS_LINES.size() < 256, "the status index stores bytes");
+
+constexpr std::string_view SERVER_LINE = "Server: " SERVER_NAME "\r\n";
+constexpr size_t DATE_SIZE = 29;  // `Sun, 06 Nov 1994 08:49:37 GMT`
+
+/**
+ * @brief Append `<version> <status> <reason>\r\n`, copied from the pre-rendered table for known codes
+ */
+void appendStatusLine(std::string& str, const std::string& version, const int status) {
+	if (status >= FIRST_STATUS && status < FIRST_STATUS + STATUS_RANGE && STATUS_INDEX[status - FIRST_STATUS]) {
+		const StatusLine& line = STATUS_LINES[STATUS_INDEX[status - FIRST_STATUS] - 1];
+		const size_t offset = str.size();
+		str.append(line.text, line.size);
+		if (version != "HTTP/1.1")
+			str.replace(offset, 8, version);
+		return;
+	}
+	str += version;
+	str += ' ';
+	str += std::to_string(status);
+	str += ' ';
+	str += Http::reasonPhrase(status);
+	str += "\r\n";
+}
+
+}  // namespace
+
 HttpResponse::HttpResponse(const Http::Status status) : _status(status) { setDefaultHeaders(); }
 
 HttpResponse::HttpResponse(int status) : _status(static_cast<Http::Status>(status)) { setDefaultHeaders(); }
@@ -60,34 +143,98 @@ void HttpResponse::setStatus(const Http::Status status) { _status = status; }
 
 Http::Status HttpResponse::getStatus() const { return _status; }
 
-std::string getCurrentDate() {
-	const auto now = std::chrono::system_clock::now();
-	const std::time_t now_c = std::chrono::system_clock::to_time_t(now);
-	std::string date = std::ctime(&now_c);
-	date.pop_back();
-	date += " GMT";
-	return date;
+void HttpResponse::setBodyStream(std::shared_ptr<BodyStream> stream) { _bodyStream = std::move(stream); }
+
+const std::shared_ptr<BodyStream> &HttpResponse::getBodyStream() const { return _bodyStream; }
+
+bool HttpResponse::hasBodyStream() const { return _bodyStream != nullptr; }
+
+void HttpResponse::setHeaderBlock(const std::string_view block) { _headerBlock = block; }
+
+/**
+ * @brief RFC 7231 IMF-fixdate of the current second, `Sun, 06 Nov 1994 08:49:37 GMT`. Rendered at most once a
+ * second, every response sent within the same second shares it.
+ */
+std::string_view HttpResponse::currentDate() {
+	static constexpr const char* DAYS[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+	static constexpr const char* MONTHS[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+											 "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+	thread_local std::time_t renderedAt = -1;
+	thread_local char date[64];
+	thread_local size_t size = 0;
+
+	const std::time_t now = std::time(nullptr);
+	if (now != renderedAt) {
+		std::tm tm{};
+		gmtime_r(&now, &tm);
+		const int written = std::snprintf(date, sizeof(date), "%s, %02d %s %04d %02d:%02d:%02d GMT", DAYS[tm.tm_wday],
+										  tm.tm_mday, MONTHS[tm.tm_mon], tm.tm_year + 1900, tm.tm_hour, tm.tm_min,
+										  tm.tm_sec);
+		size = written > 0 ? static_cast<size_t>(written) : 0;
+		renderedAt = now;
+	}
+	return {date, size};
 }
 
+/**
+ * @brief Server and Date are not stored, they are written by the serialization unless a header of the same name
+ * was set (a CGI or an upstream may bring its own)
+ */
 void HttpResponse::setDefaultHeaders() {
-	addHeaderIfNew("Server", SERVER_NAME);
 	addHeaderIfNew("Content-Type", "text/html");
 	if (_httpVersion == "HTTP/1.1") {
 		addHeaderIfNew("Connection", "keep-alive");
 	} else {
 		addHeaderIfNew("Connection", "close");
 	}
-	addHeaderIfNew("Content-Length", std::to_string(_body.length()));
-	addHeaderIfNew("Date", getCurrentDate());
-	// TODO: Add more headers???
+	// A streamed body brings its own framing (Content-Length or Transfer-Encoding)
+	if (!_bodyStream)
+		addHeaderIfNew("Content-Length", std::to_string(getBody().size()));
 }
 
-std::string HttpResponse::toString() const {
-	std::string str = _httpVersion + " " + std::to_string(_status) + " " + getStatusMessage(_status) + "\r\n";
+std::string HttpResponse::toString() const { return _serialize(true); }
+
+/**
+ * @brief Status line and headers including the empty line that ends them
+ */
+std::string HttpResponse::headerToString() const { return _serialize(false); }
+
+/**
+ * @brief Render the response into one buffer sized up front: the pre-rendered status line, Server, the cached
+ * Date, the header block of the route, the headers of the response and optionally the body
+ */
+std::string HttpResponse::_serialize(const bool withBody) const {
+	const bool hasServer = _headers.count("Server") != 0;
+	const bool hasDate = _headers.count("Date") != 0;
+
+	size_t size = _httpVersion.size() + 64 + _headerBlock.size() + 2;
+	if (!hasServer)
+		size += SERVER_LINE.size();
+	if (!hasDate)
+		size += DATE_SIZE + 8;
+	for (const auto &[key, value] : _headers) size += key.size() + value.size() + 4;
+	if (withBody)
+		size += getBody().size();
+
+	std::string str;
+	str.reserve(size);
+	appendStatusLine(str, _httpVersion, _status);
+	if (!hasServer)
+		str += SERVER_LINE;
+	if (!hasDate) {
+		str += "Date: ";
+		str += currentDate();
+		str += "\r\n";
+	}
+	str += _headerBlock;
 	for (const auto &[key, value] : _headers) {
-		str += key + ": ";
-		str += value + "\r\n";
+		str += key;
+		str += ": ";
+		str += value;
+		str += "\r\n";
 	}
-	str += "\r\n" + _body;
+	str += "\r\n";
+	if (withBody)
+		str += getBody();
 	return str;
 }
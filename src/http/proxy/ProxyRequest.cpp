@@ -0,0 +1,489 @@
+#include "ProxyRequest.hpp"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include "Logger.hpp"
+#include "webserv.hpp"
+
+namespace {
+std::string toLower(std::string str) {
+	std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+	return str;
+}
+
+/**
+ * @brief `content-type` -> `Content-Type`, so that upstream headers line up with the ones webserv sets itself
+ */
+std::string canonicalHeaderName(std::string name) {
+	bool upper = true;
+	for (char& c : name) {
+		c = static_cast<char>(upper ? ::toupper(c) : ::tolower(c));
+		upper = c == '-';
+	}
+	return name;
+}
+
+std::string trim(const std::string& str) {
+	const size_t start = str.find_first_not_of(" \t");
+	if (start == std::string::npos)
+		return "";
+	return str.substr(start, str.find_last_not_of(" \t\r") - start + 1);
+}
+}  // namespace
+
+/**
+ * @param body stays owned by the caller, it has to outlive process()
+ */
+ProxyRequest::ProxyRequest(std::shared_ptr<Upstream> upstream, std::string hashKey, std::string head,
+						   const std::string_view body, const bool retryable, const std::chrono::milliseconds timeout,
+						   const bool dechunk)
+	: _upstream(std::move(upstream)),
+	  _hashKey(std::move(hashKey)),
+	  _head(std::move(head)),
+	  _body(body),
+	  _retryable(retryable),
+	  _timeout(timeout),
+	  _dechunk(dechunk),
+	  _tried(_upstream->getPeerCount(), false) {}
+
+ProxyRequest::~ProxyRequest() { _releaseConnection(false); }
+
+/**
+ * @brief Advance connect/send/receive as far as possible without blocking
+ * @return true once the response head has arrived or the request failed (see getError())
+ */
+bool ProxyRequest::process() {
+	while (true) {
+		switch (_state) {
+			case State::CONNECT:
+				_connect();
+				break;
+			case State::CONNECTING:
+				if (!_checkConnected())
+					return false;
+				break;
+			case State::SENDING:
+				if (!_send())
+					return false;
+				break;
+			case State::RECEIVING_HEADER:
+				if (!_receiveHeader())
+					return false;
+				break;
+			case State::STREAMING:
+			case State::DONE:
+			case State::FAILED:
+				return true;
+		}
+	}
+}
+
+Http::Status ProxyRequest::getError() const { return _error; }
+
+const HttpResponse& ProxyRequest::getResponse() const { return _response; }
+
+bool ProxyRequest::hasBody() const { return _state == State::STREAMING; }
+
+/**
+ * @brief The body is delimited by closing the client connection (upstream sent no length, or a chunked body
+ * is decoded for an HTTP/1.0 client)
+ */
+bool ProxyRequest::closesConnection() const { return _closeClient; }
+
+/**
+ * @brief The upstream connection while connecting, sending the request or waiting for data, until the timeout
+ * of that step
+ */
+IoWait ProxyRequest::getWait() const {
+	switch (_state) {
+		case State::CONNECTING:
+			return {_fd, POLLOUT, _lastActivity + std::chrono::milliseconds(PROXY_CONNECT_TIMEOUT_MS)};
+		case State::SENDING:
+			return {_fd, POLLOUT, _lastActivity + _timeout};
+		case State::RECEIVING_HEADER:
+		case State::STREAMING:
+			if (_buffered.empty())
+				return {_fd, POLLIN, _lastActivity + _timeout};
+			return {};
+		default:
+			return {};
+	}
+}
+
+/**
+ * @brief Relay the next piece of the upstream body
+ */
+BodyStream::Status ProxyRequest::read(std::string& chunk, const size_t maxSize) {
+	chunk.clear();
+	if (_state == State::DONE)
+		return Status::END;
+	if (_state != State::STREAMING)
+		return Status::ERROR;
+
+	if (!_buffered.empty()) {
+		// Body bytes that arrived together with the header
+		const size_t used = _frame(_buffered.data(), std::min(_buffered.size(), maxSize), chunk);
+		_buffered.erase(0, used);
+		if (_complete && !_buffered.empty())
+			_upstreamKeepAlive = false;
+	} else {
+		_readBuffer.resize(std::min(maxSize, PROXY_BUFFER_SIZE));
+		const ssize_t bytesRead = recv(_fd, _readBuffer.data(), _readBuffer.size(), 0);
+		if (bytesRead > 0) {
+			_lastActivity = Clock::now();
+			if (_frame(_readBuffer.data(), bytesRead, chunk) < static_cast<size_t>(bytesRead))
+				_upstreamKeepAlive = false;	 // more data than the message announced
+		} else if (bytesRead == 0) {
+			if (_framing != Framing::CLOSE)
+				return _abort("upstream closed the connection before the body was complete");
+			_complete = true;
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			if (_timedOut(_timeout))
+				return _abort("upstream timed out while sending the body");
+		} else {
+			return _abort("error reading from upstream: " + std::string(strerror(errno)));
+		}
+	}
+	if (_invalidBody)
+		return _abort("upstream sent an invalid chunked body");
+
+	if (_complete) {
+		_releaseConnection(_upstreamKeepAlive && _buffered.empty());
+		_state = State::DONE;
+	}
+	if (!chunk.empty())
+		return Status::DATA;
+	return _state == State::DONE ? Status::END : Status::AGAIN;
+}
+
+void ProxyRequest::_connect() {
+	_peer = _upstream->select(_hashKey, _tried);
+	if (_peer == Upstream::NO_PEER) {
+		LOG_ERROR("Upstream " + _upstream->getName() + ": no live upstreams");
+		_error = _lastError;
+		_state = State::FAILED;
+		return;
+	}
+
+	_fd = _upstream->acquire(_peer, _reused);
+	if (_fd == -1) {
+		_fail(Http::BAD_GATEWAY, true);
+		return;
+	}
+	LOG_DEBUG("Proxying request to " + _upstream->getPeer(_peer).name + (_reused ? " (pooled connection)" : ""));
+	_sent = 0;
+	_header.clear();
+	_lastActivity = Clock::now();
+	_state = _reused ? State::SENDING : State::CONNECTING;
+}
+
+bool ProxyRequest::_checkConnected() {
+	pollfd pfd{_fd, POLLOUT, 0};
+	const int pollret = poll(&pfd, 1, 0);
+	if (pollret == 0) {
+		if (!_timedOut(std::chrono::milliseconds(PROXY_CONNECT_TIMEOUT_MS)))
+			return false;
+		LOG_ERROR("Connecting to upstream " + _upstream->getPeer(_peer).name + " timed out");
+		_fail(Http::GATEWAY_TIMEOUT, true);
+		return true;
+	}
+
+	int error = 0;
+	socklen_t length = sizeof(error);
+	if (pollret < 0 || getsockopt(_fd, SOL_SOCKET, SO_ERROR, &error, &length) == -1 || error != 0) {
+		LOG_ERROR("Connecting to upstream " + _upstream->getPeer(_peer).name +
+				  " failed: " + std::string(strerror(error ? error : errno)));
+		_fail(Http::BAD_GATEWAY, true);
+		return true;
+	}
+	_lastActivity = Clock::now();
+	_state = State::SENDING;
+	return true;
+}
+
+/**
+ * @brief Send what is left of the head and the body with one call, the body straight from the client's request
+ */
+bool ProxyRequest::_send() {
+	iovec parts[2];
+	int count = 0;
+	if (_sent < _head.size())
+		parts[count++] = {_head.data() + _sent, _head.size() - _sent};
+	const size_t bodySent = _sent > _head.size() ? _sent - _head.size() : 0;
+	if (bodySent < _body.size())
+		parts[count++] = {const_cast<char*>(_body.data()) + bodySent, _body.size() - bodySent};
+	const ssize_t bytesSent = writev(_fd, parts, count);
+	if (bytesSent > 0) {
+		_sent += bytesSent;
+		_lastActivity = Clock::now();
+		if (_sent == _head.size() + _body.size())
+			_state = State::RECEIVING_HEADER;
+		return true;
+	}
+	if (bytesSent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		if (!_timedOut(_timeout))
+			return false;
+		LOG_ERROR("Sending request to upstream " + _upstream->getPeer(_peer).name + " timed out");
+		_fail(Http::GATEWAY_TIMEOUT, true);
+		return true;
+	}
+	LOG_ERROR("Sending request to upstream " + _upstream->getPeer(_peer).name +
+			  " failed: " + std::string(strerror(errno)));
+	// A pooled connection may have been closed by the upstream in the meantime, that is not the peer's fault
+	_fail(Http::BAD_GATEWAY, !_reused);
+	return true;
+}
+
+bool ProxyRequest::_receiveHeader() {
+	if (const size_t headerEnd = _header.find("\r\n\r\n"); headerEnd != std::string::npos) {
+		_parseHeader(headerEnd);
+		return true;
+	}
+
+	_readBuffer.resize(PROXY_BUFFER_SIZE);
+	const ssize_t bytesRead = recv(_fd, _readBuffer.data(), _readBuffer.size(), 0);
+	if (bytesRead > 0) {
+		_lastActivity = Clock::now();
+		_header.append(_readBuffer.data(), bytesRead);
+		if (_header.find("\r\n\r\n") == std::string::npos && _header.size() > PROXY_HEADER_BUFFER_SIZE) {
+			LOG_ERROR("Upstream " + _upstream->getPeer(_peer).name + " sent a too large header");
+			_fail(Http::BAD_GATEWAY, true);
+		}
+		return true;
+	}
+	if (bytesRead == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		if (!_timedOut(_timeout))
+			return false;
+		LOG_ERROR("Upstream " + _upstream->getPeer(_peer).name + " timed out");
+		_fail(Http::GATEWAY_TIMEOUT, true);
+		return true;
+	}
+	LOG_ERROR("Upstream " + _upstream->getPeer(_peer).name + " closed the connection without a response");
+	_fail(Http::BAD_GATEWAY, !(_reused && _header.empty()));
+	return true;
+}
+
+/**
+ * @brief Build the client response from the upstream head and decide how the body is delimited
+ */
+void ProxyRequest::_parseHeader(const size_t headerEnd) {
+	std::istringstream head(_header.substr(0, headerEnd));
+	_buffered = _header.substr(headerEnd + 4);
+	_header.clear();
+
+	std::string line;
+	std::getline(head, line);
+	std::istringstream statusLine(line);
+	std::string version;
+	int status = 0;
+	statusLine >> version >> status;
+	if (version.rfind("HTTP/1.", 0) != 0 || status < 100 || status > 599 || status == 101) {
+		LOG_ERROR("Upstream " + _upstream->getPeer(_peer).name + " sent an invalid status line: " + line);
+		_fail(Http::BAD_GATEWAY, true);
+		return;
+	}
+	if (status < 200) {
+		// Interim response (e.g. 100 Continue), the real one follows
+		_header = _buffered;
+		_buffered.clear();
+		return;
+	}
+
+	_response = HttpResponse();
+	_response.setStatus(static_cast<Http::Status>(status));
+	_upstreamKeepAlive = version == "HTTP/1.1";
+	bool chunked = false;
+	bool hasLength = false;
+	size_t contentLength = 0;
+
+	while (std::getline(head, line)) {
+		const size_t colon = line.find(':');
+		if (colon == std::string::npos)
+			continue;
+		const std::string name = toLower(trim(line.substr(0, colon)));
+		const std::string value = trim(line.substr(colon + 1));
+
+		if (name == "connection") {
+			const std::string options = toLower(value);
+			if (options.find("close") != std::string::npos)
+				_upstreamKeepAlive = false;
+			else if (options.find("keep-alive") != std::string::npos)
+				_upstreamKeepAlive = true;
+		} else if (name == "transfer-encoding") {
+			chunked = toLower(value).find("chunked") != std::string::npos;
+		} else if (name == "content-length") {
+			try {
+				contentLength = std::stoul(value);
+				hasLength = true;
+			} catch (const std::exception&) {
+				LOG_ERROR("Upstream " + _upstream->getPeer(_peer).name + " sent an invalid Content-Length");
+				_fail(Http::BAD_GATEWAY, true);
+				return;
+			}
+		} else if (name != "keep-alive" && name != "proxy-connection" && name != "te" && name != "trailer" &&
+				   name != "upgrade") {
+			_response.addHeader(canonicalHeaderName(name), value);
+		}
+	}
+
+	if (status == Http::NO_CONTENT || status == Http::NOT_MODIFIED || (!chunked && hasLength && contentLength == 0))
+		_framing = Framing::NONE;
+	else if (chunked)
+		_framing = Framing::CHUNKED;
+	else if (hasLength)
+		_framing = Framing::LENGTH;
+	else
+		_framing = Framing::CLOSE;
+
+	switch (_framing) {
+		case Framing::LENGTH:
+			_remaining = contentLength;
+			_response.addHeader("Content-Length", std::to_string(contentLength));
+			break;
+		case Framing::CHUNKED:
+			if (_dechunk)
+				_closeClient = true;
+			else
+				_response.addHeader("Transfer-Encoding", "chunked");
+			break;
+		case Framing::CLOSE:
+			_upstreamKeepAlive = false;
+			_closeClient = true;
+			break;
+		case Framing::NONE:
+			break;
+	}
+
+	_upstream->reportSuccess(_peer);
+	// No retry from here on: the request may be gone while the body is relayed
+	_body = {};
+	if (_framing == Framing::NONE) {
+		_releaseConnection(_upstreamKeepAlive && _buffered.empty());
+		_state = State::DONE;
+		return;
+	}
+	_state = State::STREAMING;
+}
+
+/**
+ * @brief Move body bytes into `out` according to the framing of the upstream response
+ * @return the number of bytes of `data` that belong to the body
+ */
+size_t ProxyRequest::_frame(const char* data, const size_t size, std::string& out) {
+	switch (_framing) {
+		case Framing::LENGTH: {
+			const size_t length = std::min(size, _remaining);
+			out.append(data, length);
+			_remaining -= length;
+			_complete = _remaining == 0;
+			return length;
+		}
+		case Framing::CHUNKED:
+			return _decodeChunked(data, size, out);
+		case Framing::CLOSE:
+			out.append(data, size);
+			return size;
+		case Framing::NONE:
+		default:
+			_complete = true;
+			return 0;
+	}
+}
+
+/**
+ * @brief Follow the chunked framing to find the end of the body. The chunks are relayed as they are, or
+ * decoded for HTTP/1.0 clients.
+ */
+size_t ProxyRequest::_decodeChunked(const char* data, const size_t size, std::string& out) {
+	size_t pos = 0;
+	while (pos < size && !_complete && !_invalidBody) {
+		if (_chunkState == ChunkState::DATA) {
+			const size_t length = std::min(size - pos, _remaining);
+			out.append(data + pos, length);
+			pos += length;
+			_remaining -= length;
+			if (_remaining == 0)
+				_chunkState = ChunkState::DATA_END;
+			continue;
+		}
+
+		const char c = data[pos++];
+		if (!_dechunk)
+			out += c;
+		if (_chunkState == ChunkState::DATA_END) {
+			if (c == '\n')
+				_chunkState = ChunkState::SIZE_LINE;
+			continue;
+		}
+		if (c != '\n') {
+			_chunkLine += c;
+			_invalidBody = _chunkLine.size() > PROXY_HEADER_BUFFER_SIZE;
+			continue;
+		}
+
+		const std::string line = trim(_chunkLine);
+		_chunkLine.clear();
+		if (_chunkState == ChunkState::TRAILER) {
+			_complete = line.empty();
+			continue;
+		}
+		try {
+			_remaining = std::stoul(line, nullptr, 16);
+		} catch (const std::exception&) {
+			_invalidBody = true;
+			break;
+		}
+		_chunkState = _remaining == 0 ? ChunkState::TRAILER : ChunkState::DATA;
+	}
+	return pos;
+}
+
+/**
+ * @brief Give up on the current connection and try again if that is still allowed: always when the request
+ * did not reach the upstream yet, otherwise only for retryable (idempotent) requests
+ * @param peerFault count the failure for the passive health check of the peer
+ */
+void ProxyRequest::_fail(const Http::Status status, const bool peerFault) {
+	const bool requestSent = _sent > 0;
+	_lastError = status;
+	_releaseConnection(false);
+	if (peerFault) {
+		_upstream->reportFailure(_peer);
+		_tried[_peer] = true;
+	}
+	if (++_attempts <= _upstream->getPeerCount() && (!requestSent || _retryable)) {
+		LOG_WARN("Upstream " + _upstream->getName() + ": retrying request (attempt " + std::to_string(_attempts + 1) +
+				 ")");
+		_state = State::CONNECT;
+		return;
+	}
+	_error = status;
+	_state = State::FAILED;
+}
+
+BodyStream::Status ProxyRequest::_abort(const std::string& reason) {
+	LOG_ERROR("Upstream " + _upstream->getPeer(_peer).name + ": " + reason);
+	_upstream->reportFailure(_peer);
+	_releaseConnection(false);
+	_state = State::FAILED;
+	return Status::ERROR;
+}
+
+void ProxyRequest::_releaseConnection(const bool reusable) {
+	if (_fd == -1)
+		return;
+	_upstream->release(_peer, _fd, reusable);
+	_fd = -1;
+}
+
+bool ProxyRequest::_timedOut(const std::chrono::milliseconds timeout) const {
+	return Clock::now() - _lastActivity > timeout;
+}
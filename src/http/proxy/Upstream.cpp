@@ -0,0 +1,243 @@
+#include "Upstream.hpp"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "Logger.hpp"
+
+// Points per unit of weight on the consistent hash ring
+#define UPSTREAM_RING_POINTS 160
+
+Upstream::Upstream(const UpstreamConfig& config)
+	: _name(config.getName()),
+	  _balance(config.getBalance()),
+	  _hashKey(config.getHashKey()),
+	  _keepalive(config.getKeepalive()) {
+	for (const auto& server : config.getServers()) {
+		Peer peer;
+		peer.name = server.host + ":" + std::to_string(server.port);
+		peer.weight = server.weight;
+		peer.maxFails = server.maxFails;
+		peer.failTimeout = std::chrono::milliseconds(server.failTimeout);
+
+		// Resolved once per configuration load. getaddrinfo blocks, a slow resolver stalls a reload meanwhile.
+		addrinfo hints{};
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		addrinfo* result = nullptr;
+		if (const int err = getaddrinfo(server.host.c_str(), std::to_string(server.port).c_str(), &hints, &result);
+			err != 0 || result == nullptr) {
+			LOG_ERROR("Upstream " + _name + ": cannot resolve " + peer.name + ": " + gai_strerror(err));
+		} else {
+			std::memcpy(&peer.address, result->ai_addr, sizeof(peer.address));
+			peer.resolved = true;
+		}
+		if (result)
+			freeaddrinfo(result);
+		_peers.push_back(peer);
+	}
+	_buildRing();
+}
+
+Upstream::~Upstream() {
+	for (auto& peer : _peers) {
+		for (const int fd : peer.idle) close(fd);
+	}
+}
+
+const std::string& Upstream::getName() const { return _name; }
+
+const std::string& Upstream::getHashKey() const { return _hashKey; }
+
+size_t Upstream::getPeerCount() const { return _peers.size(); }
+
+const Upstream::Peer& Upstream::getPeer(const size_t index) const { return _peers.at(index); }
+
+/**
+ * @brief Pick the peer for the next request
+ * @param hashKey request key for `hash` balancing (ignored otherwise)
+ * @param exclude peers that already failed for this request
+ * @return index of the peer or NO_PEER if none is available
+ */
+size_t Upstream::select(const std::string& hashKey, const std::vector<bool>& exclude) {
+	const Clock::time_point now = Clock::now();
+	switch (_balance) {
+		case UpstreamConfig::Balance::LEAST_CONN:
+			return _selectLeastConn(exclude, now);
+		case UpstreamConfig::Balance::HASH:
+			return _selectHash(hashKey, exclude, now);
+		case UpstreamConfig::Balance::ROUND_ROBIN:
+		default:
+			return _selectRoundRobin(exclude, now);
+	}
+}
+
+/**
+ * @brief Get a connection to the peer: an idle keep-alive connection if one is still usable, otherwise a
+ * new non-blocking socket with the connect in progress
+ * @param reused set to true if the connection comes from the pool
+ * @return the socket or -1 if it could not be created
+ */
+int Upstream::acquire(const size_t peer, bool& reused) {
+	Peer& target = _peers.at(peer);
+	while (!target.idle.empty()) {
+		const int fd = target.idle.back();
+		target.idle.pop_back();
+
+		// An idle connection must not be readable: data or EOF means the upstream closed it
+		pollfd pfd{fd, POLLIN, 0};
+		if (poll(&pfd, 1, 0) == 0) {
+			LOG_DEBUG("Upstream " + _name + ": reusing connection " + std::to_string(fd) + " to " + target.name);
+			reused = true;
+			target.active++;
+			return fd;
+		}
+		close(fd);
+	}
+
+	reused = false;
+	const int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd == -1) {
+		LOG_ERROR("Upstream " + _name + ": socket failed: " + std::string(strerror(errno)));
+		return -1;
+	}
+	if (fcntl(fd, F_SETFL, O_NONBLOCK) == -1 || fcntl(fd, F_SETFD, FD_CLOEXEC) == -1) {
+		LOG_ERROR("Upstream " + _name + ": fcntl failed: " + std::string(strerror(errno)));
+		close(fd);
+		return -1;
+	}
+	if (connect(fd, reinterpret_cast<const sockaddr*>(&target.address), sizeof(target.address)) == -1 &&
+		errno != EINPROGRESS) {
+		LOG_ERROR("Upstream " + _name + ": connect to " + target.name + " failed: " + std::string(strerror(errno)));
+		close(fd);
+		return -1;
+	}
+	target.active++;
+	return fd;
+}
+
+/**
+ * @brief Give a connection back: into the pool if it can carry another request, otherwise it is closed
+ */
+void Upstream::release(const size_t peer, const int fd, const bool reusable) {
+	Peer& target = _peers.at(peer);
+	if (target.active > 0)
+		target.active--;
+	if (fd < 0)
+		return;
+	if (reusable && target.idle.size() < _keepalive) {
+		target.idle.push_back(fd);
+		return;
+	}
+	close(fd);
+}
+
+void Upstream::reportSuccess(const size_t peer) { _peers.at(peer).fails = 0; }
+
+void Upstream::reportFailure(const size_t peer) {
+	Peer& target = _peers.at(peer);
+	const Clock::time_point now = Clock::now();
+	if (target.fails == 0 || now - target.firstFailAt > target.failTimeout) {
+		target.fails = 0;
+		target.firstFailAt = now;
+	}
+	target.fails++;
+	if (target.maxFails != 0 && target.fails >= target.maxFails) {
+		LOG_WARN("Upstream " + _name + ": " + target.name + " failed " + std::to_string(target.fails) +
+				 " times, ejecting it for " + std::to_string(target.failTimeout.count()) + " ms");
+		target.ejectedUntil = now + target.failTimeout;
+		target.fails = 0;
+		for (const int fd : target.idle) close(fd);
+		target.idle.clear();
+	}
+}
+
+bool Upstream::_isAvailable(const size_t peer, const std::vector<bool>& exclude, const Clock::time_point now) const {
+	return _peers[peer].resolved && now >= _peers[peer].ejectedUntil && (peer >= exclude.size() || !exclude[peer]);
+}
+
+/**
+ * @brief Smooth weighted round robin: every peer gains its weight, the richest one is picked and pays the total
+ */
+size_t Upstream::_selectRoundRobin(const std::vector<bool>& exclude, const Clock::time_point now) {
+	size_t best = NO_PEER;
+	long total = 0;
+	for (size_t i = 0; i < _peers.size(); i++) {
+		if (!_isAvailable(i, exclude, now))
+			continue;
+		_peers[i].currentWeight += static_cast<long>(_peers[i].weight);
+		total += static_cast<long>(_peers[i].weight);
+		if (best == NO_PEER || _peers[i].currentWeight > _peers[best].currentWeight)
+			best = i;
+	}
+	if (best != NO_PEER)
+		_peers[best].currentWeight -= total;
+	return best;
+}
+
+/**
+ * @brief Fewest active connections relative to the weight; ties are broken in turn
+ */
+size_t Upstream::_selectLeastConn(const std::vector<bool>& exclude, const Clock::time_point now) {
+	size_t best = NO_PEER;
+	for (size_t n = 0; n < _peers.size(); n++) {
+		const size_t i = (_next + n) % _peers.size();
+		if (!_isAvailable(i, exclude, now))
+			continue;
+		if (best == NO_PEER || _peers[i].active * _peers[best].weight < _peers[best].active * _peers[i].weight)
+			best = i;
+	}
+	_next = (_next + 1) % std::max<size_t>(_peers.size(), 1);
+	return best;
+}
+
+/**
+ * @brief Consistent hashing: the first available peer clockwise from the key's point on the ring
+ */
+size_t Upstream::_selectHash(const std::string& key, const std::vector<bool>& exclude,
+							 const Clock::time_point now) const {
+	if (_ring.empty())
+		return NO_PEER;
+	const uint32_t point = _hash(key);
+	auto it = std::lower_bound(_ring.begin(), _ring.end(), std::make_pair(point, size_t(0)));
+	for (size_t n = 0; n < _ring.size(); n++, it++) {
+		if (it == _ring.end())
+			it = _ring.begin();
+		if (_isAvailable(it->second, exclude, now))
+			return it->second;
+	}
+	return NO_PEER;
+}
+
+void Upstream::_buildRing() {
+	_ring.clear();
+	for (size_t i = 0; i < _peers.size(); i++) {
+		for (size_t n = 0; n < _peers[i].weight * UPSTREAM_RING_POINTS; n++)
+			_ring.emplace_back(_hash(_peers[i].name + "#" + std::to_string(n)), i);
+	}
+	std::sort(_ring.begin(), _ring.end());
+}
+
+/**
+ * @brief 32 bit FNV-1a with a final avalanche, so that similar keys spread over the whole ring
+ */
+uint32_t Upstream::_hash(const std::string& key) {
+	uint32_t hash = 2166136261u;
+	for (const char c : key) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 16777619u;
+	}
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35u;
+	hash ^= hash >> 16;
+	return hash;
+}
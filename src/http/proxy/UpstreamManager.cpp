@@ -0,0 +1,16 @@
+#include "UpstreamManager.hpp"
+
+UpstreamManager& UpstreamManager::getInstance() {
+	static UpstreamManager instance;
+	return instance;
+}
+
+void UpstreamManager::configure(const std::vector<UpstreamConfig>& upstreams) {
+	_upstreams.clear();
+	for (const auto& config : upstreams) _upstreams[config.getName()] = std::make_shared<Upstream>(config);
+}
+
+std::shared_ptr<Upstream> UpstreamManager::get(const std::string& name) const {
+	const auto it = _upstreams.find(name);
+	return it == _upstreams.end() ? nullptr : it->second;
+}
@@ -0,0 +1,311 @@
+#include "AccessLog.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "Logger.hpp"
+
+std::atomic<bool> AccessLog::_reopenRequested(false);
+
+namespace {
+/**
+ * @brief Escape a value for a quoted field: `"` and `\` are escaped, control characters are written as \xHH
+ */
+void appendEscaped(std::string& out, const std::string& value, const bool json) {
+	for (const char c : value) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if (static_cast<unsigned char>(c) < 0x20 || c == 0x7f) {
+			char hex[8];
+			std::snprintf(hex, sizeof(hex), json ? "\\u%04x" : "\\x%02X", static_cast<unsigned char>(c));
+			out += hex;
+		} else {
+			out += c;
+		}
+	}
+}
+
+std::string formatSeconds(const std::chrono::microseconds duration) {
+	char seconds[32];
+	std::snprintf(seconds, sizeof(seconds), "%.3f", static_cast<double>(duration.count()) / 1e6);
+	return seconds;
+}
+
+std::string formatMilliseconds(const std::chrono::microseconds duration) {
+	if (duration.count() < 0)
+		return "-";
+	char milliseconds[32];
+	std::snprintf(milliseconds, sizeof(milliseconds), "%.3fms", static_cast<double>(duration.count()) / 1e3);
+	return milliseconds;
+}
+}  // namespace
+
+AccessLog& AccessLog::getInstance() {
+	static AccessLog instance;
+	return instance;
+}
+
+AccessLog::~AccessLog() {
+	flushAll();
+	for (auto& [path, file] : _files) _close(file);
+}
+
+/**
+ * @brief Open the files of all servers. Servers that share a file share its buffer, with the smallest buffer size
+ * and flush interval any of them asked for. Files that are no longer used are flushed and closed.
+ */
+void AccessLog::configure(const std::vector<AccessLogConfig>& configs) {
+	std::unordered_map<std::string, AccessLogConfig> merged;
+	for (const AccessLogConfig& config : configs) {
+		if (config.path.empty())
+			continue;
+		const auto [it, added] = merged.emplace(config.path, config);
+		if (added)
+			continue;
+		it->second.bufferSize = std::min(it->second.bufferSize, config.bufferSize);
+		it->second.flushInterval = std::min(it->second.flushInterval, config.flushInterval);
+	}
+
+	for (auto it = _files.begin(); it != _files.end();) {
+		if (merged.count(it->first) != 0) {
+			++it;
+			continue;
+		}
+		LOG_INFO("Closing access log " + it->first + ", it is no longer configured");
+		_flush(it->first, it->second);
+		_close(it->second);
+		it = _files.erase(it);
+	}
+	for (const auto& [path, config] : merged) {
+		File& file = _open(config);
+		if (file.buffer.size() >= config.bufferSize)
+			_flush(path, file);
+		file.bufferSize = config.bufferSize;
+		file.flushInterval = std::chrono::milliseconds(config.flushInterval);
+		file.buffer.reserve(config.bufferSize + 1024);
+		file.configured = true;
+	}
+}
+
+/**
+ * @brief Append a line for a completed request, the file is written when its buffer is full
+ */
+void AccessLog::write(const AccessLogConfig& config, const Entry& entry) {
+	File& file = _open(config);
+	if (file.fd == -1)
+		return;
+	if (file.buffer.empty())
+		file.firstBufferedAt = Clock::now();
+
+	_updateTime();
+	if (config.format == AccessLogConfig::Format::JSON)
+		_formatJson(file.buffer, entry);
+	else
+		_formatCombined(file.buffer, entry);
+
+	if (file.buffer.size() >= file.bufferSize)
+		_flush(config.path, file);
+}
+
+/**
+ * @brief Append a request that took longer than the threshold, with the time spent in each phase:
+ * `[$time_local] $remote_addr "$request" $status total=… wait=… header=… body=… dispatch=… handler=…
+ * response_start=… send=…`, `-` for phases the request never reached
+ */
+void AccessLog::writeSlow(const SlowLogConfig& config, const Entry& entry, const RequestTiming& timing) {
+	AccessLogConfig fileConfig;
+	fileConfig.path = config.path;
+	File& file = _open(fileConfig);
+	if (file.fd == -1)
+		return;
+	if (file.buffer.empty())
+		file.firstBufferedAt = Clock::now();
+
+	_updateTime();
+	std::string& out = file.buffer;
+	out += '[';
+	out += _cachedLocalTime;
+	out += "] ";
+	out += entry.clientAddress.empty() ? "-" : entry.clientAddress;
+	out += " \"";
+	if (entry.method.empty()) {
+		out += '-';
+	} else {
+		appendEscaped(out, entry.method + " " + entry.uri + " " + entry.version, false);
+	}
+	out += "\" ";
+	out += std::to_string(entry.status);
+	out += " total=";
+	out += formatMilliseconds(timing.total());
+	for (int mark = RequestTiming::FIRST_BYTE; mark < RequestTiming::MARK_COUNT; ++mark) {
+		out += ' ';
+		out += RequestTiming::phaseName(static_cast<RequestTiming::Mark>(mark));
+		out += '=';
+		out += formatMilliseconds(timing.phase(static_cast<RequestTiming::Mark>(mark)));
+	}
+	out += '\n';
+
+	if (file.buffer.size() >= file.bufferSize)
+		_flush(config.path, file);
+}
+
+/**
+ * @brief Called once per event loop iteration: reopen the files if requested, flush buffers that
+ * waited longer than their flush interval and close flushed files that are not configured
+ * @return milliseconds until the next buffer has to be flushed, -1 if nothing is buffered
+ */
+int AccessLog::tick() {
+	if (_reopenRequested.exchange(false))
+		_reopen();
+
+	const Clock::time_point now = Clock::now();
+	int nextFlush = -1;
+	for (auto it = _files.begin(); it != _files.end();) {
+		File& file = it->second;
+		const auto due = file.firstBufferedAt + file.flushInterval;
+		if (!file.buffer.empty() && now >= due)
+			_flush(it->first, file);
+		if (!file.buffer.empty()) {
+			const int wait = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(due - now).count());
+			if (nextFlush == -1 || wait < nextFlush)
+				nextFlush = wait;
+		} else if (!file.configured) {
+			_close(file);
+			it = _files.erase(it);
+			continue;
+		}
+		++it;
+	}
+	return nextFlush;
+}
+
+void AccessLog::flushAll() {
+	for (auto& [path, file] : _files) _flush(path, file);
+}
+
+/**
+ * @brief Only sets a flag, safe to call from a signal handler
+ */
+void AccessLog::requestReopen() { _reopenRequested = true; }
+
+AccessLog::File& AccessLog::_open(const AccessLogConfig& config) {
+	auto it = _files.find(config.path);
+	if (it != _files.end())
+		return it->second;
+
+	File& file = _files[config.path];
+	file.bufferSize = config.bufferSize;
+	file.flushInterval = std::chrono::milliseconds(config.flushInterval);
+	file.buffer.reserve(config.bufferSize + 1024);
+	file.fd = open(config.path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+	if (file.fd == -1)
+		LOG_ERROR("Cannot open access log " + config.path + ": " + std::string(strerror(errno)));
+	return file;
+}
+
+void AccessLog::_close(File& file) {
+	if (file.fd != -1)
+		close(file.fd);
+	file.fd = -1;
+}
+
+void AccessLog::_flush(const std::string& path, File& file) {
+	size_t written = 0;
+	while (file.fd != -1 && written < file.buffer.size()) {
+		const ssize_t bytes = ::write(file.fd, file.buffer.data() + written, file.buffer.size() - written);
+		if (bytes == -1 && errno == EINTR)
+			continue;
+		if (bytes <= 0) {
+			LOG_ERROR("Writing access log " + path + " failed: " + std::string(strerror(errno)));
+			break;
+		}
+		written += bytes;
+	}
+	file.buffer.clear();
+}
+
+/**
+ * @brief Write what is buffered to the old files, then open the files again under their names
+ */
+void AccessLog::_reopen() {
+	LOG_INFO("Reopening access logs");
+	for (auto& [path, file] : _files) {
+		_flush(path, file);
+		_close(file);
+		file.fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+		if (file.fd == -1)
+			LOG_ERROR("Cannot reopen access log " + path + ": " + std::string(strerror(errno)));
+	}
+}
+
+/**
+ * @brief `$remote_addr - - [$time_local] "$request" $status $body_bytes_sent "$http_referer" "$http_user_agent"`
+ * followed by the request time in seconds
+ */
+void AccessLog::_formatCombined(std::string& out, const Entry& entry) {
+	out += entry.clientAddress.empty() ? "-" : entry.clientAddress;
+	out += " - - [";
+	out += _cachedLocalTime;
+	out += "] \"";
+	if (entry.method.empty()) {
+		out += '-';
+	} else {
+		appendEscaped(out, entry.method + " " + entry.uri + " " + entry.version, false);
+	}
+	out += "\" ";
+	out += std::to_string(entry.status);
+	out += ' ';
+	out += std::to_string(entry.bodyBytes);
+	out += " \"";
+	appendEscaped(out, entry.referer.empty() ? "-" : entry.referer, false);
+	out += "\" \"";
+	appendEscaped(out, entry.userAgent.empty() ? "-" : entry.userAgent, false);
+	out += "\" ";
+	out += formatSeconds(entry.duration);
+	out += '\n';
+}
+
+void AccessLog::_formatJson(std::string& out, const Entry& entry) {
+	const auto field = [&out](const char* name, const std::string& value) {
+		out += '"';
+		out += name;
+		out += "\":\"";
+		appendEscaped(out, value, true);
+		out += "\",";
+	};
+	out += '{';
+	field("time", _cachedIsoTime);
+	field("remote_addr", entry.clientAddress);
+	field("host", entry.host);
+	field("method", entry.method);
+	field("uri", entry.uri);
+	field("protocol", entry.version);
+	out += "\"status\":" + std::to_string(entry.status) + ",";
+	out += "\"body_bytes_sent\":" + std::to_string(entry.bodyBytes) + ",";
+	out += "\"request_time\":" + formatSeconds(entry.duration) + ",";
+	field("referer", entry.referer);
+	field("user_agent", entry.userAgent);
+	out.back() = '}';
+	out += '\n';
+}
+
+/**
+ * @brief The timestamps are only formatted again when the second changes
+ */
+void AccessLog::_updateTime() {
+	const std::time_t now = std::time(nullptr);
+	if (now == _cachedSecond)
+		return;
+	_cachedSecond = now;
+	std::tm local{};
+	localtime_r(&now, &local);
+	char buffer[64];
+	_cachedLocalTime.assign(buffer, std::strftime(buffer, sizeof(buffer), "%d/%b/%Y:%H:%M:%S %z", &local));
+	_cachedIsoTime.assign(buffer, std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S%z", &local));
+}
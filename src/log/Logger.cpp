@@ -12,11 +12,19 @@
 
 #include "Logger.hpp"
 
+#include <pthread.h>
+
+#include <algorithm>
+
+#include "webserv.hpp"
+
 Logger& Logger::getInstance() {
 	static Logger instance;
 	return instance;
 }
 
+Logger::~Logger() { stopAsync(); }
+
 void Logger::setOutputToFile(const std::string& filename) {
 	logFile.open(filename, std::ios::app);
 	if (logFile.is_open()) {
@@ -33,16 +41,212 @@ void Logger::setOutputToConsole() {
 }
 
 void Logger::log(const std::string& msg, const LogLevel level) {
-	if (level < LOG_LEVEL)
+	if (level < LOG_LEVEL || !isEnabled(level))
 		return;
-	const std::time_t now = std::time(nullptr);
-	if (outputToFile) {
-		logFile << std::left << std::put_time(std::localtime(&now), "%F %T") << " " << std::left << std::setw(20)
-				<< level << " " << msg << std::endl;
-	} else {
-		std::cout << std::left << std::put_time(std::localtime(&now), "%F %T") << " " << std::left << std::setw(20)
-				  << level << " " << msg << std::endl;
+	if (_async.load(std::memory_order_relaxed)) {
+		if (!_push(msg, level))
+			_dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	std::string line;
+	_format(line, Clock::now(), level, msg);
+	_output(line);
+}
+
+void Logger::setLevel(const LogLevel level) { _level = std::max<int>(level, LOG_LEVEL); }
+
+LogLevel Logger::getLevel() const { return static_cast<LogLevel>(_level.load()); }
+
+/**
+ * @brief Log one level more (SIGTTIN), down to the build time minimum. Async-signal-safe.
+ */
+void Logger::increaseVerbosity() {
+	int level = _level.load();
+	while (level > LOG_LEVEL && !_level.compare_exchange_weak(level, level - 1)) {
+	}
+}
+
+/**
+ * @brief Log one level less (SIGTTOU). Async-signal-safe.
+ */
+void Logger::decreaseVerbosity() {
+	int level = _level.load();
+	while (level < ERROR && !_level.compare_exchange_weak(level, level + 1)) {
+	}
+}
+
+/**
+ * @brief Hand the output over to the writer thread. The output target must not be changed while async.
+ */
+void Logger::startAsync() {
+	if (_async)
+		return;
+	if (!_ring) {
+		_ring = std::make_unique<Record[]>(LOG_RING_SIZE);
+		_mask = LOG_RING_SIZE - 1;
+		static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+		// The writer thread does not exist in forked children (CGI), they have to log synchronously
+		pthread_atfork(nullptr, nullptr, &Logger::_atforkChild);
+	}
+	_tail = _head.load();
+	for (size_t i = 0; i < LOG_RING_SIZE; i++) _ring[i].sequence.store(_tail + i, std::memory_order_relaxed);
+	_running = true;
+	_writer = std::make_unique<std::thread>(&Logger::_writerLoop, this);
+	_async = true;
+}
+
+/**
+ * @brief Stop the writer thread after it wrote everything that is queued and go back to synchronous logging
+ */
+void Logger::stopAsync() {
+	if (!_async)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(_wakeupMutex);
+		_running = false;
+	}
+	_wakeup.notify_one();
+	_writer->join();
+	_writer.reset();
+	// Records pushed while the writer was shutting down
+	std::string lines;
+	while (_pop(lines)) {
+	}
+	_output(lines);
+	_async = false;
+}
+
+bool Logger::isAsync() const { return _async; }
+
+size_t Logger::getDroppedCount() const { return _dropped.load(std::memory_order_relaxed); }
+
+/**
+ * @brief Claim the next free slot and copy the record into it (the slot keeps its string capacity, so
+ * this does not allocate once the buffer is warm)
+ * @return false if the buffer is full
+ */
+bool Logger::_push(const std::string& msg, const LogLevel level) {
+	size_t position = _head.load(std::memory_order_relaxed);
+	Record* record;
+	while (true) {
+		record = &_ring[position & _mask];
+		const size_t sequence = record->sequence.load(std::memory_order_acquire);
+		if (sequence == position) {
+			if (_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		} else if (sequence < position) {
+			return false;
+		} else {
+			position = _head.load(std::memory_order_relaxed);
+		}
+	}
+	record->time = Clock::now();
+	record->level = level;
+	record->msg = msg;
+	record->sequence.store(position + 1, std::memory_order_release);
+	// Pairs with the fence in _writerLoop(): either the writer sees the record or this sees it idle
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (_writerIdle.load(std::memory_order_relaxed)) {
+		std::lock_guard<std::mutex> lock(_wakeupMutex);
+		_wakeup.notify_one();
+	}
+	return true;
+}
+
+/**
+ * @brief Format the oldest record into `out` and free its slot (writer thread only)
+ * @return false if the buffer is empty
+ */
+bool Logger::_pop(std::string& out) {
+	Record& record = _ring[_tail & _mask];
+	if (record.sequence.load(std::memory_order_acquire) != _tail + 1)
+		return false;
+	_format(out, record.time, record.level, record.msg);
+	record.sequence.store(_tail + _mask + 1, std::memory_order_release);
+	_tail++;
+	return true;
+}
+
+bool Logger::_hasRecord() const {
+	return _ring[_tail & _mask].sequence.load(std::memory_order_acquire) == _tail + 1;
+}
+
+void Logger::_writerLoop() {
+	std::string batch;
+	while (true) {
+		const bool running = _running.load(std::memory_order_acquire);
+		size_t count = 0;
+		while (count < LOG_BATCH_SIZE && _pop(batch)) count++;
+
+		if (const size_t dropped = _dropped.load(std::memory_order_relaxed); dropped != _reportedDrops) {
+			_format(batch, Clock::now(), WARN,
+					"Log buffer full, dropped " + std::to_string(dropped - _reportedDrops) + " messages");
+			_reportedDrops = dropped;
+		}
+		if (!batch.empty()) {
+			_output(batch);
+			batch.clear();
+		}
+		if (count == 0) {
+			if (!running)
+				return;
+			std::unique_lock<std::mutex> lock(_wakeupMutex);
+			_writerIdle.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			_wakeup.wait(lock, [this] { return _hasRecord() || !_running.load(std::memory_order_acquire); });
+			_writerIdle.store(false, std::memory_order_relaxed);
+		}
+	}
+}
+
+/**
+ * @brief Append `<date> <time> <level> <msg>\n`; the date is only formatted again when the second changes. Both
+ * the writer thread and synchronous callers format, so the cached date is per thread.
+ */
+void Logger::_format(std::string& out, const Clock::time_point time, const LogLevel level, const std::string& msg) {
+	static const auto pad = [](const LogLevel logLevel) {
+		std::ostringstream prefix;
+		prefix << std::left << std::setw(20) << logLevel;
+		return prefix.str();
+	};
+	static const std::string levels[] = {pad(TRACE), pad(DEBUG), pad(INFO), pad(WARN), pad(ERROR)};
+
+	thread_local std::time_t cachedSecond = -1;
+	thread_local std::string cachedTime;
+
+	const std::time_t second = Clock::to_time_t(time);
+	if (second != cachedSecond) {
+		std::tm local{};
+		localtime_r(&second, &local);
+		char buffer[32];
+		cachedTime.assign(buffer, std::strftime(buffer, sizeof(buffer), "%F %T", &local));
+		cachedSecond = second;
 	}
+	out += cachedTime;
+	out += ' ';
+	out += levels[level];
+	out += ' ';
+	out += msg;
+	out += '\n';
+}
+
+void Logger::_output(const std::string& lines) {
+	if (lines.empty())
+		return;
+	if (outputToFile)
+		logFile.write(lines.data(), static_cast<std::streamsize>(lines.size())).flush();
+	else
+		std::cout.write(lines.data(), static_cast<std::streamsize>(lines.size())).flush();
+}
+
+void Logger::_atforkChild() {
+	Logger& logger = getInstance();
+	if (!logger._async)
+		return;
+	// Only the forking thread survives: forget about the writer, it cannot be joined here
+	static_cast<void>(logger._writer.release());
+	logger._running = false;
+	logger._async = false;
 }
 
 std::ostream& operator<<(std::ostream& os, const LogLevel level) {
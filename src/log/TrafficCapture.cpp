@@ -0,0 +1,158 @@
+#include "TrafficCapture.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "Logger.hpp"
+
+std::atomic<bool> TrafficCapture::_reopenRequested(false);
+
+TrafficCapture& TrafficCapture::getInstance() {
+	static TrafficCapture instance;
+	return instance;
+}
+
+TrafficCapture::~TrafficCapture() {
+	flush();
+	if (_fd != -1)
+		close(_fd);
+}
+
+/**
+ * @brief Also called on a reload: a capture to the same file keeps going, a new path starts a new file
+ */
+void TrafficCapture::configure(const TrafficCaptureConfig& config) {
+	const bool samePath = _fd != -1 && config.path == _config.path;
+	if (!samePath) {
+		flush();
+		if (_fd != -1)
+			close(_fd);
+		_fd = -1;
+	}
+	_config = config;
+	if (_config.path.empty())
+		return;
+	_buffer.reserve(_config.bufferSize + 64 * 1024);
+	if (!samePath)
+		_open();
+}
+
+/**
+ * @brief Start capturing a new client connection
+ * @return id of the connection in the capture, 0 if capturing is off
+ */
+uint32_t TrafficCapture::connectionOpened(const uint16_t port) {
+	if (_fd == -1)
+		return 0;
+	const uint32_t connection = _nextConnection++;
+	if (_nextConnection == 0)
+		_nextConnection = 1;
+	_appendHeader(OPEN, connection);
+	_appendInteger(port, 2);
+	_recordAdded();
+	return connection;
+}
+
+void TrafficCapture::received(const uint32_t connection, const char* data, const size_t size) {
+	if (_fd == -1 || connection == 0)
+		return;
+	_appendHeader(DATA, connection);
+	_appendInteger(size, 4);
+	_buffer.append(data, size);
+	_recordAdded();
+}
+
+void TrafficCapture::responded(const uint32_t connection, const int status, const bool withoutBody,
+							   const uint64_t bodyBytes) {
+	if (_fd == -1 || connection == 0)
+		return;
+	_appendHeader(RESPONSE, connection);
+	_appendInteger(static_cast<uint16_t>(status), 2);
+	_appendInteger(withoutBody ? RESPONSE_WITHOUT_BODY : 0, 1);
+	_appendInteger(bodyBytes, 8);
+	_recordAdded();
+}
+
+void TrafficCapture::connectionClosed(const uint32_t connection) {
+	if (_fd == -1 || connection == 0)
+		return;
+	_appendHeader(CLOSE, connection);
+	_recordAdded();
+}
+
+/**
+ * @brief Called once per event loop iteration, like AccessLog::tick
+ * @return milliseconds until the buffer has to be flushed, -1 if nothing is buffered
+ */
+int TrafficCapture::tick() {
+	if (_reopenRequested.exchange(false) && !_config.path.empty()) {
+		LOG_INFO("Reopening traffic capture " + _config.path);
+		flush();
+		if (_fd != -1)
+			close(_fd);
+		_open();
+	}
+	if (_buffer.empty())
+		return -1;
+	const auto due = _firstBufferedAt + std::chrono::milliseconds(_config.flushInterval);
+	const Clock::time_point now = Clock::now();
+	if (now >= due) {
+		flush();
+		return -1;
+	}
+	return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(due - now).count());
+}
+
+void TrafficCapture::flush() {
+	size_t written = 0;
+	while (_fd != -1 && written < _buffer.size()) {
+		const ssize_t bytes = write(_fd, _buffer.data() + written, _buffer.size() - written);
+		if (bytes == -1 && errno == EINTR)
+			continue;
+		if (bytes <= 0) {
+			LOG_ERROR("Writing traffic capture " + _config.path + " failed: " + std::string(strerror(errno)));
+			break;
+		}
+		written += bytes;
+	}
+	_buffer.clear();
+}
+
+/**
+ * @brief Only sets a flag, safe to call from a signal handler
+ */
+void TrafficCapture::requestReopen() { _reopenRequested = true; }
+
+/**
+ * @brief Every file is a capture of its own: it starts with the magic and counts time from its opening
+ */
+void TrafficCapture::_open() {
+	_fd = open(_config.path.c_str(), O_WRONLY | O_TRUNC | O_CREAT | O_CLOEXEC, 0600);
+	if (_fd == -1) {
+		LOG_ERROR("Cannot open traffic capture " + _config.path + ": " + std::string(strerror(errno)));
+		return;
+	}
+	_openedAt = Clock::now();
+	_buffer.append(MAGIC, sizeof(MAGIC));
+	_firstBufferedAt = _openedAt;
+}
+
+void TrafficCapture::_appendHeader(const RecordType type, const uint32_t connection) {
+	if (_buffer.empty())
+		_firstBufferedAt = Clock::now();
+	_appendInteger(type, 1);
+	_appendInteger(connection, 4);
+	_appendInteger(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - _openedAt).count(), 8);
+}
+
+void TrafficCapture::_appendInteger(const uint64_t value, const size_t bytes) {
+	for (size_t i = 0; i < bytes; ++i) _buffer += static_cast<char>((value >> (8 * i)) & 0xff);
+}
+
+void TrafficCapture::_recordAdded() {
+	if (_buffer.size() >= _config.bufferSize)
+		flush();
+}
@@ -10,14 +10,23 @@
 /*                                                                            */
 /* ************************************************************************** */
 
+#include <unistd.h>
+
 #include <atomic>
 #include <csignal>
 #include <exception>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <sstream>
 
+#include "AccessLog.hpp"
+#include "CgiLimiter.hpp"
+#include "ConnectionTable.hpp"
 #include "MultiSocketWebserver.hpp"
+#include "Socket.hpp"
+#include "TrafficCapture.hpp"
+#include "UpstreamManager.hpp"
 #include "globals.hpp"
 #include "webserv.hpp"
 
@@ -54,6 +63,68 @@ void printServerConfigs(const std::vector<std::vector<ServerConfig>> &server_con
 	}
 }
 
+struct Configuration {
+		HttpConfig http;
+		std::vector<std::vector<ServerConfig>> servers;
+};
+
+/**
+ * @brief Read, parse and validate the configuration file, at startup and on every reload
+ * @return std::nullopt if the file cannot be read or is invalid (the errors are logged)
+ */
+std::optional<Configuration> loadConfiguration(const std::string &filepath) {
+	LOG_INFO("Parsing configuration file...");
+	std::string source;
+	try {
+		source = readFile(filepath);
+	} catch (const std::runtime_error &e) {
+		LOG_ERROR("Failed to read configuration file: " + std::string(e.what()));
+		return std::nullopt;
+	}
+
+	Lexer lexer(filepath, source);
+	Parser parser(lexer);
+
+	Configuration configuration;
+	try {
+		configuration.servers = parser.parse();
+		validateServerConfigs(configuration.servers);
+	} catch (...) {
+		parser.flushErrors();
+		return std::nullopt;
+	}
+	configuration.http = parser.getHttpConfig();
+	return configuration;
+}
+
+/**
+ * @brief Apply the settings of the `http` block. `log_async` only takes effect at startup.
+ */
+void applyHttpConfig(const HttpConfig &httpConfig) {
+	CgiLimiter::getInstance().configure(httpConfig.getCgiMaxProcesses(), httpConfig.getCgiQueueSize(),
+										httpConfig.getCgiQueueTimeout());
+	UpstreamManager::getInstance().configure(httpConfig.getUpstreams());
+	Logger::getInstance().setLevel(httpConfig.getLogLevel());
+	TrafficCapture::getInstance().configure(httpConfig.getTrafficCapture());
+}
+
+/**
+ * @brief The files of all `access_log` and `slow_log` directives, for AccessLog::configure()
+ */
+std::vector<AccessLogConfig> accessLogConfigs(const std::vector<std::vector<ServerConfig>> &servers) {
+	std::vector<AccessLogConfig> configs;
+	for (const std::vector<ServerConfig> &listener : servers) {
+		for (const ServerConfig &server : listener) {
+			configs.push_back(server.getAccessLog());
+			// The slow log is buffered with the default access log settings
+			AccessLogConfig slowLog;
+			slowLog.path = server.getSlowLog().path;
+			configs.push_back(slowLog);
+		}
+	}
+	return configs;
+}
+
 // Signal handler function
 void signalHandler(const int signum) {
 	if (stopServer) {
@@ -69,6 +140,44 @@ void signalHandler(const int signum) {
 	signal(SIGINT, SIG_IGN);
 }
 
+/**
+ * @brief SIGTTIN logs more, SIGTTOU logs less (only changes an atomic, safe in a signal handler)
+ */
+void logLevelSignalHandler(const int signum) {
+	if (signum == SIGTTIN)
+		Logger::getInstance().increaseVerbosity();
+	else
+		Logger::getInstance().decreaseVerbosity();
+}
+
+/**
+ * @brief SIGUSR1 reopens the access logs and the traffic capture (e.g. after logrotate moved them)
+ */
+void reopenLogsSignalHandler(const int) {
+	AccessLog::requestReopen();
+	TrafficCapture::requestReopen();
+}
+
+/**
+ * @brief SIGUSR2 logs the table of open client connections
+ */
+void connectionDumpSignalHandler(const int) { ConnectionTable::requestDump(); }
+
+/**
+ * @brief SIGHUP reloads the configuration file without dropping connections
+ */
+void reloadSignalHandler(const int) { MultiSocketWebserver::requestReload(); }
+
+/**
+ * @brief SIGALRM starts the binary again, it takes over the listening sockets (binary upgrade)
+ */
+void upgradeSignalHandler(const int) { MultiSocketWebserver::requestUpgrade(); }
+
+/**
+ * @brief SIGQUIT stops accepting and exits once the open connections are done
+ */
+void drainSignalHandler(const int) { MultiSocketWebserver::requestDrain(); }
+
 int main(const int argc, const char *argv[]) {
 	std::string filepath;
 	if (argc != 2) {
@@ -82,40 +191,62 @@ int main(const int argc, const char *argv[]) {
 	// Register signal handler
 	signal(SIGINT, signalHandler);
 	signal(SIGTERM, signalHandler);
+	// Peers closing their end must not kill the process, writes report EPIPE instead
+	signal(SIGPIPE, SIG_IGN);
 
-	std::string source;
-	std::vector<std::vector<ServerConfig>> server_config_vectors;
-
-	LOG_INFO("Parsing configuration file...");
-	try {
-		source = readFile(filepath);
-	} catch (const std::runtime_error &e) {
-		LOG_ERROR("Failed to read configuration file: " + std::string(e.what()));
-		return 1;
-	}
-
-	Lexer lexer(filepath, source);
-	Parser parser(lexer);
-
-	try {
-		server_config_vectors = parser.parse();
-		validateServerConfigs(server_config_vectors);
-	} catch (...) {
-		parser.flushErrors();
+	std::optional<Configuration> configuration = loadConfiguration(filepath);
+	if (!configuration)
 		return 1;
-	}
 
-	printServerConfigs(server_config_vectors);
+	std::cout << configuration->http << std::endl;
+	printServerConfigs(configuration->servers);
+
+	applyHttpConfig(configuration->http);
+	AccessLog::getInstance().configure(accessLogConfigs(configuration->servers));
+	signal(SIGTTIN, logLevelSignalHandler);
+	signal(SIGTTOU, logLevelSignalHandler);
+	signal(SIGUSR1, reopenLogsSignalHandler);
+	signal(SIGUSR2, connectionDumpSignalHandler);
+	signal(SIGHUP, reloadSignalHandler);
+	signal(SIGALRM, upgradeSignalHandler);
+	signal(SIGQUIT, drainSignalHandler);
+	if (configuration->http.getLogAsync())
+		Logger::getInstance().startAsync();
 
 	try {
 		LOG_INFO("Starting server...");
-		MultiSocketWebserver server(server_config_vectors);
+		MultiSocketWebserver server(std::move(configuration->servers));
+		server.setConfigLoader([filepath]() -> std::optional<MultiSocketWebserver::LoadedConfig> {
+			std::optional<Configuration> reloaded = loadConfiguration(filepath);
+			if (!reloaded)
+				return std::nullopt;
+			std::vector<AccessLogConfig> accessLogs = accessLogConfigs(reloaded->servers);
+			return MultiSocketWebserver::LoadedConfig{
+				std::move(reloaded->servers), [http = reloaded->http, accessLogs = std::move(accessLogs)] {
+					applyHttpConfig(http);
+					AccessLog::getInstance().configure(accessLogs);
+				}};
+		});
+		server.setUpgradeCommand(std::vector<std::string>(argv, argv + argc));
+		const bool upgrading = Socket::loadInherited();
 		server.initSockets();
+		Socket::closeUnusedInherited();
+		if (upgrading) {
+			// Listening on the inherited sockets now, the old process can stop accepting
+			LOG_INFO("Binary upgrade: took over the listening sockets, draining pid " + std::to_string(getppid()));
+			kill(getppid(), SIGQUIT);
+		}
 		server.run();
 	} catch (const std::exception &e) {
 		LOG_ERROR("Server Error: " + std::string(e.what()));
+		AccessLog::getInstance().flushAll();
+		TrafficCapture::getInstance().flush();
+		Logger::getInstance().stopAsync();
 		return 1;
 	}
 
+	AccessLog::getInstance().flushAll();
+	TrafficCapture::getInstance().flush();
+	Logger::getInstance().stopAsync();
 	return 0;
 }
@@ -0,0 +1,97 @@
+#include "ConnectionTable.hpp"
+
+#include <cstdio>
+#include <sstream>
+
+#include "webserv.hpp"
+
+std::atomic<bool> ConnectionTable::_dumpRequested(false);
+
+namespace {
+void appendRow(std::string& out, const ConnectionTable::Row& row) {
+	char line[256];
+	std::snprintf(line, sizeof(line), "%-6d %-21s %-16s %9lld %9lld %8zu %8zu %10zu %8d %-9s ", row.fd,
+				  row.peer.c_str(), row.status, static_cast<long long>(row.age.count()),
+				  static_cast<long long>(row.idle.count()), row.headerBuffered, row.bodyBuffered, row.bytesSent,
+				  static_cast<int>(row.cgiPid), row.cgiState);
+	out += line;
+	out += row.requestLine.empty() ? "-" : row.requestLine;
+	out += '\n';
+}
+
+void appendChunk(std::string& out, const std::string& data) {
+	std::ostringstream size;
+	size << std::hex << data.size();
+	out += size.str();
+	out += "\r\n";
+	out += data;
+	out += "\r\n";
+}
+}  // namespace
+
+ConnectionTable& ConnectionTable::getInstance() {
+	static ConnectionTable instance;
+	return instance;
+}
+
+void ConnectionTable::setSource(Lister lister, Describer describer) {
+	_lister = std::move(lister);
+	_describer = std::move(describer);
+}
+
+/**
+ * @brief Start a dump of the connections that are open right now
+ * @param chunked produce `Transfer-Encoding: chunked` framing (HTTP/1.1 responses)
+ */
+std::shared_ptr<ConnectionTable::Stream> ConnectionTable::stream(const bool chunked) const {
+	return std::make_shared<Stream>(_lister ? _lister() : std::vector<int>(), chunked);
+}
+
+bool ConnectionTable::describe(const int fd, Row& row) const { return _describer && _describer(fd, row); }
+
+/**
+ * @brief Only sets a flag, safe to call from a signal handler
+ */
+void ConnectionTable::requestDump() { _dumpRequested = true; }
+
+bool ConnectionTable::takeDumpRequest() { return _dumpRequested.exchange(false); }
+
+ConnectionTable::Stream::Stream(std::vector<int> fds, const bool chunked) : _fds(std::move(fds)), _chunked(chunked) {}
+
+BodyStream::Status ConnectionTable::Stream::read(std::string& chunk, const size_t maxSize) {
+	chunk.clear();
+	if (_done)
+		return Status::END;
+
+	std::string rows;
+	if (!_headerSent) {
+		rows += "# " + std::to_string(_fds.size()) + " connections\n";
+		char header[256];
+		std::snprintf(header, sizeof(header), "%-6s %-21s %-16s %9s %9s %8s %8s %10s %8s %-9s %s\n", "fd", "peer",
+					  "status", "age_ms", "idle_ms", "header", "body", "sent", "cgi_pid", "cgi_state", "request");
+		rows += header;
+		_headerSent = true;
+	}
+
+	// A bounded batch per call keeps the event loop responsive for large tables
+	const size_t budget = std::min(maxSize, CONNECTION_TABLE_BATCH_BYTES);
+	ConnectionTable::Row row;
+	while (_next < _fds.size() && rows.size() < budget) {
+		row = ConnectionTable::Row();
+		if (ConnectionTable::getInstance().describe(_fds[_next], row))
+			appendRow(rows, row);
+		++_next;
+	}
+
+	if (_next == _fds.size())
+		_done = true;
+	if (!_chunked) {
+		chunk = std::move(rows);
+		return Status::DATA;
+	}
+	if (!rows.empty())
+		appendChunk(chunk, rows);
+	if (_done)
+		chunk += "0\r\n\r\n";
+	return Status::DATA;
+}
@@ -0,0 +1,40 @@
+#include "LatencyHistogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+static_assert(LatencyHistogram::indexOf(LatencyHistogram::MAX_VALUE) == LatencyHistogram::BUCKET_COUNT - 1);
+static_assert(LatencyHistogram::highestValueOf(LatencyHistogram::BUCKET_COUNT - 1) == LatencyHistogram::MAX_VALUE);
+static_assert(LatencyHistogram::indexOf(LatencyHistogram::highestValueOf(100) + 1) == 101);
+
+void LatencyHistogram::Snapshot::add(const LatencyHistogram& histogram) {
+	for (size_t i = 0; i < BUCKET_COUNT; ++i) counts[i] += histogram._counts[i].load(std::memory_order_relaxed);
+	count += histogram._count.load(std::memory_order_relaxed);
+	sum += histogram._sum.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Number of recorded values whose whole bucket lies at or below `value`
+ */
+uint64_t LatencyHistogram::Snapshot::countAtOrBelow(const uint64_t value) const {
+	uint64_t total = 0;
+	for (size_t i = 0; i < BUCKET_COUNT && highestValueOf(i) <= value; ++i) total += counts[i];
+	return total;
+}
+
+/**
+ * @brief Smallest bucket bound that covers the given share of the recorded values
+ * @param quantile between 0 and 1
+ */
+uint64_t LatencyHistogram::Snapshot::valueAtQuantile(const double quantile) const {
+	if (count == 0)
+		return 0;
+	const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(count))));
+	uint64_t seen = 0;
+	for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+		seen += counts[i];
+		if (seen >= rank)
+			return highestValueOf(i);
+	}
+	return MAX_VALUE;
+}
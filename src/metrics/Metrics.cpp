@@ -0,0 +1,269 @@
+#include "Metrics.hpp"
+
+#include <cstdio>
+
+#include "CgiCache.hpp"
+#include "CgiLimiter.hpp"
+
+namespace {
+// `le` bounds of the exported histogram: microseconds and their rendering in seconds
+constexpr std::pair<uint64_t, const char*> LATENCY_BOUNDS[] = {
+	{100, "0.0001"},  {250, "0.00025"},  {500, "0.0005"},  {1000, "0.001"},	  {2500, "0.0025"}, {5000, "0.005"},
+	{10000, "0.01"},  {25000, "0.025"},  {50000, "0.05"},  {100000, "0.1"},	  {250000, "0.25"}, {500000, "0.5"},
+	{1000000, "1"},	  {2500000, "2.5"},	 {5000000, "5"},   {10000000, "10"},  {30000000, "30"},
+};
+constexpr std::pair<double, const char*> LATENCY_QUANTILES[] = {
+	{0.5, "0.5"}, {0.9, "0.9"}, {0.99, "0.99"}, {0.999, "0.999"}};
+constexpr const char* STATUS_CLASSES[] = {"1xx", "2xx", "3xx", "4xx", "5xx"};
+
+std::string escapeLabel(const std::string& value) {
+	std::string escaped;
+	escaped.reserve(value.size());
+	for (const char c : value) {
+		if (c == '\\' || c == '"')
+			escaped += '\\';
+		if (c == '\n') {
+			escaped += "\\n";
+			continue;
+		}
+		escaped += c;
+	}
+	return escaped;
+}
+
+std::string formatSeconds(const uint64_t microseconds) {
+	char seconds[32];
+	std::snprintf(seconds, sizeof(seconds), "%.6f", static_cast<double>(microseconds) / 1e6);
+	return seconds;
+}
+
+void appendHeader(std::string& out, const char* name, const char* type, const char* help) {
+	out += "# HELP ";
+	out += name;
+	out += ' ';
+	out += help;
+	out += "\n# TYPE ";
+	out += name;
+	out += ' ';
+	out += type;
+	out += '\n';
+}
+
+void appendMetric(std::string& out, const char* name, const char* type, const char* help, const uint64_t value) {
+	appendHeader(out, name, type, help);
+	out += name;
+	out += ' ';
+	out += std::to_string(value);
+	out += '\n';
+}
+
+void appendHistogram(std::string& out, const std::string& name, const std::string& labels,
+					 const LatencyHistogram::Snapshot& histogram) {
+	for (const auto& [bound, le] : LATENCY_BOUNDS) {
+		out += name + "_bucket{" + labels + ",le=\"" + le + "\"} " +
+			   std::to_string(histogram.countAtOrBelow(bound)) + "\n";
+	}
+	out += name + "_bucket{" + labels + ",le=\"+Inf\"} " + std::to_string(histogram.count) + "\n";
+	out += name + "_sum{" + labels + "} " + formatSeconds(histogram.sum) + "\n";
+	out += name + "_count{" + labels + "} " + std::to_string(histogram.count) + "\n";
+}
+
+void appendQuantiles(std::string& out, const std::string& name, const std::string& labels,
+					 const LatencyHistogram::Snapshot& histogram) {
+	for (const auto& [quantile, value] : LATENCY_QUANTILES) {
+		out += name + "{" + labels + ",quantile=\"" + value + "\"} " +
+			   formatSeconds(histogram.valueAtQuantile(quantile)) + "\n";
+	}
+}
+}  // namespace
+
+Metrics& Metrics::getInstance() {
+	static Metrics instance;
+	return instance;
+}
+
+void Metrics::connectionAccepted() { _local().accepted.add(1); }
+
+void Metrics::loopWakeup() { _local().loopWakeups.add(1); }
+
+void Metrics::bytesReceived(const size_t bytes) { _local().bytesIn.add(bytes); }
+
+void Metrics::bytesSent(const size_t bytes) { _local().bytesOut.add(bytes); }
+
+void Metrics::cgiSpawned() { _local().cgiSpawned.add(1); }
+
+void Metrics::cgiTimedOut() { _local().cgiTimeouts.add(1); }
+
+/**
+ * @brief Count a completed response and its latency for the route that handled it
+ * @param route path of the matched location, empty if the request never got that far
+ */
+void Metrics::recordRequest(const std::string& host, const int port, const std::string& route, const int status,
+							const std::chrono::microseconds duration) {
+	Shard& shard = _local();
+	std::string& key = shard.keyBuffer;
+	key.assign(host).append(":").append(std::to_string(port)).append("\t").append(route);
+
+	auto it = shard.routes.find(key);
+	if (it == shard.routes.end()) {
+		auto stats = std::make_unique<RouteStats>();
+		stats->server = key.substr(0, key.find('\t'));
+		stats->route = route;
+		const std::lock_guard<std::mutex> lock(shard.routesMutex);
+		it = shard.routes.emplace(key, std::move(stats)).first;
+	}
+	RouteStats& stats = *it->second;
+	if (status >= 100 && status < 600)
+		stats.requests[status / 100 - 1].add(1);
+	stats.latency.record(static_cast<uint64_t>(duration.count()));
+}
+
+/**
+ * @brief Add the phases of a completed request to the server wide phase histograms
+ */
+void Metrics::recordPhases(const RequestTiming& timing) {
+	Shard& shard = _local();
+	for (int mark = RequestTiming::FIRST_BYTE; mark < RequestTiming::MARK_COUNT; ++mark) {
+		const std::chrono::microseconds phase = timing.phase(static_cast<RequestTiming::Mark>(mark));
+		if (phase.count() >= 0)
+			shard.phases[mark].record(static_cast<uint64_t>(phase.count()));
+	}
+}
+
+void Metrics::setConnectionCollector(ConnectionCollector collector) {
+	const std::lock_guard<std::mutex> lock(_mutex);
+	_connectionCollector = std::move(collector);
+}
+
+/**
+ * @brief Sum up all shards and render them in the Prometheus text exposition format (version 0.0.4)
+ */
+std::string Metrics::render() const {
+	struct RouteTotals {
+			std::string server;
+			std::string route;
+			uint64_t requests[5] = {0, 0, 0, 0, 0};
+			LatencyHistogram::Snapshot latency;
+	};
+
+	uint64_t accepted = 0;
+	uint64_t loopWakeups = 0;
+	uint64_t bytesIn = 0;
+	uint64_t bytesOut = 0;
+	uint64_t cgiSpawned = 0;
+	uint64_t cgiTimeouts = 0;
+	std::map<std::string, RouteTotals> routes;
+	LatencyHistogram::Snapshot phases[RequestTiming::MARK_COUNT];
+	ConnectionCounts connections;
+	{
+		const std::lock_guard<std::mutex> lock(_mutex);
+		for (const auto& shard : _shards) {
+			accepted += shard->accepted.get();
+			loopWakeups += shard->loopWakeups.get();
+			bytesIn += shard->bytesIn.get();
+			bytesOut += shard->bytesOut.get();
+			cgiSpawned += shard->cgiSpawned.get();
+			cgiTimeouts += shard->cgiTimeouts.get();
+			for (int mark = RequestTiming::FIRST_BYTE; mark < RequestTiming::MARK_COUNT; ++mark)
+				phases[mark].add(shard->phases[mark]);
+
+			const std::lock_guard<std::mutex> routesLock(shard->routesMutex);
+			for (const auto& [key, stats] : shard->routes) {
+				RouteTotals& totals = routes[key];
+				totals.server = stats->server;
+				totals.route = stats->route;
+				for (size_t i = 0; i < 5; ++i) totals.requests[i] += stats->requests[i].get();
+				totals.latency.add(stats->latency);
+			}
+		}
+		if (_connectionCollector)
+			connections = _connectionCollector();
+	}
+
+	std::string out;
+	out.reserve(4096 + routes.size() * 4096);
+
+	appendMetric(out, "webserv_connections_accepted_total", "counter", "Accepted client connections.", accepted);
+	appendMetric(out, "webserv_connections_active", "gauge", "Open client connections.", connections.active);
+	appendMetric(out, "webserv_connections_reading", "gauge", "Connections receiving a request.",
+				 connections.reading);
+	appendMetric(out, "webserv_connections_writing", "gauge", "Connections processing or sending a response.",
+				 connections.writing);
+	appendMetric(out, "webserv_connections_waiting", "gauge", "Idle keep-alive connections.", connections.waiting);
+	appendMetric(out, "webserv_event_loop_wakeups_total", "counter", "Returns from poll, events or timeouts.",
+				 loopWakeups);
+	appendMetric(out, "webserv_received_bytes_total", "counter", "Bytes received from clients.", bytesIn);
+	appendMetric(out, "webserv_sent_bytes_total", "counter", "Bytes sent to clients.", bytesOut);
+
+	appendHeader(out, "webserv_requests_total", "counter", "Completed requests by route and status class.");
+	for (const auto& [key, totals] : routes) {
+		const std::string labels =
+			"server=\"" + escapeLabel(totals.server) + "\",route=\"" + escapeLabel(totals.route) + "\"";
+		for (size_t i = 0; i < 5; ++i) {
+			if (totals.requests[i] != 0)
+				out += "webserv_requests_total{" + labels + ",code=\"" + STATUS_CLASSES[i] + "\"} " +
+					   std::to_string(totals.requests[i]) + "\n";
+		}
+	}
+
+	appendHeader(out, "webserv_request_duration_seconds", "histogram",
+				 "Time from the first byte of the request to the last byte of the response.");
+	for (const auto& [key, totals] : routes) {
+		const std::string labels =
+			"server=\"" + escapeLabel(totals.server) + "\",route=\"" + escapeLabel(totals.route) + "\"";
+		appendHistogram(out, "webserv_request_duration_seconds", labels, totals.latency);
+	}
+
+	appendHeader(out, "webserv_request_duration_quantile_seconds", "gauge",
+				 "Request latency quantiles since start, within 12.5%.");
+	for (const auto& [key, totals] : routes) {
+		const std::string labels =
+			"server=\"" + escapeLabel(totals.server) + "\",route=\"" + escapeLabel(totals.route) + "\"";
+		appendQuantiles(out, "webserv_request_duration_quantile_seconds", labels, totals.latency);
+	}
+
+	appendHeader(out, "webserv_request_phase_seconds", "histogram",
+				 "Time spent per request phase (wait, header, body, dispatch, handler, response_start, send).");
+	for (int mark = RequestTiming::FIRST_BYTE; mark < RequestTiming::MARK_COUNT; ++mark) {
+		const std::string labels =
+			std::string("phase=\"") + RequestTiming::phaseName(static_cast<RequestTiming::Mark>(mark)) + "\"";
+		appendHistogram(out, "webserv_request_phase_seconds", labels, phases[mark]);
+	}
+	appendHeader(out, "webserv_request_phase_quantile_seconds", "gauge",
+				 "Request phase quantiles since start, within 12.5%.");
+	for (int mark = RequestTiming::FIRST_BYTE; mark < RequestTiming::MARK_COUNT; ++mark) {
+		const std::string labels =
+			std::string("phase=\"") + RequestTiming::phaseName(static_cast<RequestTiming::Mark>(mark)) + "\"";
+		appendQuantiles(out, "webserv_request_phase_quantile_seconds", labels, phases[mark]);
+	}
+
+	const CgiLimiter::Counters& limiter = CgiLimiter::getInstance().getCounters();
+	const CgiCache::Counters& cache = CgiCache::getInstance().getCounters();
+	appendMetric(out, "webserv_cgi_spawned_total", "counter", "Started CGI processes.", cgiSpawned);
+	appendMetric(out, "webserv_cgi_timeouts_total", "counter", "CGI processes killed or abandoned after a timeout.",
+				 cgiTimeouts);
+	appendMetric(out, "webserv_cgi_running", "gauge", "Running CGI processes.", limiter.running);
+	appendMetric(out, "webserv_cgi_queued", "gauge", "Requests waiting for a CGI slot.", limiter.queued);
+	appendMetric(out, "webserv_cgi_rejected_total", "counter", "Requests rejected because the CGI queue was full.",
+				 limiter.rejected);
+	appendMetric(out, "webserv_cgi_queue_timeouts_total", "counter", "Requests that waited too long for a CGI slot.",
+				 limiter.timedOut);
+	appendMetric(out, "webserv_cgi_cache_hits_total", "counter", "CGI responses served from the cache.", cache.hits);
+	appendMetric(out, "webserv_cgi_cache_stale_total", "counter", "Stale CGI responses served from the cache.",
+				 cache.stale);
+	appendMetric(out, "webserv_cgi_cache_misses_total", "counter", "CGI cache misses.", cache.misses);
+	return out;
+}
+
+/**
+ * @brief The calling thread's shard, registered on first use
+ */
+Metrics::Shard& Metrics::_local() {
+	thread_local Shard* shard = nullptr;
+	if (shard == nullptr) {
+		const std::lock_guard<std::mutex> lock(_mutex);
+		_shards.push_back(std::make_unique<Shard>());
+		shard = _shards.back().get();
+	}
+	return *shard;
+}
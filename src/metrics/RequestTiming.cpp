@@ -0,0 +1,56 @@
+#include "RequestTiming.hpp"
+
+/**
+ * @brief Start over for the next request, the connection became idle at `accepted`
+ */
+void RequestTiming::reset(const Clock::time_point accepted) {
+	marks.fill(Clock::time_point());
+	marks[ACCEPTED] = accepted;
+}
+
+/**
+ * @brief Time from the previous mark that was reached to `mark`
+ * @return -1 us if `mark` was not reached
+ */
+std::chrono::microseconds RequestTiming::phase(const Mark mark) const {
+	if (mark == ACCEPTED || !has(mark))
+		return std::chrono::microseconds(-1);
+	for (int previous = mark - 1; previous >= ACCEPTED; --previous) {
+		if (has(static_cast<Mark>(previous)))
+			return std::chrono::duration_cast<std::chrono::microseconds>(marks[mark] - marks[previous]);
+	}
+	return std::chrono::microseconds(-1);
+}
+
+/**
+ * @brief Time from the first byte of the request to the last byte of the response
+ */
+std::chrono::microseconds RequestTiming::total() const {
+	if (!has(FIRST_BYTE) || !has(LAST_BYTE))
+		return std::chrono::microseconds(-1);
+	return std::chrono::duration_cast<std::chrono::microseconds>(marks[LAST_BYTE] - marks[FIRST_BYTE]);
+}
+
+/**
+ * @brief Name of the phase that ends at `mark`
+ */
+const char* RequestTiming::phaseName(const Mark mark) {
+	switch (mark) {
+		case FIRST_BYTE:
+			return "wait";
+		case HEADER_DONE:
+			return "header";
+		case BODY_DONE:
+			return "body";
+		case ROUTE_MATCHED:
+			return "dispatch";
+		case HANDLER_DONE:
+			return "handler";
+		case FIRST_RESPONSE_BYTE:
+			return "response_start";
+		case LAST_BYTE:
+			return "send";
+		default:
+			return "accept";
+	}
+}
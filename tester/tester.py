@@ -1,5 +1,13 @@
 import requests
+import http.client
 import json
+import os
+import re
+import signal
+import socket
+import subprocess
+import threading
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
 from colorama import init, Fore, Style
 
 # Initialize colorama for colored output
@@ -8,6 +16,18 @@ init(autoreset=True)
 # Base URL for the server
 BASE_URL = "http://localhost:8080"
 
+# Address of the backend the /proxy/ location of tester.conf forwards to
+BACKEND_ADDRESS = ("127.0.0.1", 8081)
+
+# access_log of the server in tester.conf, flushed every 100ms
+ACCESS_LOG = "/tmp/webserv-tester-access.log"
+
+# Tags the requests of this run in the log files, which outlive it
+RUN_ID = str(os.getpid())
+
+# slow_log of the server in tester.conf, which shares the buffers of the access log but flushes every second
+SLOW_LOG = "/tmp/webserv-tester-slow.log"
+
 # Utility function to display test results
 def print_result(title, success, method=None, endpoint=None):
 	if success:
@@ -17,17 +37,63 @@ def print_result(title, success, method=None, endpoint=None):
 		if method and endpoint:
 			print(f"{Fore.RED}   → {method} {endpoint}")
 
-# Utility function to make requests and handle exceptions
-def make_request(title, method, endpoint, headers=None, data=None, files=None, expected_status=None):
+# Utility function to make requests and handle exceptions. Redirects are not followed, so their status can be
+# checked. expected_headers maps header names to their value, or to None if the header must be absent.
+def make_request(title, method, endpoint, headers=None, data=None, files=None, expected_status=None,
+		expected_headers=None, expected_body=None):
 	try:
-		response = requests.request(method, BASE_URL + endpoint, headers=headers, data=data, files=files)
-		success = response.status_code == expected_status
-		print_result(title, success, method, endpoint)
-		if not success:
-			print(f"{Fore.RED}   Expected: {expected_status}, Got: {response.status_code}\nResponse: {response.text}\n")
+		response = requests.request(method, BASE_URL + endpoint, headers=headers, data=data, files=files,
+			allow_redirects=False)
+		errors = []
+		if response.status_code != expected_status:
+			errors.append(f"Expected: {expected_status}, Got: {response.status_code}")
+		for name, value in (expected_headers or {}).items():
+			if response.headers.get(name) != value:
+				errors.append(f"Expected header {name}: {value}, Got: {response.headers.get(name)}")
+		if expected_body is not None and expected_body not in response.text:
+			errors.append(f"Expected body containing: {expected_body}")
+		print_result(title, not errors, method, endpoint)
+		if errors:
+			print(f"{Fore.RED}   " + "\n   ".join(errors) + f"\nResponse: {response.text}\n")
+		return response
 	except requests.exceptions.RequestException as e:
 		print_result(title, False, method, endpoint)
 		print(f"{Fore.RED}   Error: {e}")
+		return None
+
+# Utility function to send raw bytes on one connection and read back the given number of responses,
+# for what requests cannot express (hand-made chunked bodies, pipelining)
+def send_raw(payload, count):
+	host, port = BASE_URL.split("//")[1].split(":")
+	with socket.create_connection((host, int(port)), timeout=5) as sock:
+		sock.sendall(payload)
+		data = b""
+		responses = []
+		while len(responses) < count:
+			end = data.find(b"\r\n\r\n")
+			if end != -1:
+				head = data[:end].decode(errors="replace")
+				length = 0
+				for line in head.split("\r\n")[1:]:
+					name, _, value = line.partition(":")
+					if name.strip().lower() == "content-length":
+						length = int(value)
+				if len(data) >= end + 4 + length:
+					status = int(head.split(" ")[1])
+					responses.append((status, data[end + 4:end + 4 + length].decode(errors="replace")))
+					data = data[end + 4 + length:]
+					continue
+			chunk = sock.recv(65536)
+			if not chunk:
+				break
+			data += chunk
+		return responses
+
+# Utility function to signal the webserv under test, which has to be the only one running
+def signal_server(signum):
+	pid = int(subprocess.check_output(["pgrep", "-x", "webserv"]).split()[0])
+	os.kill(pid, signum)
+	return pid
 
 # Testing GET requests
 def test_get_requests():
@@ -40,6 +106,7 @@ def test_get_requests():
 	make_request("GET request to a non-existent endpoint.", "GET", "/nonexistent", expected_status=404)
 	make_request("GET request with body.", "GET", "/", data="This should be ignored", expected_status=200)
 
+	test_upgrade()
 	make_request("GET request with local root.", "GET", "/local-root/index.html", expected_status=200)
 
 # Testing POST requests
@@ -77,6 +144,423 @@ def test_cgi_requests():
 	make_request("CGI request to a non-existent CGI script.", "GET", "/cgi-bin/nonexistent.py", expected_status=404)
 	make_request("CGI request with malformed URL targeting CGI scripts.", "GET", "/cgi-bin/%invalid-url%", expected_status=400)
 
+# Testing a CGI request body that the child's stdin pipe cannot take at once: it is written from the event loop as
+# the child reads it
+def test_cgi_request_body():
+	print("\nCGI Request Body")
+	make_request("CGI POST request with a body larger than the pipe buffer.", "POST", "/cgi-bin/hello.py",
+		headers={"Content-Type": "text/plain"}, data="x" * (1024 * 1024), expected_status=200,
+		expected_body="Content Length: 1048576")
+
+# Testing chunked request bodies: every chunk is decoded, trailer fields are skipped and the bytes after the
+# body are the next request on the connection
+def test_chunked_requests():
+	print("\nChunked Requests")
+	cases = [
+		("Chunked POST with several chunks, followed by a pipelined GET.",
+			b"5\r\nHello\r\n8\r\n, chunke\r\n7\r\nd world\r\n0\r\n\r\n"),
+		("Chunked POST with trailer fields, followed by a pipelined GET.",
+			b"5\r\nHello\r\nf\r\n, chunked world\r\n0\r\nX-Checksum: 1234\r\nX-Other: trailer\r\n\r\n"),
+	]
+	for title, body in cases:
+		payload = (b"POST /cgi-bin/hello.py HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n" + body
+			+ b"GET / HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n")
+		try:
+			responses = send_raw(payload, 2)
+			success = (len(responses) == 2 and responses[0][0] == 200
+				and "POST Data: Hello, chunked world" in responses[0][1] and responses[1][0] == 200)
+			print_result(title, success, "POST", "/cgi-bin/hello.py")
+			if not success:
+				print(f"{Fore.RED}   Got: {responses}\n")
+		except OSError as e:
+			print_result(title, False, "POST", "/cgi-bin/hello.py")
+			print(f"{Fore.RED}   Error: {e}")
+
+# Testing virtual hosts: the second server of tester.conf answers every request with a redirect
+def test_virtual_hosts():
+	print("\nVirtual Hosts")
+	make_request("Unknown Host goes to the default server.", "GET", "/", headers={"Host": "unknown.invalid"}, expected_status=200)
+	make_request("Host with a port matches the server name.", "GET", "/", headers={"Host": "www.example.test:8080"},
+		expected_status=301, expected_headers={"Location": "/virtual-host"})
+	make_request("Wildcard server name (*.example.test).", "GET", "/", headers={"Host": "www.example.test"},
+		expected_status=301, expected_headers={"Location": "/virtual-host"})
+	make_request("Host names are case insensitive.", "GET", "/", headers={"Host": "WWW.Example.Test"},
+		expected_status=301, expected_headers={"Location": "/virtual-host"})
+	make_request("Regex server name (~^api[0-9]+\\.example\\.org$).", "GET", "/", headers={"Host": "api12.example.org"},
+		expected_status=301, expected_headers={"Location": "/virtual-host"})
+	make_request("Host that does not match the regex goes to the default server.", "GET", "/",
+		headers={"Host": "api.example.org"}, expected_status=200)
+
+# Testing location matching
+def test_locations():
+	print("\nLocations")
+	make_request("Exact location (location = /exact).", "GET", "/exact", expected_status=301,
+		expected_headers={"Location": "/exact-matched"})
+	make_request("Exact location does not match a longer path.", "GET", "/exact/more", expected_status=404)
+	make_request("Regex location (location ~ ^/regex/[0-9]+$).", "GET", "/regex/42", expected_status=301,
+		expected_headers={"Location": "/regex-matched"})
+	make_request("Regex location does not match other paths.", "GET", "/regex/abc", expected_status=404)
+
+# Testing MIME types: the types block of /types/ comes before the built-in table
+def test_mime_types():
+	print("\nMIME Types")
+	make_request("Extension from the types block, case insensitive.", "GET", "/types/app.LOG", expected_status=200,
+		expected_headers={"Content-Type": "text/plain"})
+	make_request("types block overrides a built-in extension.", "GET", "/types/data.html", expected_status=200,
+		expected_headers={"Content-Type": "application/json"})
+	make_request("Built-in extension.", "GET", "/types/script.js", expected_status=200,
+		expected_headers={"Content-Type": "application/javascript"})
+	make_request("Unknown extension.", "GET", "/types/blob.xyz", expected_status=200,
+		expected_headers={"Content-Type": "application/octet-stream"})
+	make_request("Override is limited to its location.", "GET", "/html/index.html", expected_status=200,
+		expected_headers={"Content-Type": "text/html"})
+
+# Testing add_header, and the cached Date header
+def test_add_header():
+	print("\nadd_header")
+	make_request("add_header on a 200 response.", "GET", "/headers/index.html", expected_status=200,
+		expected_headers={"X-Tester": "yes", "X-Tester-Always": "yes"})
+	make_request("add_header without always is not added to a 404 response.", "GET", "/headers/nonexistent",
+		expected_status=404, expected_headers={"X-Tester": None, "X-Tester-Always": "yes"})
+	response = make_request("Response with a Date header.", "GET", "/", expected_status=200)
+	date = response.headers.get("Date", "") if response is not None else ""
+	success = re.match(r"^(Mon|Tue|Wed|Thu|Fri|Sat|Sun), \d{2} \w{3} \d{4} \d{2}:\d{2}:\d{2} GMT$", date) is not None
+	print_result("Date is an IMF-fixdate.", success, "GET", "/")
+	if not success:
+		print(f"{Fore.RED}   Got: {date}\n")
+
+# Testing JSON directory listings
+def test_json_autoindex():
+	print("\nJSON Autoindex")
+	for title, endpoint, headers in [
+			("JSON listing with autoindex_format json.", "/listing/", None),
+			("JSON listing for an Accept header that prefers it.", "/cgi-bin/", {"Accept": "application/json"})]:
+		response = make_request(title, "GET", endpoint, headers=headers, expected_status=200,
+			expected_headers={"Content-Type": "application/json"})
+		if response is None or response.status_code != 200:
+			continue
+		try:
+			names = [entry["name"] for entry in response.json()["entries"]]
+			print_result("   ... lists the directory.", names == ["hello.pl", "hello.py"], "GET", endpoint)
+		except (ValueError, KeyError) as e:
+			print_result("   ... lists the directory.", False, "GET", endpoint)
+			print(f"{Fore.RED}   Error: {e}")
+	endpoint = "/listing/?limit=1"
+	pages = []
+	while endpoint and len(pages) < 3:
+		response = requests.get(BASE_URL + endpoint)
+		try:
+			page = response.json()
+			pages.append([entry["name"] for entry in page["entries"]])
+			endpoint = f"/listing/?limit=1&cursor={page['next']}" if page["next"] else None
+		except (ValueError, KeyError):
+			break
+	print_result("JSON listing is paged by a cursor.", pages == [["hello.pl"], ["hello.py"]], "GET", "/listing/?limit=1")
+	if pages != [["hello.pl"], ["hello.py"]]:
+		print(f"{Fore.RED}   Got: {pages}\n")
+	make_request("HTML listing without an Accept header.", "GET", "/cgi-bin/", expected_status=200,
+		expected_headers={"Content-Type": "text/html"})
+
+# Backend for the proxy tests, answers with the path and body it received
+class BackendHandler(BaseHTTPRequestHandler):
+	def do_GET(self):
+		self._reply(self.path.encode())
+
+	def do_POST(self):
+		self._reply(self.path.encode() + b" " + self.rfile.read(int(self.headers.get("Content-Length", 0))))
+
+	def _reply(self, body):
+		self.send_response(200)
+		self.send_header("Content-Type", "text/plain")
+		self.send_header("Content-Length", str(len(body)))
+		self.end_headers()
+		self.wfile.write(body)
+
+	def log_message(self, format, *args):
+		pass
+
+# Testing proxy_pass
+def test_proxy_requests():
+	print("\nProxy Requests")
+	backend = ThreadingHTTPServer(BACKEND_ADDRESS, BackendHandler)
+	threading.Thread(target=backend.serve_forever, daemon=True).start()
+	try:
+		make_request("Proxied GET replaces the location prefix.", "GET", "/proxy/hello?x=1", expected_status=200,
+			expected_body="/backend/hello?x=1")
+		make_request("Proxied POST forwards the body.", "POST", "/proxy/echo", data="proxied body", expected_status=200,
+			expected_body="/backend/echo proxied body")
+	finally:
+		backend.shutdown()
+		backend.server_close()
+	make_request("Proxied request without a backend.", "GET", "/proxy/hello", expected_status=502)
+
+# Testing the CGI limiter: /cgi-limited/ runs one CGI at a time and nothing may queue
+def test_cgi_limiter():
+	print("\nCGI Limiter")
+	first = threading.Thread(target=make_request, args=("CGI request that takes the only slot.", "GET",
+		"/cgi-limited/sleep.py"), kwargs={"expected_status": 200})
+	first.start()
+	threading.Event().wait(0.3)
+	make_request("CGI request while the slot is busy gets 503.", "GET", "/cgi-limited/sleep.py", expected_status=503,
+		expected_headers={"Retry-After": "2"})
+	first.join()
+
+# Utility function for the CGI cache tests: runs the requests concurrently and returns the X-Cache-Status and
+# body of each response, in the order of the endpoints
+def fetch_cached(endpoints, method="GET", delay=0.0):
+	results = [None] * len(endpoints)
+	def fetch(index, endpoint):
+		try:
+			response = requests.request(method, BASE_URL + endpoint)
+			results[index] = (response.headers.get("X-Cache-Status"), response.text)
+		except requests.exceptions.RequestException as e:
+			results[index] = (None, str(e))
+	threads = []
+	for index, endpoint in enumerate(endpoints):
+		threads.append(threading.Thread(target=fetch, args=(index, endpoint)))
+		threads[-1].start()
+		threading.Event().wait(delay)
+	for thread in threads:
+		thread.join()
+	return results
+
+def check_cached(title, endpoint, results, expected_statuses, same_body):
+	statuses = [status for status, _ in results]
+	bodies = {body for _, body in results}
+	success = statuses == expected_statuses and (len(bodies) == 1) == same_body
+	print_result(title, success, "GET", endpoint)
+	if not success:
+		print(f"{Fore.RED}   Expected: {expected_statuses}, Got: {results}\n")
+
+# Testing the CGI cache: /cgi-cached/ caches for 1s and serves a stale copy while it is being updated.
+# stamp.py takes 0.5s and answers with a timestamp, its query string sets the Cache-Control it sends.
+def test_cgi_cache():
+	print("\nCGI Cache")
+	endpoint = "/cgi-cached/stamp.py"
+	results = fetch_cached([endpoint] * 3, delay=0.1)
+	check_cached("Concurrent requests run the CGI once.", endpoint, results, ["MISS", "HIT", "HIT"], True)
+	first = results[0][1]
+	results = fetch_cached([endpoint]) + [("HIT", first)]
+	check_cached("Request within the ttl is a HIT with the cached body.", endpoint, results, ["HIT", "HIT"], True)
+	threading.Event().wait(1.1)
+	results = fetch_cached([endpoint] * 2, delay=0.1)
+	check_cached("Expired entry is served STALE while it is updated.", endpoint, results, ["MISS", "STALE"], False)
+	endpoint = "/cgi-cached/stamp.py?cache-control=no-store"
+	results = fetch_cached([endpoint] * 2, delay=0.7)
+	check_cached("Cache-Control: no-store is not cached.", endpoint, results, ["MISS", "BYPASS"], False)
+	endpoint = "/cgi-cached/stamp.py?cache-control=max-age=5"
+	results = fetch_cached([endpoint])
+	threading.Event().wait(1.1)
+	results += fetch_cached([endpoint])
+	check_cached("Cache-Control: max-age overrides cgi_cache_ttl.", endpoint, results, ["MISS", "HIT"], True)
+	endpoint = "/cgi-cached/stamp.py"
+	results = fetch_cached([endpoint], method="POST")
+	check_cached("POST bypasses the cache.", endpoint, results, ["BYPASS"], True)
+
+# Utility function for the access log tests: the lines the server wrote to a log file
+def read_log(path):
+	threading.Event().wait(0.3)	# flush=100ms
+	try:
+		with open(path) as log:
+			return log.read().splitlines()
+	except OSError:
+		return []
+
+# Testing the access log: combined format, and SIGUSR1 reopens the file after it was rotated
+def test_access_log():
+	print("\nAccess Log")
+	endpoint = "/?access-log=combined"
+	make_request("Request to log.", "GET", endpoint, headers={"User-Agent": "tester", "Referer": "http://ref/"},
+		expected_status=200)
+	lines = [line for line in read_log(ACCESS_LOG) if "access-log=combined" in line]
+	combined = re.compile(r'^127\.0\.0\.1 - - \[\d{2}/\w{3}/\d{4}:\d{2}:\d{2}:\d{2} [+-]\d{4}\] '
+		r'"GET /\?access-log=combined HTTP/1\.1" 200 \d+ "http://ref/" "tester" \d+\.\d{3}$')
+	success = len(lines) >= 1 and combined.match(lines[-1]) is not None
+	print_result("Access log line in the combined format.", success, "GET", endpoint)
+	if not success:
+		print(f"{Fore.RED}   Got: {lines[-1:]}\n")
+	rotated = ACCESS_LOG + ".1"
+	try:
+		os.replace(ACCESS_LOG, rotated)
+		signal_server(signal.SIGUSR1)
+		threading.Event().wait(0.2)
+		endpoint = "/?access-log=reopen-" + RUN_ID
+		make_request("Request after rotating the log.", "GET", endpoint, expected_status=200)
+		reopened = any(endpoint in line for line in read_log(ACCESS_LOG))
+		rotated_only = not any(endpoint in line for line in read_log(rotated))
+		print_result("SIGUSR1 reopens the access log.", reopened and rotated_only, "GET", endpoint)
+	except (OSError, subprocess.CalledProcessError) as e:
+		print_result("SIGUSR1 reopens the access log.", False, "GET", endpoint)
+		print(f"{Fore.RED}   Error: {e}")
+	finally:
+		if os.path.exists(rotated):
+			os.remove(rotated)
+
+# Testing the slow log: only requests over the threshold, with the time spent in each phase
+def test_slow_log():
+	print("\nSlow Log")
+	endpoint = "/cgi-limited/sleep.py?slow-log=slow-" + RUN_ID
+	_, before = scrape_metrics()
+	make_request("Slow request.", "GET", endpoint, expected_status=200)
+	make_request("Fast request.", "GET", "/?slow-log=fast-" + RUN_ID, expected_status=200)
+	_, after = scrape_metrics()
+	threading.Event().wait(1.0)
+	lines = [line for line in read_log(SLOW_LOG) if f"-{RUN_ID} HTTP/" in line]
+	phases = r" ".join(rf"{phase}=(?:\d+\.\d{{3}}ms|-)" for phase in
+		["header", "body", "dispatch", "handler", "response_start", "send"])
+	slow = re.compile(r'^\[\d{2}/\w{3}/\d{4}:\d{2}:\d{2}:\d{2} [+-]\d{4}\] 127\.0\.0\.1 '
+		r'"GET ' + re.escape(endpoint) + r' HTTP/1\.1" 200 total=\d+\.\d{3}ms wait=\d+\.\d{3}ms ' + phases + "$")
+	handler = re.search(r" handler=(\d+)\.", lines[0]) if len(lines) == 1 else None
+	success = len(lines) == 1 and slow.match(lines[0]) is not None and handler and int(handler.group(1)) >= 900
+	print_result("Only the slow request is logged, with its phases.", success, "GET", endpoint)
+	if not success:
+		print(f"{Fore.RED}   Got: {lines}\n")
+	handled = 'webserv_request_phase_seconds_count{phase="handler"}'
+	success = after.get(handled, 0) - before.get(handled, 0) == 3
+	print_result("Phases are recorded in the metrics.", success, "GET", "/metrics")
+
+# Utility function for the metrics tests: the samples of a scrape of /metrics, by name and labels
+def scrape_metrics():
+	response = requests.get(BASE_URL + "/metrics")
+	samples = {}
+	for line in response.text.splitlines():
+		if line and not line.startswith("#"):
+			name, value = line.rsplit(" ", 1)
+			samples[name] = float(value)
+	return response, samples
+
+# Testing the metrics location: the Prometheus text format, and the counters of the requests in between scrapes
+def test_metrics():
+	print("\nMetrics")
+	endpoint = "/metrics"
+	response, before = scrape_metrics()
+	success = response.status_code == 200 and response.headers.get("Content-Type", "").startswith("text/plain") \
+		and "# TYPE webserv_request_duration_seconds histogram" in response.text
+	print_result("Metrics are served in the Prometheus text format.", success, "GET", endpoint)
+	make_request("Request to count.", "GET", "/", expected_status=200)
+	make_request("Request to count.", "GET", "/nonexistent", expected_status=404)
+	_, after = scrape_metrics()
+	route = 'server="0.0.0.0:8080",route="/"'
+	def delta(name):
+		return after.get(name, 0) - before.get(name, 0)
+	success = delta(f'webserv_requests_total{{{route},code="2xx"}}') == 1 \
+		and delta(f'webserv_requests_total{{{route},code="4xx"}}') == 1
+	print_result("Requests are counted per route and status class.", success, "GET", endpoint)
+	success = delta(f'webserv_request_duration_seconds_count{{{route}}}') == 2 \
+		and delta(f'webserv_request_duration_seconds_bucket{{{route},le="+Inf"}}') == 2
+	print_result("Latencies are recorded in the histogram.", success, "GET", endpoint)
+	success = delta("webserv_connections_accepted_total") >= 2 and delta("webserv_sent_bytes_total") > 0
+	print_result("Connections and bytes are counted.", success, "GET", endpoint)
+	make_request("Metrics location only answers GET.", "POST", endpoint, data="x", expected_status=405)
+
+# Testing the connection table: a connection that sent half a request header is listed with what it buffered
+def test_connection_table():
+	print("\nConnection Table")
+	endpoint = "/connections"
+	partial = b"GET /partial HTTP/1.1\r\nHost: localhost\r\n"
+	with socket.create_connection(("localhost", 8080)) as client:
+		client.sendall(partial)
+		threading.Event().wait(0.2)
+		response = make_request("Connection table is listed.", "GET", endpoint, expected_status=200,
+			expected_headers={"Transfer-Encoding": "chunked"}, expected_body="cgi_state request")
+		peer = f"127.0.0.1:{client.getsockname()[1]}"
+		rows = [line.split() for line in (response.text if response else "").splitlines()]
+		row = next((row for row in rows if len(row) > 1 and row[1] == peer), None)
+		success = row is not None and row[2] == "HEADER" and row[5] == str(len(partial)) and row[-1] == "-"
+		print_result("Connection reading its header is listed with the buffered bytes.", success, "GET", endpoint)
+		if not success:
+			print(f"{Fore.RED}   Got: {row}\n")
+
+# Utility function for the reload test: the paths of the files a process has open
+def open_files(pid):
+	paths = set()
+	for fd in os.listdir(f"/proc/{pid}/fd"):
+		try:
+			paths.add(os.readlink(f"/proc/{pid}/fd/{fd}"))
+		except OSError:
+			pass
+	return paths
+
+# Testing the configuration reload: SIGHUP applies a changed tester.conf to an open connection and closes the log
+# files it no longer uses, an invalid one is ignored. The original file is restored at the end.
+def test_reload():
+	print("\nConfiguration Reload")
+	endpoint = "/reloaded"
+	with open("tester.conf") as conf:
+		original = conf.read()
+	location = "\n        location /reloaded {\n            allow_methods GET;\n            return 301 /reload-ok;\n        }\n"
+	marker = "        location /upload {"
+	moved_slow_log = SLOW_LOG + ".reloaded"
+	connection = http.client.HTTPConnection("localhost", 8080, timeout=5)
+	def get_on_connection():
+		connection.request("GET", endpoint)
+		response = connection.getresponse()
+		response.read()
+		return response.status, response.getheader("Location")
+	def reload(content):
+		with open("tester.conf", "w") as conf:
+			conf.write(content)
+		signal_server(signal.SIGHUP)
+		threading.Event().wait(0.3)
+	try:
+		before = get_on_connection()
+		reload(original.replace(marker, location.lstrip("\n") + "\n" + marker, 1).replace(SLOW_LOG, moved_slow_log))
+		after = get_on_connection()
+		success = before[0] == 404 and after == (301, "/reload-ok")
+		print_result("SIGHUP applies the new configuration to an open connection.", success, "GET", endpoint)
+		if not success:
+			print(f"{Fore.RED}   Before: {before}, after: {after}\n")
+		files = open_files(signal_server(0))
+		success = moved_slow_log in files and SLOW_LOG not in files
+		print_result("SIGHUP closes the log files the new configuration does not use.", success)
+		if not success:
+			print(f"{Fore.RED}   Open files: {sorted(files)}\n")
+		reload("http { server { listen 8080; unknown_directive; } }\n")
+		make_request("Invalid configuration keeps the running one.", "GET", endpoint, expected_status=301,
+			expected_headers={"Location": "/reload-ok"})
+	except (OSError, http.client.HTTPException, subprocess.CalledProcessError) as e:
+		print_result("SIGHUP reloads the configuration.", False, "GET", endpoint)
+		print(f"{Fore.RED}   Error: {e}")
+	finally:
+		connection.close()
+		reload(original)
+	make_request("Restored configuration.", "GET", endpoint, expected_status=404)
+
+# Utility function for the upgrade test: an exited process may be listed until its parent reaps it
+def is_running(pid):
+	try:
+		with open(f"/proc/{int(pid)}/stat") as stat:
+			return stat.read().rsplit(")", 1)[1].split()[0] != "Z"
+	except OSError:
+		return False
+
+# Testing the binary upgrade: SIGALRM starts a new webserv that takes over the listening socket, the old one
+# answers the request in progress with Connection: close and exits. Runs last, the server has a new pid after it.
+def test_upgrade():
+	print("\nBinary Upgrade")
+	endpoint = "/cgi-limited/sleep.py"
+	try:
+		old_pid = signal_server(0)
+		in_progress = []
+		request = threading.Thread(target=lambda: in_progress.append(requests.get(BASE_URL + endpoint)))
+		request.start()
+		threading.Event().wait(0.3)
+		os.kill(old_pid, signal.SIGALRM)
+		request.join()
+		response = in_progress[0] if in_progress else None
+		success = response is not None and response.status_code == 200 and response.headers.get("Connection") == "close"
+		print_result("Request in progress is answered with Connection: close.", success, "GET", endpoint)
+		threading.Event().wait(1.5)
+		pids = [int(pid) for pid in subprocess.check_output(["pgrep", "-x", "webserv"]).split() if is_running(pid)]
+		success = len(pids) == 1 and pids[0] != old_pid
+		print_result("Old process exits, the new one keeps serving.", success, "GET", endpoint)
+		if not success:
+			print(f"{Fore.RED}   Old pid: {old_pid}, running: {pids}\n")
+		make_request("Request to the new process.", "GET", "/", expected_status=200)
+	except (OSError, requests.exceptions.RequestException, subprocess.CalledProcessError) as e:
+		print_result("SIGALRM upgrades the binary.", False, "GET", endpoint)
+		print(f"{Fore.RED}   Error: {e}")
+
 # General invalid tests
 def test_invalid_requests():
 	print("\nGeneral Invalid Tests")
@@ -91,5 +575,21 @@ if __name__ == "__main__":
 	# test_delete_requests()
 	# test_cgi_requests()
 	# test_invalid_requests()
+	test_chunked_requests()
+	test_cgi_request_body()
+	test_virtual_hosts()
+	test_locations()
+	test_mime_types()
+	test_add_header()
+	test_json_autoindex()
+	test_access_log()
+	test_proxy_requests()
+	test_cgi_limiter()
+	test_cgi_cache()
+	test_metrics()
+	test_slow_log()
+	test_connection_table()
+	test_reload()
+	test_upgrade()
 	make_request("GET request with local root.", "GET", "/local-root/index.html", expected_status=200)
 	print("\nAll tests completed.")
@@ -0,0 +1,14 @@
+#!/usr/bin/python3
+import os
+import time
+
+# Slow enough for concurrent requests to overlap, the body tells the runs apart
+time.sleep(0.5)
+cache_control = os.getenv("QUERY_STRING", "").partition("cache-control=")[2]
+
+print("HTTP/1.1 200 OK")
+print("Content-Type: text/plain")
+if cache_control:
+	print(f"Cache-Control: {cache_control}")
+print()
+print(time.time_ns())
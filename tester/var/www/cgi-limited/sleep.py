@@ -0,0 +1,9 @@
+#!/usr/bin/python3
+import time
+
+# Keep the only slot of the location busy for a while
+time.sleep(1)
+
+print("Content-Type: text/plain")
+print()
+print("done")